@@ -170,6 +170,17 @@ public class Collectd
   native public static int registerWrite (String name,
       CollectdWriteInterface object);
 
+  /**
+   * Registers a write callback which receives value lists in batches of up
+   * to {@code size} elements. A flush callback with the same name is
+   * registered automatically.
+   *
+   * @return Zero when successful, non-zero otherwise.
+   * @see CollectdWriteBatchInterface
+   */
+  native public static int registerWriteBatch (String name,
+      CollectdWriteBatchInterface object, int size);
+
   /**
    * Java representation of collectd/src/plugin.h:plugin_register_flush
    *
@@ -231,6 +242,14 @@ public class Collectd
    */
   native public static int dispatchValues (ValueList vl);
 
+  /**
+   * Dispatches all value lists of the array with a single native call.
+   *
+   * @return Zero when successful, the number of value lists which could not
+   * be dispatched otherwise.
+   */
+  native public static int dispatchValues (ValueList[] vl);
+
   /**
    * Java representation of collectd/src/plugin.h:plugin_dispatch_notification
    *
@@ -39,9 +39,9 @@
 /*
  * Global variables
  */
-char hostname_g[DATA_MAX_NAME_LEN];
-int  interval_g;
-int  timeout_g;
+char     hostname_g[DATA_MAX_NAME_LEN];
+cdtime_t interval_g;
+int      timeout_g;
 #if HAVE_LIBKSTAT
 kstat_ctl_t *kc;
 #endif /* HAVE_LIBKSTAT */
@@ -141,14 +141,13 @@ static int init_global_variables (void)
 	str = global_option_get ("Interval");
 	if (str == NULL)
 		str = "10";
-	interval_g = atoi (str);
-	if (interval_g <= 0)
+	if ((parse_cdtime (str, &interval_g) != 0) || (interval_g == 0))
 	{
 		fprintf (stderr, "Cannot set the interval to a correct value.\n"
 				"Please check your settings.\n");
 		return (-1);
 	}
-	DEBUG ("interval_g = %i;", interval_g);
+	DEBUG ("interval_g = %.3f;", CDTIME_T_TO_DOUBLE (interval_g));
 
 	str = global_option_get ("Timeout");
 	if (str == NULL)
@@ -315,22 +314,14 @@ static int do_init (void)
 
 static int do_loop (void)
 {
-	struct timeval tv_now;
-	struct timeval tv_next;
-	struct timeval tv_wait;
-	struct timespec ts_wait;
+	cdtime_t wait_until;
+
+	wait_until = cdtime () + interval_g;
 
 	while (loop == 0)
 	{
-		if (gettimeofday (&tv_next, NULL) < 0)
-		{
-			char errbuf[1024];
-			ERROR ("gettimeofday failed: %s",
-					sstrerror (errno, errbuf,
-						sizeof (errbuf)));
-			return (-1);
-		}
-		tv_next.tv_sec += interval_g;
+		struct timespec ts_wait = { 0, 0 };
+		cdtime_t now;
 
 #if HAVE_LIBKSTAT
 		update_kstat ();
@@ -339,25 +330,24 @@ static int do_loop (void)
 		/* Issue all plugins */
 		plugin_read_all ();
 
-		if (gettimeofday (&tv_now, NULL) < 0)
-		{
-			char errbuf[1024];
-			ERROR ("gettimeofday failed: %s",
-					sstrerror (errno, errbuf,
-						sizeof (errbuf)));
-			return (-1);
-		}
-
-		if (timeval_cmp (tv_next, tv_now, &tv_wait) <= 0)
+		now = cdtime ();
+		if (now >= wait_until)
 		{
 			WARNING ("Not sleeping because the next interval is "
-					"%i.%06i seconds in the past!",
-					(int) tv_wait.tv_sec, (int) tv_wait.tv_usec);
+					"%.3f seconds in the past!",
+					CDTIME_T_TO_DOUBLE (now - wait_until));
+			wait_until = now + interval_g;
 			continue;
 		}
+		else if ((wait_until - now) > interval_g)
+		{
+			/* The clock has been stepped backwards. Don't sleep
+			 * longer than one interval. */
+			wait_until = now + interval_g;
+		}
 
-		ts_wait.tv_sec  = tv_wait.tv_sec;
-		ts_wait.tv_nsec = (long) (1000 * tv_wait.tv_usec);
+		CDTIME_T_TO_TIMESPEC (wait_until - now, &ts_wait);
+		wait_until = wait_until + interval_g;
 
 		while ((loop == 0) && (nanosleep (&ts_wait, &ts_wait) == -1))
 		{
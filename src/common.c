@@ -931,9 +931,9 @@ int parse_values (char *buffer, value_list_t *vl, const data_set_t *ds)
 		if (i == -1)
 		{
 			if (strcmp ("N", ptr) == 0)
-				vl->time = time (NULL);
-			else
-				vl->time = (time_t) atoi (ptr);
+				vl->time = cdtime ();
+			else if (parse_cdtime (ptr, &vl->time) != 0)
+				return (-1);
 		}
 		else
 		{
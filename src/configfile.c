@@ -101,7 +101,9 @@ static cf_global_option_t cf_global_options[] =
 	{"ReadThreads", NULL, "5"},
 	{"Timeout",     NULL, "2"},
 	{"PreCacheChain",  NULL, "PreCache"},
-	{"PostCacheChain", NULL, "PostCache"}
+	{"PostCacheChain", NULL, "PostCache"},
+	{"NotificationQueueLength", NULL, "1024"},
+	{"NotificationCoalesceInterval", NULL, "0"}
 };
 static int cf_global_options_num = STATIC_ARRAY_LEN (cf_global_options);
 
@@ -1002,6 +1004,30 @@ int cf_util_get_int (const oconfig_item_t *ci, int *ret_value) /* {{{ */
 	return (0);
 } /* }}} int cf_util_get_int */
 
+int cf_util_get_cdtime (const oconfig_item_t *ci, cdtime_t *ret_value) /* {{{ */
+{
+	if ((ci == NULL) || (ret_value == NULL))
+		return (EINVAL);
+
+	if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_NUMBER))
+	{
+		ERROR ("cf_util_get_cdtime: The %s option requires "
+				"exactly one numeric argument.", ci->key);
+		return (-1);
+	}
+
+	if (ci->values[0].value.number < 0.0)
+	{
+		ERROR ("cf_util_get_cdtime: The numeric argument of the %s "
+				"option must not be negative.", ci->key);
+		return (-1);
+	}
+
+	*ret_value = DOUBLE_TO_CDTIME_T (ci->values[0].value.number);
+
+	return (0);
+} /* }}} int cf_util_get_cdtime */
+
 int cf_util_get_boolean (const oconfig_item_t *ci, _Bool *ret_bool) /* {{{ */
 {
 	if ((ci == NULL) || (ret_bool == NULL))
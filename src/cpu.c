@@ -29,6 +29,10 @@
 #include "common.h"
 #include "plugin.h"
 
+#if KERNEL_LINUX
+# include "utils_procfs.h"
+#endif
+
 #ifdef HAVE_MACH_KERN_RETURN_H
 # include <mach/kern_return.h>
 #endif
@@ -113,7 +117,7 @@ static int cpu_temp_retry_max     = 1;
 /* #endif PROCESSOR_CPU_LOAD_INFO */
 
 #elif defined(KERNEL_LINUX)
-/* no variables needed */
+static cu_procfs_t *proc_stat = NULL;
 /* #endif KERNEL_LINUX */
 
 #elif defined(HAVE_LIBKSTAT)
@@ -163,7 +167,7 @@ static int init (void)
 	DEBUG ("host_processors returned %i %s", (int) cpu_list_len, cpu_list_len == 1 ? "processor" : "processors");
 	INFO ("cpu plugin: Found %i processor%s.", (int) cpu_list_len, cpu_list_len == 1 ? "" : "s");
 
-	cpu_temp_retry_max = 86400 / interval_g;
+	cpu_temp_retry_max = (int) (86400.0 / CDTIME_T_TO_DOUBLE (interval_g));
 /* #endif PROCESSOR_CPU_LOAD_INFO */
 
 #elif defined(HAVE_LIBKSTAT)
@@ -354,36 +358,48 @@ static int cpu_read (void)
 	int cpu;
 	counter_t user, nice, syst, idle;
 	counter_t wait, intr, sitr; /* sitr == soft interrupt */
-	FILE *fh;
-	char buf[1024];
+	char *buffer;
+	char *line;
 
 	char *fields[9];
 	int numfields;
 
-	if ((fh = fopen ("/proc/stat", "r")) == NULL)
+	if (proc_stat == NULL)
+	{
+		proc_stat = cu_procfs_create ("/proc/stat");
+		if (proc_stat == NULL)
+		{
+			char errbuf[1024];
+			ERROR ("cpu plugin: open (/proc/stat) failed: %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			return (-1);
+		}
+	}
+
+	if ((buffer = cu_procfs_read (proc_stat, NULL)) == NULL)
 	{
 		char errbuf[1024];
-		ERROR ("cpu plugin: fopen (/proc/stat) failed: %s",
+		ERROR ("cpu plugin: reading /proc/stat failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buf, 1024, fh) != NULL)
+	while ((line = cu_procfs_line (&buffer)) != NULL)
 	{
-		if (strncmp (buf, "cpu", 3))
+		if (strncmp (line, "cpu", 3))
 			continue;
-		if ((buf[3] < '0') || (buf[3] > '9'))
+		if ((line[3] < '0') || (line[3] > '9'))
 			continue;
 
-		numfields = strsplit (buf, fields, 9);
+		numfields = cu_procfs_fields (line, fields, 9);
 		if (numfields < 5)
 			continue;
 
 		cpu = atoi (fields[0] + 3);
-		user = atoll (fields[1]);
-		nice = atoll (fields[2]);
-		syst = atoll (fields[3]);
-		idle = atoll (fields[4]);
+		user = cu_procfs_u64 (fields[1]);
+		nice = cu_procfs_u64 (fields[2]);
+		syst = cu_procfs_u64 (fields[3]);
+		idle = cu_procfs_u64 (fields[4]);
 
 		submit (cpu, "user", user);
 		submit (cpu, "nice", nice);
@@ -392,20 +408,18 @@ static int cpu_read (void)
 
 		if (numfields >= 8)
 		{
-			wait = atoll (fields[5]);
-			intr = atoll (fields[6]);
-			sitr = atoll (fields[7]);
+			wait = cu_procfs_u64 (fields[5]);
+			intr = cu_procfs_u64 (fields[6]);
+			sitr = cu_procfs_u64 (fields[7]);
 
 			submit (cpu, "wait", wait);
 			submit (cpu, "interrupt", intr);
 			submit (cpu, "softirq", sitr);
 
 			if (numfields >= 9)
-				submit (cpu, "steal", atoll (fields[8]));
+				submit (cpu, "steal", cu_procfs_u64 (fields[8]));
 		}
 	}
-
-	fclose (fh);
 /* #endif defined(KERNEL_LINUX) */
 
 #elif defined(HAVE_LIBKSTAT)
@@ -601,8 +615,21 @@ static int cpu_read (void)
 	return (0);
 }
 
+#if KERNEL_LINUX
+static int cpu_shutdown (void)
+{
+	cu_procfs_destroy (proc_stat);
+	proc_stat = NULL;
+
+	return (0);
+} /* int cpu_shutdown */
+#endif /* KERNEL_LINUX */
+
 void module_register (void)
 {
 	plugin_register_init ("cpu", init);
 	plugin_register_read ("cpu", cpu_read);
+#if KERNEL_LINUX
+	plugin_register_shutdown ("cpu", cpu_shutdown);
+#endif
 } /* void module_register */
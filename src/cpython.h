@@ -160,6 +160,8 @@ static inline PyObject *cpy_string_to_unicode_or_bytes(const char *buf) {
 }
 
 void cpy_log_exception(const char *context);
+PyObject *cpy_build_values_list(const data_set_t *ds, const value_list_t *value_list);
+PyObject *cpy_build_meta_dict(meta_data_t *meta);
 
 /* Python object declarations. */
 
@@ -188,7 +190,7 @@ typedef struct {
 	PluginData data;
 	PyObject *values;    /* Sequence */
 	PyObject *meta;      /* dict */
-	int interval;
+	double interval;
 } Values;
 PyTypeObject ValuesType;
 #define Values_New() PyObject_CallFunctionObjArgs((PyObject *) &ValuesType, (void *) 0)
@@ -207,3 +209,18 @@ PyTypeObject SignedType;
 typedef PyLongObject Unsigned;
 PyTypeObject UnsignedType;
 
+typedef struct {
+	PyObject_HEAD        /* No semicolon! */
+	value_list_t *vl;    /* Array, owned */
+	const data_set_t **ds;
+	Py_ssize_t size;
+} ValuesBatch;
+PyTypeObject ValuesBatchType;
+PyObject *ValuesBatch_New(value_list_t *vl, const data_set_t **ds, size_t size);
+
+typedef struct {
+	PyObject_HEAD        /* No semicolon! */
+	ValuesBatch *batch;
+	Py_ssize_t index;
+} ValueView;
+PyTypeObject ValueViewType;
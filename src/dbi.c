@@ -463,6 +463,7 @@ static int cdbi_read_database_query (cdbi_database_t *db, /* {{{ */
   size_t column_num;
   char **column_names;
   char **column_values;
+  struct timeval begin;
   int status;
   size_t i;
 
@@ -481,6 +482,7 @@ static int cdbi_read_database_query (cdbi_database_t *db, /* {{{ */
   statement = udb_query_get_statement (q);
   assert (statement != NULL);
 
+  gettimeofday (&begin, /* timezone = */ NULL);
   res = dbi_conn_query (db->connection, statement);
   if (res == NULL)
   {
@@ -635,6 +637,9 @@ static int cdbi_read_database_query (cdbi_database_t *db, /* {{{ */
   /* Tell the db query interface that we're done with this query. */
   udb_query_finish_result (q, prep_area);
 
+  udb_query_submit_time (q, hostname_g, /* plugin = */ "dbi", db->name,
+      /* interval = */ -1, &begin);
+
   /* Clean up and return `status = 0' (success) */
   BAIL_OUT (0);
 #undef BAIL_OUT
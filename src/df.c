@@ -27,6 +27,14 @@
 #include "configfile.h"
 #include "utils_mount.h"
 #include "utils_ignorelist.h"
+#include "utils_avltree.h"
+#include "utils_complain.h"
+
+#include <pthread.h>
+
+#if HAVE_POLL_H
+# include <poll.h>
+#endif
 
 #if HAVE_STATVFS
 # if HAVE_SYS_STATVFS_H
@@ -46,6 +54,53 @@
 # error "No applicable input method."
 #endif
 
+#define DF_THREADS_DEFAULT 4
+#define DF_TIMEOUT_DEFAULT 2.0
+/* Maximum number of additional threads started to replace threads which
+ * are stuck in calls to STATANYFS. */
+#define DF_HUNG_MAX 32
+
+/*
+ * The list of mount points is only re-read when the mount table changes.
+ * STATANYFS is called by a pool of threads, once per file system: mount
+ * points showing the same device number (bind mounts) share the result of
+ * the first one. If a call doesn't return within `Timeout' seconds, the
+ * mount point is skipped until the call returns.
+ */
+#define DF_QUEUED  0x01
+#define DF_RUNNING 0x02
+#define DF_HUNG    0x04
+#define DF_REMOVED 0x08
+
+struct df_mount_s;
+typedef struct df_mount_s df_mount_t;
+struct df_mount_s
+{
+	char *dir;
+	char *device;
+	char *type;
+	char disk_name[256];
+
+	/* All of the following is protected by `df_lock'. */
+	int flags;
+	dev_t dev;
+	_Bool dev_known;
+	/* Mount point of the same file system whose results are used. */
+	df_mount_t *primary;
+
+	uint64_t round;
+	int status;
+#if HAVE_STATVFS
+	struct statvfs statbuf;
+#elif HAVE_STATFS
+	struct statfs statbuf;
+#endif
+	c_complain_t complaint;
+
+	df_mount_t *next;
+	df_mount_t *job_next;
+};
+
 static const char *config_keys[] =
 {
 	"Device",
@@ -54,7 +109,10 @@ static const char *config_keys[] =
 	"IgnoreSelected",
 	"ReportByDevice",
 	"ReportReserved",
-	"ReportInodes"
+	"ReportInodes",
+	"IgnoreDuplicates",
+	"Threads",
+	"Timeout"
 };
 static int config_keys_num = STATIC_ARRAY_SIZE (config_keys);
 
@@ -65,6 +123,27 @@ static ignorelist_t *il_fstype = NULL;
 static _Bool by_device = false;
 static _Bool report_reserved = false;
 static _Bool report_inodes = false;
+static _Bool ignore_duplicates = false;
+
+static int df_threads_num = DF_THREADS_DEFAULT;
+static double df_timeout = DF_TIMEOUT_DEFAULT;
+
+static df_mount_t *df_mounts = NULL;
+static _Bool df_mounts_valid = false;
+#if KERNEL_LINUX && HAVE_POLL_H
+static int df_mounts_fd = -1;
+#endif
+
+static df_mount_t *job_head = NULL;
+static df_mount_t *job_tail = NULL;
+static uint64_t df_round = 0;
+static int df_pending = 0;
+static int df_threads_running = 0;
+static int df_threads_hung = 0;
+static _Bool df_shutdown_flag = false;
+static pthread_mutex_t df_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t df_job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t df_done_cond = PTHREAD_COND_INITIALIZER;
 
 static int df_init (void)
 {
@@ -141,6 +220,37 @@ static int df_config (const char *key, const char *value)
 
 		return (0);
 	}
+	else if (strcasecmp (key, "IgnoreDuplicates") == 0)
+	{
+		if (IS_TRUE (value))
+			ignore_duplicates = true;
+		else
+			ignore_duplicates = false;
+
+		return (0);
+	}
+	else if (strcasecmp (key, "Threads") == 0)
+	{
+		int tmp = atoi (value);
+		if (tmp < 1)
+		{
+			WARNING ("df plugin: Invalid number of threads: %s", value);
+			return (1);
+		}
+		df_threads_num = tmp;
+		return (0);
+	}
+	else if (strcasecmp (key, "Timeout") == 0)
+	{
+		double tmp = atof (value);
+		if (tmp <= 0.0)
+		{
+			WARNING ("df plugin: Invalid timeout: %s", value);
+			return (1);
+		}
+		df_timeout = tmp;
+		return (0);
+	}
 
 
 	return (-1);
@@ -193,16 +303,100 @@ static void df_submit_one (char *plugin_instance,
 	plugin_dispatch_values (&vl);
 } /* void df_submit_one */
 
-static int df_read (void)
+static void df_mount_free (df_mount_t *m) /* {{{ */
 {
-#if HAVE_STATVFS
-	struct statvfs statbuf;
-#elif HAVE_STATFS
-	struct statfs statbuf;
+	if (m == NULL)
+		return;
+
+	sfree (m->dir);
+	sfree (m->device);
+	sfree (m->type);
+	sfree (m);
+} /* }}} void df_mount_free */
+
+/* Returns true if the mount table may have changed since the last call. */
+static _Bool df_mounts_changed (void) /* {{{ */
+{
+#if KERNEL_LINUX && HAVE_POLL_H
+	struct pollfd pfd;
+	int status;
+
+	/* The kernel signals POLLERR|POLLPRI on /proc/self/mounts whenever
+	 * the mount table changes. */
+	if (df_mounts_fd < 0)
+	{
+		df_mounts_fd = open ("/proc/self/mounts", O_RDONLY);
+		return (true);
+	}
+
+	memset (&pfd, 0, sizeof (pfd));
+	pfd.fd = df_mounts_fd;
+	pfd.events = POLLPRI;
+
+	status = poll (&pfd, 1, /* timeout = */ 0);
+	if (status < 0)
+		return (true);
+
+	return ((pfd.revents & (POLLERR | POLLPRI)) != 0);
+#else
+	return (true);
 #endif
-	/* struct STATANYFS statbuf; */
+} /* }}} _Bool df_mounts_changed */
+
+/* Sets the name used to report the mount point. Returns non-zero if the
+ * mount point should not be reported. */
+static int df_disk_name (cu_mount_t *mnt, char *buffer, /* {{{ */
+		size_t buffer_size)
+{
+	if (by_device)
+	{
+		/* eg, /dev/hda1  -- strip off the "/dev/" */
+		if (strncmp (mnt->spec_device, "/dev/", strlen ("/dev/")) == 0)
+			sstrncpy (buffer, mnt->spec_device + strlen ("/dev/"), buffer_size);
+		else
+			sstrncpy (buffer, mnt->spec_device, buffer_size);
+
+		if (strlen (buffer) < 1)
+		{
+			DEBUG ("df: no device name name for mountpoint %s, skipping", mnt->dir);
+			return (-1);
+		}
+	}
+	else
+	{
+		if (strcmp (mnt->dir, "/") == 0)
+		{
+			if (strcmp (mnt->type, "rootfs") == 0)
+				return (-1);
+			sstrncpy (buffer, "root", buffer_size);
+		}
+		else
+		{
+			int i, len;
+
+			sstrncpy (buffer, mnt->dir + 1, buffer_size);
+			len = strlen (buffer);
+
+			for (i = 0; i < len; i++)
+				if (buffer[i] == '/')
+					buffer[i] = '-';
+		}
+	}
+
+	return (0);
+} /* }}} int df_disk_name */
+
+/* Re-reads the list of mount points. Entries of mount points which are still
+ * mounted are reused, so that calls still running aren't started again. The
+ * caller must hold `df_lock'. */
+static int df_mounts_update (void) /* {{{ */
+{
 	cu_mount_t *mnt_list;
 	cu_mount_t *mnt_ptr;
+	c_avl_tree_t *old;
+	df_mount_t *new_head = NULL;
+	df_mount_t *new_tail = NULL;
+	df_mount_t *m;
 
 	mnt_list = NULL;
 	if (cu_mount_getlist (&mnt_list) == NULL)
@@ -211,157 +405,491 @@ static int df_read (void)
 		return (-1);
 	}
 
+	old = c_avl_create ((void *) strcmp);
+	if (old == NULL)
+	{
+		cu_mount_freelist (mnt_list);
+		return (-1);
+	}
+	for (m = df_mounts; m != NULL; m = m->next)
+		c_avl_insert (old, m->dir, m);
+
 	for (mnt_ptr = mnt_list; mnt_ptr != NULL; mnt_ptr = mnt_ptr->next)
 	{
-		unsigned long long blocksize;
+		const char *device;
 		char disk_name[256];
 
-		if (ignorelist_match (il_device,
-					(mnt_ptr->spec_device != NULL)
-					? mnt_ptr->spec_device
-					: mnt_ptr->device))
+		device = (mnt_ptr->spec_device != NULL)
+			? mnt_ptr->spec_device : mnt_ptr->device;
+
+		if (ignorelist_match (il_device, device))
 			continue;
 		if (ignorelist_match (il_mountpoint, mnt_ptr->dir))
 			continue;
 		if (ignorelist_match (il_fstype, mnt_ptr->type))
 			continue;
 
-		if (STATANYFS (mnt_ptr->dir, &statbuf) < 0)
-		{
-			char errbuf[1024];
-			ERROR (STATANYFS_STR"(%s) failed: %s",
-					mnt_ptr->dir,
-					sstrerror (errno, errbuf,
-						sizeof (errbuf)));
-			continue;
-		}
-
-		if (!statbuf.f_blocks)
+		if (df_disk_name (mnt_ptr, disk_name, sizeof (disk_name)) != 0)
 			continue;
 
-		if (by_device) 
+		m = NULL;
+		if ((c_avl_get (old, mnt_ptr->dir, (void *) &m) == 0)
+				&& (strcmp (m->device, device) == 0)
+				&& (strcmp (m->type, mnt_ptr->type) == 0))
 		{
-			/* eg, /dev/hda1  -- strip off the "/dev/" */
-			if (strncmp (mnt_ptr->spec_device, "/dev/", strlen ("/dev/")) == 0)
-				sstrncpy (disk_name, mnt_ptr->spec_device + strlen ("/dev/"), sizeof (disk_name));
-			else
-				sstrncpy (disk_name, mnt_ptr->spec_device, sizeof (disk_name));
-
-			if (strlen(disk_name) < 1) 
+			c_avl_remove (old, mnt_ptr->dir, NULL, NULL);
+		}
+		else
+		{
+			m = (df_mount_t *) malloc (sizeof (*m));
+			if (m == NULL)
 			{
-				DEBUG("df: no device name name for mountpoint %s, skipping", mnt_ptr->dir);
+				ERROR ("df plugin: malloc failed.");
 				continue;
 			}
-		} 
-		else 
-		{
-			if (strcmp (mnt_ptr->dir, "/") == 0)
+			memset (m, 0, sizeof (*m));
+			m->dir = strdup (mnt_ptr->dir);
+			m->device = strdup (device);
+			m->type = strdup (mnt_ptr->type);
+			if ((m->dir == NULL) || (m->device == NULL)
+					|| (m->type == NULL))
 			{
-				if (strcmp (mnt_ptr->type, "rootfs") == 0)
-					continue;
-				sstrncpy (disk_name, "root", sizeof (disk_name));
+				ERROR ("df plugin: strdup failed.");
+				df_mount_free (m);
+				continue;
 			}
-			else
-			{
-				int i, len;
+			C_COMPLAIN_INIT (&m->complaint);
+		}
 
-				sstrncpy (disk_name, mnt_ptr->dir + 1, sizeof (disk_name));
-				len = strlen (disk_name);
+		sstrncpy (m->disk_name, disk_name, sizeof (m->disk_name));
+		/* A file system may have been mounted over. */
+		m->dev_known = false;
+		m->primary = NULL;
+		m->next = NULL;
 
-				for (i = 0; i < len; i++)
-					if (disk_name[i] == '/')
-						disk_name[i] = '-';
-			}
+		if (new_tail == NULL)
+			new_head = m;
+		else
+			new_tail->next = m;
+		new_tail = m;
+	}
+	cu_mount_freelist (mnt_list);
+
+	/* Free the entries of mount points which have gone. Entries still in
+	 * use by a thread are freed by that thread. */
+	while (42)
+	{
+		char *dir;
+
+		if (c_avl_pick (old, (void *) &dir, (void *) &m) != 0)
+			break;
+
+		if ((m->flags & DF_RUNNING) != 0)
+			m->flags |= DF_REMOVED;
+		else
+			df_mount_free (m);
+	}
+	c_avl_destroy (old);
+
+	df_mounts = new_head;
+	df_mounts_valid = true;
+	return (0);
+} /* }}} int df_mounts_update */
+
+static void *df_thread (void __attribute__((unused)) *arg) /* {{{ */
+{
+	pthread_mutex_lock (&df_lock);
+	while (42)
+	{
+		df_mount_t *m;
+		struct stat st;
+		_Bool need_dev;
+		int status;
+
+		while ((job_head == NULL) && !df_shutdown_flag)
+			pthread_cond_wait (&df_job_cond, &df_lock);
+
+		if (df_shutdown_flag)
+			break;
+
+		m = job_head;
+		job_head = m->job_next;
+		if (job_head == NULL)
+			job_tail = NULL;
+		m->job_next = NULL;
+		m->flags = (m->flags & ~DF_QUEUED) | DF_RUNNING;
+		need_dev = !m->dev_known;
+		pthread_mutex_unlock (&df_lock);
+
+		status = 0;
+		if (need_dev && (stat (m->dir, &st) != 0))
+			status = errno;
+		if ((status == 0) && (STATANYFS (m->dir, &m->statbuf) < 0))
+			status = errno;
+
+		pthread_mutex_lock (&df_lock);
+		m->flags &= ~DF_RUNNING;
+		m->status = status;
+		if ((status == 0) && need_dev)
+		{
+			m->dev = st.st_dev;
+			m->dev_known = true;
 		}
 
-		blocksize = BLOCKSIZE(statbuf);
+		if ((m->flags & DF_HUNG) != 0)
+		{
+			m->flags &= ~DF_HUNG;
+			df_threads_hung--;
+
+			if ((m->flags & DF_REMOVED) != 0)
+				df_mount_free (m);
+			else
+				c_release (LOG_NOTICE, &m->complaint, "df plugin: "
+						STATANYFS_STR"(%s) has returned again.",
+						m->dir);
 
-		if (report_reserved)
+			/* A replacement has been started for this thread. */
+			if ((df_threads_running - df_threads_hung) > df_threads_num)
+				break;
+		}
+		else if ((m->flags & DF_REMOVED) != 0)
 		{
-			uint64_t blk_free;
-			uint64_t blk_reserved;
-			uint64_t blk_used;
-
-			/*
-			 * Sanity-check for the values in the struct
-			 */
-			/* Check for negative "available" byes. For example UFS can
-			 * report negative free space for user. Notice. blk_reserved
-			 * will start to diminish after this. */
+			df_mount_free (m);
+		}
+		else
+		{
+			m->round = df_round;
+			df_pending--;
+			if (df_pending == 0)
+				pthread_cond_broadcast (&df_done_cond);
+		}
+	} /* while (42) */
+	df_threads_running--;
+	pthread_mutex_unlock (&df_lock);
+
+	return ((void *) 0);
+} /* }}} void *df_thread */
+
+/* Starts a thread for the pool. The caller must hold `df_lock'. */
+static int df_thread_start (void) /* {{{ */
+{
+	pthread_t tid;
+	pthread_attr_t attr;
+	int status;
+
+	pthread_attr_init (&attr);
+	pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+	status = pthread_create (&tid, &attr, df_thread, /* arg = */ NULL);
+	pthread_attr_destroy (&attr);
+	if (status != 0)
+	{
+		char errbuf[1024];
+		ERROR ("df plugin: pthread_create failed: %s",
+				sstrerror (status, errbuf, sizeof (errbuf)));
+		return (-1);
+	}
+
+	df_threads_running++;
+	return (0);
+} /* }}} int df_thread_start */
+
+static int df_compare_dev (const void *a, const void *b) /* {{{ */
+{
+	dev_t dev_a = *((const dev_t *) a);
+	dev_t dev_b = *((const dev_t *) b);
+
+	if (dev_a < dev_b)
+		return (-1);
+	else if (dev_a > dev_b)
+		return (1);
+	return (0);
+} /* }}} int df_compare_dev */
+
+static void df_submit_statbuf (char *disk_name, /* {{{ */
+#if HAVE_STATVFS
+		struct statvfs statbuf
+#elif HAVE_STATFS
+		struct statfs statbuf
+#endif
+		)
+{
+	unsigned long long blocksize;
+
+	blocksize = BLOCKSIZE(statbuf);
+
+	if (report_reserved)
+	{
+		uint64_t blk_free;
+		uint64_t blk_reserved;
+		uint64_t blk_used;
+
+		/*
+		 * Sanity-check for the values in the struct
+		 */
+		/* Check for negative "available" byes. For example UFS can
+		 * report negative free space for user. Notice. blk_reserved
+		 * will start to diminish after this. */
 #if HAVE_STATVFS
-			/* Cast and temporary variable are needed to avoid
-			 * compiler warnings.
-			 * ((struct statvfs).f_bavail is unsigned (POSIX)) */
-			int64_t signed_bavail = (int64_t) statbuf.f_bavail;
-			if (signed_bavail < 0)
-				statbuf.f_bavail = 0;
+		/* Cast and temporary variable are needed to avoid
+		 * compiler warnings.
+		 * ((struct statvfs).f_bavail is unsigned (POSIX)) */
+		int64_t signed_bavail = (int64_t) statbuf.f_bavail;
+		if (signed_bavail < 0)
+			statbuf.f_bavail = 0;
 #elif HAVE_STATFS
-			if (statbuf.f_bavail < 0)
-				statbuf.f_bavail = 0;
+		if (statbuf.f_bavail < 0)
+			statbuf.f_bavail = 0;
 #endif
-			/* Make sure that f_blocks >= f_bfree >= f_bavail */
-			if (statbuf.f_bfree < statbuf.f_bavail)
-				statbuf.f_bfree = statbuf.f_bavail;
-			if (statbuf.f_blocks < statbuf.f_bfree)
-				statbuf.f_blocks = statbuf.f_bfree;
-
-			blk_free = (uint64_t) statbuf.f_bavail;
-			blk_reserved = (uint64_t) (statbuf.f_bfree - statbuf.f_bavail);
-			blk_used = (uint64_t) (statbuf.f_blocks - statbuf.f_bfree);
-			
-			df_submit_one (disk_name, "df_complex", "free",
-					(gauge_t) (blk_free * blocksize));
-			df_submit_one (disk_name, "df_complex", "reserved",
-					(gauge_t) (blk_reserved * blocksize));
-			df_submit_one (disk_name, "df_complex", "used",
-					(gauge_t) (blk_used * blocksize));
+		/* Make sure that f_blocks >= f_bfree >= f_bavail */
+		if (statbuf.f_bfree < statbuf.f_bavail)
+			statbuf.f_bfree = statbuf.f_bavail;
+		if (statbuf.f_blocks < statbuf.f_bfree)
+			statbuf.f_blocks = statbuf.f_bfree;
+
+		blk_free = (uint64_t) statbuf.f_bavail;
+		blk_reserved = (uint64_t) (statbuf.f_bfree - statbuf.f_bavail);
+		blk_used = (uint64_t) (statbuf.f_blocks - statbuf.f_bfree);
+
+		df_submit_one (disk_name, "df_complex", "free",
+				(gauge_t) (blk_free * blocksize));
+		df_submit_one (disk_name, "df_complex", "reserved",
+				(gauge_t) (blk_reserved * blocksize));
+		df_submit_one (disk_name, "df_complex", "used",
+				(gauge_t) (blk_used * blocksize));
+	}
+	else /* compatibility code */
+	{
+		gauge_t df_free;
+		gauge_t df_used;
+
+		df_free = statbuf.f_bfree * blocksize;
+		df_used = (statbuf.f_blocks - statbuf.f_bfree) * blocksize;
+
+		df_submit_two (disk_name, "df", df_used, df_free);
+	}
+
+	/* inode handling */
+	if (report_inodes)
+	{
+		uint64_t inode_free;
+		uint64_t inode_reserved;
+		uint64_t inode_used;
+
+		/* Sanity-check for the values in the struct */
+		if (statbuf.f_ffree < statbuf.f_favail)
+			statbuf.f_ffree = statbuf.f_favail;
+		if (statbuf.f_files < statbuf.f_ffree)
+			statbuf.f_files = statbuf.f_ffree;
+
+		inode_free = (uint64_t) statbuf.f_favail;
+		inode_reserved = (uint64_t) (statbuf.f_ffree - statbuf.f_favail);
+		inode_used = (uint64_t) (statbuf.f_files - statbuf.f_ffree);
+
+		df_submit_one (disk_name, "df_inodes", "free",
+				(gauge_t) inode_free);
+		df_submit_one (disk_name, "df_inodes", "reserved",
+				(gauge_t) inode_reserved);
+		df_submit_one (disk_name, "df_inodes", "used",
+				(gauge_t) inode_used);
+	}
+} /* }}} void df_submit_statbuf */
+
+static int df_read (void)
+{
+	df_mount_t *m;
+	c_avl_tree_t *devs;
+	struct timeval tv;
+	struct timespec deadline;
+
+	pthread_mutex_lock (&df_lock);
+
+	if (!df_mounts_valid || df_mounts_changed ())
+	{
+		if (df_mounts_update () != 0)
+		{
+			pthread_mutex_unlock (&df_lock);
+			return (-1);
+		}
+	}
+
+	while ((df_threads_running - df_threads_hung) < df_threads_num)
+		if (df_thread_start () != 0)
+			break;
+	if (df_threads_running <= df_threads_hung)
+	{
+		pthread_mutex_unlock (&df_lock);
+		return (-1);
+	}
+
+	/* Queue one call per file system. */
+	df_round++;
+	df_pending = 0;
+	for (m = df_mounts; m != NULL; m = m->next)
+	{
+		if ((m->primary != NULL) || ((m->flags & DF_RUNNING) != 0))
+			continue;
+
+		m->flags |= DF_QUEUED;
+		m->job_next = NULL;
+		if (job_tail == NULL)
+			job_head = m;
+		else
+			job_tail->job_next = m;
+		job_tail = m;
+		df_pending++;
+	}
+	pthread_cond_broadcast (&df_job_cond);
+
+	gettimeofday (&tv, /* timezone = */ NULL);
+	deadline.tv_sec = tv.tv_sec + (time_t) df_timeout;
+	deadline.tv_nsec = (long) (tv.tv_usec * 1000)
+		+ (long) ((df_timeout - (double) ((time_t) df_timeout)) * 1e9);
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	while (df_pending > 0)
+		if (pthread_cond_timedwait (&df_done_cond, &df_lock,
+					&deadline) == ETIMEDOUT)
+			break;
+
+	/* Give up on calls which haven't returned yet. */
+	if (df_pending > 0)
+	{
+		job_head = NULL;
+		job_tail = NULL;
+
+		for (m = df_mounts; m != NULL; m = m->next)
+		{
+			if ((m->flags & DF_QUEUED) != 0)
+			{
+				m->flags &= ~DF_QUEUED;
+				m->job_next = NULL;
+			}
+			else if (((m->flags & DF_RUNNING) != 0)
+					&& ((m->flags & DF_HUNG) == 0))
+			{
+				m->flags |= DF_HUNG;
+				df_threads_hung++;
+				c_complain (LOG_WARNING, &m->complaint,
+						"df plugin: "STATANYFS_STR"(%s) didn't "
+						"return within %.3f seconds. Skipping "
+						"this mount point until it returns.",
+						m->dir, df_timeout);
+
+				if (df_threads_running < (df_threads_num + DF_HUNG_MAX))
+					df_thread_start ();
+			}
 		}
-		else /* compatibility code */
+		df_pending = 0;
+	}
+
+	devs = c_avl_create (df_compare_dev);
+
+	for (m = df_mounts; m != NULL; m = m->next)
+	{
+		df_mount_t *src = m;
+
+		if (m->primary == NULL)
 		{
-			gauge_t df_free;
-			gauge_t df_used;
+			df_mount_t *first = NULL;
+
+			if ((m->round != df_round) || ((m->flags & DF_RUNNING) != 0))
+				continue;
 
-			df_free = statbuf.f_bfree * blocksize;
-			df_used = (statbuf.f_blocks - statbuf.f_bfree) * blocksize;
+			if (m->status != 0)
+			{
+				char errbuf[1024];
+				ERROR (STATANYFS_STR"(%s) failed: %s",
+						m->dir,
+						sstrerror (m->status, errbuf,
+							sizeof (errbuf)));
+				continue;
+			}
 
-			df_submit_two (disk_name, "df", df_used, df_free);
+			/* Bind mounts share the device number. */
+			if ((devs != NULL) && m->dev_known)
+			{
+				if (c_avl_get (devs, &m->dev, (void *) &first) == 0)
+					m->primary = first;
+				else
+					c_avl_insert (devs, &m->dev, m);
+			}
 		}
 
-		/* inode handling */
-		if (report_inodes)
+		if (m->primary != NULL)
 		{
-			uint64_t inode_free;
-			uint64_t inode_reserved;
-			uint64_t inode_used;
-
-			/* Sanity-check for the values in the struct */
-			if (statbuf.f_ffree < statbuf.f_favail)
-				statbuf.f_ffree = statbuf.f_favail;
-			if (statbuf.f_files < statbuf.f_ffree)
-				statbuf.f_files = statbuf.f_ffree;
-
-			inode_free = (uint64_t) statbuf.f_favail;
-			inode_reserved = (uint64_t) (statbuf.f_ffree - statbuf.f_favail);
-			inode_used = (uint64_t) (statbuf.f_files - statbuf.f_ffree);
-			
-			df_submit_one (disk_name, "df_inodes", "free",
-					(gauge_t) inode_free);
-			df_submit_one (disk_name, "df_inodes", "reserved",
-					(gauge_t) inode_reserved);
-			df_submit_one (disk_name, "df_inodes", "used",
-					(gauge_t) inode_used);
+			/* Mount points which have been mounted over show
+			 * the same file system under the same name. */
+			if (by_device || ignore_duplicates
+					|| (strcmp (m->disk_name,
+							m->primary->disk_name) == 0))
+				continue;
+
+			src = m->primary;
+			if ((src->round != df_round)
+					|| ((src->flags & DF_RUNNING) != 0)
+					|| (src->status != 0))
+				continue;
 		}
+
+		if (!src->statbuf.f_blocks)
+			continue;
+
+		df_submit_statbuf (m->disk_name, src->statbuf);
 	}
 
-	cu_mount_freelist (mnt_list);
+	if (devs != NULL)
+		c_avl_destroy (devs);
+
+	pthread_mutex_unlock (&df_lock);
 
 	return (0);
 } /* int df_read */
 
+static int df_shutdown (void)
+{
+	df_mount_t *m;
+
+	pthread_mutex_lock (&df_lock);
+	df_shutdown_flag = true;
+	pthread_cond_broadcast (&df_job_cond);
+
+	/* Threads stuck in STATANYFS still use their entry. */
+	m = df_mounts;
+	while (m != NULL)
+	{
+		df_mount_t *next = m->next;
+
+		if ((m->flags & DF_RUNNING) != 0)
+			m->flags |= DF_REMOVED;
+		else
+			df_mount_free (m);
+
+		m = next;
+	}
+	df_mounts = NULL;
+	df_mounts_valid = false;
+	pthread_mutex_unlock (&df_lock);
+
+#if KERNEL_LINUX && HAVE_POLL_H
+	if (df_mounts_fd >= 0)
+	{
+		close (df_mounts_fd);
+		df_mounts_fd = -1;
+	}
+#endif
+
+	return (0);
+} /* int df_shutdown */
+
 void module_register (void)
 {
 	plugin_register_config ("df", df_config,
 			config_keys, config_keys_num);
 	plugin_register_init ("df", df_init);
 	plugin_register_read ("df", df_read);
+	plugin_register_shutdown ("df", df_shutdown);
 } /* void module_register */
@@ -26,6 +26,10 @@
 #include "plugin.h"
 #include "utils_ignorelist.h"
 
+#if KERNEL_LINUX
+# include "utils_procfs.h"
+#endif
+
 #if HAVE_MACH_MACH_TYPES_H
 #  include <mach/mach_types.h>
 #endif
@@ -103,6 +107,10 @@ typedef struct diskstats
 } diskstats_t;
 
 static diskstats_t *disklist;
+
+static cu_procfs_t *proc_diskstats = NULL;
+/* Set to one if /proc/partitions is read, i. e. the kernel is 2.4.* */
+static int proc_diskstats_fieldshift = 0;
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKSTAT
@@ -239,7 +247,7 @@ static void disk_submit (const char *plugin_instance,
 static counter_t disk_calc_time_incr (counter_t delta_time, counter_t delta_ops)
 {
 	double avg_time = ((double) delta_time) / ((double) delta_ops);
-	double avg_time_incr = ((double) interval_g) * avg_time;
+	double avg_time_incr = CDTIME_T_TO_DOUBLE (interval_g) * avg_time;
 
 	return ((counter_t) (avg_time_incr + .5));
 }
@@ -429,12 +437,12 @@ static int disk_read (void)
 /* #endif HAVE_IOKIT_IOKITLIB_H */
 
 #elif KERNEL_LINUX
-	FILE *fh;
-	char buffer[1024];
-	
+	char *buffer;
+	char *line;
+
 	char *fields[32];
 	int numfields;
-	int fieldshift = 0;
+	int fieldshift;
 
 	int minor = 0;
 
@@ -451,29 +459,44 @@ static int disk_read (void)
 
 	diskstats_t *ds, *pre_ds;
 
-	if ((fh = fopen ("/proc/diskstats", "r")) == NULL)
+	if (proc_diskstats == NULL)
 	{
-		fh = fopen ("/proc/partitions", "r");
-		if (fh == NULL)
+		proc_diskstats = cu_procfs_create ("/proc/diskstats");
+		proc_diskstats_fieldshift = 0;
+		if (proc_diskstats == NULL)
 		{
-			ERROR ("disk plugin: fopen (/proc/{diskstats,partitions}) failed.");
-			return (-1);
+			proc_diskstats = cu_procfs_create ("/proc/partitions");
+			if (proc_diskstats == NULL)
+			{
+				ERROR ("disk plugin: open (/proc/{diskstats,partitions}) failed.");
+				return (-1);
+			}
+
+			/* Kernel is 2.4.* */
+			proc_diskstats_fieldshift = 1;
 		}
+	}
+	fieldshift = proc_diskstats_fieldshift;
 
-		/* Kernel is 2.4.* */
-		fieldshift = 1;
+	if ((buffer = cu_procfs_read (proc_diskstats, NULL)) == NULL)
+	{
+		char errbuf[1024];
+		ERROR ("disk plugin: reading /proc/%s failed: %s",
+				(fieldshift == 0) ? "diskstats" : "partitions",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		return (-1);
 	}
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	while ((line = cu_procfs_line (&buffer)) != NULL)
 	{
 		char *disk_name;
 
-		numfields = strsplit (buffer, fields, 32);
+		numfields = cu_procfs_fields (line, fields, 32);
 
 		if ((numfields != (14 + fieldshift)) && (numfields != 7))
 			continue;
 
-		minor = atoll (fields[1]);
+		minor = cu_procfs_u64 (fields[1]);
 
 		disk_name = fields[2 + fieldshift];
 
@@ -502,26 +525,26 @@ static int disk_read (void)
 		if (numfields == 7)
 		{
 			/* Kernel 2.6, Partition */
-			read_ops      = atoll (fields[3]);
-			read_sectors  = atoll (fields[4]);
-			write_ops     = atoll (fields[5]);
-			write_sectors = atoll (fields[6]);
+			read_ops      = cu_procfs_u64 (fields[3]);
+			read_sectors  = cu_procfs_u64 (fields[4]);
+			write_ops     = cu_procfs_u64 (fields[5]);
+			write_sectors = cu_procfs_u64 (fields[6]);
 		}
 		else if (numfields == (14 + fieldshift))
 		{
-			read_ops  =  atoll (fields[3 + fieldshift]);
-			write_ops =  atoll (fields[7 + fieldshift]);
+			read_ops  =  cu_procfs_u64 (fields[3 + fieldshift]);
+			write_ops =  cu_procfs_u64 (fields[7 + fieldshift]);
 
-			read_sectors  = atoll (fields[5 + fieldshift]);
-			write_sectors = atoll (fields[9 + fieldshift]);
+			read_sectors  = cu_procfs_u64 (fields[5 + fieldshift]);
+			write_sectors = cu_procfs_u64 (fields[9 + fieldshift]);
 
 			if ((fieldshift == 0) || (minor == 0))
 			{
 				is_disk = 1;
-				read_merged  = atoll (fields[4 + fieldshift]);
-				read_time    = atoll (fields[6 + fieldshift]);
-				write_merged = atoll (fields[8 + fieldshift]);
-				write_time   = atoll (fields[10+ fieldshift]);
+				read_merged  = cu_procfs_u64 (fields[4 + fieldshift]);
+				read_time    = cu_procfs_u64 (fields[6 + fieldshift]);
+				write_merged = cu_procfs_u64 (fields[8 + fieldshift]);
+				write_time   = cu_procfs_u64 (fields[10+ fieldshift]);
 			}
 		}
 		else
@@ -635,9 +658,7 @@ static int disk_read (void)
 			disk_submit (disk_name, "disk_merged",
 					read_merged, write_merged);
 		} /* if (is_disk) */
-	} /* while (fgets (buffer, sizeof (buffer), fh) != NULL) */
-
-	fclose (fh);
+	} /* while ((line = cu_procfs_line (&buffer)) != NULL) */
 /* #endif defined(KERNEL_LINUX) */
 
 #elif HAVE_LIBKSTAT
@@ -761,10 +782,23 @@ static int disk_read (void)
 	return (0);
 } /* int disk_read */
 
+#if KERNEL_LINUX
+static int disk_shutdown (void)
+{
+	cu_procfs_destroy (proc_diskstats);
+	proc_diskstats = NULL;
+
+	return (0);
+} /* int disk_shutdown */
+#endif /* KERNEL_LINUX */
+
 void module_register (void)
 {
   plugin_register_config ("disk", disk_config,
       config_keys, config_keys_num);
   plugin_register_init ("disk", disk_init);
   plugin_register_read ("disk", disk_read);
+#if KERNEL_LINUX
+  plugin_register_shutdown ("disk", disk_shutdown);
+#endif
 } /* void module_register */
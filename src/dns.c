@@ -28,6 +28,7 @@
 #include "plugin.h"
 #include "configfile.h"
 
+#include "utils_atomic.h"
 #include "utils_dns.h"
 #include <pthread.h>
 #include <poll.h>
@@ -37,16 +38,63 @@
 # include <pcap-bpf.h>
 #endif
 
+#if HAVE_LINUX_IF_PACKET_H
+# include <sys/mman.h>
+# include <arpa/inet.h>
+# include <net/if.h>
+# include <linux/if_ether.h>
+# include <linux/if_packet.h>
+# include <linux/filter.h>
+# if defined(TPACKET3_HDRLEN) && defined(PACKET_FANOUT)
+#  define HAVE_TPACKET_V3 1
+# endif
+#endif
+#ifndef HAVE_TPACKET_V3
+# define HAVE_TPACKET_V3 0
+#endif
+
+#define CAPTURE_PCAP    0
+#define CAPTURE_TPACKET 1
+
 /*
  * Private data types
  */
-struct counter_list_s
+/* Counters of one capture thread. They are only ever written by the thread
+ * owning them, using atomic operations, so capturing never has to wait for
+ * the read callback. The read callback sums up the counters of all
+ * threads. */
+struct dns_counters_s
 {
-	unsigned int key;
-	unsigned int value;
-	struct counter_list_s *next;
+	uint64_t tr_queries;
+	uint64_t tr_responses;
+	uint64_t qtype[T_MAX];
+	uint64_t opcode[OP_MAX];
+	uint64_t rcode[16];
+
+	/* capture statistics as reported by libpcap or the kernel */
+	uint64_t received;
+	uint64_t dropped;
+};
+typedef struct dns_counters_s dns_counters_t;
+
+struct dns_worker_s
+{
+	pthread_t thread;
+
+	/* last statistics returned by pcap_stats(3) */
+	unsigned int pcap_recv;
+	unsigned int pcap_drop;
+
+#if HAVE_TPACKET_V3
+	int      fd;
+	uint8_t *ring;
+	size_t   block_size;
+	size_t   block_num;
+#endif
+
+	dns_counters_t counters;
 };
-typedef struct counter_list_s counter_list_t;
+typedef struct dns_worker_s dns_worker_t;
 
 /*
  * Private variables
@@ -55,102 +103,37 @@ static const char *config_keys[] =
 {
 	"Interface",
 	"IgnoreSource",
-	"SelectNumericQueryTypes"
+	"SelectNumericQueryTypes",
+	"CaptureMethod",
+	"CaptureThreads",
+	"RingSize",
+	"ReplayFile"
 };
 static int config_keys_num = STATIC_ARRAY_SIZE (config_keys);
 static int select_numeric_qtype = 1;
 
 #define PCAP_SNAPLEN 1460
+/* Read timeout of the capture in milliseconds. Keep it short, so packets are
+ * counted in the interval they arrived in. */
+#define PCAP_TIMEOUT 10
 static char   *pcap_device = NULL;
 
-static counter_t       tr_queries;
-static counter_t       tr_responses;
-static counter_list_t *qtype_list;
-static counter_list_t *opcode_list;
-static counter_list_t *rcode_list;
-
-static pthread_t       listen_thread;
-static int             listen_thread_init = 0;
-/* The `traffic' mutex if for `tr_queries' and `tr_responses' */
-static pthread_mutex_t traffic_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t qtype_mutex   = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t opcode_mutex  = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t rcode_mutex   = PTHREAD_MUTEX_INITIALIZER;
+static int     capture_method = CAPTURE_PCAP;
+static int     capture_threads = 1;
+/* Size of the ring buffer of each capture thread, in MiBytes. */
+static int     ring_size = 4;
+static char   *replay_file = NULL;
+
+static dns_worker_t **workers = NULL;
+static int            workers_num = 0;
+static pthread_key_t  counters_key;
+#if HAVE_TPACKET_V3
+static int            loopback_ifindex = -1;
+#endif
 
 /*
  * Private functions
  */
-static counter_list_t *counter_list_search (counter_list_t **list, unsigned int key)
-{
-	counter_list_t *entry;
-
-	DEBUG ("counter_list_search (list = %p, key = %u)",
-			(void *) *list, key);
-
-	for (entry = *list; entry != NULL; entry = entry->next)
-		if (entry->key == key)
-			break;
-
-	DEBUG ("return (%p)", (void *) entry);
-	return (entry);
-}
-
-static counter_list_t *counter_list_create (counter_list_t **list,
-		unsigned int key, unsigned int value)
-{
-	counter_list_t *entry;
-
-	DEBUG ("counter_list_create (list = %p, key = %u, value = %u)",
-			(void *) *list, key, value);
-
-	entry = (counter_list_t *) malloc (sizeof (counter_list_t));
-	if (entry == NULL)
-		return (NULL);
-
-	memset (entry, 0, sizeof (counter_list_t));
-	entry->key = key;
-	entry->value = value;
-
-	if (*list == NULL)
-	{
-		*list = entry;
-	}
-	else
-	{
-		counter_list_t *last;
-
-		last = *list;
-		while (last->next != NULL)
-			last = last->next;
-
-		last->next = entry;
-	}
-
-	DEBUG ("return (%p)", (void *) entry);
-	return (entry);
-}
-
-static void counter_list_add (counter_list_t **list,
-		unsigned int key, unsigned int increment)
-{
-	counter_list_t *entry;
-
-	DEBUG ("counter_list_add (list = %p, key = %u, increment = %u)",
-			(void *) *list, key, increment);
-
-	entry = counter_list_search (list, key);
-
-	if (entry != NULL)
-	{
-		entry->value += increment;
-	}
-	else
-	{
-		counter_list_create (list, key, increment);
-	}
-	DEBUG ("return ()");
-}
-
 static int dns_config (const char *key, const char *value)
 {
 	if (strcasecmp (key, "Interface") == 0)
@@ -172,6 +155,55 @@ static int dns_config (const char *key, const char *value)
 		else
 			select_numeric_qtype = 1;
 	}
+	else if (strcasecmp (key, "CaptureMethod") == 0)
+	{
+		if (strcasecmp (value, "pcap") == 0)
+			capture_method = CAPTURE_PCAP;
+		else if (strcasecmp (value, "tpacket") == 0)
+		{
+#if HAVE_TPACKET_V3
+			capture_method = CAPTURE_TPACKET;
+#else
+			WARNING ("dns plugin: The `tpacket' capture method is "
+					"not available on this system. Using "
+					"`pcap' instead.");
+			capture_method = CAPTURE_PCAP;
+#endif
+		}
+		else
+		{
+			ERROR ("dns plugin: Unknown capture method: %s", value);
+			return (1);
+		}
+	}
+	else if (strcasecmp (key, "CaptureThreads") == 0)
+	{
+		int tmp = atoi (value);
+		if ((tmp < 1) || (tmp > 64))
+		{
+			ERROR ("dns plugin: `CaptureThreads' must be in the "
+					"range 1-64.");
+			return (1);
+		}
+		capture_threads = tmp;
+	}
+	else if (strcasecmp (key, "RingSize") == 0)
+	{
+		int tmp = atoi (value);
+		if (tmp < 1)
+		{
+			ERROR ("dns plugin: `RingSize' must be a positive "
+					"number of megabytes.");
+			return (1);
+		}
+		ring_size = tmp;
+	}
+	else if (strcasecmp (key, "ReplayFile") == 0)
+	{
+		sfree (replay_file);
+		if ((replay_file = strdup (value)) == NULL)
+			return (1);
+	}
 	else
 	{
 		return (-1);
@@ -182,6 +214,12 @@ static int dns_config (const char *key, const char *value)
 
 static void dns_child_callback (const rfc1035_header_t *dns)
 {
+	dns_counters_t *counters;
+
+	counters = pthread_getspecific (counters_key);
+	if (counters == NULL)
+		return;
+
 	if (dns->qr == 0)
 	{
 		/* This is a query */
@@ -193,128 +231,547 @@ static void dns_child_callback (const rfc1035_header_t *dns)
 				skip = 1;
 		}
 
-		pthread_mutex_lock (&traffic_mutex);
-		tr_queries += dns->length;
-		pthread_mutex_unlock (&traffic_mutex);
+		catomic_add (&counters->tr_queries, (uint64_t) dns->length);
 
 		if (skip == 0)
-		{
-			pthread_mutex_lock (&qtype_mutex);
-			counter_list_add (&qtype_list, dns->qtype,  1);
-			pthread_mutex_unlock (&qtype_mutex);
-		}
+			catomic_add (&counters->qtype[dns->qtype], 1);
 	}
 	else
 	{
 		/* This is a reply */
-		pthread_mutex_lock (&traffic_mutex);
-		tr_responses += dns->length;
-		pthread_mutex_unlock (&traffic_mutex);
-
-		pthread_mutex_lock (&rcode_mutex);
-		counter_list_add (&rcode_list,  dns->rcode,  1);
-		pthread_mutex_unlock (&rcode_mutex);
+		catomic_add (&counters->tr_responses, (uint64_t) dns->length);
+		catomic_add (&counters->rcode[dns->rcode], 1);
 	}
 
 	/* FIXME: Are queries, replies or both interesting? */
-	pthread_mutex_lock (&opcode_mutex);
-	counter_list_add (&opcode_list, dns->opcode, 1);
-	pthread_mutex_unlock (&opcode_mutex);
+	catomic_add (&counters->opcode[dns->opcode], 1);
 }
 
-static void *dns_child_loop (__attribute__((unused)) void *dummy)
+static void dns_worker_prepare (dns_worker_t *w)
+{
+	sigset_t sigmask;
+
+	/* Don't block any signals */
+	sigemptyset (&sigmask);
+	pthread_sigmask (SIG_SETMASK, &sigmask, NULL);
+
+	pthread_setspecific (counters_key, &w->counters);
+} /* void dns_worker_prepare */
+
+static void dns_pcap_handler (u_char *user, const struct pcap_pkthdr *hdr,
+		const u_char *pkt)
+{
+	dns_worker_t *w = (dns_worker_t *) user;
+
+	/* When replaying a file there are no statistics from libpcap, so
+	 * count the packets read here. */
+	if (replay_file != NULL)
+		catomic_add (&w->counters.received, 1);
+
+	handle_pcap (NULL, hdr, pkt);
+} /* void dns_pcap_handler */
+
+static void dns_pcap_update_stats (dns_worker_t *w, pcap_t *pcap_obj)
+{
+	struct pcap_stat ps;
+
+	memset (&ps, 0, sizeof (ps));
+	if (pcap_stats (pcap_obj, &ps) != 0)
+		return;
+
+	/* libpcap reports absolute values which may wrap around. */
+	catomic_add (&w->counters.received,
+			(uint64_t) (ps.ps_recv - w->pcap_recv));
+	catomic_add (&w->counters.dropped,
+			(uint64_t) (ps.ps_drop - w->pcap_drop));
+
+	w->pcap_recv = ps.ps_recv;
+	w->pcap_drop = ps.ps_drop;
+} /* void dns_pcap_update_stats */
+
+static void dns_pcap_replay (dns_worker_t *w, pcap_t *pcap_obj)
 {
+	struct timeval tv_begin;
+	struct timeval tv_end;
+	double duration;
+	uint64_t packets;
+	int status;
+
+	gettimeofday (&tv_begin, NULL);
+	status = pcap_loop (pcap_obj, -1, dns_pcap_handler, (u_char *) w);
+	gettimeofday (&tv_end, NULL);
+
+	if (status < 0)
+	{
+		ERROR ("dns plugin: Reading `%s' failed: %s",
+				replay_file, pcap_geterr (pcap_obj));
+		return;
+	}
+
+	duration = (double) (tv_end.tv_sec - tv_begin.tv_sec)
+		+ ((double) (tv_end.tv_usec - tv_begin.tv_usec)) / 1000000.0;
+	packets = catomic_get (&w->counters.received);
+
+	INFO ("dns plugin: Replayed %"PRIu64" packets from `%s' in %.3f "
+			"seconds (%.0f packets/s).",
+			packets, replay_file, duration,
+			(duration > 0.0) ? ((double) packets) / duration : 0.0);
+} /* void dns_pcap_replay */
+
+static void *dns_pcap_loop (void *arg)
+{
+	dns_worker_t *w = arg;
 	pcap_t *pcap_obj;
 	char    pcap_error[PCAP_ERRBUF_SIZE];
 	struct  bpf_program fp;
+	time_t  last_stats = 0;
+	time_t  now;
 
 	int status;
 
-	/* Don't block any signals */
+	dns_worker_prepare (w);
+
+	if (replay_file != NULL)
 	{
-		sigset_t sigmask;
-		sigemptyset (&sigmask);
-		pthread_sigmask (SIG_SETMASK, &sigmask, NULL);
+		DEBUG ("dns plugin: Opening `%s'..", replay_file);
+		pcap_obj = pcap_open_offline (replay_file, pcap_error);
+		if (pcap_obj == NULL)
+		{
+			ERROR ("dns plugin: Opening file `%s' failed: %s",
+					replay_file, pcap_error);
+			return (NULL);
+		}
 	}
-
-	/* Passing `pcap_device == NULL' is okay and the same as passign "any" */
-	DEBUG ("dns plugin: Creating PCAP object..");
-	pcap_obj = pcap_open_live ((pcap_device != NULL) ? pcap_device : "any",
-			PCAP_SNAPLEN,
-			0 /* Not promiscuous */,
-			interval_g,
-			pcap_error);
-	if (pcap_obj == NULL)
+	else
 	{
-		ERROR ("dns plugin: Opening interface `%s' "
-				"failed: %s",
-				(pcap_device != NULL) ? pcap_device : "any",
+		/* Passing `pcap_device == NULL' is okay and the same as
+		 * passign "any" */
+		DEBUG ("dns plugin: Creating PCAP object..");
+		pcap_obj = pcap_open_live ((pcap_device != NULL) ? pcap_device : "any",
+				PCAP_SNAPLEN,
+				0 /* Not promiscuous */,
+				PCAP_TIMEOUT,
 				pcap_error);
-		return (NULL);
+		if (pcap_obj == NULL)
+		{
+			ERROR ("dns plugin: Opening interface `%s' "
+					"failed: %s",
+					(pcap_device != NULL) ? pcap_device : "any",
+					pcap_error);
+			return (NULL);
+		}
 	}
 
 	memset (&fp, 0, sizeof (fp));
 	if (pcap_compile (pcap_obj, &fp, "udp port 53", 1, 0) < 0)
 	{
 		ERROR ("dns plugin: pcap_compile failed");
+		pcap_close (pcap_obj);
 		return (NULL);
 	}
 	if (pcap_setfilter (pcap_obj, &fp) < 0)
 	{
 		ERROR ("dns plugin: pcap_setfilter failed");
+		pcap_freecode (&fp);
+		pcap_close (pcap_obj);
 		return (NULL);
 	}
+	pcap_freecode (&fp);
 
 	DEBUG ("PCAP object created.");
 
 	dnstop_set_pcap_obj (pcap_obj);
-	dnstop_set_callback (dns_child_callback);
 
-	status = pcap_loop (pcap_obj,
-			-1 /* loop forever */,
-			handle_pcap /* callback */,
-			NULL /* Whatever this means.. */);
-	if (status < 0)
-		ERROR ("dns plugin: Listener thread is exiting "
-				"abnormally: %s", pcap_geterr (pcap_obj));
+	if (replay_file != NULL)
+	{
+		dns_pcap_replay (w, pcap_obj);
+	}
+	else
+	{
+		/* Use pcap_dispatch rather than pcap_loop, so the capture
+		 * statistics can be fetched from this thread. */
+		while (42)
+		{
+			status = pcap_dispatch (pcap_obj,
+					-1 /* all packets in the buffer */,
+					dns_pcap_handler /* callback */,
+					(u_char *) w);
+			if (status < 0)
+			{
+				ERROR ("dns plugin: Listener thread is exiting "
+						"abnormally: %s", pcap_geterr (pcap_obj));
+				break;
+			}
+
+			now = time (NULL);
+			if (now != last_stats)
+			{
+				dns_pcap_update_stats (w, pcap_obj);
+				last_stats = now;
+			}
+		}
+	}
 
 	DEBUG ("child is exiting");
 
 	pcap_close (pcap_obj);
-	listen_thread_init = 0;
 	pthread_exit (NULL);
 
 	return (NULL);
-} /* static void dns_child_loop (void) */
+} /* static void dns_pcap_loop (void) */
 
-static int dns_init (void)
+#if HAVE_TPACKET_V3
+static int dns_tpacket_setsockopt (dns_worker_t *w, int level, int option,
+		const void *value, socklen_t value_len, const char *name)
 {
-	/* clean up an old thread */
+	char errbuf[1024];
+
+	if (setsockopt (w->fd, level, option, value, value_len) == 0)
+		return (0);
+
+	ERROR ("dns plugin: setsockopt (%s) failed: %s", name,
+			sstrerror (errno, errbuf, sizeof (errbuf)));
+	return (-1);
+} /* int dns_tpacket_setsockopt */
+
+/* Compiles the "udp port 53" filter for raw IP packets and attaches it to
+ * the socket, so that only DNS packets are copied into the ring. */
+static int dns_tpacket_attach_filter (dns_worker_t *w)
+{
+	pcap_t *pcap_dead;
+	struct bpf_program fp;
+	struct sock_fprog fprog;
 	int status;
 
-	pthread_mutex_lock (&traffic_mutex);
-	tr_queries   = 0;
-	tr_responses = 0;
-	pthread_mutex_unlock (&traffic_mutex);
+	pcap_dead = pcap_open_dead (DLT_RAW, PCAP_SNAPLEN);
+	if (pcap_dead == NULL)
+	{
+		ERROR ("dns plugin: pcap_open_dead failed.");
+		return (-1);
+	}
+
+	memset (&fp, 0, sizeof (fp));
+	if (pcap_compile (pcap_dead, &fp, "udp port 53", 1, 0) < 0)
+	{
+		ERROR ("dns plugin: pcap_compile failed: %s",
+				pcap_geterr (pcap_dead));
+		pcap_close (pcap_dead);
+		return (-1);
+	}
+
+	/* `struct bpf_insn' and `struct sock_filter' share the same layout. */
+	memset (&fprog, 0, sizeof (fprog));
+	fprog.len = (unsigned short) fp.bf_len;
+	fprog.filter = (struct sock_filter *) fp.bf_insns;
+
+	status = dns_tpacket_setsockopt (w, SOL_SOCKET, SO_ATTACH_FILTER,
+			&fprog, sizeof (fprog), "SO_ATTACH_FILTER");
+
+	pcap_freecode (&fp);
+	pcap_close (pcap_dead);
+	return (status);
+} /* int dns_tpacket_attach_filter */
+
+static int dns_tpacket_open (dns_worker_t *w)
+{
+	struct tpacket_req3 req;
+	struct sockaddr_ll sll;
+	int version = TPACKET_V3;
+	int status;
+
+	/* SOCK_DGRAM strips the link layer header, so all packets can be
+	 * handled as DLT_RAW, regardless of the interface they came from. */
+	w->fd = socket (AF_PACKET, SOCK_DGRAM, htons (ETH_P_ALL));
+	if (w->fd < 0)
+	{
+		char errbuf[1024];
+		ERROR ("dns plugin: socket (AF_PACKET) failed: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		return (-1);
+	}
+
+	status = dns_tpacket_setsockopt (w, SOL_PACKET, PACKET_VERSION,
+			&version, sizeof (version), "PACKET_VERSION");
+	if (status != 0)
+		return (-1);
 
-	if (listen_thread_init != 0)
+	/* Attach the filter before binding, so that no unfiltered packets
+	 * end up in the ring. */
+	status = dns_tpacket_attach_filter (w);
+	if (status != 0)
 		return (-1);
 
-	status = pthread_create (&listen_thread, NULL, dns_child_loop,
-			(void *) 0);
+	w->block_size = 1 << 20;
+	w->block_num = (size_t) ring_size;
+
+	memset (&req, 0, sizeof (req));
+	req.tp_block_size = (unsigned int) w->block_size;
+	req.tp_block_nr = (unsigned int) w->block_num;
+	req.tp_frame_size = 2048;
+	req.tp_frame_nr = (unsigned int) ((w->block_size * w->block_num)
+			/ req.tp_frame_size);
+	/* Hand blocks to user space after 100ms even if they're not full. */
+	req.tp_retire_blk_tov = 100;
+
+	status = dns_tpacket_setsockopt (w, SOL_PACKET, PACKET_RX_RING,
+			&req, sizeof (req), "PACKET_RX_RING");
 	if (status != 0)
+		return (-1);
+
+	w->ring = mmap (NULL, w->block_size * w->block_num,
+			PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+	if (w->ring == MAP_FAILED)
 	{
 		char errbuf[1024];
-		ERROR ("dns plugin: pthread_create failed: %s",
+		ERROR ("dns plugin: mmap failed: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
+		w->ring = NULL;
 		return (-1);
 	}
 
-	listen_thread_init = 1;
+	memset (&sll, 0, sizeof (sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons (ETH_P_ALL);
+	if ((pcap_device != NULL) && (strcmp ("any", pcap_device) != 0))
+	{
+		sll.sll_ifindex = (int) if_nametoindex (pcap_device);
+		if (sll.sll_ifindex == 0)
+		{
+			ERROR ("dns plugin: No such interface: %s",
+					pcap_device);
+			return (-1);
+		}
+	}
+
+	if (bind (w->fd, (struct sockaddr *) &sll, sizeof (sll)) != 0)
+	{
+		char errbuf[1024];
+		ERROR ("dns plugin: bind failed: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		return (-1);
+	}
+
+	/* Distribute the packets among all capture threads. Hashing keeps
+	 * all packets of a flow on the same thread. */
+	if (capture_threads > 1)
+	{
+		int fanout = (getpid () & 0xffff) | (PACKET_FANOUT_HASH << 16);
+
+		status = dns_tpacket_setsockopt (w, SOL_PACKET, PACKET_FANOUT,
+				&fanout, sizeof (fanout), "PACKET_FANOUT");
+		if (status != 0)
+			return (-1);
+	}
 
 	return (0);
-} /* int dns_init */
+} /* int dns_tpacket_open */
+
+static void dns_tpacket_close (dns_worker_t *w)
+{
+	if (w->ring != NULL)
+	{
+		munmap (w->ring, w->block_size * w->block_num);
+		w->ring = NULL;
+	}
+
+	if (w->fd >= 0)
+	{
+		close (w->fd);
+		w->fd = -1;
+	}
+} /* void dns_tpacket_close */
+
+static void dns_tpacket_update_stats (dns_worker_t *w)
+{
+	struct tpacket_stats_v3 st;
+	socklen_t st_len = sizeof (st);
+
+	memset (&st, 0, sizeof (st));
+	if (getsockopt (w->fd, SOL_PACKET, PACKET_STATISTICS,
+				&st, &st_len) != 0)
+		return;
+
+	/* The kernel resets its counters whenever they are read. */
+	catomic_add (&w->counters.received, (uint64_t) st.tp_packets);
+	catomic_add (&w->counters.dropped, (uint64_t) st.tp_drops);
+} /* void dns_tpacket_update_stats */
+
+static void dns_tpacket_handle_block (struct tpacket_block_desc *bd)
+{
+	struct tpacket3_hdr *ph;
+	uint32_t i;
+
+	ph = (struct tpacket3_hdr *) ((uint8_t *) bd
+			+ bd->hdr.bh1.offset_to_first_pkt);
+
+	for (i = 0; i < bd->hdr.bh1.num_pkts; i++)
+	{
+		struct sockaddr_ll *sll;
+
+		sll = (struct sockaddr_ll *) ((uint8_t *) ph
+				+ TPACKET_ALIGN (sizeof (*ph)));
+
+		/* Packets sent over the loopback interface show up twice.
+		 * Ignore the outgoing copy, like libpcap does. */
+		if ((sll->sll_pkttype != PACKET_OUTGOING)
+				|| (sll->sll_ifindex != loopback_ifindex))
+			handle_packet (DLT_RAW, (u_char *) ph + ph->tp_mac,
+					(int) ph->tp_snaplen);
+
+		ph = (struct tpacket3_hdr *) ((uint8_t *) ph
+				+ ph->tp_next_offset);
+	}
+} /* void dns_tpacket_handle_block */
+
+static void *dns_tpacket_loop (void *arg)
+{
+	dns_worker_t *w = arg;
+	size_t block = 0;
+	time_t last_stats = 0;
+
+	dns_worker_prepare (w);
+
+	if (dns_tpacket_open (w) != 0)
+	{
+		dns_tpacket_close (w);
+		return (NULL);
+	}
+
+	while (42)
+	{
+		struct tpacket_block_desc *bd;
+		time_t now;
+
+		bd = (struct tpacket_block_desc *) (w->ring
+				+ block * w->block_size);
+
+		if ((bd->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+		{
+			struct pollfd pfd;
+			int status;
+
+			memset (&pfd, 0, sizeof (pfd));
+			pfd.fd = w->fd;
+			pfd.events = POLLIN | POLLERR;
+
+			status = poll (&pfd, 1, 1000 /* ms */);
+			if ((status < 0) && (errno != EINTR))
+			{
+				char errbuf[1024];
+				ERROR ("dns plugin: poll failed: %s",
+						sstrerror (errno, errbuf,
+							sizeof (errbuf)));
+				break;
+			}
+		}
+		else
+		{
+			dns_tpacket_handle_block (bd);
+
+			/* Return the block to the kernel only after we're
+			 * done reading it. */
+			catomic_barrier ();
+			bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+			block = (block + 1) % w->block_num;
+		}
+
+		now = time (NULL);
+		if (now != last_stats)
+		{
+			dns_tpacket_update_stats (w);
+			last_stats = now;
+		}
+	} /* while (42) */
+
+	dns_tpacket_close (w);
+	return (NULL);
+} /* void *dns_tpacket_loop */
+#endif /* HAVE_TPACKET_V3 */
+
+static int dns_init (void)
+{
+	void *(*loop) (void *) = dns_pcap_loop;
+	int status;
+	int i;
+
+	if (workers != NULL)
+		return (-1);
+
+	if (replay_file != NULL)
+	{
+		if (capture_method != CAPTURE_PCAP)
+			INFO ("dns plugin: Replaying `%s' using libpcap.",
+					replay_file);
+		capture_method = CAPTURE_PCAP;
+	}
+
+	if ((capture_method == CAPTURE_PCAP) && (capture_threads > 1))
+	{
+		WARNING ("dns plugin: `CaptureThreads' requires the "
+				"`tpacket' capture method. Using one thread.");
+		capture_threads = 1;
+	}
+
+#if HAVE_TPACKET_V3
+	if (capture_method == CAPTURE_TPACKET)
+	{
+		loop = dns_tpacket_loop;
+		loopback_ifindex = (int) if_nametoindex ("lo");
+	}
+#endif
+
+	status = pthread_key_create (&counters_key, NULL);
+	if (status != 0)
+	{
+		ERROR ("dns plugin: pthread_key_create failed.");
+		return (-1);
+	}
+
+	dnstop_set_callback (dns_child_callback);
+
+	workers = calloc (capture_threads, sizeof (*workers));
+	if (workers == NULL)
+	{
+		ERROR ("dns plugin: calloc failed.");
+		return (-1);
+	}
+
+	for (i = 0; i < capture_threads; i++)
+	{
+		dns_worker_t *w;
+
+		w = calloc (1, sizeof (*w));
+		if (w == NULL)
+		{
+			ERROR ("dns plugin: calloc failed.");
+			break;
+		}
+#if HAVE_TPACKET_V3
+		w->fd = -1;
+#endif
+
+		status = pthread_create (&w->thread, NULL, loop, (void *) w);
+		if (status != 0)
+		{
+			char errbuf[1024];
+			ERROR ("dns plugin: pthread_create failed: %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			sfree (w);
+			break;
+		}
 
+		workers[workers_num] = w;
+		workers_num++;
+	}
+
+	if (workers_num == 0)
+	{
+		sfree (workers);
+		return (-1);
+	}
+
+	return (0);
+} /* int dns_init */
 static void submit_counter (const char *type, const char *type_instance,
 		counter_t value)
 {
@@ -350,71 +807,91 @@ static void submit_octets (counter_t queries, counter_t responses)
 	plugin_dispatch_values (&vl);
 } /* void submit_counter */
 
-static int dns_read (void)
+static void submit_capture (counter_t received, counter_t dropped)
 {
-	unsigned int keys[T_MAX];
-	unsigned int values[T_MAX];
-	int len;
+	value_t values[2];
+	value_list_t vl = VALUE_LIST_INIT;
+
+	values[0].counter = received;
+	values[1].counter = dropped;
+
+	vl.values = values;
+	vl.values_len = 2;
+	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+	sstrncpy (vl.plugin, "dns", sizeof (vl.plugin));
+	sstrncpy (vl.type, "dns_capture", sizeof (vl.type));
+
+	plugin_dispatch_values (&vl);
+} /* void submit_capture */
+
+/* Sums up one counter of all capture threads. The offset is relative to
+ * the beginning of `dns_counters_t'. */
+static counter_t dns_counter_sum (size_t offset)
+{
+	counter_t sum = 0;
 	int i;
 
-	counter_list_t *ptr;
+	for (i = 0; i < workers_num; i++)
+		sum += (counter_t) catomic_get ((uint64_t *) (((char *)
+						&workers[i]->counters) + offset));
 
-	pthread_mutex_lock (&traffic_mutex);
-	values[0] = tr_queries;
-	values[1] = tr_responses;
-	pthread_mutex_unlock (&traffic_mutex);
+	return (sum);
+} /* counter_t dns_counter_sum */
 
-	if ((values[0] != 0) || (values[1] != 0))
-		submit_octets (values[0], values[1]);
+#define DNS_COUNTER_SUM(member) \
+	dns_counter_sum (offsetof (dns_counters_t, member))
 
-	pthread_mutex_lock (&qtype_mutex);
-	for (ptr = qtype_list, len = 0;
-		       	(ptr != NULL) && (len < T_MAX);
-		       	ptr = ptr->next, len++)
-	{
-		keys[len]   = ptr->key;
-		values[len] = ptr->value;
-	}
-	pthread_mutex_unlock (&qtype_mutex);
+static int dns_read (void)
+{
+	counter_t queries;
+	counter_t responses;
+	counter_t received;
+	counter_t dropped;
+	counter_t value;
+	int i;
 
-	for (i = 0; i < len; i++)
-	{
-		DEBUG ("qtype = %u; counter = %u;", keys[i], values[i]);
-		submit_counter ("dns_qtype", qtype_str (keys[i]), values[i]);
-	}
+	queries   = DNS_COUNTER_SUM (tr_queries);
+	responses = DNS_COUNTER_SUM (tr_responses);
 
-	pthread_mutex_lock (&opcode_mutex);
-	for (ptr = opcode_list, len = 0;
-		       	(ptr != NULL) && (len < T_MAX);
-		       	ptr = ptr->next, len++)
-	{
-		keys[len]   = ptr->key;
-		values[len] = ptr->value;
-	}
-	pthread_mutex_unlock (&opcode_mutex);
+	if ((queries != 0) || (responses != 0))
+		submit_octets (queries, responses);
 
-	for (i = 0; i < len; i++)
+	for (i = 0; i < T_MAX; i++)
 	{
-		DEBUG ("opcode = %u; counter = %u;", keys[i], values[i]);
-		submit_counter ("dns_opcode", opcode_str (keys[i]), values[i]);
+		value = DNS_COUNTER_SUM (qtype[i]);
+		if (value == 0)
+			continue;
+
+		DEBUG ("qtype = %i; counter = %"PRIu64";", i, (uint64_t) value);
+		submit_counter ("dns_qtype", qtype_str (i), value);
 	}
 
-	pthread_mutex_lock (&rcode_mutex);
-	for (ptr = rcode_list, len = 0;
-		       	(ptr != NULL) && (len < T_MAX);
-		       	ptr = ptr->next, len++)
+	for (i = 0; i < OP_MAX; i++)
 	{
-		keys[len]   = ptr->key;
-		values[len] = ptr->value;
+		value = DNS_COUNTER_SUM (opcode[i]);
+		if (value == 0)
+			continue;
+
+		DEBUG ("opcode = %i; counter = %"PRIu64";", i, (uint64_t) value);
+		submit_counter ("dns_opcode", opcode_str (i), value);
 	}
-	pthread_mutex_unlock (&rcode_mutex);
 
-	for (i = 0; i < len; i++)
+	for (i = 0; i < 16; i++)
 	{
-		DEBUG ("rcode = %u; counter = %u;", keys[i], values[i]);
-		submit_counter ("dns_rcode", rcode_str (keys[i]), values[i]);
+		value = DNS_COUNTER_SUM (rcode[i]);
+		if (value == 0)
+			continue;
+
+		DEBUG ("rcode = %i; counter = %"PRIu64";", i, (uint64_t) value);
+		submit_counter ("dns_rcode", rcode_str (i), value);
 	}
 
+	received = DNS_COUNTER_SUM (received);
+	dropped  = DNS_COUNTER_SUM (dropped);
+
+	if ((received != 0) || (dropped != 0))
+		submit_capture (received, dropped);
+
 	return (0);
 } /* int dns_read */
 
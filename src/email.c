@@ -38,6 +38,7 @@
 #include "plugin.h"
 
 #include "configfile.h"
+#include "utils_atomic.h"
 
 #include <stddef.h>
 
@@ -69,17 +70,20 @@
 /*
  * Private data structures
  */
-/* linked list of email and check types */
+/* hash table of email and check types; entries are only ever added while
+ * the plugin is running, so looking up a type does not require a lock */
 typedef struct type {
 	char        *name;
-	int         value;
+	/* updated using atomic operations only */
+	uint64_t    value;
 	struct type *next;
 } type_t;
 
+#define TYPE_HASH_SIZE 64
+
 typedef struct {
-	type_t *head;
-	type_t *tail;
-} type_list_t;
+	type_t * volatile buckets[TYPE_HASH_SIZE];
+} type_hash_t;
 
 /* collector thread control information */
 typedef struct collector {
@@ -145,22 +149,16 @@ static collector_t **collectors = NULL;
 static pthread_mutex_t available_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int available_collectors;
 
-static pthread_mutex_t count_mutex = PTHREAD_MUTEX_INITIALIZER;
-static type_list_t list_count;
-static type_list_t list_count_copy;
-
-static pthread_mutex_t size_mutex = PTHREAD_MUTEX_INITIALIZER;
-static type_list_t list_size;
-static type_list_t list_size_copy;
+/* serializes adding new types to any of the hash tables */
+static pthread_mutex_t types_mutex = PTHREAD_MUTEX_INITIALIZER;
+static type_hash_t hash_count;
+static type_hash_t hash_size;
+static type_hash_t hash_check;
 
 static pthread_mutex_t score_mutex = PTHREAD_MUTEX_INITIALIZER;
 static double score;
 static int score_count;
 
-static pthread_mutex_t check_mutex = PTHREAD_MUTEX_INITIALIZER;
-static type_list_t list_check;
-static type_list_t list_check_copy;
-
 /*
  * Private functions
  */
@@ -211,40 +209,79 @@ static int email_config (const char *key, const char *value)
 	return 0;
 } /* static int email_config (char *, char *) */
 
-/* Increment the value of the given name in the given list by incr. */
-static void type_list_incr (type_list_t *list, char *name, int incr)
+static unsigned int type_hash_func (const char *name)
 {
-	if (NULL == list->head) {
-		list->head = (type_t *)smalloc (sizeof (type_t));
+	unsigned int hash = 5381;
+
+	while ('\0' != *name) {
+		hash = ((hash << 5) + hash) + (unsigned char)*name;
+		++name;
+	}
+	return hash % TYPE_HASH_SIZE;
+} /* static unsigned int type_hash_func (const char *) */
 
-		list->head->name  = sstrdup (name);
-		list->head->value = incr;
-		list->head->next  = NULL;
+static type_t *type_hash_search (type_t *head, const char *name)
+{
+	type_t *ptr;
 
-		list->tail = list->head;
+	for (ptr = head; NULL != ptr; ptr = ptr->next) {
+		if (0 == strcmp (name, ptr->name))
+			return ptr;
 	}
-	else {
-		type_t *ptr;
+	return NULL;
+} /* static type_t *type_hash_search (type_t *, const char *) */
 
-		for (ptr = list->head; NULL != ptr; ptr = ptr->next) {
-			if (0 == strcmp (name, ptr->name))
-				break;
-		}
+/* Increment the value of the given name in the given hash table by incr. */
+static void type_hash_incr (type_hash_t *hash, const char *name, int incr)
+{
+	unsigned int idx = type_hash_func (name);
+	type_t *ptr;
+
+	ptr = type_hash_search (hash->buckets[idx], name);
 
+	if (NULL == ptr) {
+		pthread_mutex_lock (&types_mutex);
+
+		/* another collector may have added it in the meantime */
+		ptr = type_hash_search (hash->buckets[idx], name);
 		if (NULL == ptr) {
-			list->tail->next = (type_t *)smalloc (sizeof (type_t));
-			list->tail = list->tail->next;
+			ptr = (type_t *)smalloc (sizeof (type_t));
+
+			ptr->name  = sstrdup (name);
+			ptr->value = 0;
+			ptr->next  = hash->buckets[idx];
 
-			list->tail->name  = sstrdup (name);
-			list->tail->value = incr;
-			list->tail->next  = NULL;
+			/* make the entry visible to lock-less readers only
+			 * after it has been initialized completely */
+			catomic_barrier ();
+			hash->buckets[idx] = ptr;
 		}
-		else {
-			ptr->value += incr;
+
+		pthread_mutex_unlock (&types_mutex);
+	}
+
+	catomic_add (&ptr->value, (uint64_t)incr);
+	return;
+} /* static void type_hash_incr (type_hash_t *, const char *, int) */
+
+static void type_hash_free (type_hash_t *hash)
+{
+	int i;
+
+	for (i = 0; i < TYPE_HASH_SIZE; ++i) {
+		type_t *ptr = hash->buckets[i];
+
+		while (NULL != ptr) {
+			type_t *next = ptr->next;
+
+			free (ptr->name);
+			free (ptr);
+			ptr = next;
 		}
+		hash->buckets[i] = NULL;
 	}
 	return;
-} /* static void type_list_incr (type_list_t *, char *) */
+} /* static void type_hash_free (type_hash_t *) */
 
 static void *collect (void *arg)
 {
@@ -328,15 +365,10 @@ static void *collect (void *arg)
 
 				bytes = atoi (tmp);
 
-				pthread_mutex_lock (&count_mutex);
-				type_list_incr (&list_count, type, 1);
-				pthread_mutex_unlock (&count_mutex);
+				type_hash_incr (&hash_count, type, 1);
 
-				if (bytes > 0) {
-					pthread_mutex_lock (&size_mutex);
-					type_list_incr (&list_size, type, bytes);
-					pthread_mutex_unlock (&size_mutex);
-				}
+				if (bytes > 0)
+					type_hash_incr (&hash_size, type, bytes);
 			}
 			else if ('s' == line[0]) { /* s:<value> */
 				pthread_mutex_lock (&score_mutex);
@@ -350,9 +382,7 @@ static void *collect (void *arg)
 				char *type = strtok_r (line + 2, ",", &ptr);
 
 				do {
-					pthread_mutex_lock (&check_mutex);
-					type_list_incr (&list_check, type, 1);
-					pthread_mutex_unlock (&check_mutex);
+					type_hash_incr (&hash_check, type, 1);
 				} while (NULL != (type = strtok_r (NULL, ",", &ptr)));
 			}
 			else {
@@ -569,8 +599,6 @@ static int email_init (void)
 
 static int email_shutdown (void)
 {
-	type_t *ptr = NULL;
-
 	int i = 0;
 
 	if (connector != ((pthread_t) 0)) {
@@ -610,35 +638,9 @@ static int email_shutdown (void)
 
 	pthread_mutex_unlock (&conns_mutex);
 
-	for (ptr = list_count.head; NULL != ptr; ptr = ptr->next) {
-		free (ptr->name);
-		free (ptr);
-	}
-
-	for (ptr = list_count_copy.head; NULL != ptr; ptr = ptr->next) {
-		free (ptr->name);
-		free (ptr);
-	}
-
-	for (ptr = list_size.head; NULL != ptr; ptr = ptr->next) {
-		free (ptr->name);
-		free (ptr);
-	}
-
-	for (ptr = list_size_copy.head; NULL != ptr; ptr = ptr->next) {
-		free (ptr->name);
-		free (ptr);
-	}
-
-	for (ptr = list_check.head; NULL != ptr; ptr = ptr->next) {
-		free (ptr->name);
-		free (ptr);
-	}
-
-	for (ptr = list_check_copy.head; NULL != ptr; ptr = ptr->next) {
-		free (ptr->name);
-		free (ptr);
-	}
+	type_hash_free (&hash_count);
+	type_hash_free (&hash_size);
+	type_hash_free (&hash_check);
 
 	unlink ((NULL == sock_file) ? SOCK_PATH : sock_file);
 
@@ -664,48 +666,24 @@ static void email_submit (const char *type, const char *type_instance, gauge_t v
 	plugin_dispatch_values (&vl);
 } /* void email_submit */
 
-/* Copy list l1 to list l2. l2 may partly exist already, but it is assumed
- * that neither the order nor the name of any element of either list is
- * changed and no elements are deleted. The values of l1 are reset to zero
- * after they have been copied to l2. */
-static void copy_type_list (type_list_t *l1, type_list_t *l2)
+/* Submit the values of all types in the given hash table and reset them to
+ * zero. */
+static void submit_type_hash (type_hash_t *hash, const char *type)
 {
-	type_t *ptr1;
-	type_t *ptr2;
-
-	type_t *last = NULL;
-
-	for (ptr1 = l1->head, ptr2 = l2->head; NULL != ptr1;
-			ptr1 = ptr1->next, last = ptr2, ptr2 = ptr2->next) {
-		if (NULL == ptr2) {
-			ptr2 = (type_t *)smalloc (sizeof (type_t));
-			ptr2->name = NULL;
-			ptr2->next = NULL;
-
-			if (NULL == last) {
-				l2->head = ptr2;
-			}
-			else {
-				last->next = ptr2;
-			}
-
-			l2->tail = ptr2;
-		}
+	int i;
 
-		if (NULL == ptr2->name) {
-			ptr2->name = sstrdup (ptr1->name);
-		}
+	for (i = 0; i < TYPE_HASH_SIZE; ++i) {
+		type_t *ptr;
 
-		ptr2->value = ptr1->value;
-		ptr1->value = 0;
+		for (ptr = hash->buckets[i]; NULL != ptr; ptr = ptr->next)
+			email_submit (type, ptr->name,
+					(gauge_t)catomic_reset (&ptr->value));
 	}
 	return;
-}
+} /* static void submit_type_hash (type_hash_t *, const char *) */
 
 static int email_read (void)
 {
-	type_t *ptr;
-
 	double score_old;
 	int score_count_old;
 
@@ -713,26 +691,10 @@ static int email_read (void)
 		return (-1);
 
 	/* email count */
-	pthread_mutex_lock (&count_mutex);
-
-	copy_type_list (&list_count, &list_count_copy);
-
-	pthread_mutex_unlock (&count_mutex);
-
-	for (ptr = list_count_copy.head; NULL != ptr; ptr = ptr->next) {
-		email_submit ("email_count", ptr->name, ptr->value);
-	}
+	submit_type_hash (&hash_count, "email_count");
 
 	/* email size */
-	pthread_mutex_lock (&size_mutex);
-
-	copy_type_list (&list_size, &list_size_copy);
-
-	pthread_mutex_unlock (&size_mutex);
-
-	for (ptr = list_size_copy.head; NULL != ptr; ptr = ptr->next) {
-		email_submit ("email_size", ptr->name, ptr->value);
-	}
+	submit_type_hash (&hash_size, "email_size");
 
 	/* spam score */
 	pthread_mutex_lock (&score_mutex);
@@ -748,14 +710,7 @@ static int email_read (void)
 		email_submit ("spam_score", "", score_old);
 
 	/* spam checks */
-	pthread_mutex_lock (&check_mutex);
-
-	copy_type_list (&list_check, &list_check_copy);
-
-	pthread_mutex_unlock (&check_mutex);
-
-	for (ptr = list_check_copy.head; NULL != ptr; ptr = ptr->next)
-		email_submit ("spam_check", ptr->name, ptr->value);
+	submit_type_hash (&hash_check, "spam_check");
 
 	return (0);
 } /* int email_read */
@@ -31,6 +31,7 @@
 
 #include "utils_cmd_putval.h"
 #include "utils_cmd_putnotif.h"
+#include "utils_complain.h"
 
 #include <sys/types.h>
 #include <pwd.h>
@@ -41,8 +42,13 @@
 
 #define PL_NORMAL        0x01
 #define PL_NOTIF_ACTION  0x02
+#define PL_COPROC        0x04
 
 #define PL_RUNNING       0x10
+#define PL_PENDING       0x20
+
+#define EXEC_NOTIF_THREADS_DEFAULT 5
+#define EXEC_NOTIF_QUEUE_DEFAULT   1024
 
 /*
  * Private data types
@@ -54,6 +60,12 @@
  * The `pid' and `status' fields are thus unused if the `PL_NOTIF_ACTION' flag
  * is set.
  * The `PL_RUNNING' flag is set in `exec_read' and unset in `exec_read_one'.
+ *
+ * Programs with the `PL_COPROC' flag set are kept running: `fd_in' is the
+ * write end of the program's STDIN. `PL_NORMAL' coprocesses are sent a
+ * "COLLECT" request each interval and set the `PL_PENDING' flag until the
+ * program answers with "DONE". `PL_NOTIF_ACTION' coprocesses are written to
+ * by the notification workers while holding `lock'.
  */
 struct program_list_s;
 typedef struct program_list_s program_list_t;
@@ -66,14 +78,25 @@ struct program_list_s
   int             pid;
   int             status;
   int             flags;
+  int             fd_in;
+  pthread_mutex_t lock;
+  c_complain_t    complaint;
   program_list_t *next;
 };
 
-typedef struct program_list_and_notification_s
+/*
+ * Notifications are not handled in the thread dispatching them. Instead, they
+ * are appended to a bounded queue which is worked off by a fixed number of
+ * notification threads.
+ */
+struct program_list_and_notification_s;
+typedef struct program_list_and_notification_s program_list_and_notification_t;
+struct program_list_and_notification_s
 {
   program_list_t *pl;
   notification_t n;
-} program_list_and_notification_t;
+  program_list_and_notification_t *next;
+};
 
 /*
  * Private variables
@@ -81,6 +104,20 @@ typedef struct program_list_and_notification_s
 static program_list_t *pl_head = NULL;
 static pthread_mutex_t pl_lock = PTHREAD_MUTEX_INITIALIZER;
 
+static int notif_threads_num = EXEC_NOTIF_THREADS_DEFAULT;
+static int notif_queue_limit = EXEC_NOTIF_QUEUE_DEFAULT;
+
+static pthread_t *notif_threads = NULL;
+static int notif_threads_running = 0;
+static _Bool notif_shutdown = 0;
+
+static program_list_and_notification_t *notif_queue_head = NULL;
+static program_list_and_notification_t *notif_queue_tail = NULL;
+static int notif_queue_length = 0;
+static pthread_mutex_t notif_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t notif_queue_cond = PTHREAD_COND_INITIALIZER;
+static c_complain_t notif_queue_complaint = C_COMPLAIN_INIT_STATIC;
+
 /*
  * Functions
  */
@@ -133,11 +170,20 @@ static int exec_config_exec (oconfig_item_t *ci) /* {{{ */
   }
   memset (pl, '\0', sizeof (program_list_t));
 
-  if (strcasecmp ("NotificationExec", ci->key) == 0)
+  if ((strcasecmp ("NotificationExec", ci->key) == 0)
+      || (strcasecmp ("CoprocessNotificationExec", ci->key) == 0))
     pl->flags |= PL_NOTIF_ACTION;
   else
     pl->flags |= PL_NORMAL;
 
+  if ((strcasecmp ("CoprocessExec", ci->key) == 0)
+      || (strcasecmp ("CoprocessNotificationExec", ci->key) == 0))
+    pl->flags |= PL_COPROC;
+
+  pl->fd_in = -1;
+  pthread_mutex_init (&pl->lock, /* attr = */ NULL);
+  C_COMPLAIN_INIT (&pl->complaint);
+
   pl->user = strdup (ci->values[0].value.string);
   if (pl->user == NULL)
   {
@@ -254,8 +300,28 @@ static int exec_config (oconfig_item_t *ci) /* {{{ */
   {
     oconfig_item_t *child = ci->children + i;
     if ((strcasecmp ("Exec", child->key) == 0)
-        || (strcasecmp ("NotificationExec", child->key) == 0))
+        || (strcasecmp ("NotificationExec", child->key) == 0)
+        || (strcasecmp ("CoprocessExec", child->key) == 0)
+        || (strcasecmp ("CoprocessNotificationExec", child->key) == 0))
       exec_config_exec (child);
+    else if (strcasecmp ("NotificationThreads", child->key) == 0)
+    {
+      int tmp = notif_threads_num;
+      if ((cf_util_get_int (child, &tmp) != 0) || (tmp < 1))
+        WARNING ("exec plugin: The `NotificationThreads' option requires "
+            "a positive integer argument.");
+      else
+        notif_threads_num = tmp;
+    }
+    else if (strcasecmp ("NotificationQueueLimit", child->key) == 0)
+    {
+      int tmp = notif_queue_limit;
+      if ((cf_util_get_int (child, &tmp) != 0) || (tmp < 1))
+        WARNING ("exec plugin: The `NotificationQueueLimit' option requires "
+            "a positive integer argument.");
+      else
+        notif_queue_limit = tmp;
+    }
     else
     {
       WARNING ("exec plugin: Unknown config option `%s'.", child->key);
@@ -270,13 +336,15 @@ static void set_environment (void) /* {{{ */
   char buffer[1024];
 
 #ifdef HAVE_SETENV
-  ssnprintf (buffer, sizeof (buffer), "%i", interval_g);
+  ssnprintf (buffer, sizeof (buffer), "%.3f",
+      CDTIME_T_TO_DOUBLE (interval_g));
   setenv ("COLLECTD_INTERVAL", buffer, /* overwrite = */ 1);
 
   ssnprintf (buffer, sizeof (buffer), "%s", hostname_g);
   setenv ("COLLECTD_HOSTNAME", buffer, /* overwrite = */ 1);
 #else
-  ssnprintf (buffer, sizeof (buffer), "COLLECTD_INTERVAL=%i", interval_g);
+  ssnprintf (buffer, sizeof (buffer), "COLLECTD_INTERVAL=%.3f",
+      CDTIME_T_TO_DOUBLE (interval_g));
   putenv (buffer);
 
   ssnprintf (buffer, sizeof (buffer), "COLLECTD_HOSTNAME=%s", hostname_g);
@@ -546,6 +614,46 @@ static int parse_line (char *buffer) /* {{{ */
   }
 } /* int parse_line }}} */
 
+/*
+ * Asks a running coprocess to collect values by writing a "COLLECT" line to its
+ * STDIN. The program is expected to answer with a line reading "DONE" after it
+ * has printed all values; until then no further requests are sent. The caller
+ * must hold `pl_lock'.
+ */
+static int coproc_send_request (program_list_t *pl) /* {{{ */
+{
+  char buffer[64];
+  int status;
+
+  if (pl->fd_in < 0)
+    return (-1);
+
+  if ((pl->flags & PL_PENDING) != 0)
+  {
+    c_complain (LOG_WARNING, &pl->complaint,
+        "exec plugin: Coprocess `%s' did not answer the previous request. "
+        "Skipping this interval.", pl->exec);
+    return (-1);
+  }
+  c_release (LOG_INFO, &pl->complaint,
+      "exec plugin: Coprocess `%s' is answering requests again.", pl->exec);
+
+  ssnprintf (buffer, sizeof (buffer), "COLLECT %u\n",
+      (unsigned int) time (NULL));
+
+  status = swrite (pl->fd_in, buffer, strlen (buffer));
+  if (status != 0)
+  {
+    char errbuf[1024];
+    ERROR ("exec plugin: Sending request to coprocess `%s' failed: %s",
+        pl->exec, sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  pl->flags |= PL_PENDING;
+  return (0);
+} /* }}} int coproc_send_request */
+
 static void *exec_read_one (void *arg) /* {{{ */
 {
   program_list_t *pl = (program_list_t *) arg;
@@ -556,8 +664,10 @@ static void *exec_read_one (void *arg) /* {{{ */
   char buffer_err[1024];
   char *pbuffer = buffer;
   char *pbuffer_err = buffer_err;
+  int fd_in = -1;
 
-  status = fork_child (pl, NULL, &fd, &fd_err);
+  status = fork_child (pl, ((pl->flags & PL_COPROC) != 0) ? &fd_in : NULL,
+      &fd, &fd_err);
   if (status < 0)
   {
     /* Reset the "running" flag */
@@ -570,6 +680,16 @@ static void *exec_read_one (void *arg) /* {{{ */
 
   assert (pl->pid != 0);
 
+  /* Coprocesses are sent their first request right away. Subsequent requests
+   * are sent by `exec_read'. */
+  if ((pl->flags & PL_COPROC) != 0)
+  {
+    pthread_mutex_lock (&pl_lock);
+    pl->fd_in = fd_in;
+    coproc_send_request (pl);
+    pthread_mutex_unlock (&pl_lock);
+  }
+
   FD_ZERO( &fdset );
   FD_SET(fd, &fdset);
   FD_SET(fd_err, &fdset);
@@ -615,7 +735,15 @@ static void *exec_read_one (void *arg) /* {{{ */
         *pnl = '\0';
         if (*(pnl-1) == '\r' ) *(pnl-1) = '\0';
 
-        parse_line (pbuffer);
+        if (((pl->flags & PL_COPROC) != 0)
+            && (strcasecmp ("DONE", pbuffer) == 0))
+        {
+          pthread_mutex_lock (&pl_lock);
+          pl->flags &= ~PL_PENDING;
+          pthread_mutex_unlock (&pl_lock);
+        }
+        else
+          parse_line (pbuffer);
 
         pbuffer = ++pnl;
       }
@@ -695,7 +823,12 @@ static void *exec_read_one (void *arg) /* {{{ */
   pl->pid = 0;
 
   pthread_mutex_lock (&pl_lock);
-  pl->flags &= ~PL_RUNNING;
+  pl->flags &= ~(PL_RUNNING | PL_PENDING);
+  if (pl->fd_in >= 0)
+  {
+    close (pl->fd_in);
+    pl->fd_in = -1;
+  }
   pthread_mutex_unlock (&pl_lock);
 
   close (fd);
@@ -706,35 +839,29 @@ static void *exec_read_one (void *arg) /* {{{ */
   return (NULL);
 } /* void *exec_read_one }}} */
 
-static void *exec_notification_one (void *arg) /* {{{ */
+/*
+ * Formats a notification in the "HTTP header" like format documented in
+ * collectd-exec(5). Returns the number of bytes written to `buffer'.
+ */
+static int format_notification (char *buffer, size_t buffer_size, /* {{{ */
+    const notification_t *n)
 {
-  program_list_t *pl = ((program_list_and_notification_t *) arg)->pl;
-  notification_t *n = &((program_list_and_notification_t *) arg)->n;
   notification_meta_t *meta;
-  int fd;
-  FILE *fh;
-  int pid;
-  int status;
   const char *severity;
+  size_t offset = 0;
+  int status;
 
-  pid = fork_child (pl, &fd, NULL, NULL);
-  if (pid < 0) {
-    sfree (arg);
-    pthread_exit ((void *) 1);
-  }
-
-  fh = fdopen (fd, "w");
-  if (fh == NULL)
-  {
-    char errbuf[1024];
-    ERROR ("exec plugin: fdopen (%i) failed: %s", fd,
-        sstrerror (errno, errbuf, sizeof (errbuf)));
-    kill (pl->pid, SIGTERM);
-    pl->pid = 0;
-    close (fd);
-    sfree (arg);
-    pthread_exit ((void *) 1);
-  }
+#define BUFFER_ADD(...) do { \
+  status = ssnprintf (buffer + offset, buffer_size - offset, __VA_ARGS__); \
+  if (status < 0) \
+    return (-1); \
+  else if (((size_t) status) >= (buffer_size - offset)) \
+  { \
+    WARNING ("exec plugin: Notification has been truncated."); \
+    return ((int) strlen (buffer)); \
+  } \
+  offset += (size_t) status; \
+} while (0)
 
   severity = "FAILURE";
   if (n->severity == NOTIF_WARNING)
@@ -742,64 +869,216 @@ static void *exec_notification_one (void *arg) /* {{{ */
   else if (n->severity == NOTIF_OKAY)
     severity = "OKAY";
 
-  fprintf (fh,
-      "Severity: %s\n"
+  BUFFER_ADD ("Severity: %s\n"
       "Time: %u\n",
       severity, (unsigned int) n->time);
 
   /* Print the optional fields */
   if (strlen (n->host) > 0)
-    fprintf (fh, "Host: %s\n", n->host);
+    BUFFER_ADD ("Host: %s\n", n->host);
   if (strlen (n->plugin) > 0)
-    fprintf (fh, "Plugin: %s\n", n->plugin);
+    BUFFER_ADD ("Plugin: %s\n", n->plugin);
   if (strlen (n->plugin_instance) > 0)
-    fprintf (fh, "PluginInstance: %s\n", n->plugin_instance);
+    BUFFER_ADD ("PluginInstance: %s\n", n->plugin_instance);
   if (strlen (n->type) > 0)
-    fprintf (fh, "Type: %s\n", n->type);
+    BUFFER_ADD ("Type: %s\n", n->type);
   if (strlen (n->type_instance) > 0)
-    fprintf (fh, "TypeInstance: %s\n", n->type_instance);
+    BUFFER_ADD ("TypeInstance: %s\n", n->type_instance);
 
   for (meta = n->meta; meta != NULL; meta = meta->next)
   {
     if (meta->type == NM_TYPE_STRING)
-      fprintf (fh, "%s: %s\n", meta->name, meta->nm_value.nm_string);
+      BUFFER_ADD ("%s: %s\n", meta->name, meta->nm_value.nm_string);
     else if (meta->type == NM_TYPE_SIGNED_INT)
-      fprintf (fh, "%s: %"PRIi64"\n", meta->name, meta->nm_value.nm_signed_int);
+      BUFFER_ADD ("%s: %"PRIi64"\n", meta->name, meta->nm_value.nm_signed_int);
     else if (meta->type == NM_TYPE_UNSIGNED_INT)
-      fprintf (fh, "%s: %"PRIu64"\n", meta->name, meta->nm_value.nm_unsigned_int);
+      BUFFER_ADD ("%s: %"PRIu64"\n", meta->name, meta->nm_value.nm_unsigned_int);
     else if (meta->type == NM_TYPE_DOUBLE)
-      fprintf (fh, "%s: %e\n", meta->name, meta->nm_value.nm_double);
+      BUFFER_ADD ("%s: %e\n", meta->name, meta->nm_value.nm_double);
     else if (meta->type == NM_TYPE_BOOLEAN)
-      fprintf (fh, "%s: %s\n", meta->name,
+      BUFFER_ADD ("%s: %s\n", meta->name,
           meta->nm_value.nm_boolean ? "true" : "false");
   }
 
-  fprintf (fh, "\n%s\n", n->message);
+  BUFFER_ADD ("\n%s\n", n->message);
 
-  fflush (fh);
-  fclose (fh);
+#undef BUFFER_ADD
+
+  return ((int) offset);
+} /* }}} int format_notification */
+
+/* Forks a new process for a single notification. */
+static int exec_notification_one (program_list_t *pl, /* {{{ */
+    const char *buffer, size_t buffer_len)
+{
+  int fd;
+  int pid;
+  int status;
+
+  pid = fork_child (pl, &fd, NULL, NULL);
+  if (pid < 0)
+    return (-1);
+
+  status = swrite (fd, buffer, buffer_len);
+  if (status != 0)
+  {
+    char errbuf[1024];
+    ERROR ("exec plugin: Writing notification to `%s' failed: %s",
+        pl->exec, sstrerror (errno, errbuf, sizeof (errbuf)));
+  }
+  close (fd);
 
   waitpid (pid, &status, 0);
 
   DEBUG ("exec plugin: Child %i exited with status %i.",
       pid, status);
 
-  if (n->meta != NULL)
-    plugin_notification_meta_free (n->meta);
-  n->meta = NULL;
-  sfree (arg);
-  pthread_exit ((void *) 0);
+  return (0);
+} /* }}} int exec_notification_one */
+
+/*
+ * Passes a notification to a long running notification handler. Each
+ * notification is preceded by a line "NOTIFICATION <bytes>", so that the
+ * program knows how much data to read. If the program is not running (any
+ * more), it is (re-)started.
+ */
+static int exec_notification_coproc (program_list_t *pl, /* {{{ */
+    const char *buffer, size_t buffer_len)
+{
+  char header[64];
+  int status;
+
+  pthread_mutex_lock (&pl->lock);
+
+  if (pl->fd_in < 0)
+  {
+    int pid;
+
+    /* `fork_child' refuses to start a program which is (still) running. */
+    pl->pid = 0;
+    pid = fork_child (pl, &pl->fd_in, NULL, NULL);
+    if (pid < 0)
+    {
+      pl->fd_in = -1;
+      pthread_mutex_unlock (&pl->lock);
+      return (-1);
+    }
+    pl->pid = pid;
+  }
+
+  ssnprintf (header, sizeof (header), "NOTIFICATION %zu\n", buffer_len);
+
+  status = swrite (pl->fd_in, header, strlen (header));
+  if (status == 0)
+    status = swrite (pl->fd_in, buffer, buffer_len);
+
+  if (status != 0)
+  {
+    char errbuf[1024];
+    ERROR ("exec plugin: Writing notification to coprocess `%s' failed: %s",
+        pl->exec, sstrerror (errno, errbuf, sizeof (errbuf)));
+
+    /* The program will be restarted with the next notification. */
+    close (pl->fd_in);
+    pl->fd_in = -1;
+    if (pl->pid > 0)
+      kill (pl->pid, SIGTERM);
+    pl->pid = 0;
+  }
+
+  pthread_mutex_unlock (&pl->lock);
+  return (status);
+} /* }}} int exec_notification_coproc */
+
+static void *exec_notification_thread (void __attribute__((unused)) *arg) /* {{{ */
+{
+  pthread_mutex_lock (&notif_queue_lock);
+  while (42)
+  {
+    program_list_and_notification_t *pln;
+    char buffer[4096];
+    int buffer_len;
+
+    while ((notif_queue_head == NULL) && !notif_shutdown)
+      pthread_cond_wait (&notif_queue_cond, &notif_queue_lock);
+
+    if (notif_queue_head == NULL)
+      break;
+
+    pln = notif_queue_head;
+    notif_queue_head = pln->next;
+    if (notif_queue_head == NULL)
+      notif_queue_tail = NULL;
+    notif_queue_length--;
+    pthread_mutex_unlock (&notif_queue_lock);
+
+    buffer_len = format_notification (buffer, sizeof (buffer), &pln->n);
+    if (buffer_len > 0)
+    {
+      if ((pln->pl->flags & PL_COPROC) != 0)
+        exec_notification_coproc (pln->pl, buffer, (size_t) buffer_len);
+      else
+        exec_notification_one (pln->pl, buffer, (size_t) buffer_len);
+    }
+
+    if (pln->n.meta != NULL)
+      plugin_notification_meta_free (pln->n.meta);
+    sfree (pln);
+
+    pthread_mutex_lock (&notif_queue_lock);
+  } /* while (42) */
+  pthread_mutex_unlock (&notif_queue_lock);
+
   return (NULL);
-} /* void *exec_notification_one }}} */
+} /* }}} void *exec_notification_thread */
 
 static int exec_init (void) /* {{{ */
 {
   struct sigaction sa;
+  program_list_t *pl;
+  int i;
 
   memset (&sa, '\0', sizeof (sa));
   sa.sa_handler = sigchld_handler;
   sigaction (SIGCHLD, &sa, NULL);
 
+  /* Only start the notification threads if they're actually needed. */
+  for (pl = pl_head; pl != NULL; pl = pl->next)
+    if ((pl->flags & PL_NOTIF_ACTION) != 0)
+      break;
+  if ((pl == NULL) || (notif_threads != NULL))
+    return (0);
+
+  notif_threads = (pthread_t *) calloc (notif_threads_num,
+      sizeof (*notif_threads));
+  if (notif_threads == NULL)
+  {
+    ERROR ("exec plugin: calloc failed.");
+    return (-1);
+  }
+
+  for (i = 0; i < notif_threads_num; i++)
+  {
+    int status;
+
+    status = pthread_create (notif_threads + notif_threads_running,
+        /* attr = */ NULL, exec_notification_thread, /* arg = */ NULL);
+    if (status != 0)
+    {
+      char errbuf[1024];
+      ERROR ("exec plugin: pthread_create failed: %s",
+          sstrerror (status, errbuf, sizeof (errbuf)));
+      continue;
+    }
+    notif_threads_running++;
+  }
+
+  if (notif_threads_running == 0)
+  {
+    sfree (notif_threads);
+    return (-1);
+  }
+
   return (0);
 } /* int exec_init }}} */
 
@@ -817,6 +1096,13 @@ static int exec_read (void) /* {{{ */
       continue;
 
     pthread_mutex_lock (&pl_lock);
+    /* Running coprocesses are only asked to collect values. */
+    if ((pl->flags & (PL_COPROC | PL_RUNNING)) == (PL_COPROC | PL_RUNNING))
+    {
+      coproc_send_request (pl);
+      pthread_mutex_unlock (&pl_lock);
+      continue;
+    }
     /* Skip if a child is already running. */
     if ((pl->flags & PL_RUNNING) != 0)
     {
@@ -843,17 +1129,25 @@ static int exec_notification (const notification_t *n, /* {{{ */
 
   for (pl = pl_head; pl != NULL; pl = pl->next)
   {
-    pthread_t t;
-    pthread_attr_t attr;
-
     /* Only execute `notification' style executables here. */
     if ((pl->flags & PL_NOTIF_ACTION) == 0)
       continue;
 
     /* Skip if a child is already running. */
-    if (pl->pid != 0)
+    if (((pl->flags & PL_COPROC) == 0) && (pl->pid != 0))
       continue;
 
+    pthread_mutex_lock (&notif_queue_lock);
+    if (notif_queue_length >= notif_queue_limit)
+    {
+      pthread_mutex_unlock (&notif_queue_lock);
+      c_complain (LOG_WARNING, &notif_queue_complaint,
+          "exec plugin: The notification queue is full (%i entries). "
+          "Dropping notifications.", notif_queue_limit);
+      continue;
+    }
+    pthread_mutex_unlock (&notif_queue_lock);
+
     pln = (program_list_and_notification_t *) malloc (sizeof
         (program_list_and_notification_t));
     if (pln == NULL)
@@ -863,6 +1157,7 @@ static int exec_notification (const notification_t *n, /* {{{ */
     }
 
     pln->pl = pl;
+    pln->next = NULL;
     memcpy (&pln->n, n, sizeof (notification_t));
 
     /* Set the `meta' member to NULL, otherwise `plugin_notification_meta_copy'
@@ -870,10 +1165,19 @@ static int exec_notification (const notification_t *n, /* {{{ */
     pln->n.meta = NULL;
     plugin_notification_meta_copy (&pln->n, n);
 
-    pthread_attr_init (&attr);
-    pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
-    pthread_create (&t, &attr, exec_notification_one, (void *) pln);
-    pthread_attr_destroy (&attr);
+    pthread_mutex_lock (&notif_queue_lock);
+    if (notif_queue_tail == NULL)
+      notif_queue_head = pln;
+    else
+      notif_queue_tail->next = pln;
+    notif_queue_tail = pln;
+    notif_queue_length++;
+    pthread_cond_signal (&notif_queue_cond);
+    pthread_mutex_unlock (&notif_queue_lock);
+
+    c_release (LOG_INFO, &notif_queue_complaint,
+        "exec plugin: The notification queue is accepting "
+        "notifications again.");
   } /* for (pl) */
 
   return (0);
@@ -883,18 +1187,37 @@ static int exec_shutdown (void) /* {{{ */
 {
   program_list_t *pl;
   program_list_t *next;
+  int i;
+
+  /* Let the notification threads work off the queue and terminate. */
+  pthread_mutex_lock (&notif_queue_lock);
+  notif_shutdown = 1;
+  pthread_cond_broadcast (&notif_queue_cond);
+  pthread_mutex_unlock (&notif_queue_lock);
+
+  for (i = 0; i < notif_threads_running; i++)
+    pthread_join (notif_threads[i], /* retval = */ NULL);
+  notif_threads_running = 0;
+  sfree (notif_threads);
 
   pl = pl_head;
   while (pl != NULL)
   {
     next = pl->next;
 
+    if (pl->fd_in >= 0)
+    {
+      close (pl->fd_in);
+      pl->fd_in = -1;
+    }
+
     if (pl->pid > 0)
     {
       kill (pl->pid, SIGTERM);
       INFO ("exec plugin: Sent SIGTERM to %hu", (unsigned short int) pl->pid);
     }
 
+    pthread_mutex_destroy (&pl->lock);
     sfree (pl->user);
     sfree (pl);
 
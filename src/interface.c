@@ -76,10 +76,54 @@ static int nif;
 static int pnif;
 #endif /* HAVE_PERFSTAT */
 
+#if KERNEL_LINUX && !HAVE_GETIFADDRS
+# include "utils_procfs.h"
+#endif
+
 #if !HAVE_GETIFADDRS && !KERNEL_LINUX && !HAVE_LIBKSTAT && !HAVE_LIBSTATGRAB && !HAVE_PERFSTAT
 # error "No applicable input method."
 #endif
 
+/*
+ * On Linux, the statistics are requested from the kernel using a netlink
+ * socket which is kept open. /proc/net/dev is only read if that fails.
+ */
+#if KERNEL_LINUX && !HAVE_GETIFADDRS && HAVE_LINUX_RTNETLINK_H
+# define IF_NETLINK 1
+# include <linux/netlink.h>
+# include <linux/rtnetlink.h>
+# include "utils_avltree.h"
+#else
+# define IF_NETLINK 0
+#endif
+
+#if IF_NETLINK
+/* The per-interface state is kept between reads, so the ignorelist is only
+ * consulted when an interface appears or is renamed. */
+struct if_link_s
+{
+	int index;
+	char name[IFNAMSIZ];
+	_Bool ignored;
+	uint64_t generation;
+};
+typedef struct if_link_s if_link_t;
+
+struct if_stats_s
+{
+	uint64_t rx_packets;
+	uint64_t tx_packets;
+	uint64_t rx_bytes;
+	uint64_t tx_bytes;
+	uint64_t rx_errors;
+	uint64_t tx_errors;
+};
+typedef struct if_stats_s if_stats_t;
+
+/* Maximum number of requests sent with one call to send(2). */
+# define IF_NL_BATCH 128
+#endif /* IF_NETLINK */
+
 /*
  * (Module-)Global variables
  */
@@ -87,12 +131,38 @@ static const char *config_keys[] =
 {
 	"Interface",
 	"IgnoreSelected",
+	"TrackLinks",
 	NULL
 };
-static int config_keys_num = 2;
+static int config_keys_num = 3;
 
 static ignorelist_t *ignorelist = NULL;
 
+#if IF_NETLINK
+static int nl_sock = -1;
+static uint32_t nl_seq = 0;
+static char nl_buffer[65536];
+static _Bool nl_failed = 0;
+
+static c_avl_tree_t *if_links = NULL;
+static uint64_t if_links_generation = 0;
+static int if_links_num = 0;
+static int if_links_selected = 0;
+
+/* If enabled, link changes are received via the RTNLGRP_LINK multicast
+ * group, so the names of the interfaces needn't be requested on each read.
+ * Only the selected interfaces are queried, unless most interfaces are
+ * selected anyway. */
+static _Bool track_links = 1;
+static int nl_track_sock = -1;
+static _Bool nl_track_resync = 1;
+static _Bool nl_stats_unsupported = 0;
+#endif /* IF_NETLINK */
+
+#if KERNEL_LINUX && !HAVE_GETIFADDRS
+static cu_procfs_t *proc_net_dev = NULL;
+#endif
+
 #ifdef HAVE_LIBKSTAT
 #define MAX_NUMIF 256
 extern kstat_ctl_t *kc;
@@ -116,6 +186,15 @@ static int interface_config (const char *key, const char *value)
 			invert = 0;
 		ignorelist_set_invert (ignorelist, invert);
 	}
+	else if (strcasecmp (key, "TrackLinks") == 0)
+	{
+#if IF_NETLINK
+		track_links = IS_TRUE (value) ? 1 : 0;
+#else
+		WARNING ("interface plugin: The `TrackLinks' option is only "
+				"available on Linux.");
+#endif
+	}
 	else
 	{
 		return (-1);
@@ -154,16 +233,13 @@ static int interface_init (void)
 } /* int interface_init */
 #endif /* HAVE_LIBKSTAT */
 
-static void if_submit (const char *dev, const char *type,
+static void if_dispatch (const char *dev, const char *type,
 		unsigned long long rx,
 		unsigned long long tx)
 {
 	value_t values[2];
 	value_list_t vl = VALUE_LIST_INIT;
 
-	if (ignorelist_match (ignorelist, dev) != 0)
-		return;
-
 	values[0].counter = rx;
 	values[1].counter = tx;
 
@@ -175,8 +251,595 @@ static void if_submit (const char *dev, const char *type,
 	sstrncpy (vl.type_instance, dev, sizeof (vl.type_instance));
 
 	plugin_dispatch_values (&vl);
+} /* void if_dispatch */
+
+static void if_submit (const char *dev, const char *type,
+		unsigned long long rx,
+		unsigned long long tx)
+{
+	if (ignorelist_match (ignorelist, dev) != 0)
+		return;
+
+	if_dispatch (dev, type, rx, tx);
 } /* void if_submit */
 
+#if IF_NETLINK
+static int if_link_compare (const void *a, const void *b) /* {{{ */
+{
+	int index_a = *((const int *) a);
+	int index_b = *((const int *) b);
+
+	if (index_a < index_b)
+		return (-1);
+	else if (index_a > index_b)
+		return (1);
+	return (0);
+} /* }}} int if_link_compare */
+
+static void if_link_remove (int index) /* {{{ */
+{
+	if_link_t *link = NULL;
+	int *key;
+
+	if (c_avl_remove (if_links, &index, (void *) &key,
+				(void *) &link) != 0)
+		return;
+
+	if (!link->ignored)
+		if_links_selected--;
+	if_links_num--;
+	sfree (link);
+} /* }}} void if_link_remove */
+
+/* Returns the cached state of the interface, creating it if necessary. The
+ * ignorelist is only consulted if the interface is new or has been
+ * renamed. */
+static if_link_t *if_link_get (int index, const char *name) /* {{{ */
+{
+	if_link_t *link = NULL;
+
+	if (c_avl_get (if_links, &index, (void *) &link) != 0)
+	{
+		link = (if_link_t *) malloc (sizeof (*link));
+		if (link == NULL)
+			return (NULL);
+		memset (link, 0, sizeof (*link));
+		link->index = index;
+		link->ignored = 1;
+
+		if (c_avl_insert (if_links, &link->index, link) != 0)
+		{
+			sfree (link);
+			return (NULL);
+		}
+		if_links_num++;
+	}
+	else if (strcmp (link->name, name) == 0)
+	{
+		return (link);
+	}
+
+	if (!link->ignored)
+		if_links_selected--;
+
+	sstrncpy (link->name, name, sizeof (link->name));
+	link->ignored = (ignorelist_match (ignorelist, name) != 0) ? 1 : 0;
+
+	if (!link->ignored)
+		if_links_selected++;
+
+	return (link);
+} /* }}} if_link_t *if_link_get */
+
+/* Removes interfaces which haven't been seen during the last dump. If link
+ * changes are tracked, this is only needed after messages have been lost. */
+static void if_links_sweep (void) /* {{{ */
+{
+	c_avl_iterator_t *iter;
+	int *key;
+	if_link_t *link;
+	int stale[64];
+	size_t stale_num;
+
+	do
+	{
+		stale_num = 0;
+
+		iter = c_avl_get_iterator (if_links);
+		while ((stale_num < STATIC_ARRAY_SIZE (stale))
+				&& (c_avl_iterator_next (iter, (void *) &key,
+						(void *) &link) == 0))
+		{
+			if (link->generation != if_links_generation)
+				stale[stale_num++] = link->index;
+		}
+		c_avl_iterator_destroy (iter);
+
+		while (stale_num > 0)
+			if_link_remove (stale[--stale_num]);
+	} while (stale_num != 0);
+} /* }}} void if_links_sweep */
+
+static void if_link_submit (const if_link_t *link, /* {{{ */
+		const if_stats_t *stats)
+{
+	if_dispatch (link->name, "if_octets", stats->rx_bytes, stats->tx_bytes);
+	if_dispatch (link->name, "if_packets", stats->rx_packets, stats->tx_packets);
+	if_dispatch (link->name, "if_errors", stats->rx_errors, stats->tx_errors);
+} /* }}} void if_link_submit */
+
+#if HAVE_DECL_IFLA_STATS64 || HAVE_DECL_IFLA_STATS_LINK_64
+static void if_stats_from64 (if_stats_t *stats, /* {{{ */
+		const struct rtattr *rta)
+{
+	struct rtnl_link_stats64 s64;
+
+	/* The attribute is only aligned to four bytes. */
+	memcpy (&s64, RTA_DATA (rta), sizeof (s64));
+	stats->rx_packets = s64.rx_packets;
+	stats->tx_packets = s64.tx_packets;
+	stats->rx_bytes = s64.rx_bytes;
+	stats->tx_bytes = s64.tx_bytes;
+	stats->rx_errors = s64.rx_errors;
+	stats->tx_errors = s64.tx_errors;
+} /* }}} void if_stats_from64 */
+#endif
+
+/* Handles one RTM_NEWLINK or RTM_DELLINK message. If `submit' is true, the
+ * statistics of selected interfaces are dispatched. */
+static void if_nl_link (const struct nlmsghdr *nlh, _Bool submit) /* {{{ */
+{
+	const struct ifinfomsg *ifi;
+	const struct rtattr *rta;
+	int rta_len;
+	const char *name = NULL;
+	if_stats_t stats;
+	_Bool have_stats = 0;
+	if_link_t *link;
+
+	if (nlh->nlmsg_len < NLMSG_LENGTH (sizeof (*ifi)))
+		return;
+	ifi = NLMSG_DATA (nlh);
+
+	/* The bridge code sends AF_BRIDGE messages for its ports, e.g. an
+	 * RTM_DELLINK when a port leaves the bridge. The interface itself
+	 * still exists. */
+	if (ifi->ifi_family != AF_UNSPEC)
+		return;
+
+	if (nlh->nlmsg_type == RTM_DELLINK)
+	{
+		if_link_remove (ifi->ifi_index);
+		return;
+	}
+
+	rta = IFLA_RTA (ifi);
+	rta_len = IFLA_PAYLOAD (nlh);
+	for (; RTA_OK (rta, rta_len); rta = RTA_NEXT (rta, rta_len))
+	{
+		if (rta->rta_type == IFLA_IFNAME)
+		{
+			name = RTA_DATA (rta);
+		}
+#if HAVE_DECL_IFLA_STATS64
+		else if ((rta->rta_type == IFLA_STATS64)
+				&& (RTA_PAYLOAD (rta) >= sizeof (struct rtnl_link_stats64)))
+		{
+			if_stats_from64 (&stats, rta);
+			have_stats = 1;
+		}
+#endif
+		else if ((rta->rta_type == IFLA_STATS) && !have_stats
+				&& (RTA_PAYLOAD (rta) >= sizeof (struct rtnl_link_stats)))
+		{
+			const struct rtnl_link_stats *s32 = RTA_DATA (rta);
+
+			stats.rx_packets = s32->rx_packets;
+			stats.tx_packets = s32->tx_packets;
+			stats.rx_bytes = s32->rx_bytes;
+			stats.tx_bytes = s32->tx_bytes;
+			stats.rx_errors = s32->rx_errors;
+			stats.tx_errors = s32->tx_errors;
+			have_stats = 1;
+		}
+	}
+
+	if ((name == NULL) || (name[0] == 0))
+		return;
+
+	link = if_link_get (ifi->ifi_index, name);
+	if (link == NULL)
+		return;
+	link->generation = if_links_generation;
+
+	if (submit && !link->ignored && have_stats)
+		if_link_submit (link, &stats);
+} /* }}} void if_nl_link */
+
+#if HAVE_DECL_IFLA_STATS_LINK_64
+/* Handles one RTM_NEWSTATS message. The name of the interface is taken from
+ * the cache, which is kept up to date by the link notifications. */
+static void if_nl_stats (const struct nlmsghdr *nlh) /* {{{ */
+{
+	const struct if_stats_msg *ifsm;
+	const struct rtattr *rta;
+	int rta_len;
+	if_link_t *link = NULL;
+
+	if (nlh->nlmsg_len < NLMSG_LENGTH (sizeof (*ifsm)))
+		return;
+	ifsm = NLMSG_DATA (nlh);
+
+	/* Interfaces created since the notifications have been read are
+	 * picked up by the next read. */
+	if (c_avl_get (if_links, &ifsm->ifindex, (void *) &link) != 0)
+		return;
+	if (link->ignored)
+		return;
+
+	rta = (const struct rtattr *) (((const char *) ifsm)
+			+ NLMSG_ALIGN (sizeof (*ifsm)));
+	rta_len = nlh->nlmsg_len - NLMSG_LENGTH (sizeof (*ifsm));
+	for (; RTA_OK (rta, rta_len); rta = RTA_NEXT (rta, rta_len))
+	{
+		if ((rta->rta_type == IFLA_STATS_LINK_64)
+				&& (RTA_PAYLOAD (rta) >= sizeof (struct rtnl_link_stats64)))
+		{
+			if_stats_t stats;
+
+			if_stats_from64 (&stats, rta);
+			if_link_submit (link, &stats);
+			return;
+		}
+	}
+} /* }}} void if_nl_stats */
+#endif /* HAVE_DECL_IFLA_STATS_LINK_64 */
+
+static int if_nl_open (int groups) /* {{{ */
+{
+	struct sockaddr_nl sa;
+	int fd;
+
+	fd = socket (AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0)
+	{
+		char errbuf[1024];
+		ERROR ("interface plugin: socket (AF_NETLINK) failed: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		return (-1);
+	}
+
+	memset (&sa, 0, sizeof (sa));
+	sa.nl_family = AF_NETLINK;
+	sa.nl_groups = groups;
+	if (bind (fd, (struct sockaddr *) &sa, sizeof (sa)) != 0)
+	{
+		char errbuf[1024];
+		ERROR ("interface plugin: bind (AF_NETLINK) failed: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		close (fd);
+		return (-1);
+	}
+
+	return (fd);
+} /* }}} int if_nl_open */
+
+/* Appends a request for `type' to `buffer'. If `index' is zero, all
+ * interfaces are dumped. Returns the number of bytes appended. */
+static size_t if_nl_request (char *buffer, int type, int index) /* {{{ */
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *) buffer;
+
+	memset (nlh, 0, NLMSG_SPACE (sizeof (struct ifinfomsg)));
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = NLM_F_REQUEST;
+	if (index == 0)
+		nlh->nlmsg_flags |= NLM_F_DUMP;
+	nlh->nlmsg_seq = ++nl_seq;
+
+#if HAVE_DECL_IFLA_STATS_LINK_64
+	if (type == RTM_GETSTATS)
+	{
+		struct if_stats_msg *ifsm = NLMSG_DATA (nlh);
+
+		nlh->nlmsg_len = NLMSG_LENGTH (sizeof (*ifsm));
+		ifsm->family = AF_UNSPEC;
+		ifsm->ifindex = index;
+		ifsm->filter_mask = IFLA_STATS_FILTER_BIT (IFLA_STATS_LINK_64);
+		return (NLMSG_ALIGN (nlh->nlmsg_len));
+	}
+#endif
+	{
+		struct ifinfomsg *ifi = NLMSG_DATA (nlh);
+
+		nlh->nlmsg_len = NLMSG_LENGTH (sizeof (*ifi));
+		ifi->ifi_family = AF_UNSPEC;
+		ifi->ifi_index = index;
+	}
+
+	return (NLMSG_ALIGN (nlh->nlmsg_len));
+} /* }}} size_t if_nl_request */
+
+/* Sends `buffer' and handles the replies until `expected' replies have been
+ * received or, if `expected' is zero, until the end of the dump. Returns
+ * zero on success or a negative error code. */
+static int if_nl_transact (const char *buffer, size_t buffer_size, /* {{{ */
+		uint32_t seq_first, int expected)
+{
+	uint32_t seq_last = nl_seq;
+	int received = 0;
+
+	if (send (nl_sock, buffer, buffer_size, 0) < 0)
+	{
+		char errbuf[1024];
+		ERROR ("interface plugin: send (AF_NETLINK) failed: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		return (-errno);
+	}
+
+	while (42)
+	{
+		struct nlmsghdr *nlh;
+		ssize_t len;
+
+		len = recv (nl_sock, nl_buffer, sizeof (nl_buffer), 0);
+		if (len < 0)
+		{
+			char errbuf[1024];
+
+			if (errno == EINTR)
+				continue;
+			ERROR ("interface plugin: recv (AF_NETLINK) failed: %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			return (-errno);
+		}
+
+		for (nlh = (struct nlmsghdr *) nl_buffer;
+				NLMSG_OK (nlh, (size_t) len);
+				nlh = NLMSG_NEXT (nlh, len))
+		{
+			if ((nlh->nlmsg_seq < seq_first) || (nlh->nlmsg_seq > seq_last))
+				continue;
+
+			if (nlh->nlmsg_type == NLMSG_DONE)
+				return (0);
+
+			if (nlh->nlmsg_type == NLMSG_ERROR)
+			{
+				const struct nlmsgerr *err = NLMSG_DATA (nlh);
+
+				/* The interface has gone. */
+				if ((expected == 0) || (err->error != -ENODEV))
+					return ((err->error < 0) ? err->error : -EIO);
+			}
+#if HAVE_DECL_IFLA_STATS_LINK_64
+			else if (nlh->nlmsg_type == RTM_NEWSTATS)
+				if_nl_stats (nlh);
+#endif
+			else if (nlh->nlmsg_type == RTM_NEWLINK)
+				if_nl_link (nlh, /* submit = */ 1);
+
+			if (expected > 0)
+			{
+				received++;
+				if (received >= expected)
+					return (0);
+			}
+		}
+	}
+
+	/* not reached */
+	return (-EIO);
+} /* }}} int if_nl_transact */
+
+static int if_nl_dump (int type) /* {{{ */
+{
+	char buffer[NLMSG_SPACE (sizeof (struct ifinfomsg)) + 16];
+	size_t len;
+
+	len = if_nl_request (buffer, type, /* index = */ 0);
+	return (if_nl_transact (buffer, len, nl_seq, /* expected = */ 0));
+} /* }}} int if_nl_dump */
+
+/* Queries the selected interfaces only, sending one request per interface,
+ * in batches. */
+static int if_nl_query_selected (int type) /* {{{ */
+{
+	char buffer[IF_NL_BATCH * (NLMSG_SPACE (sizeof (struct ifinfomsg)) + 16)];
+	c_avl_iterator_t *iter;
+	int *key;
+	if_link_t *link;
+	int *indexes;
+	int indexes_num;
+	int offset;
+	int status = 0;
+
+	if (if_links_selected <= 0)
+		return (0);
+
+	/* The replies may change the tree, so the selected interfaces are
+	 * collected beforehand. */
+	indexes = (int *) calloc (if_links_selected, sizeof (*indexes));
+	if (indexes == NULL)
+		return (-ENOMEM);
+
+	indexes_num = 0;
+	iter = c_avl_get_iterator (if_links);
+	while ((indexes_num < if_links_selected)
+			&& (c_avl_iterator_next (iter, (void *) &key,
+					(void *) &link) == 0))
+		if (!link->ignored)
+			indexes[indexes_num++] = link->index;
+	c_avl_iterator_destroy (iter);
+
+	for (offset = 0; (offset < indexes_num) && (status == 0);
+			offset += IF_NL_BATCH)
+	{
+		uint32_t seq_first = nl_seq + 1;
+		size_t len = 0;
+		int batch;
+		int i;
+
+		batch = indexes_num - offset;
+		if (batch > IF_NL_BATCH)
+			batch = IF_NL_BATCH;
+
+		for (i = 0; i < batch; i++)
+			len += if_nl_request (buffer + len, type, indexes[offset + i]);
+
+		status = if_nl_transact (buffer, len, seq_first, batch);
+	}
+
+	sfree (indexes);
+	return (status);
+} /* }}} int if_nl_query_selected */
+
+/* Applies the link changes received via the multicast group. */
+static void if_nl_track (void) /* {{{ */
+{
+	if (nl_track_sock < 0)
+	{
+		nl_track_sock = if_nl_open (RTMGRP_LINK);
+		if (nl_track_sock < 0)
+			return;
+		nl_track_resync = 1;
+	}
+
+	while (42)
+	{
+		struct nlmsghdr *nlh;
+		ssize_t len;
+
+		len = recv (nl_track_sock, nl_buffer, sizeof (nl_buffer),
+				MSG_DONTWAIT);
+		if (len < 0)
+		{
+			/* Messages have been lost. */
+			if (errno == ENOBUFS)
+			{
+				nl_track_resync = 1;
+				continue;
+			}
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (nlh = (struct nlmsghdr *) nl_buffer;
+				NLMSG_OK (nlh, (size_t) len);
+				nlh = NLMSG_NEXT (nlh, len))
+			if_nl_link (nlh, /* submit = */ 0);
+	}
+} /* }}} void if_nl_track */
+
+static void if_nl_close (void) /* {{{ */
+{
+	if (nl_sock >= 0)
+	{
+		close (nl_sock);
+		nl_sock = -1;
+	}
+	if (nl_track_sock >= 0)
+	{
+		close (nl_track_sock);
+		nl_track_sock = -1;
+	}
+} /* }}} void if_nl_close */
+
+/* Reads the statistics of the selected interfaces once the cached list of
+ * interfaces is up to date. */
+static int if_nl_read_tracked (void) /* {{{ */
+{
+	int type = RTM_GETLINK;
+	int status;
+
+#if HAVE_DECL_IFLA_STATS_LINK_64
+	/* RTM_GETSTATS (Linux 4.7) returns the counters only, which is much
+	 * less data than RTM_GETLINK. */
+	if (!nl_stats_unsupported)
+		type = RTM_GETSTATS;
+#endif
+
+	while (42)
+	{
+		/* Querying interfaces one by one is only cheaper than a dump
+		 * if few of them are selected. */
+		if ((if_links_selected * 4) < if_links_num)
+			status = if_nl_query_selected (type);
+		else
+			status = if_nl_dump (type);
+
+		if ((type == RTM_GETLINK)
+				|| ((status != -EOPNOTSUPP) && (status != -EINVAL)))
+			break;
+
+		INFO ("interface plugin: RTM_GETSTATS is not supported. "
+				"Using RTM_GETLINK instead.");
+		nl_stats_unsupported = 1;
+		type = RTM_GETLINK;
+	}
+
+	return (status);
+} /* }}} int if_nl_read_tracked */
+
+/* Returns zero on success, less than zero on failure and greater than zero
+ * if netlink isn't available and /proc/net/dev should be read instead. */
+static int if_nl_read (void) /* {{{ */
+{
+	int status;
+
+	if (nl_failed)
+		return (1);
+
+	if (nl_sock < 0)
+	{
+		if (if_links == NULL)
+			if_links = c_avl_create (if_link_compare);
+		if (if_links == NULL)
+			return (-1);
+
+		nl_sock = if_nl_open (/* groups = */ 0);
+		if (nl_sock < 0)
+		{
+			NOTICE ("interface plugin: Reading /proc/net/dev "
+					"instead.");
+			nl_failed = 1;
+			return (1);
+		}
+	}
+
+	if_links_generation++;
+
+	if (track_links)
+	{
+		if_nl_track ();
+		if ((nl_track_sock >= 0) && !nl_track_resync)
+		{
+			status = if_nl_read_tracked ();
+			if (status != 0)
+				if_nl_close ();
+			return (status);
+		}
+	}
+
+	/* Dump all interfaces, including their names. */
+	status = if_nl_dump (RTM_GETLINK);
+	if (status != 0)
+	{
+		/* Start over with new sockets. */
+		if_nl_close ();
+		return (status);
+	}
+
+	if (if_links_num > 0)
+		if_links_sweep ();
+	if (track_links && (nl_track_sock >= 0))
+		nl_track_resync = 0;
+
+	return (0);
+} /* }}} int if_nl_read */
+#endif /* IF_NETLINK */
+
 static int interface_read (void)
 {
 #if HAVE_GETIFADDRS
@@ -231,8 +894,8 @@ static int interface_read (void)
 /* #endif HAVE_GETIFADDRS */
 
 #elif KERNEL_LINUX
-	FILE *fh;
-	char buffer[1024];
+	char *buffer;
+	char *line;
 	unsigned long long incoming, outgoing;
 	char *device;
 
@@ -240,47 +903,65 @@ static int interface_read (void)
 	char *fields[16];
 	int numfields;
 
-	if ((fh = fopen ("/proc/net/dev", "r")) == NULL)
+#if IF_NETLINK
+	{
+		int status = if_nl_read ();
+		if (status <= 0)
+			return (status);
+	}
+#endif
+
+	if (proc_net_dev == NULL)
+	{
+		proc_net_dev = cu_procfs_create ("/proc/net/dev");
+		if (proc_net_dev == NULL)
+		{
+			char errbuf[1024];
+			WARNING ("interface plugin: open: %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			return (-1);
+		}
+	}
+
+	if ((buffer = cu_procfs_read (proc_net_dev, NULL)) == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("interface plugin: fopen: %s",
+		WARNING ("interface plugin: read: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buffer, 1024, fh) != NULL)
+	while ((line = cu_procfs_line (&buffer)) != NULL)
 	{
-		if (!(dummy = strchr(buffer, ':')))
+		if (!(dummy = strchr(line, ':')))
 			continue;
 		dummy[0] = '\0';
 		dummy++;
 
-		device = buffer;
+		device = line;
 		while (device[0] == ' ')
 			device++;
 
 		if (device[0] == '\0')
 			continue;
 
-		numfields = strsplit (dummy, fields, 16);
+		numfields = cu_procfs_fields (dummy, fields, 16);
 
 		if (numfields < 11)
 			continue;
 
-		incoming = atoll (fields[0]);
-		outgoing = atoll (fields[8]);
+		incoming = cu_procfs_u64 (fields[0]);
+		outgoing = cu_procfs_u64 (fields[8]);
 		if_submit (device, "if_octets", incoming, outgoing);
 
-		incoming = atoll (fields[1]);
-		outgoing = atoll (fields[9]);
+		incoming = cu_procfs_u64 (fields[1]);
+		outgoing = cu_procfs_u64 (fields[9]);
 		if_submit (device, "if_packets", incoming, outgoing);
 
-		incoming = atoll (fields[2]);
-		outgoing = atoll (fields[10]);
+		incoming = cu_procfs_u64 (fields[2]);
+		outgoing = cu_procfs_u64 (fields[10]);
 		if_submit (device, "if_errors", incoming, outgoing);
 	}
-
-	fclose (fh);
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKSTAT
@@ -376,6 +1057,32 @@ static int interface_read (void)
 	return (0);
 } /* int interface_read */
 
+#if KERNEL_LINUX && !HAVE_GETIFADDRS
+static int interface_shutdown (void)
+{
+#if IF_NETLINK
+	if_nl_close ();
+
+	if (if_links != NULL)
+	{
+		int *key;
+		if_link_t *link;
+
+		while (c_avl_pick (if_links, (void *) &key, (void *) &link) == 0)
+			sfree (link);
+		c_avl_destroy (if_links);
+		if_links = NULL;
+		if_links_num = 0;
+		if_links_selected = 0;
+	}
+#endif
+	cu_procfs_destroy (proc_net_dev);
+	proc_net_dev = NULL;
+
+	return (0);
+} /* int interface_shutdown */
+#endif
+
 void module_register (void)
 {
 	plugin_register_config ("interface", interface_config,
@@ -384,4 +1091,7 @@ void module_register (void)
 	plugin_register_init ("interface", interface_init);
 #endif
 	plugin_register_read ("interface", interface_read);
+#if KERNEL_LINUX && !HAVE_GETIFADDRS
+	plugin_register_shutdown ("interface", interface_shutdown);
+#endif
 } /* void module_register */
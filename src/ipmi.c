@@ -664,7 +664,7 @@ static int c_ipmi_init (void)
   int status;
 
   /* Don't send `ADD' notifications during startup (~ 1 minute) */
-  c_ipmi_init_in_progress = 1 + (60 / interval_g);
+  c_ipmi_init_in_progress = 1 + (int) (60.0 / CDTIME_T_TO_DOUBLE (interval_g));
 
   c_ipmi_active = 1;
 
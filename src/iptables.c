@@ -111,6 +111,26 @@ typedef struct {
 static ip_chain_t **chain_list = NULL;
 static int chain_num = 0;
 
+/*
+ * All entries configured for the same chain. The groups are sorted by
+ * protocol and table, so each table is fetched from the kernel once per read
+ * and each chain is walked once for all of its entries.
+ */
+typedef struct {
+    protocol_version_t ip_version;
+    char table[XT_TABLE_MAXNAMELEN];
+    char chain[XT_TABLE_MAXNAMELEN];
+    ip_chain_t **entries;
+    int entries_num;
+    /* Number of entries selecting rules by comment. */
+    int comments_num;
+    /* Highest rule number selected, if no entry selects by comment. */
+    int rule_num_max;
+} ip_chain_group_t;
+
+static ip_chain_group_t *group_list = NULL;
+static int group_num = 0;
+
 static int iptables_config (const char *key, const char *value)
 {
 	/* int ip_value; */
@@ -369,14 +389,52 @@ static int submit_match (const struct ipt_entry_match *match,
 } /* int submit_match */
 
 
+/* ipv6 submit_group_match: Passes a comment match to all entries selecting
+ * rules by comment. */
+static int submit6_group_match (const struct ip6t_entry_match *match,
+                const struct ip6t_entry *entry,
+                const ip_chain_group_t *group,
+                int rule_num)
+{
+    int i;
+
+    if (strcmp (match->u.user.name, "comment") != 0)
+        return (0);
+
+    for (i = 0; i < group->entries_num; i++)
+        if (group->entries[i]->rule_type != RTYPE_NUM)
+            submit6_match (match, entry, group->entries[i], rule_num);
+
+    return (0);
+} /* int submit6_group_match */
+
+/* ipv4 submit_group_match */
+static int submit_group_match (const struct ipt_entry_match *match,
+		const struct ipt_entry *entry,
+		const ip_chain_group_t *group,
+		int rule_num)
+{
+    int i;
+
+    if (strcmp (match->u.user.name, "comment") != 0)
+	return (0);
+
+    for (i = 0; i < group->entries_num; i++)
+	if (group->entries[i]->rule_type != RTYPE_NUM)
+	    submit_match (match, entry, group->entries[i], rule_num);
+
+    return (0);
+} /* int submit_group_match */
+
 /* ipv6 submit_chain */
-static void submit6_chain( ip6tc_handle_t *handle, ip_chain_t *chain )
+static void submit6_chain( ip6tc_handle_t *handle, const ip_chain_group_t *group )
 {
     const struct ip6t_entry *entry;
     int rule_num;
+    int i;
 
     /* Find first rule for chain and use the iterate macro */
-    entry = ip6tc_first_rule( chain->chain, handle );
+    entry = ip6tc_first_rule( group->chain, handle );
     if (entry == NULL)
     {
         DEBUG ("ip6tc_first_rule failed: %s", ip6tc_strerror (errno));
@@ -386,15 +444,19 @@ static void submit6_chain( ip6tc_handle_t *handle, ip_chain_t *chain )
     rule_num = 1;
     while (entry)
     {
-        if (chain->rule_type == RTYPE_NUM)
-        {
-            submit6_match (NULL, entry, chain, rule_num);
-        }
-        else
+        for (i = 0; i < group->entries_num; i++)
         {
-            IP6T_MATCH_ITERATE( entry, submit6_match, entry, chain, rule_num );
+            ip_chain_t *chain = group->entries[i];
+
+            if ((chain->rule_type == RTYPE_NUM) && (chain->rule.num == rule_num))
+                submit6_match (NULL, entry, chain, rule_num);
         }
 
+        if (group->comments_num > 0)
+            IP6T_MATCH_ITERATE( entry, submit6_group_match, entry, group, rule_num );
+        else if (rule_num >= group->rule_num_max)
+            break;
+
         entry = ip6tc_next_rule( entry, handle );
         rule_num++;
     } /* while (entry) */
@@ -402,13 +464,14 @@ static void submit6_chain( ip6tc_handle_t *handle, ip_chain_t *chain )
 
 
 /* ipv4 submit_chain */
-static void submit_chain( iptc_handle_t *handle, ip_chain_t *chain )
+static void submit_chain( iptc_handle_t *handle, const ip_chain_group_t *group )
 {
     const struct ipt_entry *entry;
     int rule_num;
+    int i;
 
     /* Find first rule for chain and use the iterate macro */    
-    entry = iptc_first_rule( chain->chain, handle );
+    entry = iptc_first_rule( group->chain, handle );
     if (entry == NULL)
     {
 	DEBUG ("iptc_first_rule failed: %s", iptc_strerror (errno));
@@ -418,90 +481,226 @@ static void submit_chain( iptc_handle_t *handle, ip_chain_t *chain )
     rule_num = 1;
     while (entry)
     {
-	if (chain->rule_type == RTYPE_NUM)
+	for (i = 0; i < group->entries_num; i++)
 	{
-	    submit_match (NULL, entry, chain, rule_num);
-	}
-	else
-	{
-	    IPT_MATCH_ITERATE( entry, submit_match, entry, chain, rule_num );
+	    ip_chain_t *chain = group->entries[i];
+
+	    if ((chain->rule_type == RTYPE_NUM) && (chain->rule.num == rule_num))
+		submit_match (NULL, entry, chain, rule_num);
 	}
 
+	if (group->comments_num > 0)
+	    IPT_MATCH_ITERATE( entry, submit_group_match, entry, group, rule_num );
+	else if (rule_num >= group->rule_num_max)
+	    break;
+
 	entry = iptc_next_rule( entry, handle );
 	rule_num++;
     } /* while (entry) */
 }
 
+/* Fetches the table of the given groups once and walks their chains. */
+static int ip6tables_read_table (const ip_chain_group_t *groups, int groups_num)
+{
+    int i;
+#ifdef HAVE_IP6TC_HANDLE_T
+    ip6tc_handle_t _handle;
+    ip6tc_handle_t *handle = &_handle;
+
+    *handle = ip6tc_init (groups[0].table);
+    if (*handle == NULL)
+#else
+    ip6tc_handle_t *handle;
+
+    handle = ip6tc_init (groups[0].table);
+    if (handle == NULL)
+#endif
+    {
+        ERROR ("iptables plugin: ip6tc_init (%s) failed: %s",
+                groups[0].table, ip6tc_strerror (errno));
+        return (-1);
+    }
+
+    for (i = 0; i < groups_num; i++)
+        submit6_chain (handle, groups + i);
+
+    ip6tc_free (handle);
+    return (0);
+} /* int ip6tables_read_table */
+
+static int iptables_read_table (const ip_chain_group_t *groups, int groups_num)
+{
+    int i;
+#ifdef HAVE_IPTC_HANDLE_T
+    iptc_handle_t _handle;
+    iptc_handle_t *handle = &_handle;
+
+    *handle = iptc_init (groups[0].table);
+    if (*handle == NULL)
+#else
+    iptc_handle_t *handle;
+
+    handle = iptc_init (groups[0].table);
+    if (handle == NULL)
+#endif
+    {
+	ERROR ("iptables plugin: iptc_init (%s) failed: %s",
+		groups[0].table, iptc_strerror (errno));
+	return (-1);
+    }
+
+    for (i = 0; i < groups_num; i++)
+	submit_chain (handle, groups + i);
+
+    iptc_free (handle);
+    return (0);
+} /* int iptables_read_table */
+
+static void submit_read_time (const ip_chain_group_t *group, double seconds)
+{
+    value_t values[1];
+    value_list_t vl = VALUE_LIST_INIT;
+
+    values[0].gauge = seconds;
+
+    vl.values = values;
+    vl.values_len = 1;
+    sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+    sstrncpy (vl.plugin, (group->ip_version == IPV6) ? "ip6tables" : "iptables",
+	    sizeof (vl.plugin));
+    sstrncpy (vl.plugin_instance, group->table, sizeof (vl.plugin_instance));
+    sstrncpy (vl.type, "response_time", sizeof (vl.type));
+
+    plugin_dispatch_values (&vl);
+} /* void submit_read_time */
 
 static int iptables_read (void)
 {
     int i;
     int num_failures = 0;
-    ip_chain_t *chain;
 
-    /* Init the iptc handle structure and query the correct table */    
-    for (i = 0; i < chain_num; i++)
+    /* Groups of the same table are adjacent: fetch each table once. */
+    i = 0;
+    while (i < group_num)
     {
-	chain = chain_list[i];
-	
-	if (!chain)
+	ip_chain_group_t *first = group_list + i;
+	struct timeval start, end;
+	int groups_num;
+	int status;
+	int j;
+
+	for (groups_num = 1; i + groups_num < group_num; groups_num++)
 	{
-	    DEBUG ("iptables plugin: chain == NULL");
-	    continue;
+	    ip_chain_group_t *group = group_list + i + groups_num;
+
+	    if ((group->ip_version != first->ip_version)
+		    || (strcmp (group->table, first->table) != 0))
+		break;
 	}
 
-	if ( chain->ip_version == IPV4 )
-        {
-#ifdef HAVE_IPTC_HANDLE_T
-		iptc_handle_t _handle;
-		iptc_handle_t *handle = &_handle;
+	gettimeofday (&start, /* timezone = */ NULL);
 
-		*handle = iptc_init (chain->table);
-#else
-		iptc_handle_t *handle;
-                handle = iptc_init (chain->table);
-#endif
+	if (first->ip_version == IPV4)
+	    status = iptables_read_table (first, groups_num);
+	else
+	    status = ip6tables_read_table (first, groups_num);
 
-                if (!handle)
-                {
-                        ERROR ("iptables plugin: iptc_init (%s) failed: %s",
-                                chain->table, iptc_strerror (errno));
-                        num_failures++;
-                        continue;
-                }
+	if (status == 0)
+	{
+	    gettimeofday (&end, /* timezone = */ NULL);
+	    submit_read_time (first, (double) (end.tv_sec - start.tv_sec)
+		    + ((double) (end.tv_usec - start.tv_usec)) / 1000000.0);
+	}
+	else
+	{
+	    for (j = 0; j < groups_num; j++)
+		num_failures += first[j].entries_num;
+	}
 
-                submit_chain (handle, chain);
-                iptc_free (handle);
-        }
-        else if ( chain->ip_version == IPV6 )
-        {
-#ifdef HAVE_IP6TC_HANDLE_T
-		ip6tc_handle_t _handle;
-		ip6tc_handle_t *handle = &_handle;
+	i += groups_num;
+    } /* while (i < group_num) */
 
-		*handle = ip6tc_init (chain->table);
-#else
-                ip6tc_handle_t *handle;
-                handle = ip6tc_init (chain->table);
-#endif
+    return ((num_failures < chain_num) ? 0 : -1);
+} /* int iptables_read */
 
-                if (!handle)
-                {
-                        ERROR ("iptables plugin: ip6tc_init (%s) failed: %s",
-                                chain->table, ip6tc_strerror (errno));
-                        num_failures++;
-                        continue;
-                }
+static int iptables_group_compare (const void *a, const void *b)
+{
+    const ip_chain_group_t *ga = a;
+    const ip_chain_group_t *gb = b;
 
-                submit6_chain (handle, chain);
-                ip6tc_free (handle);
-        }
-        else num_failures++;
+    if (ga->ip_version != gb->ip_version)
+	return ((ga->ip_version < gb->ip_version) ? -1 : 1);
+
+    return (strcmp (ga->table, gb->table));
+} /* int iptables_group_compare */
+
+static int iptables_init (void)
+{
+    int i;
+    int j;
+
+    if (group_list != NULL)
+	return (0);
 
+    for (i = 0; i < chain_num; i++)
+    {
+	ip_chain_t *chain = chain_list[i];
+	ip_chain_group_t *group = NULL;
+	ip_chain_t **entries;
+
+	if (chain == NULL)
+	    continue;
+
+	for (j = 0; j < group_num; j++)
+	{
+	    if ((group_list[j].ip_version == chain->ip_version)
+		    && (strcmp (group_list[j].table, chain->table) == 0)
+		    && (strcmp (group_list[j].chain, chain->chain) == 0))
+	    {
+		group = group_list + j;
+		break;
+	    }
+	}
+
+	if (group == NULL)
+	{
+	    group = realloc (group_list, (group_num + 1) * sizeof (*group_list));
+	    if (group == NULL)
+	    {
+		ERROR ("iptables plugin: realloc failed.");
+		return (-1);
+	    }
+	    group_list = group;
+
+	    group = group_list + group_num;
+	    memset (group, 0, sizeof (*group));
+	    group->ip_version = chain->ip_version;
+	    sstrncpy (group->table, chain->table, sizeof (group->table));
+	    sstrncpy (group->chain, chain->chain, sizeof (group->chain));
+	    group_num++;
+	}
+
+	entries = realloc (group->entries,
+		(group->entries_num + 1) * sizeof (*entries));
+	if (entries == NULL)
+	{
+	    ERROR ("iptables plugin: realloc failed.");
+	    return (-1);
+	}
+	group->entries = entries;
+	group->entries[group->entries_num] = chain;
+	group->entries_num++;
+
+	if (chain->rule_type != RTYPE_NUM)
+	    group->comments_num++;
+	else if (chain->rule.num > group->rule_num_max)
+	    group->rule_num_max = chain->rule.num;
     } /* for (i = 0 .. chain_num) */
 
-    return ((num_failures < chain_num) ? 0 : -1);
-} /* int iptables_read */
+    qsort (group_list, group_num, sizeof (*group_list), iptables_group_compare);
+
+    return (0);
+} /* int iptables_init */
 
 static int iptables_shutdown (void)
 {
@@ -517,6 +716,11 @@ static int iptables_shutdown (void)
     }
     sfree (chain_list);
 
+    for (i = 0; i < group_num; i++)
+	sfree (group_list[i].entries);
+    sfree (group_list);
+    group_num = 0;
+
     return (0);
 } /* int iptables_shutdown */
 
@@ -524,6 +728,7 @@ void module_register (void)
 {
     plugin_register_config ("iptables", iptables_config,
 	    config_keys, config_keys_num);
+    plugin_register_init ("iptables", iptables_init);
     plugin_register_read ("iptables", iptables_read);
     plugin_register_shutdown ("iptables", iptables_shutdown);
 } /* void module_register */
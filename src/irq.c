@@ -24,6 +24,7 @@
 #include "common.h"
 #include "plugin.h"
 #include "configfile.h"
+#include "utils_procfs.h"
 
 #if !KERNEL_LINUX
 # error "No applicable input method."
@@ -49,6 +50,8 @@ static unsigned int   irq_list_num = 0;
  */
 static int irq_list_action;
 
+static cu_procfs_t *proc_interrupts = NULL;
+
 static int irq_config (const char *key, const char *value)
 {
 	if (strcasecmp (key, "Irq") == 0)
@@ -128,29 +131,41 @@ static void irq_submit (const char *irq_name, counter_t value)
 
 static int irq_read (void)
 {
-	FILE *fh;
-	char buffer[1024];
+	char *buffer;
+	char *line;
 	unsigned long long irq_value;
-	unsigned long long value;
-	char *endptr;
+	uint64_t value;
 	int i;
 
 	char *fields[64];
 	int fields_num;
 
-	if ((fh = fopen ("/proc/interrupts", "r")) == NULL)
+	if (proc_interrupts == NULL)
+	{
+		proc_interrupts = cu_procfs_create ("/proc/interrupts");
+		if (proc_interrupts == NULL)
+		{
+			char errbuf[1024];
+			WARNING ("irq plugin: open (/proc/interrupts): %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			return (-1);
+		}
+	}
+
+	if ((buffer = cu_procfs_read (proc_interrupts, NULL)) == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("irq plugin: fopen (/proc/interrupts): %s",
+		WARNING ("irq plugin: read (/proc/interrupts): %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+
+	while ((line = cu_procfs_line (&buffer)) != NULL)
 	{
 		char *irq_name;
 		size_t irq_name_len;
 
-		fields_num = strsplit (buffer, fields, 64);
+		fields_num = cu_procfs_fields (line, fields, 64);
 		if (fields_num < 2)
 			continue;
 
@@ -170,12 +185,8 @@ static int irq_read (void)
 		irq_value = 0;
 		for (i = 1; i < fields_num; i++)
 		{
-			errno = 0;
-			endptr = NULL;
-			value = strtoull (fields[i], &endptr, 10);
-
 			/* Ignore all fields following a non-numeric field. */
-			if ((errno != 0) || (endptr == NULL) || (*endptr != 0))
+			if (cu_procfs_parse_u64 (fields[i], &value) != 0)
 				break;
 
 			irq_value += value;
@@ -189,14 +200,21 @@ static int irq_read (void)
 		irq_submit (irq_name, irq_value % 4294967296ULL);
 	}
 
-	fclose (fh);
-
 	return (0);
 } /* int irq_read */
 
+static int irq_shutdown (void)
+{
+	cu_procfs_destroy (proc_interrupts);
+	proc_interrupts = NULL;
+
+	return (0);
+} /* int irq_shutdown */
+
 void module_register (void)
 {
 	plugin_register_config ("irq", irq_config,
 			config_keys, config_keys_num);
 	plugin_register_read ("irq", irq_read);
+	plugin_register_shutdown ("irq", irq_shutdown);
 } /* void module_register */
@@ -63,6 +63,7 @@ typedef struct java_plugin_class_s java_plugin_class_t;
 #define CB_TYPE_NOTIFICATION 8
 #define CB_TYPE_MATCH        9
 #define CB_TYPE_TARGET      10
+#define CB_TYPE_WRITE_BATCH 11
 struct cjni_callback_info_s /* {{{ */
 {
   char     *name;
@@ -74,6 +75,59 @@ struct cjni_callback_info_s /* {{{ */
 typedef struct cjni_callback_info_s cjni_callback_info_t;
 /* }}} */
 
+/* Write callback which receives value lists in batches, see
+ * `registerWriteBatch'. */
+struct cjni_write_batch_s /* {{{ */
+{
+  cjni_callback_info_t *cbi;
+
+  pthread_mutex_t lock;
+  value_list_t *values;
+  const data_set_t **data_sets;
+  size_t values_num;
+  size_t size;
+  cdtime_t first_time;
+};
+typedef struct cjni_write_batch_s cjni_write_batch_t;
+/* }}} */
+
+/* Classes and method IDs used when converting value lists. They are looked
+ * up once after the JVM has been created, because doing so for every value
+ * list dominates the cost of write callbacks. */
+struct cjni_cache_s /* {{{ */
+{
+  jclass    c_valuelist;
+  jmethodID m_valuelist_constructor;
+  jmethodID m_valuelist_setdataset;
+  jmethodID m_valuelist_addvalue;
+  jmethodID m_valuelist_getvalues;
+  jmethodID m_valuelist_sethost;
+  jmethodID m_valuelist_setplugin;
+  jmethodID m_valuelist_setplugininstance;
+  jmethodID m_valuelist_settype;
+  jmethodID m_valuelist_settypeinstance;
+  jmethodID m_valuelist_settime;
+  jmethodID m_valuelist_setinterval;
+  jmethodID m_valuelist_gethost;
+  jmethodID m_valuelist_getplugin;
+  jmethodID m_valuelist_getplugininstance;
+  jmethodID m_valuelist_gettype;
+  jmethodID m_valuelist_gettypeinstance;
+  jmethodID m_valuelist_gettime;
+  jmethodID m_valuelist_getinterval;
+
+  jclass    c_long;
+  jmethodID m_long_constructor;
+  jclass    c_double;
+  jmethodID m_double_constructor;
+
+  jmethodID m_number_longvalue;
+  jmethodID m_number_doublevalue;
+  jmethodID m_list_toarray;
+};
+typedef struct cjni_cache_s cjni_cache_t;
+/* }}} */
+
 /*
  * Global variables
  */
@@ -95,6 +149,13 @@ static pthread_mutex_t       java_callbacks_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static oconfig_item_t       *config_block = NULL;
 
+/* Batched write callbacks, flushed when shutting down. */
+static cjni_write_batch_t  **java_write_batches     = NULL;
+static size_t                java_write_batches_num = 0;
+static pthread_mutex_t       java_write_batches_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static cjni_cache_t cjni_cache;
+
 /*
  * Prototypes
  *
@@ -109,6 +170,11 @@ static int cjni_callback_register (JNIEnv *jvm_env, jobject o_name,
 static int cjni_read (user_data_t *user_data);
 static int cjni_write (const data_set_t *ds, const value_list_t *vl,
     user_data_t *ud);
+static int cjni_write_batch (const data_set_t *ds, const value_list_t *vl,
+    user_data_t *ud);
+static int cjni_write_batch_flush (int timeout, const char *identifier,
+    user_data_t *ud);
+static void cjni_write_batch_destroy (void *arg);
 static int cjni_flush (int timeout, const char *identifier, user_data_t *ud);
 static void cjni_log (int severity, const char *message, user_data_t *ud);
 static int cjni_notification (const notification_t *n, user_data_t *ud);
@@ -225,57 +291,15 @@ static int ctoj_double (JNIEnv *jvm_env, /* {{{ */
 /* Convert a jlong to a java.lang.Number */
 static jobject ctoj_jlong_to_number (JNIEnv *jvm_env, jlong value) /* {{{ */
 {
-  jclass c_long;
-  jmethodID m_long_constructor;
-
-  /* Look up the java.lang.Long class */
-  c_long = (*jvm_env)->FindClass (jvm_env, "java/lang/Long");
-  if (c_long == NULL)
-  {
-    ERROR ("java plugin: ctoj_jlong_to_number: Looking up the "
-        "java.lang.Long class failed.");
-    return (NULL);
-  }
-
-  m_long_constructor = (*jvm_env)->GetMethodID (jvm_env,
-      c_long, "<init>", "(J)V");
-  if (m_long_constructor == NULL)
-  {
-    ERROR ("java plugin: ctoj_jlong_to_number: Looking up the "
-        "`Long (long)' constructor failed.");
-    return (NULL);
-  }
-
   return ((*jvm_env)->NewObject (jvm_env,
-        c_long, m_long_constructor, value));
+        cjni_cache.c_long, cjni_cache.m_long_constructor, value));
 } /* }}} jobject ctoj_jlong_to_number */
 
 /* Convert a jdouble to a java.lang.Number */
 static jobject ctoj_jdouble_to_number (JNIEnv *jvm_env, jdouble value) /* {{{ */
 {
-  jclass c_double;
-  jmethodID m_double_constructor;
-
-  /* Look up the java.lang.Long class */
-  c_double = (*jvm_env)->FindClass (jvm_env, "java/lang/Double");
-  if (c_double == NULL)
-  {
-    ERROR ("java plugin: ctoj_jdouble_to_number: Looking up the "
-        "java.lang.Double class failed.");
-    return (NULL);
-  }
-
-  m_double_constructor = (*jvm_env)->GetMethodID (jvm_env,
-      c_double, "<init>", "(D)V");
-  if (m_double_constructor == NULL)
-  {
-    ERROR ("java plugin: ctoj_jdouble_to_number: Looking up the "
-        "`Double (double)' constructor failed.");
-    return (NULL);
-  }
-
   return ((*jvm_env)->NewObject (jvm_env,
-        c_double, m_double_constructor, value));
+        cjni_cache.c_double, cjni_cache.m_double_constructor, value));
 } /* }}} jobject ctoj_jdouble_to_number */
 
 /* Convert a value_t to a java.lang.Number */
@@ -672,106 +696,38 @@ static jobject ctoj_data_set (JNIEnv *jvm_env, const data_set_t *ds) /* {{{ */
   return (o_dataset);
 } /* }}} jobject ctoj_data_set */
 
-static int ctoj_value_list_add_value (JNIEnv *jvm_env, /* {{{ */
-    value_t value, int ds_type,
-    jclass class_ptr, jobject object_ptr)
-{
-  jmethodID m_addvalue;
-  jobject o_number;
-
-  m_addvalue = (*jvm_env)->GetMethodID (jvm_env, class_ptr,
-      "addValue", "(Ljava/lang/Number;)V");
-  if (m_addvalue == NULL)
-  {
-    ERROR ("java plugin: ctoj_value_list_add_value: "
-        "Cannot find method `void addValue (Number)'.");
-    return (-1);
-  }
-
-  o_number = ctoj_value_to_number (jvm_env, value, ds_type);
-  if (o_number == NULL)
-  {
-    ERROR ("java plugin: ctoj_value_list_add_value: "
-        "ctoj_value_to_number failed.");
-    return (-1);
-  }
-
-  (*jvm_env)->CallVoidMethod (jvm_env, object_ptr, m_addvalue, o_number);
-
-  (*jvm_env)->DeleteLocalRef (jvm_env, o_number);
-
-  return (0);
-} /* }}} int ctoj_value_list_add_value */
-
-static int ctoj_value_list_add_data_set (JNIEnv *jvm_env, /* {{{ */
-    jclass c_valuelist, jobject o_valuelist, const data_set_t *ds)
+/* Call a cached `void setFoo (String s)' method. */
+static int ctoj_string_cached (JNIEnv *jvm_env, /* {{{ */
+    const char *string, jobject object_ptr, jmethodID m_set)
 {
-  jmethodID m_setdataset;
-  jobject o_dataset;
-
-  /* Look for the `void setDataSource (List<DataSource> ds)' method. */
-  m_setdataset = (*jvm_env)->GetMethodID (jvm_env, c_valuelist,
-      "setDataSet", "(Lorg/collectd/api/DataSet;)V");
-  if (m_setdataset == NULL)
-  {
-    ERROR ("java plugin: ctoj_value_list_add_data_set: "
-        "Cannot find the `void setDataSet (DataSet)' method.");
-    return (-1);
-  }
+  jstring o_string;
 
-  /* Create a DataSet object. */
-  o_dataset = ctoj_data_set (jvm_env, ds);
-  if (o_dataset == NULL)
+  o_string = (*jvm_env)->NewStringUTF (jvm_env,
+      (string != NULL) ? string : "");
+  if (o_string == NULL)
   {
-    ERROR ("java plugin: ctoj_value_list_add_data_set: "
-        "ctoj_data_set (%s) failed.", ds->type);
+    ERROR ("java plugin: ctoj_string_cached: NewStringUTF failed.");
     return (-1);
   }
 
-  /* Actually call the method. */
-  (*jvm_env)->CallVoidMethod (jvm_env,
-      o_valuelist, m_setdataset, o_dataset);
-
-  /* Decrease reference counter on the List<DataSource> object. */
-  (*jvm_env)->DeleteLocalRef (jvm_env, o_dataset);
+  (*jvm_env)->CallVoidMethod (jvm_env, object_ptr, m_set, o_string);
+  (*jvm_env)->DeleteLocalRef (jvm_env, o_string);
 
   return (0);
-} /* }}} int ctoj_value_list_add_data_set */
+} /* }}} int ctoj_string_cached */
 
-/* Convert a value_list_t (and data_set_t) to a org/collectd/api/ValueList */
+/* Convert a value_list_t (and data_set_t) to a org/collectd/api/ValueList. If
+ * `o_dataset' is not NULL, it is used instead of converting `ds' again. */
 static jobject ctoj_value_list (JNIEnv *jvm_env, /* {{{ */
-    const data_set_t *ds, const value_list_t *vl)
+    const data_set_t *ds, jobject o_dataset, const value_list_t *vl)
 {
-  jclass c_valuelist;
-  jmethodID m_valuelist_constructor;
   jobject o_valuelist;
   int status;
   int i;
 
-  /* First, create a new ValueList instance..
-   * Look up the class.. */
-  c_valuelist = (*jvm_env)->FindClass (jvm_env,
-      "org/collectd/api/ValueList");
-  if (c_valuelist == NULL)
-  {
-    ERROR ("java plugin: ctoj_value_list: "
-        "FindClass (org/collectd/api/ValueList) failed.");
-    return (NULL);
-  }
-
-  /* Lookup the `ValueList ()' constructor. */
-  m_valuelist_constructor = (*jvm_env)->GetMethodID (jvm_env, c_valuelist,
-      "<init>", "()V");
-  if (m_valuelist_constructor == NULL)
-  {
-    ERROR ("java plugin: ctoj_value_list: Cannot find the "
-        "`ValueList ()' constructor.");
-    return (NULL);
-  }
-
-  /* Create a new instance. */
-  o_valuelist = (*jvm_env)->NewObject (jvm_env, c_valuelist,
-      m_valuelist_constructor);
+  /* Create a new ValueList instance. */
+  o_valuelist = (*jvm_env)->NewObject (jvm_env, cjni_cache.c_valuelist,
+      cjni_cache.m_valuelist_constructor);
   if (o_valuelist == NULL)
   {
     ERROR ("java plugin: ctoj_value_list: Creating a new ValueList instance "
@@ -779,66 +735,72 @@ static jobject ctoj_value_list (JNIEnv *jvm_env, /* {{{ */
     return (NULL);
   }
 
-  status = ctoj_value_list_add_data_set (jvm_env,
-      c_valuelist, o_valuelist, ds);
-  if (status != 0)
+  if (o_dataset != NULL)
   {
-    ERROR ("java plugin: ctoj_value_list: "
-        "ctoj_value_list_add_data_set failed.");
-    (*jvm_env)->DeleteLocalRef (jvm_env, o_valuelist);
-    return (NULL);
+    (*jvm_env)->CallVoidMethod (jvm_env, o_valuelist,
+        cjni_cache.m_valuelist_setdataset, o_dataset);
+  }
+  else
+  {
+    o_dataset = ctoj_data_set (jvm_env, ds);
+    if (o_dataset == NULL)
+    {
+      ERROR ("java plugin: ctoj_value_list: ctoj_data_set (%s) failed.",
+          ds->type);
+      (*jvm_env)->DeleteLocalRef (jvm_env, o_valuelist);
+      return (NULL);
+    }
+
+    (*jvm_env)->CallVoidMethod (jvm_env, o_valuelist,
+        cjni_cache.m_valuelist_setdataset, o_dataset);
+
+    /* Decrease reference counter on the DataSet object. */
+    (*jvm_env)->DeleteLocalRef (jvm_env, o_dataset);
   }
 
   /* Set the strings.. */
-#define SET_STRING(str,method_name) do { \
-  status = ctoj_string (jvm_env, str, \
-      c_valuelist, o_valuelist, method_name); \
+#define SET_STRING(str,method) do { \
+  status = ctoj_string_cached (jvm_env, str, o_valuelist, \
+      cjni_cache.method); \
   if (status != 0) { \
-    ERROR ("java plugin: ctoj_value_list: ctoj_string (%s) failed.", \
-        method_name); \
+    ERROR ("java plugin: ctoj_value_list: ctoj_string_cached (%s) failed.", \
+        #method); \
     (*jvm_env)->DeleteLocalRef (jvm_env, o_valuelist); \
     return (NULL); \
   } } while (0)
 
-  SET_STRING (vl->host,            "setHost");
-  SET_STRING (vl->plugin,          "setPlugin");
-  SET_STRING (vl->plugin_instance, "setPluginInstance");
-  SET_STRING (vl->type,            "setType");
-  SET_STRING (vl->type_instance,   "setTypeInstance");
+  SET_STRING (vl->host,            m_valuelist_sethost);
+  SET_STRING (vl->plugin,          m_valuelist_setplugin);
+  SET_STRING (vl->plugin_instance, m_valuelist_setplugininstance);
+  SET_STRING (vl->type,            m_valuelist_settype);
+  SET_STRING (vl->type_instance,   m_valuelist_settypeinstance);
 
 #undef SET_STRING
 
   /* Set the `time' member. Java stores time in milliseconds. */
-  status = ctoj_long (jvm_env, ((jlong) vl->time) * ((jlong) 1000),
-      c_valuelist, o_valuelist, "setTime");
-  if (status != 0)
-  {
-    ERROR ("java plugin: ctoj_value_list: ctoj_long (setTime) failed.");
-    (*jvm_env)->DeleteLocalRef (jvm_env, o_valuelist);
-    return (NULL);
-  }
+  (*jvm_env)->CallVoidMethod (jvm_env, o_valuelist,
+      cjni_cache.m_valuelist_settime, (jlong) CDTIME_T_TO_MS (vl->time));
 
-  /* Set the `interval' member.. */
-  status = ctoj_long (jvm_env, (jlong) vl->interval,
-      c_valuelist, o_valuelist, "setInterval");
-  if (status != 0)
-  {
-    ERROR ("java plugin: ctoj_value_list: ctoj_long (setInterval) failed.");
-    (*jvm_env)->DeleteLocalRef (jvm_env, o_valuelist);
-    return (NULL);
-  }
+  /* Set the `interval' member. The Java API uses whole seconds. */
+  (*jvm_env)->CallVoidMethod (jvm_env, o_valuelist,
+      cjni_cache.m_valuelist_setinterval,
+      (jlong) CDTIME_T_TO_TIME_T (vl->interval));
 
   for (i = 0; i < vl->values_len; i++)
   {
-    status = ctoj_value_list_add_value (jvm_env, vl->values[i], ds->ds[i].type,
-        c_valuelist, o_valuelist);
-    if (status != 0)
+    jobject o_number;
+
+    o_number = ctoj_value_to_number (jvm_env, vl->values[i], ds->ds[i].type);
+    if (o_number == NULL)
     {
-      ERROR ("java plugin: ctoj_value_list: "
-          "ctoj_value_list_add_value failed.");
+      ERROR ("java plugin: ctoj_value_list: ctoj_value_to_number failed.");
       (*jvm_env)->DeleteLocalRef (jvm_env, o_valuelist);
       return (NULL);
     }
+
+    (*jvm_env)->CallVoidMethod (jvm_env, o_valuelist,
+        cjni_cache.m_valuelist_addvalue, o_number);
+    (*jvm_env)->DeleteLocalRef (jvm_env, o_number);
   }
 
   return (o_valuelist);
@@ -1019,81 +981,44 @@ static int jtoc_long (JNIEnv *jvm_env, /* {{{ */
   return (0);
 } /* }}} int jtoc_long */
 
-/* Call a `double <method> ()' method. */
-static int jtoc_double (JNIEnv *jvm_env, /* {{{ */
-    jdouble *ret_value,
-    jclass class_ptr, jobject object_ptr, const char *method_name)
+/* Call a cached `String getFoo ()' method. */
+static int jtoc_string_cached (JNIEnv *jvm_env, /* {{{ */
+    char *buffer, size_t buffer_size, int empty_okay,
+    jobject object_ptr, jmethodID method_id)
 {
-  jmethodID method_id;
+  jobject string_obj;
+  const char *c_str;
 
-  method_id = (*jvm_env)->GetMethodID (jvm_env, class_ptr,
-      method_name, "()D");
-  if (method_id == NULL)
-  {
-    ERROR ("java plugin: jtoc_double: Cannot find method `double %s ()'.",
-        method_name);
+  string_obj = (*jvm_env)->CallObjectMethod (jvm_env, object_ptr, method_id);
+  if ((string_obj == NULL) && (empty_okay == 0))
     return (-1);
+  else if (string_obj == NULL)
+  {
+    memset (buffer, 0, buffer_size);
+    return (0);
   }
 
-  *ret_value = (*jvm_env)->CallDoubleMethod (jvm_env, object_ptr, method_id);
-
-  return (0);
-} /* }}} int jtoc_double */
-
-static int jtoc_value (JNIEnv *jvm_env, /* {{{ */
-    value_t *ret_value, int ds_type, jobject object_ptr)
-{
-  jclass class_ptr;
-  int status;
-
-  class_ptr = (*jvm_env)->GetObjectClass (jvm_env, object_ptr);
-
-  if (ds_type == DS_TYPE_GAUGE)
+  c_str = (*jvm_env)->GetStringUTFChars (jvm_env, string_obj, 0);
+  if (c_str == NULL)
   {
-    jdouble tmp_double;
-
-    status = jtoc_double (jvm_env, &tmp_double,
-        class_ptr, object_ptr, "doubleValue");
-    if (status != 0)
-    {
-      ERROR ("java plugin: jtoc_value: "
-          "jtoc_double failed.");
-      return (-1);
-    }
-    (*ret_value).gauge = (gauge_t) tmp_double;
+    ERROR ("java plugin: jtoc_string_cached: GetStringUTFChars failed.");
+    (*jvm_env)->DeleteLocalRef (jvm_env, string_obj);
+    return (-1);
   }
-  else
-  {
-    jlong tmp_long;
 
-    status = jtoc_long (jvm_env, &tmp_long,
-        class_ptr, object_ptr, "longValue");
-    if (status != 0)
-    {
-      ERROR ("java plugin: jtoc_value: "
-          "jtoc_long failed.");
-      return (-1);
-    }
+  sstrncpy (buffer, c_str, buffer_size);
 
-    if (ds_type == DS_TYPE_DERIVE)
-      (*ret_value).derive = (derive_t) tmp_long;
-    else if (ds_type == DS_TYPE_ABSOLUTE)
-      (*ret_value).absolute = (absolute_t) tmp_long;
-    else
-      (*ret_value).counter = (counter_t) tmp_long;
-  }
+  (*jvm_env)->ReleaseStringUTFChars (jvm_env, string_obj, c_str);
+  (*jvm_env)->DeleteLocalRef (jvm_env, string_obj);
 
   return (0);
-} /* }}} int jtoc_value */
+} /* }}} int jtoc_string_cached */
 
 /* Read a List<Number>, convert it to `value_t' and add it to the given
  * `value_list_t'. */
 static int jtoc_values_array (JNIEnv *jvm_env, /* {{{ */
-    const data_set_t *ds, value_list_t *vl,
-    jclass class_ptr, jobject object_ptr)
+    const data_set_t *ds, value_list_t *vl, jobject object_ptr)
 {
-  jmethodID m_getvalues;
-  jmethodID m_toarray;
   jobject o_list;
   jobjectArray o_number_array;
 
@@ -1116,16 +1041,8 @@ static int jtoc_values_array (JNIEnv *jvm_env, /* {{{ */
   return (status);
 
   /* Call: List<Number> ValueList.getValues () */
-  m_getvalues = (*jvm_env)->GetMethodID (jvm_env, class_ptr,
-      "getValues", "()Ljava/util/List;");
-  if (m_getvalues == NULL)
-  {
-    ERROR ("java plugin: jtoc_values_array: "
-        "Cannot find method `List getValues ()'.");
-    BAIL_OUT (-1);
-  }
-
-  o_list = (*jvm_env)->CallObjectMethod (jvm_env, object_ptr, m_getvalues);
+  o_list = (*jvm_env)->CallObjectMethod (jvm_env, object_ptr,
+      cjni_cache.m_valuelist_getvalues);
   if (o_list == NULL)
   {
     ERROR ("java plugin: jtoc_values_array: "
@@ -1134,21 +1051,19 @@ static int jtoc_values_array (JNIEnv *jvm_env, /* {{{ */
   }
 
   /* Call: Number[] List.toArray () */
-  m_toarray = (*jvm_env)->GetMethodID (jvm_env,
-      (*jvm_env)->GetObjectClass (jvm_env, o_list),
-      "toArray", "()[Ljava/lang/Object;");
-  if (m_toarray == NULL)
+  o_number_array = (*jvm_env)->CallObjectMethod (jvm_env, o_list,
+      cjni_cache.m_list_toarray);
+  if (o_number_array == NULL)
   {
     ERROR ("java plugin: jtoc_values_array: "
-        "Cannot find method `Object[] toArray ()'.");
+        "CallObjectMethod (toArray) failed.");
     BAIL_OUT (-1);
   }
 
-  o_number_array = (*jvm_env)->CallObjectMethod (jvm_env, o_list, m_toarray);
-  if (o_number_array == NULL)
+  if ((*jvm_env)->GetArrayLength (jvm_env, o_number_array) < values_num)
   {
     ERROR ("java plugin: jtoc_values_array: "
-        "CallObjectMethod (toArray) failed.");
+        "The value list has fewer values than the `%s' type.", ds->type);
     BAIL_OUT (-1);
   }
 
@@ -1162,7 +1077,6 @@ static int jtoc_values_array (JNIEnv *jvm_env, /* {{{ */
   for (i = 0; i < values_num; i++)
   {
     jobject o_number;
-    int status;
 
     o_number = (*jvm_env)->GetObjectArrayElement (jvm_env,
         o_number_array, (jsize) i);
@@ -1173,13 +1087,27 @@ static int jtoc_values_array (JNIEnv *jvm_env, /* {{{ */
       BAIL_OUT (-1);
     }
 
-    status = jtoc_value (jvm_env, values + i, ds->ds[i].type, o_number);
-    if (status != 0)
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
     {
-      ERROR ("java plugin: jtoc_values_array: "
-          "jtoc_value (%i) failed.", i);
-      BAIL_OUT (-1);
+      values[i].gauge = (gauge_t) (*jvm_env)->CallDoubleMethod (jvm_env,
+          o_number, cjni_cache.m_number_doublevalue);
+    }
+    else
+    {
+      jlong tmp_long;
+
+      tmp_long = (*jvm_env)->CallLongMethod (jvm_env,
+          o_number, cjni_cache.m_number_longvalue);
+
+      if (ds->ds[i].type == DS_TYPE_DERIVE)
+        values[i].derive = (derive_t) tmp_long;
+      else if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
+        values[i].absolute = (absolute_t) tmp_long;
+      else
+        values[i].counter = (counter_t) tmp_long;
     }
+
+    (*jvm_env)->DeleteLocalRef (jvm_env, o_number);
   } /* for (i = 0; i < values_num; i++) */
 
   vl->values = values;
@@ -1195,29 +1123,21 @@ static int jtoc_values_array (JNIEnv *jvm_env, /* {{{ */
 static int jtoc_value_list (JNIEnv *jvm_env, value_list_t *vl, /* {{{ */
     jobject object_ptr)
 {
-  jclass class_ptr;
   int status;
   jlong tmp_long;
   const data_set_t *ds;
 
-  class_ptr = (*jvm_env)->GetObjectClass (jvm_env, object_ptr);
-  if (class_ptr == NULL)
-  {
-    ERROR ("java plugin: jtoc_value_list: GetObjectClass failed.");
-    return (-1);
-  }
-
   /* eo == empty okay */
 #define SET_STRING(buffer,method, eo) do { \
-  status = jtoc_string (jvm_env, buffer, sizeof (buffer), eo, \
-      class_ptr, object_ptr, method); \
+  status = jtoc_string_cached (jvm_env, buffer, sizeof (buffer), eo, \
+      object_ptr, cjni_cache.method); \
   if (status != 0) { \
-    ERROR ("java plugin: jtoc_value_list: jtoc_string (%s) failed.", \
-        method); \
+    ERROR ("java plugin: jtoc_value_list: jtoc_string_cached (%s) failed.", \
+        #method); \
     return (-1); \
   } } while (0)
 
-  SET_STRING(vl->type, "getType", /* empty = */ 0);
+  SET_STRING(vl->type, m_valuelist_gettype, /* empty = */ 0);
 
   ds = plugin_get_ds (vl->type);
   if (ds == NULL)
@@ -1228,32 +1148,23 @@ static int jtoc_value_list (JNIEnv *jvm_env, value_list_t *vl, /* {{{ */
     return (-1);
   }
 
-  SET_STRING(vl->host,            "getHost",           /* empty = */ 0);
-  SET_STRING(vl->plugin,          "getPlugin",         /* empty = */ 0);
-  SET_STRING(vl->plugin_instance, "getPluginInstance", /* empty = */ 1);
-  SET_STRING(vl->type_instance,   "getTypeInstance",   /* empty = */ 1);
+  SET_STRING(vl->host,            m_valuelist_gethost,           /* empty = */ 0);
+  SET_STRING(vl->plugin,          m_valuelist_getplugin,         /* empty = */ 0);
+  SET_STRING(vl->plugin_instance, m_valuelist_getplugininstance, /* empty = */ 1);
+  SET_STRING(vl->type_instance,   m_valuelist_gettypeinstance,   /* empty = */ 1);
 
 #undef SET_STRING
 
-  status = jtoc_long (jvm_env, &tmp_long, class_ptr, object_ptr, "getTime");
-  if (status != 0)
-  {
-    ERROR ("java plugin: jtoc_value_list: jtoc_long (getTime) failed.");
-    return (-1);
-  }
+  tmp_long = (*jvm_env)->CallLongMethod (jvm_env, object_ptr,
+      cjni_cache.m_valuelist_gettime);
   /* Java measures time in milliseconds. */
-  vl->time = (time_t) (tmp_long / ((jlong) 1000));
+  vl->time = MS_TO_CDTIME_T (tmp_long);
 
-  status = jtoc_long (jvm_env, &tmp_long,
-      class_ptr, object_ptr, "getInterval");
-  if (status != 0)
-  {
-    ERROR ("java plugin: jtoc_value_list: jtoc_long (getInterval) failed.");
-    return (-1);
-  }
-  vl->interval = (int) tmp_long;
+  tmp_long = (*jvm_env)->CallLongMethod (jvm_env, object_ptr,
+      cjni_cache.m_valuelist_getinterval);
+  vl->interval = TIME_T_TO_CDTIME_T (tmp_long);
 
-  status = jtoc_values_array (jvm_env, ds, vl, class_ptr, object_ptr);
+  status = jtoc_values_array (jvm_env, ds, vl, object_ptr);
   if (status != 0)
   {
     ERROR ("java plugin: jtoc_value_list: jtoc_values_array failed.");
@@ -1343,6 +1254,53 @@ static jint JNICALL cjni_api_dispatch_values (JNIEnv *jvm_env, /* {{{ */
   return (status);
 } /* }}} jint cjni_api_dispatch_values */
 
+static jint JNICALL cjni_api_dispatch_values_array (JNIEnv *jvm_env, /* {{{ */
+    jobject this, jobjectArray o_array)
+{
+  jsize array_len;
+  jsize i;
+  int failed;
+
+  if (o_array == NULL)
+    return (-1);
+
+  array_len = (*jvm_env)->GetArrayLength (jvm_env, o_array);
+  DEBUG ("cjni_api_dispatch_values_array: array_len = %i;", (int) array_len);
+
+  failed = 0;
+  for (i = 0; i < array_len; i++)
+  {
+    value_list_t vl = VALUE_LIST_INIT;
+    jobject java_vl;
+    int status;
+
+    java_vl = (*jvm_env)->GetObjectArrayElement (jvm_env, o_array, i);
+    if (java_vl == NULL)
+    {
+      failed++;
+      continue;
+    }
+
+    status = jtoc_value_list (jvm_env, &vl, java_vl);
+    (*jvm_env)->DeleteLocalRef (jvm_env, java_vl);
+    if (status != 0)
+    {
+      ERROR ("java plugin: cjni_api_dispatch_values_array: "
+          "jtoc_value_list failed.");
+      failed++;
+      continue;
+    }
+
+    status = plugin_dispatch_values (&vl);
+    if (status != 0)
+      failed++;
+
+    sfree (vl.values);
+  }
+
+  return ((jint) failed);
+} /* }}} jint cjni_api_dispatch_values_array */
+
 static jint JNICALL cjni_api_dispatch_notification (JNIEnv *jvm_env, /* {{{ */
     jobject this, jobject o_notification)
 {
@@ -1450,6 +1408,74 @@ static jint JNICALL cjni_api_register_write (JNIEnv *jvm_env, /* {{{ */
   return (0);
 } /* }}} jint cjni_api_register_write */
 
+static jint JNICALL cjni_api_register_write_batch (JNIEnv *jvm_env, /* {{{ */
+    jobject this, jobject o_name, jobject o_write, jint size)
+{
+  user_data_t ud;
+  cjni_callback_info_t *cbi;
+  cjni_write_batch_t *batch;
+  cjni_write_batch_t **tmp;
+
+  if (size <= 0)
+  {
+    ERROR ("java plugin: cjni_api_register_write_batch: "
+        "The batch size must be positive.");
+    return (-1);
+  }
+
+  cbi = cjni_callback_info_create (jvm_env, o_name, o_write,
+      CB_TYPE_WRITE_BATCH);
+  if (cbi == NULL)
+    return (-1);
+
+  batch = (cjni_write_batch_t *) malloc (sizeof (*batch));
+  if (batch == NULL)
+  {
+    ERROR ("java plugin: cjni_api_register_write_batch: malloc failed.");
+    cjni_callback_info_destroy (cbi);
+    return (-1);
+  }
+  memset (batch, 0, sizeof (*batch));
+  batch->cbi = cbi;
+  batch->size = (size_t) size;
+  pthread_mutex_init (&batch->lock, /* attr = */ NULL);
+
+  pthread_mutex_lock (&java_write_batches_lock);
+  tmp = (cjni_write_batch_t **) realloc (java_write_batches,
+      (java_write_batches_num + 1) * sizeof (*java_write_batches));
+  if (tmp == NULL)
+  {
+    pthread_mutex_unlock (&java_write_batches_lock);
+    ERROR ("java plugin: cjni_api_register_write_batch: realloc failed.");
+    pthread_mutex_destroy (&batch->lock);
+    sfree (batch);
+    cjni_callback_info_destroy (cbi);
+    return (-1);
+  }
+  java_write_batches = tmp;
+  java_write_batches[java_write_batches_num] = batch;
+  java_write_batches_num++;
+  pthread_mutex_unlock (&java_write_batches_lock);
+
+  DEBUG ("java plugin: Registering new batched write callback: %s (size %i)",
+      cbi->name, (int) size);
+
+  memset (&ud, 0, sizeof (ud));
+  ud.data = (void *) batch;
+  ud.free_func = cjni_write_batch_destroy;
+
+  plugin_register_write (cbi->name, cjni_write_batch, &ud);
+
+  /* The flush callback shares the batch with the write callback, which is
+   * responsible for freeing it. */
+  ud.free_func = NULL;
+  plugin_register_flush (cbi->name, cjni_write_batch_flush, &ud);
+
+  (*jvm_env)->DeleteLocalRef (jvm_env, o_write);
+
+  return (0);
+} /* }}} jint cjni_api_register_write_batch */
+
 static jint JNICALL cjni_api_register_flush (JNIEnv *jvm_env, /* {{{ */
     jobject this, jobject o_name, jobject o_flush)
 {
@@ -1636,6 +1662,10 @@ static JNINativeMethod jni_api_functions[] = /* {{{ */
     "(Lorg/collectd/api/ValueList;)I",
     cjni_api_dispatch_values },
 
+  { "dispatchValues",
+    "([Lorg/collectd/api/ValueList;)I",
+    cjni_api_dispatch_values_array },
+
   { "dispatchNotification",
     "(Lorg/collectd/api/Notification;)I",
     cjni_api_dispatch_notification },
@@ -1660,6 +1690,10 @@ static JNINativeMethod jni_api_functions[] = /* {{{ */
     "(Ljava/lang/String;Lorg/collectd/api/CollectdWriteInterface;)I",
     cjni_api_register_write },
 
+  { "registerWriteBatch",
+    "(Ljava/lang/String;Lorg/collectd/api/CollectdWriteBatchInterface;I)I",
+    cjni_api_register_write_batch },
+
   { "registerFlush",
     "(Ljava/lang/String;Lorg/collectd/api/CollectdFlushInterface;)I",
     cjni_api_register_flush },
@@ -1727,6 +1761,11 @@ static cjni_callback_info_t *cjni_callback_info_create (JNIEnv *jvm_env, /* {{{
       method_signature = "(Lorg/collectd/api/ValueList;)I";
       break;
 
+    case CB_TYPE_WRITE_BATCH:
+      method_name = "write";
+      method_signature = "([Lorg/collectd/api/ValueList;)I";
+      break;
+
     case CB_TYPE_FLUSH:
       method_name = "flush";
       method_signature = "(ILjava/lang/String;)I";
@@ -1948,6 +1987,119 @@ static int cjni_init_native (JNIEnv *jvm_env) /* {{{ */
   return (0);
 } /* }}} int cjni_init_native */
 
+/* Look up the classes and methods used by the value list conversion
+ * functions and store them in `cjni_cache'. */
+static int cjni_cache_init (JNIEnv *jvm_env) /* {{{ */
+{
+  jclass c_tmp;
+
+#define LOOKUP_CLASS(var,name) do { \
+  c_tmp = (*jvm_env)->FindClass (jvm_env, name); \
+  if (c_tmp == NULL) { \
+    ERROR ("java plugin: cjni_cache_init: Looking up the %s class failed.", \
+        name); \
+    return (-1); \
+  } \
+  var = (*jvm_env)->NewGlobalRef (jvm_env, c_tmp); \
+  (*jvm_env)->DeleteLocalRef (jvm_env, c_tmp); \
+  if (var == NULL) { \
+    ERROR ("java plugin: cjni_cache_init: NewGlobalRef failed."); \
+    return (-1); \
+  } } while (0)
+
+#define LOOKUP_METHOD(var,class,name,signature) do { \
+  var = (*jvm_env)->GetMethodID (jvm_env, class, name, signature); \
+  if (var == NULL) { \
+    ERROR ("java plugin: cjni_cache_init: Cannot find the `%s' method " \
+        "with signature `%s'.", name, signature); \
+    return (-1); \
+  } } while (0)
+
+  LOOKUP_CLASS (cjni_cache.c_valuelist, "org/collectd/api/ValueList");
+  LOOKUP_METHOD (cjni_cache.m_valuelist_constructor,
+      cjni_cache.c_valuelist, "<init>", "()V");
+  LOOKUP_METHOD (cjni_cache.m_valuelist_setdataset, cjni_cache.c_valuelist,
+      "setDataSet", "(Lorg/collectd/api/DataSet;)V");
+  LOOKUP_METHOD (cjni_cache.m_valuelist_addvalue, cjni_cache.c_valuelist,
+      "addValue", "(Ljava/lang/Number;)V");
+  LOOKUP_METHOD (cjni_cache.m_valuelist_getvalues, cjni_cache.c_valuelist,
+      "getValues", "()Ljava/util/List;");
+
+#define LOOKUP_STRING_METHODS(member,name) do { \
+  LOOKUP_METHOD (cjni_cache.m_valuelist_set##member, cjni_cache.c_valuelist, \
+      "set" name, "(Ljava/lang/String;)V"); \
+  LOOKUP_METHOD (cjni_cache.m_valuelist_get##member, cjni_cache.c_valuelist, \
+      "get" name, "()Ljava/lang/String;"); \
+  } while (0)
+
+  LOOKUP_STRING_METHODS (host,           "Host");
+  LOOKUP_STRING_METHODS (plugin,         "Plugin");
+  LOOKUP_STRING_METHODS (plugininstance, "PluginInstance");
+  LOOKUP_STRING_METHODS (type,           "Type");
+  LOOKUP_STRING_METHODS (typeinstance,   "TypeInstance");
+
+#undef LOOKUP_STRING_METHODS
+
+  LOOKUP_METHOD (cjni_cache.m_valuelist_settime, cjni_cache.c_valuelist,
+      "setTime", "(J)V");
+  LOOKUP_METHOD (cjni_cache.m_valuelist_gettime, cjni_cache.c_valuelist,
+      "getTime", "()J");
+  LOOKUP_METHOD (cjni_cache.m_valuelist_setinterval, cjni_cache.c_valuelist,
+      "setInterval", "(J)V");
+  LOOKUP_METHOD (cjni_cache.m_valuelist_getinterval, cjni_cache.c_valuelist,
+      "getInterval", "()J");
+
+  LOOKUP_CLASS (cjni_cache.c_long, "java/lang/Long");
+  LOOKUP_METHOD (cjni_cache.m_long_constructor,
+      cjni_cache.c_long, "<init>", "(J)V");
+
+  LOOKUP_CLASS (cjni_cache.c_double, "java/lang/Double");
+  LOOKUP_METHOD (cjni_cache.m_double_constructor,
+      cjni_cache.c_double, "<init>", "(D)V");
+
+  /* Classes of the java.* namespace are never unloaded, so the method IDs
+   * stay valid without holding a reference to the class. */
+  c_tmp = (*jvm_env)->FindClass (jvm_env, "java/lang/Number");
+  if (c_tmp == NULL)
+  {
+    ERROR ("java plugin: cjni_cache_init: Looking up the "
+        "java/lang/Number class failed.");
+    return (-1);
+  }
+  LOOKUP_METHOD (cjni_cache.m_number_longvalue, c_tmp, "longValue", "()J");
+  LOOKUP_METHOD (cjni_cache.m_number_doublevalue, c_tmp, "doubleValue", "()D");
+  (*jvm_env)->DeleteLocalRef (jvm_env, c_tmp);
+
+  c_tmp = (*jvm_env)->FindClass (jvm_env, "java/util/List");
+  if (c_tmp == NULL)
+  {
+    ERROR ("java plugin: cjni_cache_init: Looking up the "
+        "java/util/List class failed.");
+    return (-1);
+  }
+  LOOKUP_METHOD (cjni_cache.m_list_toarray, c_tmp,
+      "toArray", "()[Ljava/lang/Object;");
+  (*jvm_env)->DeleteLocalRef (jvm_env, c_tmp);
+
+#undef LOOKUP_METHOD
+#undef LOOKUP_CLASS
+
+  return (0);
+} /* }}} int cjni_cache_init */
+
+/* Release the global references held by `cjni_cache'. */
+static void cjni_cache_destroy (JNIEnv *jvm_env) /* {{{ */
+{
+  if (cjni_cache.c_valuelist != NULL)
+    (*jvm_env)->DeleteGlobalRef (jvm_env, cjni_cache.c_valuelist);
+  if (cjni_cache.c_long != NULL)
+    (*jvm_env)->DeleteGlobalRef (jvm_env, cjni_cache.c_long);
+  if (cjni_cache.c_double != NULL)
+    (*jvm_env)->DeleteGlobalRef (jvm_env, cjni_cache.c_double);
+
+  memset (&cjni_cache, 0, sizeof (cjni_cache));
+} /* }}} void cjni_cache_destroy */
+
 /* Create the JVM. This is called when the first thread tries to access the JVM
  * via cjni_thread_attach. */
 static int cjni_create_jvm (void) /* {{{ */
@@ -2003,6 +2155,13 @@ static int cjni_create_jvm (void) /* {{{ */
     return (-1);
   }
 
+  status = cjni_cache_init (jvm_env);
+  if (status != 0)
+  {
+    ERROR ("java plugin: cjni_create_jvm: cjni_cache_init failed.");
+    return (-1);
+  }
+
   DEBUG ("java plugin: The JVM has been created.");
   return (0);
 } /* }}} int cjni_create_jvm */
@@ -2529,7 +2688,7 @@ static int cjni_write (const data_set_t *ds, const value_list_t *vl, /* {{{ */
 
   cbi = (cjni_callback_info_t *) ud->data;
 
-  vl_java = ctoj_value_list (jvm_env, ds, vl);
+  vl_java = ctoj_value_list (jvm_env, ds, /* o_dataset = */ NULL, vl);
   if (vl_java == NULL)
   {
     ERROR ("java plugin: cjni_write: ctoj_value_list failed.");
@@ -2551,6 +2710,321 @@ static int cjni_write (const data_set_t *ds, const value_list_t *vl, /* {{{ */
   return (ret_status);
 } /* }}} int cjni_write */
 
+/* Free the value lists taken from a `cjni_write_batch_t'. */
+static void cjni_write_batch_free_values (value_list_t *values, /* {{{ */
+    const data_set_t **data_sets, size_t values_num)
+{
+  size_t i;
+
+  if (values != NULL)
+    for (i = 0; i < values_num; i++)
+      sfree (values[i].values);
+
+  sfree (values);
+  sfree (data_sets);
+} /* }}} void cjni_write_batch_free_values */
+
+/* Convert the value lists to a `ValueList[]' and pass it to the
+ * CB_TYPE_WRITE_BATCH callback. Value lists of the same type share one
+ * `DataSet' object. */
+static int cjni_write_batch_deliver (JNIEnv *jvm_env, /* {{{ */
+    cjni_callback_info_t *cbi, value_list_t *values,
+    const data_set_t **data_sets, size_t values_num)
+{
+  jobjectArray o_array;
+  jobject o_dataset;
+  const data_set_t *last_ds;
+  jsize array_len;
+  size_t i;
+  int ret_status;
+
+  o_array = (*jvm_env)->NewObjectArray (jvm_env, (jsize) values_num,
+      cjni_cache.c_valuelist, /* initial element = */ NULL);
+  if (o_array == NULL)
+  {
+    ERROR ("java plugin: cjni_write_batch_deliver: NewObjectArray failed.");
+    return (-1);
+  }
+
+  o_dataset = NULL;
+  last_ds = NULL;
+  array_len = 0;
+  for (i = 0; i < values_num; i++)
+  {
+    jobject o_vl;
+
+    if (data_sets[i] != last_ds)
+    {
+      if (o_dataset != NULL)
+        (*jvm_env)->DeleteLocalRef (jvm_env, o_dataset);
+
+      last_ds = data_sets[i];
+      o_dataset = ctoj_data_set (jvm_env, last_ds);
+      if (o_dataset == NULL)
+      {
+        ERROR ("java plugin: cjni_write_batch_deliver: "
+            "ctoj_data_set (%s) failed.", last_ds->type);
+        last_ds = NULL;
+        continue;
+      }
+    }
+
+    o_vl = ctoj_value_list (jvm_env, data_sets[i], o_dataset, values + i);
+    if (o_vl == NULL)
+    {
+      ERROR ("java plugin: cjni_write_batch_deliver: "
+          "ctoj_value_list failed.");
+      continue;
+    }
+
+    (*jvm_env)->SetObjectArrayElement (jvm_env, o_array, array_len, o_vl);
+    (*jvm_env)->DeleteLocalRef (jvm_env, o_vl);
+    array_len++;
+  }
+
+  if (o_dataset != NULL)
+    (*jvm_env)->DeleteLocalRef (jvm_env, o_dataset);
+
+  /* Don't pass `null' elements to Java if a conversion failed. */
+  if (array_len < (jsize) values_num)
+  {
+    jobjectArray o_tmp;
+    jsize j;
+
+    o_tmp = (*jvm_env)->NewObjectArray (jvm_env, array_len,
+        cjni_cache.c_valuelist, /* initial element = */ NULL);
+    if (o_tmp == NULL)
+    {
+      ERROR ("java plugin: cjni_write_batch_deliver: NewObjectArray failed.");
+      (*jvm_env)->DeleteLocalRef (jvm_env, o_array);
+      return (-1);
+    }
+
+    for (j = 0; j < array_len; j++)
+    {
+      jobject o_vl = (*jvm_env)->GetObjectArrayElement (jvm_env, o_array, j);
+      (*jvm_env)->SetObjectArrayElement (jvm_env, o_tmp, j, o_vl);
+      (*jvm_env)->DeleteLocalRef (jvm_env, o_vl);
+    }
+
+    (*jvm_env)->DeleteLocalRef (jvm_env, o_array);
+    o_array = o_tmp;
+  }
+
+  ret_status = 0;
+  if (array_len > 0)
+    ret_status = (*jvm_env)->CallIntMethod (jvm_env,
+        cbi->object, cbi->method, o_array);
+
+  (*jvm_env)->DeleteLocalRef (jvm_env, o_array);
+
+  return (ret_status);
+} /* }}} int cjni_write_batch_deliver */
+
+/* Take the queued value lists from `batch'. Must be called with
+ * `batch->lock' held. */
+static void cjni_write_batch_take (cjni_write_batch_t *batch, /* {{{ */
+    value_list_t **ret_values, const data_set_t ***ret_data_sets,
+    size_t *ret_values_num)
+{
+  *ret_values = batch->values;
+  *ret_data_sets = batch->data_sets;
+  *ret_values_num = batch->values_num;
+
+  batch->values = NULL;
+  batch->data_sets = NULL;
+  batch->values_num = 0;
+} /* }}} void cjni_write_batch_take */
+
+/* Take all queued value lists from `batch' and pass them to Java. */
+static int cjni_write_batch_submit (JNIEnv *jvm_env, /* {{{ */
+    cjni_write_batch_t *batch)
+{
+  value_list_t *values;
+  const data_set_t **data_sets;
+  size_t values_num;
+  int status;
+
+  pthread_mutex_lock (&batch->lock);
+  cjni_write_batch_take (batch, &values, &data_sets, &values_num);
+  pthread_mutex_unlock (&batch->lock);
+
+  if (values_num == 0)
+    return (0);
+
+  status = cjni_write_batch_deliver (jvm_env, batch->cbi,
+      values, data_sets, values_num);
+  cjni_write_batch_free_values (values, data_sets, values_num);
+
+  return (status);
+} /* }}} int cjni_write_batch_submit */
+
+/* Queue a copy of the value list. Once `size' value lists have been queued or
+ * the oldest one is older than the global interval, all of them are passed
+ * to the CB_TYPE_WRITE_BATCH callback. */
+static int cjni_write_batch (const data_set_t *ds, /* {{{ */
+    const value_list_t *vl, user_data_t *ud)
+{
+  JNIEnv *jvm_env;
+  cjni_write_batch_t *batch;
+  value_list_t *values;
+  const data_set_t **data_sets;
+  size_t values_num;
+  value_list_t *copy;
+  cdtime_t now;
+  int status;
+
+  if (jvm == NULL)
+  {
+    ERROR ("java plugin: cjni_write_batch: jvm == NULL");
+    return (-1);
+  }
+
+  if ((ud == NULL) || (ud->data == NULL))
+  {
+    ERROR ("java plugin: cjni_write_batch: Invalid user data.");
+    return (-1);
+  }
+
+  batch = (cjni_write_batch_t *) ud->data;
+  now = cdtime ();
+
+  pthread_mutex_lock (&batch->lock);
+
+  if (batch->values == NULL)
+  {
+    batch->values = (value_list_t *) calloc (batch->size,
+        sizeof (*batch->values));
+    batch->data_sets = (const data_set_t **) calloc (batch->size,
+        sizeof (*batch->data_sets));
+    if ((batch->values == NULL) || (batch->data_sets == NULL))
+    {
+      sfree (batch->values);
+      sfree (batch->data_sets);
+      pthread_mutex_unlock (&batch->lock);
+      ERROR ("java plugin: cjni_write_batch: calloc failed.");
+      return (-1);
+    }
+    batch->values_num = 0;
+  }
+
+  copy = batch->values + batch->values_num;
+  memcpy (copy, vl, sizeof (*copy));
+  copy->meta = NULL;
+  copy->values = (value_t *) malloc (vl->values_len * sizeof (value_t));
+  if (copy->values == NULL)
+  {
+    pthread_mutex_unlock (&batch->lock);
+    ERROR ("java plugin: cjni_write_batch: malloc failed.");
+    return (-1);
+  }
+  memcpy (copy->values, vl->values, vl->values_len * sizeof (value_t));
+
+  batch->data_sets[batch->values_num] = ds;
+  if (batch->values_num == 0)
+    batch->first_time = now;
+  batch->values_num++;
+
+  if ((batch->values_num < batch->size)
+      && ((now - batch->first_time) < interval_g))
+  {
+    pthread_mutex_unlock (&batch->lock);
+    return (0);
+  }
+
+  cjni_write_batch_take (batch, &values, &data_sets, &values_num);
+  pthread_mutex_unlock (&batch->lock);
+
+  jvm_env = cjni_thread_attach ();
+  if (jvm_env == NULL)
+  {
+    cjni_write_batch_free_values (values, data_sets, values_num);
+    return (-1);
+  }
+
+  status = cjni_write_batch_deliver (jvm_env, batch->cbi,
+      values, data_sets, values_num);
+  cjni_write_batch_free_values (values, data_sets, values_num);
+
+  if (cjni_thread_detach () != 0)
+  {
+    ERROR ("java plugin: cjni_write_batch: cjni_thread_detach failed.");
+    return (-1);
+  }
+
+  return (status);
+} /* }}} int cjni_write_batch */
+
+/* Pass all queued value lists to the CB_TYPE_WRITE_BATCH callback. */
+static int cjni_write_batch_flush ( /* {{{ */
+    int __attribute__((unused)) timeout,
+    const char __attribute__((unused)) *identifier,
+    user_data_t *ud)
+{
+  JNIEnv *jvm_env;
+  int status;
+
+  if (jvm == NULL)
+  {
+    ERROR ("java plugin: cjni_write_batch_flush: jvm == NULL");
+    return (-1);
+  }
+
+  if ((ud == NULL) || (ud->data == NULL))
+  {
+    ERROR ("java plugin: cjni_write_batch_flush: Invalid user data.");
+    return (-1);
+  }
+
+  jvm_env = cjni_thread_attach ();
+  if (jvm_env == NULL)
+    return (-1);
+
+  status = cjni_write_batch_submit (jvm_env, (cjni_write_batch_t *) ud->data);
+
+  if (cjni_thread_detach () != 0)
+  {
+    ERROR ("java plugin: cjni_write_batch_flush: "
+        "cjni_thread_detach failed.");
+    return (-1);
+  }
+
+  return (status);
+} /* }}} int cjni_write_batch_flush */
+
+/* Free a `cjni_write_batch_t', including the callback info. Value lists still
+ * queued at this point are discarded. */
+static void cjni_write_batch_destroy (void *arg) /* {{{ */
+{
+  cjni_write_batch_t *batch;
+  size_t i;
+
+  if (arg == NULL)
+    return;
+
+  batch = (cjni_write_batch_t *) arg;
+
+  pthread_mutex_lock (&java_write_batches_lock);
+  for (i = 0; i < java_write_batches_num; i++)
+  {
+    if (java_write_batches[i] != batch)
+      continue;
+
+    memmove (java_write_batches + i, java_write_batches + i + 1,
+        (java_write_batches_num - (i + 1)) * sizeof (*java_write_batches));
+    java_write_batches_num--;
+    break;
+  }
+  pthread_mutex_unlock (&java_write_batches_lock);
+
+  cjni_write_batch_free_values (batch->values, batch->data_sets,
+      batch->values_num);
+  pthread_mutex_destroy (&batch->lock);
+
+  cjni_callback_info_destroy (batch->cbi);
+  sfree (batch);
+} /* }}} void cjni_write_batch_destroy */
+
 /* Call the CB_TYPE_FLUSH callback pointed to by the `user_data_t' pointer. */
 static int cjni_flush (int timeout, const char *identifier, /* {{{ */
     user_data_t *ud)
@@ -2877,7 +3351,7 @@ static int cjni_match_target_invoke (const data_set_t *ds, /* {{{ */
 
   cbi = (cjni_callback_info_t *) *user_data;
 
-  o_vl = ctoj_value_list (jvm_env, ds, vl);
+  o_vl = ctoj_value_list (jvm_env, ds, /* o_dataset = */ NULL, vl);
   if (o_vl == NULL)
   {
     ERROR ("java plugin: cjni_match_target_invoke: ctoj_value_list failed.");
@@ -3005,6 +3479,15 @@ static int cjni_shutdown (void) /* {{{ */
     return (-1);
   }
 
+  /* Pass value lists still queued by batched write callbacks to Java. */
+  pthread_mutex_lock (&java_write_batches_lock);
+  for (i = 0; i < java_write_batches_num; i++)
+    cjni_write_batch_submit (jvm_env, java_write_batches[i]);
+  /* The batches themselves are freed by `cjni_write_batch_destroy'. */
+  java_write_batches_num = 0;
+  sfree (java_write_batches);
+  pthread_mutex_unlock (&java_write_batches_lock);
+
   /* Execute all the shutdown functions registered by plugins. */
   cjni_shutdown_plugins (jvm_env);
 
@@ -3034,6 +3517,8 @@ static int cjni_shutdown (void) /* {{{ */
   java_classes_list_len = 0;
   sfree (java_classes_list);
 
+  cjni_cache_destroy (jvm_env);
+
   /* Destroy the JVM */
   DEBUG ("java plugin: Destroying the JVM.");
   (*jvm)->DestroyJavaVM (jvm);
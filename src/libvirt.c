@@ -32,10 +32,13 @@
 #include <libxml/tree.h>
 #include <libxml/xpath.h>
 
+#include <pthread.h>
+
 static const char *config_keys[] = {
     "Connection",
 
     "RefreshInterval",
+    "Threads",
 
     "Domain",
     "BlockDevice",
@@ -56,6 +59,39 @@ static c_complain_t conn_complain = C_COMPLAIN_INIT_STATIC;
 /* Seconds between list refreshes, 0 disables completely. */
 static int interval = 60;
 
+#if HAVE_LIBVIRT_EVENTS
+/* Domain lifecycle events. While they are delivered, the lists are refreshed
+ * when a domain changes state instead of every `interval' seconds. */
+static pthread_t event_thread;
+static _Bool event_thread_started = 0;
+static _Bool event_loop_running = 0;
+static volatile _Bool event_loop_stop = 0;
+static int event_callback_id = -1;
+
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool event_refresh = 0;
+#endif
+
+#if HAVE_LIBVIRT_BULK_STATS
+/* Cleared if the daemon does not support virDomainListGetStats. */
+static _Bool bulk_stats = 1;
+#endif
+
+/* Threads doing the per-domain calls if bulk statistics are not available.
+ * Each job is one entry of `domains'. */
+static int threads_num = 4;
+static pthread_t *threads = NULL;
+static int threads_running = 0;
+
+static pthread_mutex_t work_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t work_done_cond = PTHREAD_COND_INITIALIZER;
+static int work_next = 0;
+static int work_num = 0;
+static int work_pending = 0;
+static time_t work_time;
+static _Bool work_shutdown = 0;
+
 /* List of domains, if specified. */
 static ignorelist_t *il_domains = NULL;
 /* List of block devices, if specified. */
@@ -66,7 +102,8 @@ static ignorelist_t *il_interface_devices = NULL;
 static int ignore_device_match (ignorelist_t *,
                                 const char *domname, const char *devpath);
 
-/* Actual list of domains found on last refresh. */
+/* Actual list of domains found on last refresh. The array is terminated by a
+ * NULL pointer as required by virDomainListGetStats. */
 static virDomainPtr *domains = NULL;
 static int nr_domains = 0;
 
@@ -114,6 +151,7 @@ static enum hf_field hostname_format[HF_MAX_FIELDS] =
 static time_t last_refresh = (time_t) 0;
 
 static int refresh_lists (void);
+static void lv_disconnect (void);
 
 /* Submit functions. */
 static void cpu_submit (unsigned long long cpu_time,
@@ -133,12 +171,109 @@ static void submit_counter2 (const char *type, counter_t v0, counter_t v1,
         if (err) ERROR ("%s: %s", (s), err->message);                   \
     } while(0)
 
+#if HAVE_LIBVIRT_EVENTS
+static int
+lv_lifecycle_event (virConnectPtr c, virDomainPtr dom,
+                    int event, int detail, void *opaque)
+{
+    pthread_mutex_lock (&event_lock);
+    event_refresh = 1;
+    pthread_mutex_unlock (&event_lock);
+
+    return 0;
+}
+
+static void
+lv_event_wakeup (int timer, void *opaque)
+{
+    virEventRemoveTimeout (timer);
+}
+
+static void *
+lv_event_loop (void *arg)
+{
+    while (!event_loop_stop) {
+        if (virEventRunDefaultImpl () != 0) {
+            VIRT_ERROR (NULL, "virEventRunDefaultImpl");
+            break;
+        }
+    }
+
+    /* Without the loop no events are delivered: go back to refreshing the
+     * lists every `interval' seconds. */
+    pthread_mutex_lock (&event_lock);
+    event_loop_running = 0;
+    pthread_mutex_unlock (&event_lock);
+
+    return NULL;
+}
+
+static void
+lv_event_register (void)
+{
+    _Bool running;
+
+    pthread_mutex_lock (&event_lock);
+    running = event_loop_running;
+    pthread_mutex_unlock (&event_lock);
+
+    if (!running)
+        return;
+
+    event_callback_id = virConnectDomainEventRegisterAny (conn,
+            /* domain = */ NULL, VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+            VIR_DOMAIN_EVENT_CALLBACK (lv_lifecycle_event),
+            /* opaque = */ NULL, /* free callback = */ NULL);
+    if (event_callback_id < 0)
+        NOTICE ("libvirt plugin: Unable to register for domain events. "
+                "The lists will be refreshed every %i seconds.", interval);
+}
+
+/* Returns true if the lists are kept up to date by events and sets `refresh'
+ * if a domain has changed its state since the last call. */
+static _Bool
+lv_event_check (_Bool *refresh)
+{
+    _Bool active;
+
+    pthread_mutex_lock (&event_lock);
+    active = event_loop_running && (event_callback_id >= 0);
+    *refresh = event_refresh;
+    event_refresh = 0;
+    pthread_mutex_unlock (&event_lock);
+
+    return active;
+}
+#endif /* HAVE_LIBVIRT_EVENTS */
+
 static int
 lv_init (void)
 {
     if (virInitialize () != 0)
         return -1;
 
+#if HAVE_LIBVIRT_EVENTS
+    /* The event implementation has to be registered before the first
+     * connection is opened. */
+    if (!event_thread_started) {
+        if (virEventRegisterDefaultImpl () != 0) {
+            VIRT_ERROR (NULL, "virEventRegisterDefaultImpl");
+        } else {
+            event_loop_stop = 0;
+            event_loop_running = 1;
+            if (pthread_create (&event_thread, /* attr = */ NULL,
+                        lv_event_loop, /* arg = */ NULL) != 0) {
+                char errbuf[1024];
+                ERROR ("libvirt plugin: pthread_create failed: %s",
+                        sstrerror (errno, errbuf, sizeof (errbuf)));
+                event_loop_running = 0;
+            } else {
+                event_thread_started = 1;
+            }
+        }
+    }
+#endif
+
 	return 0;
 }
 
@@ -173,6 +308,17 @@ lv_config (const char *key, const char *value)
         return 0;
     }
 
+    if (strcasecmp (key, "Threads") == 0) {
+        char *eptr = NULL;
+        threads_num = strtol (value, &eptr, 10);
+        if (eptr == NULL || *eptr != '\0' || threads_num < 0) {
+            ERROR ("libvirt plugin: Invalid value for Threads: %s", value);
+            threads_num = 4;
+            return 1;
+        }
+        return 0;
+    }
+
     if (strcasecmp (key, "Domain") == 0) {
         if (ignorelist_add (il_domains, value)) return 1;
         return 0;
@@ -245,144 +391,559 @@ lv_config (const char *key, const char *value)
     return -1;
 }
 
-static int
-lv_read (void)
+#if HAVE_LIBVIRT_BULK_STATS
+/* Statistics of the "block.<num>." and "net.<num>." fields. Each pair of
+ * fields is submitted as one value list of the matching type. */
+static const char *bulk_block_fields[] = {
+    "rd.reqs", "wr.reqs",
+    "rd.bytes", "wr.bytes"
+};
+static const char *bulk_block_types[] = {
+    "disk_ops", "disk_octets"
+};
+
+static const char *bulk_net_fields[] = {
+    "rx.bytes", "tx.bytes",
+    "rx.pkts", "tx.pkts",
+    "rx.errs", "tx.errs",
+    "rx.drop", "tx.drop"
+};
+static const char *bulk_net_types[] = {
+    "if_octets", "if_packets", "if_errors", "if_dropped"
+};
+
+#define BULK_FIELDS_MAX 8
+
+struct bulk_device {
+    const char *name;
+    long long values[BULK_FIELDS_MAX];
+};
+
+/* Parses a field of the form "<prefix>.<num>.<suffix>". Returns a pointer to
+ * the suffix and stores the number in `index', or returns NULL if the field
+ * has a different form. */
+static const char *
+bulk_field_parse (const char *field, const char *prefix, int *index)
+{
+    size_t len = strlen (prefix);
+    char *eptr = NULL;
+    long n;
+
+    if ((strncmp (field, prefix, len) != 0) || (field[len] != '.')
+            || !isdigit ((int) field[len + 1]))
+        return NULL;
+
+    n = strtol (field + len + 1, &eptr, 10);
+    if ((eptr == NULL) || (*eptr != '.'))
+        return NULL;
+
+    *index = (int) n;
+    return eptr + 1;
+}
+
+static void
+bulk_device_set (struct bulk_device *devs, int devs_num,
+        const char **fields, int fields_num,
+        int index, const char *suffix, virTypedParameterPtr param)
 {
-    time_t t;
     int i;
 
-    if (conn == NULL) {
-        /* `conn_string == NULL' is acceptable. */
-        conn = virConnectOpenReadOnly (conn_string);
-        if (conn == NULL) {
-            c_complain (LOG_ERR, &conn_complain,
-                    "libvirt plugin: Unable to connect: "
-                    "virConnectOpenReadOnly failed.");
-            return -1;
-        }
+    if ((index < 0) || (index >= devs_num))
+        return;
+
+    if (strcmp (suffix, "name") == 0) {
+        if (param->type == VIR_TYPED_PARAM_STRING)
+            devs[index].name = param->value.s;
+        return;
     }
-    c_release (LOG_NOTICE, &conn_complain,
-            "libvirt plugin: Connection established.");
 
-    time (&t);
+    if (param->type != VIR_TYPED_PARAM_ULLONG)
+        return;
 
-    /* Need to refresh domain or device lists? */
-    if ((last_refresh == (time_t) 0) ||
-            ((interval > 0) && ((last_refresh + interval) <= t))) {
-        if (refresh_lists () != 0) {
-            if (conn != NULL)
-                virConnectClose (conn);
-            conn = NULL;
-            return -1;
+    for (i = 0; i < fields_num; ++i) {
+        if (strcmp (suffix, fields[i]) == 0) {
+            devs[index].values[i] = (long long) param->value.ul;
+            return;
         }
-        last_refresh = t;
     }
+}
 
-#if 0
-    for (i = 0; i < nr_domains; ++i)
-        fprintf (stderr, "domain %s\n", virDomainGetName (domains[i]));
-    for (i = 0; i < nr_block_devices; ++i)
-        fprintf  (stderr, "block device %d %s:%s\n",
-                  i, virDomainGetName (block_devices[i].dom),
-                  block_devices[i].path);
-    for (i = 0; i < nr_interface_devices; ++i)
-        fprintf (stderr, "interface device %d %s:%s\n",
-                 i, virDomainGetName (interface_devices[i].dom),
-                 interface_devices[i].path);
-#endif
+static void
+bulk_device_submit (struct bulk_device *devs, int devs_num,
+        const char **types, int types_num, ignorelist_t *il,
+        time_t t, virDomainPtr dom, const char *domname)
+{
+    int i, j;
 
-    /* Get CPU usage, VCPU usage for each domain. */
-    for (i = 0; i < nr_domains; ++i) {
-        virDomainInfo info;
-        virVcpuInfoPtr vinfo = NULL;
-        int status;
-        int j;
+    for (i = 0; i < devs_num; ++i) {
+        if (devs[i].name == NULL)
+            continue;
 
-        status = virDomainGetInfo (domains[i], &info);
-        if (status != 0)
-        {
-            ERROR ("libvirt plugin: virDomainGetInfo failed with status %i.",
-                    status);
+        if (il && ignore_device_match (il, domname, devs[i].name) != 0)
             continue;
+
+        for (j = 0; j < types_num; ++j) {
+            long long v0 = devs[i].values[2 * j];
+            long long v1 = devs[i].values[2 * j + 1];
+
+            if ((v0 != -1) && (v1 != -1))
+                submit_counter2 (types[j], (counter_t) v0, (counter_t) v1,
+                        t, dom, devs[i].name);
         }
+    }
+}
 
-        cpu_submit (info.cpuTime, t, domains[i], "virt_cpu_total");
+static struct bulk_device *
+bulk_device_alloc (int num)
+{
+    struct bulk_device *devs;
+    int i, j;
 
-        vinfo = malloc (info.nrVirtCpu * sizeof (vinfo[0]));
-        if (vinfo == NULL) {
-            ERROR ("libvirt plugin: malloc failed.");
+    if (num <= 0)
+        return NULL;
+
+    devs = calloc (num, sizeof (*devs));
+    if (devs == NULL) {
+        ERROR ("libvirt plugin: calloc failed.");
+        return NULL;
+    }
+
+    for (i = 0; i < num; ++i)
+        for (j = 0; j < BULK_FIELDS_MAX; ++j)
+            devs[i].values[j] = -1;
+
+    return devs;
+}
+
+static void
+lv_read_bulk_record (virDomainStatsRecordPtr rec, time_t t)
+{
+    struct bulk_device *block = NULL;
+    struct bulk_device *net = NULL;
+    int block_num = 0;
+    int net_num = 0;
+    const char *name;
+    int i;
+
+    name = virDomainGetName (rec->dom);
+    if (name == NULL) {
+        VIRT_ERROR (conn, "virDomainGetName");
+        return;
+    }
+
+    for (i = 0; i < rec->nparams; ++i) {
+        virTypedParameterPtr param = rec->params + i;
+
+        if (param->type != VIR_TYPED_PARAM_UINT)
             continue;
+
+        if (strcmp (param->field, "block.count") == 0)
+            block_num = (int) param->value.ui;
+        else if (strcmp (param->field, "net.count") == 0)
+            net_num = (int) param->value.ui;
+    }
+
+    block = bulk_device_alloc (block_num);
+    if (block == NULL)
+        block_num = 0;
+    net = bulk_device_alloc (net_num);
+    if (net == NULL)
+        net_num = 0;
+
+    for (i = 0; i < rec->nparams; ++i) {
+        virTypedParameterPtr param = rec->params + i;
+        const char *suffix;
+        int index;
+
+        if (strcmp (param->field, "cpu.time") == 0) {
+            if (param->type == VIR_TYPED_PARAM_ULLONG)
+                cpu_submit (param->value.ul, t, rec->dom, "virt_cpu_total");
+        } else if ((suffix = bulk_field_parse (param->field,
+                        "vcpu", &index)) != NULL) {
+            if ((strcmp (suffix, "time") == 0)
+                    && (param->type == VIR_TYPED_PARAM_ULLONG))
+                vcpu_submit (param->value.ul, t, rec->dom, index,
+                        "virt_vcpu");
+        } else if ((suffix = bulk_field_parse (param->field,
+                        "block", &index)) != NULL) {
+            bulk_device_set (block, block_num,
+                    bulk_block_fields, STATIC_ARRAY_SIZE (bulk_block_fields),
+                    index, suffix, param);
+        } else if ((suffix = bulk_field_parse (param->field,
+                        "net", &index)) != NULL) {
+            bulk_device_set (net, net_num,
+                    bulk_net_fields, STATIC_ARRAY_SIZE (bulk_net_fields),
+                    index, suffix, param);
         }
+    }
 
-        status = virDomainGetVcpus (domains[i], vinfo, info.nrVirtCpu,
-                /* cpu map = */ NULL, /* cpu map length = */ 0);
-        if (status < 0)
-        {
-            ERROR ("libvirt plugin: virDomainGetVcpus failed with status %i.",
-                    status);
-            free (vinfo);
-            continue;
+    bulk_device_submit (block, block_num,
+            bulk_block_types, STATIC_ARRAY_SIZE (bulk_block_types),
+            il_block_devices, t, rec->dom, name);
+    bulk_device_submit (net, net_num,
+            bulk_net_types, STATIC_ARRAY_SIZE (bulk_net_types),
+            il_interface_devices, t, rec->dom, name);
+
+    sfree (block);
+    sfree (net);
+}
+
+/* Fetches the statistics of all domains with a single call. */
+static int
+lv_read_bulk (time_t t)
+{
+    virDomainStatsRecordPtr *records = NULL;
+    int records_num;
+    int i;
+
+    if (nr_domains == 0)
+        return 0;
+
+    records_num = virDomainListGetStats (domains,
+            VIR_DOMAIN_STATS_CPU_TOTAL | VIR_DOMAIN_STATS_VCPU
+            | VIR_DOMAIN_STATS_INTERFACE | VIR_DOMAIN_STATS_BLOCK,
+            &records, /* flags = */ 0);
+    if (records_num < 0) {
+        virErrorPtr err = virGetLastError ();
+
+        if ((err != NULL) && (err->code == VIR_ERR_NO_SUPPORT)) {
+            NOTICE ("libvirt plugin: Bulk statistics are not supported by "
+                    "this connection. Falling back to per-domain calls.");
+            bulk_stats = 0;
+        } else {
+            VIRT_ERROR (conn, "virDomainListGetStats");
         }
+        return -1;
+    }
 
-        for (j = 0; j < info.nrVirtCpu; ++j)
-            vcpu_submit (vinfo[j].cpuTime,
-                    t, domains[i], vinfo[j].number, "virt_vcpu");
+    for (i = 0; i < records_num; ++i)
+        lv_read_bulk_record (records[i], t);
 
+    virDomainStatsRecordListFree (records);
+    return 0;
+}
+#endif /* HAVE_LIBVIRT_BULK_STATS */
+
+/* Get CPU usage, VCPU usage and device statistics of domains[i]. */
+static void
+lv_read_domain (int i, time_t t)
+{
+    virDomainPtr dom = domains[i];
+    virDomainInfo info;
+    virVcpuInfoPtr vinfo = NULL;
+    int status;
+    int j;
+
+    status = virDomainGetInfo (dom, &info);
+    if (status != 0)
+    {
+        ERROR ("libvirt plugin: virDomainGetInfo failed with status %i.",
+                status);
+        return;
+    }
+
+    cpu_submit (info.cpuTime, t, dom, "virt_cpu_total");
+
+    vinfo = malloc (info.nrVirtCpu * sizeof (vinfo[0]));
+    if (vinfo == NULL) {
+        ERROR ("libvirt plugin: malloc failed.");
+        return;
+    }
+
+    status = virDomainGetVcpus (dom, vinfo, info.nrVirtCpu,
+            /* cpu map = */ NULL, /* cpu map length = */ 0);
+    if (status < 0)
+    {
+        ERROR ("libvirt plugin: virDomainGetVcpus failed with status %i.",
+                status);
         free (vinfo);
+        return;
     }
 
-    /* Get block device stats for each domain. */
-    for (i = 0; i < nr_block_devices; ++i) {
+    for (j = 0; j < info.nrVirtCpu; ++j)
+        vcpu_submit (vinfo[j].cpuTime,
+                t, dom, vinfo[j].number, "virt_vcpu");
+
+    free (vinfo);
+
+    /* Get block device stats. */
+    for (j = 0; j < nr_block_devices; ++j) {
         struct _virDomainBlockStats stats;
 
-        if (virDomainBlockStats (block_devices[i].dom, block_devices[i].path,
+        if (block_devices[j].dom != dom)
+            continue;
+
+        if (virDomainBlockStats (dom, block_devices[j].path,
                     &stats, sizeof stats) != 0)
             continue;
 
         if ((stats.rd_req != -1) && (stats.wr_req != -1))
             submit_counter2 ("disk_ops",
                     (counter_t) stats.rd_req, (counter_t) stats.wr_req,
-                    t, block_devices[i].dom, block_devices[i].path);
+                    t, dom, block_devices[j].path);
 
         if ((stats.rd_bytes != -1) && (stats.wr_bytes != -1))
             submit_counter2 ("disk_octets",
                     (counter_t) stats.rd_bytes, (counter_t) stats.wr_bytes,
-                    t, block_devices[i].dom, block_devices[i].path);
+                    t, dom, block_devices[j].path);
     } /* for (nr_block_devices) */
 
-    /* Get interface stats for each domain. */
-    for (i = 0; i < nr_interface_devices; ++i) {
+    /* Get interface stats. */
+    for (j = 0; j < nr_interface_devices; ++j) {
         struct _virDomainInterfaceStats stats;
 
-        if (virDomainInterfaceStats (interface_devices[i].dom,
-                    interface_devices[i].path,
+        if (interface_devices[j].dom != dom)
+            continue;
+
+        if (virDomainInterfaceStats (dom, interface_devices[j].path,
                     &stats, sizeof stats) != 0)
             continue;
 
 	if ((stats.rx_bytes != -1) && (stats.tx_bytes != -1))
 	    submit_counter2 ("if_octets",
 		    (counter_t) stats.rx_bytes, (counter_t) stats.tx_bytes,
-		    t, interface_devices[i].dom, interface_devices[i].path);
+		    t, dom, interface_devices[j].path);
 
 	if ((stats.rx_packets != -1) && (stats.tx_packets != -1))
 	    submit_counter2 ("if_packets",
 		    (counter_t) stats.rx_packets, (counter_t) stats.tx_packets,
-		    t, interface_devices[i].dom, interface_devices[i].path);
+		    t, dom, interface_devices[j].path);
 
 	if ((stats.rx_errs != -1) && (stats.tx_errs != -1))
 	    submit_counter2 ("if_errors",
 		    (counter_t) stats.rx_errs, (counter_t) stats.tx_errs,
-		    t, interface_devices[i].dom, interface_devices[i].path);
+		    t, dom, interface_devices[j].path);
 
 	if ((stats.rx_drop != -1) && (stats.tx_drop != -1))
 	    submit_counter2 ("if_dropped",
 		    (counter_t) stats.rx_drop, (counter_t) stats.tx_drop,
-		    t, interface_devices[i].dom, interface_devices[i].path);
+		    t, dom, interface_devices[j].path);
     } /* for (nr_interface_devices) */
+} /* void lv_read_domain */
+
+static void *
+lv_worker (void *arg)
+{
+    pthread_mutex_lock (&work_lock);
+    while (!work_shutdown) {
+        time_t t;
+        int i;
+
+        if (work_next >= work_num) {
+            pthread_cond_wait (&work_cond, &work_lock);
+            continue;
+        }
+
+        i = work_next;
+        work_next++;
+        t = work_time;
+        pthread_mutex_unlock (&work_lock);
+
+        lv_read_domain (i, t);
+
+        pthread_mutex_lock (&work_lock);
+        work_pending--;
+        if (work_pending == 0)
+            pthread_cond_signal (&work_done_cond);
+    }
+    pthread_mutex_unlock (&work_lock);
+
+    return NULL;
+}
+
+static int
+lv_start_threads (void)
+{
+    int i;
+
+    if (threads_running > 0)
+        return 0;
+
+    threads = calloc (threads_num, sizeof (*threads));
+    if (threads == NULL) {
+        ERROR ("libvirt plugin: calloc failed.");
+        return -1;
+    }
+
+    work_shutdown = 0;
+    for (i = 0; i < threads_num; ++i) {
+        if (pthread_create (threads + i, /* attr = */ NULL,
+                    lv_worker, /* arg = */ NULL) != 0) {
+            char errbuf[1024];
+            ERROR ("libvirt plugin: pthread_create failed: %s",
+                    sstrerror (errno, errbuf, sizeof (errbuf)));
+            break;
+        }
+        threads_running++;
+    }
+
+    if (threads_running == 0) {
+        sfree (threads);
+        return -1;
+    }
 
     return 0;
 }
 
+static void
+lv_stop_threads (void)
+{
+    int i;
+
+    if (threads_running == 0)
+        return;
+
+    pthread_mutex_lock (&work_lock);
+    work_shutdown = 1;
+    pthread_cond_broadcast (&work_cond);
+    pthread_mutex_unlock (&work_lock);
+
+    for (i = 0; i < threads_running; ++i)
+        pthread_join (threads[i], /* retval = */ NULL);
+
+    sfree (threads);
+    threads_running = 0;
+}
+
+/* Query the domains one by one, using the worker threads if there are
+ * several domains. */
+static void
+lv_read_domains (time_t t)
+{
+    int i;
+
+    if ((threads_num < 2) || (nr_domains < 2) || (lv_start_threads () != 0)) {
+        for (i = 0; i < nr_domains; ++i)
+            lv_read_domain (i, t);
+        return;
+    }
+
+    pthread_mutex_lock (&work_lock);
+    work_time = t;
+    work_next = 0;
+    work_num = nr_domains;
+    work_pending = nr_domains;
+    pthread_cond_broadcast (&work_cond);
+
+    while (work_pending > 0)
+        pthread_cond_wait (&work_done_cond, &work_lock);
+
+    work_next = 0;
+    work_num = 0;
+    pthread_mutex_unlock (&work_lock);
+}
+
+static void
+collection_time_submit (double seconds)
+{
+    value_t values[1];
+    value_list_t vl = VALUE_LIST_INIT;
+
+    values[0].gauge = seconds;
+
+    vl.values = values;
+    vl.values_len = 1;
+    vl.time = cdtime ();
+    sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+    sstrncpy (vl.plugin, "libvirt", sizeof (vl.plugin));
+    sstrncpy (vl.type, "response_time", sizeof (vl.type));
+
+    plugin_dispatch_values (&vl);
+} /* void collection_time_submit */
+
+static int
+lv_read (void)
+{
+    struct timeval start, end;
+    time_t t;
+    _Bool refresh = 0;
+
+    if (conn == NULL) {
+        /* `conn_string == NULL' is acceptable. */
+        conn = virConnectOpenReadOnly (conn_string);
+        if (conn == NULL) {
+            c_complain (LOG_ERR, &conn_complain,
+                    "libvirt plugin: Unable to connect: "
+                    "virConnectOpenReadOnly failed.");
+            return -1;
+        }
+#if HAVE_LIBVIRT_EVENTS
+        lv_event_register ();
+#endif
+    }
+    c_release (LOG_NOTICE, &conn_complain,
+            "libvirt plugin: Connection established.");
+
+    gettimeofday (&start, /* timezone = */ NULL);
+    time (&t);
+
+    /* Need to refresh domain or device lists? Lifecycle events trigger a
+     * refresh as soon as a domain has changed its state. Devices may be
+     * hot-plugged without such an event, so refresh periodically, too. */
+#if HAVE_LIBVIRT_EVENTS
+    lv_event_check (&refresh);
+#endif
+    if (last_refresh == (time_t) 0)
+        refresh = 1;
+    else if ((interval > 0) && ((last_refresh + interval) <= t))
+        refresh = 1;
+
+    if (refresh) {
+        if (refresh_lists () != 0) {
+            lv_disconnect ();
+            return -1;
+        }
+        last_refresh = t;
+    }
+
+#if HAVE_LIBVIRT_BULK_STATS
+    if (bulk_stats && (lv_read_bulk (t) != 0)) {
+        /* The call fails as a whole if a single domain has gone away in
+         * the meantime, or the device lists are needed for the per-domain
+         * calls from now on. Either way, refresh the lists. */
+        if (refresh_lists () != 0) {
+            lv_disconnect ();
+            return -1;
+        }
+        last_refresh = t;
+
+        if (!bulk_stats)
+            lv_read_domains (t);
+        else if (lv_read_bulk (t) != 0)
+            return -1;
+    }
+    else if (!bulk_stats)
+#endif
+        lv_read_domains (t);
+
+    gettimeofday (&end, /* timezone = */ NULL);
+    collection_time_submit ((double) (end.tv_sec - start.tv_sec)
+            + ((double) (end.tv_usec - start.tv_usec)) / 1000000.0);
+
+    return 0;
+}
+
+static void
+lv_disconnect (void)
+{
+    /* The domains belong to the connection: fetch the lists again after
+     * reconnecting. */
+    free_block_devices ();
+    free_interface_devices ();
+    free_domains ();
+    last_refresh = (time_t) 0;
+
+#if HAVE_LIBVIRT_EVENTS
+    if ((conn != NULL) && (event_callback_id >= 0))
+        virConnectDomainEventDeregisterAny (conn, event_callback_id);
+    event_callback_id = -1;
+#endif
+
+    if (conn != NULL)
+        virConnectClose (conn);
+    conn = NULL;
+}
+
 static int
 refresh_lists (void)
 {
@@ -394,6 +955,10 @@ refresh_lists (void)
         return -1;
     }
 
+    free_block_devices ();
+    free_interface_devices ();
+    free_domains ();
+
     if (n > 0) {
         int i;
         int *domids;
@@ -412,10 +977,6 @@ refresh_lists (void)
             return -1;
         }
 
-        free_block_devices ();
-        free_interface_devices ();
-        free_domains ();
-
         /* Fetch each domain and add it to the list, unless ignore. */
         for (i = 0; i < n; ++i) {
             virDomainPtr dom = NULL;
@@ -447,6 +1008,12 @@ refresh_lists (void)
                 goto cont;
             }
 
+#if HAVE_LIBVIRT_BULK_STATS
+            /* The bulk statistics list the devices themselves. */
+            if (bulk_stats)
+                goto cont;
+#endif
+
             /* Get a list of devices for this domain. */
             xml = virDomainGetXMLDesc (dom, 0);
             if (!xml) {
@@ -547,7 +1114,7 @@ static int
 add_domain (virDomainPtr dom)
 {
     virDomainPtr *new_ptr;
-    int new_size = sizeof (domains[0]) * (nr_domains+1);
+    int new_size = sizeof (domains[0]) * (nr_domains+2);
 
     if (domains)
         new_ptr = realloc (domains, new_size);
@@ -559,6 +1126,7 @@ add_domain (virDomainPtr dom)
 
     domains = new_ptr;
     domains[nr_domains] = dom;
+    domains[nr_domains+1] = NULL;
     return nr_domains++;
 }
 
@@ -666,7 +1234,7 @@ init_value_list (value_list_t *vl, time_t t, virDomainPtr dom)
     const char *name;
     char uuid[VIR_UUID_STRING_BUFLEN];
 
-    vl->time = t;
+    vl->time = TIME_T_TO_CDTIME_T (t);
     vl->interval = interval_g;
 
     sstrncpy (vl->plugin, "libvirt", sizeof (vl->plugin));
@@ -769,13 +1337,23 @@ submit_counter2 (const char *type, counter_t v0, counter_t v1,
 static int
 lv_shutdown (void)
 {
-    free_block_devices ();
-    free_interface_devices ();
-    free_domains ();
-
-    if (conn != NULL)
-	virConnectClose (conn);
-    conn = NULL;
+    lv_stop_threads ();
+    lv_disconnect ();
+
+#if HAVE_LIBVIRT_EVENTS
+    if (event_thread_started) {
+        event_loop_stop = 1;
+        /* Wake up virEventRunDefaultImpl so the thread sees the flag. */
+        if (virEventAddTimeout (0, lv_event_wakeup,
+                    /* opaque = */ NULL, /* free callback = */ NULL) < 0) {
+            VIRT_ERROR (NULL, "virEventAddTimeout");
+            pthread_detach (event_thread);
+        } else {
+            pthread_join (event_thread, /* retval = */ NULL);
+        }
+        event_thread_started = 0;
+    }
+#endif
 
     ignorelist_free (il_domains);
     il_domains = NULL;
@@ -27,6 +27,10 @@
 #include "common.h"
 #include "plugin.h"
 
+#if !HAVE_GETLOADAVG && KERNEL_LINUX
+# include "utils_procfs.h"
+#endif
+
 #ifdef HAVE_SYS_LOADAVG_H
 #include <sys/loadavg.h>
 #endif
@@ -49,6 +53,10 @@
 # include <libperfstat.h>
 #endif /* HAVE_PERFSTAT */
 
+#if !HAVE_GETLOADAVG && KERNEL_LINUX
+static cu_procfs_t *proc_loadavg = NULL;
+#endif
+
 static void load_submit (gauge_t snum, gauge_t mnum, gauge_t lnum)
 {
 	value_t values[3];
@@ -84,37 +92,32 @@ static int load_read (void)
 
 #elif defined(KERNEL_LINUX)
 	gauge_t snum, mnum, lnum;
-	FILE *loadavg;
-	char buffer[16];
+	char *buffer;
 
 	char *fields[8];
 	int numfields;
 
-	if ((loadavg = fopen ("/proc/loadavg", "r")) == NULL)
+	if (proc_loadavg == NULL)
 	{
-		char errbuf[1024];
-		WARNING ("load: fopen: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
-		return (-1);
+		proc_loadavg = cu_procfs_create ("/proc/loadavg");
+		if (proc_loadavg == NULL)
+		{
+			char errbuf[1024];
+			WARNING ("load: open: %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			return (-1);
+		}
 	}
 
-	if (fgets (buffer, 16, loadavg) == NULL)
+	if ((buffer = cu_procfs_read (proc_loadavg, NULL)) == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("load: fgets: %s",
+		WARNING ("load: read: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
-		fclose (loadavg);
 		return (-1);
 	}
 
-	if (fclose (loadavg))
-	{
-		char errbuf[1024];
-		WARNING ("load: fclose: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
-	}
-
-	numfields = strsplit (buffer, fields, 8);
+	numfields = cu_procfs_fields (buffer, fields, 8);
 
 	if (numfields < 3)
 		return (-1);
@@ -166,7 +169,20 @@ static int load_read (void)
 	return (0);
 }
 
+#if !HAVE_GETLOADAVG && KERNEL_LINUX
+static int load_shutdown (void)
+{
+	cu_procfs_destroy (proc_loadavg);
+	proc_loadavg = NULL;
+
+	return (0);
+} /* int load_shutdown */
+#endif /* !HAVE_GETLOADAVG && KERNEL_LINUX */
+
 void module_register (void)
 {
 	plugin_register_read ("load", load_read);
+#if !HAVE_GETLOADAVG && KERNEL_LINUX
+	plugin_register_shutdown ("load", load_shutdown);
+#endif
 } /* void module_register */
@@ -26,6 +26,7 @@
 #include "plugin.h"
 
 #include <pthread.h>
+#include <signal.h>
 
 #define DEFAULT_LOGFILE LOCALSTATEDIR"/log/collectd.log"
 
@@ -37,6 +38,11 @@ static int log_level = LOG_INFO;
 
 static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* The log file is kept open. It is reopened after receiving SIGHUP, so that
+ * log files can be rotated. */
+static FILE *log_fh = NULL;
+static volatile sig_atomic_t do_reopen = 0;
+
 static char *log_file = NULL;
 static int print_timestamp = 1;
 static int print_severity = 0;
@@ -95,7 +101,6 @@ static int logfile_config (const char *key, const char *value)
 static void logfile_print (const char *msg, int severity, time_t timestamp_time)
 {
 	FILE *fh;
-	int do_close = 0;
 	struct tm timestamp_tm;
 	char timestamp_str[64];
 	char level_str[16] = "";
@@ -135,19 +140,23 @@ static void logfile_print (const char *msg, int severity, time_t timestamp_time)
 
 	pthread_mutex_lock (&file_lock);
 
-	if (log_file == NULL)
+	if ((log_fh != NULL) && (do_reopen != 0))
 	{
-		fh = fopen (DEFAULT_LOGFILE, "a");
-		do_close = 1;
+		fclose (log_fh);
+		log_fh = NULL;
 	}
-	else if (strcasecmp (log_file, "stderr") == 0)
+	do_reopen = 0;
+
+	if ((log_file != NULL) && (strcasecmp (log_file, "stderr") == 0))
 		fh = stderr;
-	else if (strcasecmp (log_file, "stdout") == 0)
+	else if ((log_file != NULL) && (strcasecmp (log_file, "stdout") == 0))
 		fh = stdout;
 	else
 	{
-		fh = fopen (log_file, "a");
-		do_close = 1;
+		if (log_fh == NULL)
+			log_fh = fopen ((log_file == NULL) ? DEFAULT_LOGFILE : log_file,
+					"a");
+		fh = log_fh;
 	}
 
 	if (fh == NULL)
@@ -164,8 +173,7 @@ static void logfile_print (const char *msg, int severity, time_t timestamp_time)
 		else
 			fprintf (fh, "%s%s\n", level_str, msg);
 
-		if (do_close != 0)
-			fclose (fh);
+		fflush (fh);
 	}
 
 	pthread_mutex_unlock (&file_lock);
@@ -223,13 +231,50 @@ static int logfile_notification (const notification_t *n,
 	return (0);
 } /* int logfile_notification */
 
+static void logfile_sighup (int __attribute__((unused)) signal)
+{
+	do_reopen = 1;
+} /* void logfile_sighup */
+
+static int logfile_init (void)
+{
+	struct sigaction sa;
+
+	if ((log_file != NULL) && ((strcasecmp (log_file, "stderr") == 0)
+				|| (strcasecmp (log_file, "stdout") == 0)))
+		return (0);
+
+	memset (&sa, 0, sizeof (sa));
+	sa.sa_handler = logfile_sighup;
+	sigemptyset (&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction (SIGHUP, &sa, NULL);
+
+	return (0);
+} /* int logfile_init */
+
+static int logfile_shutdown (void)
+{
+	pthread_mutex_lock (&file_lock);
+	if (log_fh != NULL)
+	{
+		fclose (log_fh);
+		log_fh = NULL;
+	}
+	pthread_mutex_unlock (&file_lock);
+
+	return (0);
+} /* int logfile_shutdown */
+
 void module_register (void)
 {
 	plugin_register_config ("logfile", logfile_config,
 			config_keys, config_keys_num);
+	plugin_register_init ("logfile", logfile_init);
 	plugin_register_log ("logfile", logfile_log, /* user_data = */ NULL);
 	plugin_register_notification ("logfile", logfile_notification,
 			/* user_data = */ NULL);
+	plugin_register_shutdown ("logfile", logfile_shutdown);
 } /* void module_register (void) */
 
 /* vim: set sw=4 ts=4 tw=78 noexpandtab : */
@@ -27,6 +27,10 @@
 #include "common.h"
 #include "plugin.h"
 
+#if KERNEL_LINUX
+# include "utils_procfs.h"
+#endif
+
 #ifdef HAVE_SYS_SYSCTL_H
 # include <sys/sysctl.h>
 #endif
@@ -67,7 +71,7 @@ static vm_size_t pagesize;
 /* #endif HAVE_SYSCTLBYNAME */
 
 #elif KERNEL_LINUX
-/* no global variables */
+static cu_procfs_t *proc_meminfo = NULL;
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKSTAT
@@ -261,8 +265,8 @@ static int memory_read (void)
 /* #endif HAVE_SYSCTLBYNAME */
 
 #elif KERNEL_LINUX
-	FILE *fh;
-	char buffer[1024];
+	char *buffer;
+	char *line;
 
 	char *fields[8];
 	int numfields;
@@ -272,42 +276,47 @@ static int memory_read (void)
 	long long mem_cached = 0;
 	long long mem_free = 0;
 
-	if ((fh = fopen ("/proc/meminfo", "r")) == NULL)
+	if (proc_meminfo == NULL)
+	{
+		proc_meminfo = cu_procfs_create ("/proc/meminfo");
+		if (proc_meminfo == NULL)
+		{
+			char errbuf[1024];
+			WARNING ("memory: open: %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			return (-1);
+		}
+	}
+
+	if ((buffer = cu_procfs_read (proc_meminfo, NULL)) == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("memory: fopen: %s",
+		WARNING ("memory: read: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buffer, 1024, fh) != NULL)
+	while ((line = cu_procfs_line (&buffer)) != NULL)
 	{
 		long long *val = NULL;
 
-		if (strncasecmp (buffer, "MemTotal:", 9) == 0)
+		if (strncasecmp (line, "MemTotal:", 9) == 0)
 			val = &mem_used;
-		else if (strncasecmp (buffer, "MemFree:", 8) == 0)
+		else if (strncasecmp (line, "MemFree:", 8) == 0)
 			val = &mem_free;
-		else if (strncasecmp (buffer, "Buffers:", 8) == 0)
+		else if (strncasecmp (line, "Buffers:", 8) == 0)
 			val = &mem_buffered;
-		else if (strncasecmp (buffer, "Cached:", 7) == 0)
+		else if (strncasecmp (line, "Cached:", 7) == 0)
 			val = &mem_cached;
 		else
 			continue;
 
-		numfields = strsplit (buffer, fields, 8);
+		numfields = cu_procfs_fields (line, fields, 8);
 
 		if (numfields < 2)
 			continue;
 
-		*val = atoll (fields[1]) * 1024LL;
-	}
-
-	if (fclose (fh))
-	{
-		char errbuf[1024];
-		WARNING ("memory: fclose: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
+		*val = (long long) cu_procfs_u64 (fields[1]) * 1024LL;
 	}
 
 	if (mem_used >= (mem_free + mem_buffered + mem_cached))
@@ -446,8 +455,21 @@ static int memory_read (void)
 	return (0);
 }
 
+#if KERNEL_LINUX
+static int memory_shutdown (void)
+{
+	cu_procfs_destroy (proc_meminfo);
+	proc_meminfo = NULL;
+
+	return (0);
+} /* int memory_shutdown */
+#endif /* KERNEL_LINUX */
+
 void module_register (void)
 {
 	plugin_register_init ("memory", memory_init);
 	plugin_register_read ("memory", memory_read);
+#if KERNEL_LINUX
+	plugin_register_shutdown ("memory", memory_shutdown);
+#endif
 } /* void module_register */
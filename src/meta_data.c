@@ -25,6 +25,21 @@
 
 #include <pthread.h>
 
+/*
+ * Defines
+ */
+/* Number of entries allocated with the first entry. Most objects only ever
+ * hold one or two entries. */
+#define MD_INITIAL_SIZE 4
+
+/* Number of buckets of the key table. */
+#define MD_KEYS_BUCKETS 256
+
+/* Upper bound for the number of interned keys. Keys added beyond this limit
+ * are copied into each entry, so arbitrary keys (e.g. from scripts) can not
+ * grow the table indefinitely. */
+#define MD_KEYS_MAX 4096
+
 /*
  * Data types
  */
@@ -38,22 +53,64 @@ union meta_value_u
 };
 typedef union meta_value_u meta_value_t;
 
-struct meta_entry_s;
-typedef struct meta_entry_s meta_entry_t;
 struct meta_entry_s
 {
-  char         *key;
-  meta_value_t  value;
+  const char   *key;
+  unsigned int  hash;
+  _Bool         key_owned;
   int           type;
-  meta_entry_t *next;
+  meta_value_t  value;
 };
+typedef struct meta_entry_s meta_entry_t;
+
+/* The entries of an object are kept in one array which is shared between an
+ * object and its clones. The array is copied before it is modified while
+ * another object still refers to it ("copy on write"). */
+struct meta_block_s
+{
+  int          refcount;
+  int          entries_num;
+  int          entries_size;
+  meta_entry_t entries[];
+};
+typedef struct meta_block_s meta_block_t;
 
 struct meta_data_s
 {
-  meta_entry_t   *head;
+  meta_block_t   *block;
+  _Bool           locked;
   pthread_mutex_t lock;
 };
 
+/* Interned keys. Keys are compared case insensitively, so only one spelling
+ * of each key is stored. */
+struct meta_key_s;
+typedef struct meta_key_s meta_key_t;
+struct meta_key_s
+{
+  unsigned int hash;
+  meta_key_t  *next;
+  char         name[];
+};
+
+/*
+ * Private variables
+ */
+static meta_key_t      *md_keys[MD_KEYS_BUCKETS];
+static int              md_keys_num = 0;
+static pthread_rwlock_t md_keys_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* Protects the reference counter of shared blocks. Blocks which are not
+ * shared can only be referenced by one object and don't need it. */
+static pthread_mutex_t  md_share_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define MD_LOCK(md) do { \
+  if ((md)->locked) pthread_mutex_lock (&(md)->lock); \
+} while (0)
+#define MD_UNLOCK(md) do { \
+  if ((md)->locked) pthread_mutex_unlock (&(md)->lock); \
+} while (0)
+
 /*
  * Private functions
  */
@@ -75,141 +132,286 @@ static char *md_strdup (const char *orig) /* {{{ */
   return (dest);
 } /* }}} char *md_strdup */
 
-static meta_entry_t *md_entry_alloc (const char *key) /* {{{ */
+/* Case insensitive FNV-1a hash. */
+static unsigned int md_hash (const char *key) /* {{{ */
 {
-  meta_entry_t *e;
+  unsigned int hash = 2166136261U;
 
-  e = (meta_entry_t *) malloc (sizeof (*e));
-  if (e == NULL)
+  for (; *key != 0; key++)
   {
-    ERROR ("md_entry_alloc: malloc failed.");
-    return (NULL);
+    hash ^= (unsigned int) tolower ((unsigned char) *key);
+    hash *= 16777619U;
   }
-  memset (e, 0, sizeof (*e));
 
-  e->key = md_strdup (key);
-  if (e->key == NULL)
-  {
-    free (e);
-    ERROR ("md_entry_alloc: md_strdup failed.");
-    return (NULL);
-  }
+  return (hash);
+} /* }}} unsigned int md_hash */
 
-  e->type = 0;
-  e->next = NULL;
+/* Returns the interned copy of `key' or NULL if the key is not interned and
+ * the table is full. */
+static const char *md_intern (const char *key, unsigned int hash) /* {{{ */
+{
+  meta_key_t *k;
+  size_t bucket = hash % MD_KEYS_BUCKETS;
+  size_t key_len;
 
-  return (e);
-} /* }}} meta_entry_t *md_entry_alloc */
+  pthread_rwlock_rdlock (&md_keys_lock);
+  for (k = md_keys[bucket]; k != NULL; k = k->next)
+    if ((k->hash == hash) && (strcasecmp (k->name, key) == 0))
+      break;
+  pthread_rwlock_unlock (&md_keys_lock);
 
-static meta_entry_t *md_entry_clone (const meta_entry_t *orig) /* {{{ */
-{
-  meta_entry_t *copy;
+  if (k != NULL)
+    return (k->name);
 
-  if (orig == NULL)
-    return (NULL);
+  pthread_rwlock_wrlock (&md_keys_lock);
 
-  copy = md_entry_alloc (orig->key);
-  copy->type = orig->type;
-  if (copy->type == MD_TYPE_STRING)
-    copy->value.mv_string = strdup (orig->value.mv_string);
-  else
-    copy->value = orig->value;
+  /* Check again: Another thread may have added the key in the meantime. */
+  for (k = md_keys[bucket]; k != NULL; k = k->next)
+    if ((k->hash == hash) && (strcasecmp (k->name, key) == 0))
+      break;
 
-  copy->next = md_entry_clone (orig->next);
-  return (copy);
-} /* }}} meta_entry_t *md_entry_clone */
+  if ((k == NULL) && (md_keys_num < MD_KEYS_MAX))
+  {
+    key_len = strlen (key);
+    k = (meta_key_t *) malloc (sizeof (*k) + key_len + 1);
+    if (k != NULL)
+    {
+      k->hash = hash;
+      memcpy (k->name, key, key_len + 1);
+      k->next = md_keys[bucket];
+      md_keys[bucket] = k;
+      md_keys_num++;
+    }
+  }
 
-static void md_entry_free (meta_entry_t *e) /* {{{ */
-{
-  if (e == NULL)
-    return;
+  pthread_rwlock_unlock (&md_keys_lock);
 
-  free (e->key);
+  return ((k != NULL) ? k->name : NULL);
+} /* }}} const char *md_intern */
 
+static void md_entry_free (meta_entry_t *e) /* {{{ */
+{
   if (e->type == MD_TYPE_STRING)
     free (e->value.mv_string);
+  e->value.mv_string = NULL;
 
-  if (e->next != NULL)
-    md_entry_free (e->next);
-
-  free (e);
+  if (e->key_owned)
+    free ((void *) e->key);
+  e->key = NULL;
 } /* }}} void md_entry_free */
 
-static int md_entry_insert (meta_data_t *md, meta_entry_t *e) /* {{{ */
+static int md_entry_copy (meta_entry_t *dst, const meta_entry_t *src) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
-
-  if ((md == NULL) || (e == NULL))
-    return (-EINVAL);
-
-  pthread_mutex_lock (&md->lock);
+  *dst = *src;
 
-  prev = NULL;
-  this = md->head;
-  while (this != NULL)
+  if (src->key_owned)
   {
-    if (strcasecmp (e->key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
+    dst->key = md_strdup (src->key);
+    if (dst->key == NULL)
+      return (-ENOMEM);
   }
 
-  if (this == NULL)
+  if (src->type == MD_TYPE_STRING)
   {
-    /* This key does not exist yet. */
-    if (md->head == NULL)
-      md->head = e;
-    else
+    dst->value.mv_string = md_strdup (src->value.mv_string);
+    if (dst->value.mv_string == NULL)
     {
-      assert (prev != NULL);
-      prev->next = e;
+      if (dst->key_owned)
+        free ((void *) dst->key);
+      return (-ENOMEM);
     }
-
-    e->next = NULL;
   }
-  else /* (this != NULL) */
+
+  return (0);
+} /* }}} int md_entry_copy */
+
+static meta_block_t *md_block_alloc (int entries_size) /* {{{ */
+{
+  meta_block_t *b;
+
+  b = (meta_block_t *) malloc (sizeof (*b)
+      + entries_size * sizeof (meta_entry_t));
+  if (b == NULL)
+    return (NULL);
+
+  b->refcount = 1;
+  b->entries_num = 0;
+  b->entries_size = entries_size;
+
+  return (b);
+} /* }}} meta_block_t *md_block_alloc */
+
+/* Drops one reference to `b' and frees it when it was the last one. */
+static void md_block_release (meta_block_t *b) /* {{{ */
+{
+  int i;
+
+  if (b == NULL)
+    return;
+
+  if (b->refcount > 1)
   {
-    if (prev == NULL)
-      md->head = e;
-    else
-      prev->next = e;
+    int refcount;
+
+    pthread_mutex_lock (&md_share_lock);
+    refcount = --b->refcount;
+    pthread_mutex_unlock (&md_share_lock);
+
+    if (refcount > 0)
+      return;
+  }
+
+  for (i = 0; i < b->entries_num; i++)
+    md_entry_free (b->entries + i);
+  free (b);
+} /* }}} void md_block_release */
+
+/* Makes sure `md' has its own copy of the entries with room for at least
+ * `entries_num' entries. The lock on md must be held while calling this
+ * function. */
+static int md_block_prepare_write (meta_data_t *md, /* {{{ */
+    int entries_num)
+{
+  meta_block_t *b = md->block;
+  meta_block_t *copy;
+  int size;
+  int i;
+
+  if ((b != NULL) && (b->refcount == 1) && (b->entries_size >= entries_num))
+    return (0);
+
+  size = (b != NULL) ? b->entries_size : MD_INITIAL_SIZE;
+  while (size < entries_num)
+    size *= 2;
 
-    e->next = this->next;
+  /* Not shared: simply grow the array. */
+  if ((b != NULL) && (b->refcount == 1))
+  {
+    copy = (meta_block_t *) realloc (b,
+        sizeof (*b) + size * sizeof (meta_entry_t));
+    if (copy == NULL)
+      return (-ENOMEM);
+
+    copy->entries_size = size;
+    md->block = copy;
+    return (0);
   }
 
-  pthread_mutex_unlock (&md->lock);
+  copy = md_block_alloc (size);
+  if (copy == NULL)
+    return (-ENOMEM);
 
-  if (this != NULL)
+  if (b != NULL)
   {
-    this->next = NULL;
-    md_entry_free (this);
+    for (i = 0; i < b->entries_num; i++)
+    {
+      if (md_entry_copy (copy->entries + i, b->entries + i) != 0)
+      {
+        md_block_release (copy);
+        return (-ENOMEM);
+      }
+      copy->entries_num++;
+    }
+
+    md_block_release (b);
   }
 
+  md->block = copy;
   return (0);
-} /* }}} int md_entry_insert */
+} /* }}} int md_block_prepare_write */
 
 /* XXX: The lock on md must be held while calling this function! */
 static meta_entry_t *md_entry_lookup (meta_data_t *md, /* {{{ */
     const char *key)
 {
-  meta_entry_t *e;
+  unsigned int hash;
+  int i;
 
-  if ((md == NULL) || (key == NULL))
+  if ((md == NULL) || (key == NULL) || (md->block == NULL))
     return (NULL);
 
-  for (e = md->head; e != NULL; e = e->next)
-    if (strcasecmp (key, e->key) == 0)
-      break;
+  hash = md_hash (key);
+  for (i = 0; i < md->block->entries_num; i++)
+  {
+    meta_entry_t *e = md->block->entries + i;
 
-  return (e);
+    if ((e->hash == hash) && (strcasecmp (key, e->key) == 0))
+      return (e);
+  }
+
+  return (NULL);
 } /* }}} meta_entry_t *md_entry_lookup */
 
-/*
- * Public functions
- */
-meta_data_t *meta_data_create (void) /* {{{ */
+/* Adds `value' with type `type' to `md', replacing an existing entry with the
+ * same key. On success, a string value is owned by `md'. */
+static int md_entry_insert (meta_data_t *md, const char *key, /* {{{ */
+    int type, meta_value_t value)
+{
+  meta_entry_t *e;
+  const char *interned;
+  unsigned int hash;
+  int status;
+  int i;
+
+  hash = md_hash (key);
+
+  MD_LOCK (md);
+
+  status = md_block_prepare_write (md, (md->block != NULL)
+      ? md->block->entries_num + 1 : 1);
+  if (status != 0)
+  {
+    MD_UNLOCK (md);
+    ERROR ("md_entry_insert: Allocating memory failed.");
+    return (status);
+  }
+
+  for (i = 0; i < md->block->entries_num; i++)
+  {
+    e = md->block->entries + i;
+    if ((e->hash == hash) && (strcasecmp (key, e->key) == 0))
+    {
+      /* Replace the value, keep the key. */
+      if (e->type == MD_TYPE_STRING)
+        free (e->value.mv_string);
+
+      e->type = type;
+      e->value = value;
+
+      MD_UNLOCK (md);
+      return (0);
+    }
+  }
+
+  /* Only new keys need to be interned. */
+  interned = md_intern (key, hash);
+
+  e = md->block->entries + md->block->entries_num;
+
+  e->hash = hash;
+  e->key = interned;
+  e->key_owned = 0;
+  if (interned == NULL)
+  {
+    e->key = md_strdup (key);
+    if (e->key == NULL)
+    {
+      MD_UNLOCK (md);
+      ERROR ("md_entry_insert: md_strdup failed.");
+      return (-ENOMEM);
+    }
+    e->key_owned = 1;
+  }
+
+  e->type = type;
+  e->value = value;
+  md->block->entries_num++;
+
+  MD_UNLOCK (md);
+  return (0);
+} /* }}} int md_entry_insert */
+
+static meta_data_t *md_create (_Bool locked) /* {{{ */
 {
   meta_data_t *md;
 
@@ -221,12 +423,27 @@ meta_data_t *meta_data_create (void) /* {{{ */
   }
   memset (md, 0, sizeof (*md));
 
-  md->head = NULL;
-  pthread_mutex_init (&md->lock, /* attr = */ NULL);
+  md->block = NULL;
+  md->locked = locked;
+  if (md->locked)
+    pthread_mutex_init (&md->lock, /* attr = */ NULL);
 
   return (md);
+} /* }}} meta_data_t *md_create */
+
+/*
+ * Public functions
+ */
+meta_data_t *meta_data_create (void) /* {{{ */
+{
+  return (md_create (/* locked = */ 1));
 } /* }}} meta_data_t *meta_data_create */
 
+meta_data_t *meta_data_create_unlocked (void) /* {{{ */
+{
+  return (md_create (/* locked = */ 0));
+} /* }}} meta_data_t *meta_data_create_unlocked */
+
 meta_data_t *meta_data_clone (meta_data_t *orig) /* {{{ */
 {
   meta_data_t *copy;
@@ -234,13 +451,21 @@ meta_data_t *meta_data_clone (meta_data_t *orig) /* {{{ */
   if (orig == NULL)
     return (NULL);
 
-  copy = meta_data_create ();
+  copy = md_create (orig->locked);
   if (copy == NULL)
     return (NULL);
 
-  pthread_mutex_lock (&orig->lock);
-  copy->head = md_entry_clone (orig->head);
-  pthread_mutex_unlock (&orig->lock);
+  /* Share the entries with the original. They are copied by whichever
+   * object is modified first. */
+  MD_LOCK (orig);
+  if (orig->block != NULL)
+  {
+    pthread_mutex_lock (&md_share_lock);
+    orig->block->refcount++;
+    pthread_mutex_unlock (&md_share_lock);
+  }
+  copy->block = orig->block;
+  MD_UNLOCK (orig);
 
   return (copy);
 } /* }}} meta_data_t *meta_data_clone */
@@ -250,9 +475,11 @@ void meta_data_destroy (meta_data_t *md) /* {{{ */
   if (md == NULL)
     return;
 
-  pthread_mutex_destroy(&md->lock);
-  md_entry_free (md->head);
-  pthread_mutex_destroy (&md->lock);
+  md_block_release (md->block);
+  md->block = NULL;
+
+  if (md->locked)
+    pthread_mutex_destroy (&md->lock);
   free (md);
 } /* }}} void meta_data_destroy */
 
@@ -263,101 +490,84 @@ int meta_data_exists (meta_data_t *md, const char *key) /* {{{ */
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  pthread_mutex_lock (&md->lock);
-
-  for (e = md->head; e != NULL; e = e->next)
-  {
-    if (strcasecmp (key, e->key) == 0)
-    {
-      pthread_mutex_unlock (&md->lock);
-      return (1);
-    }
-  }
+  MD_LOCK (md);
+  e = md_entry_lookup (md, key);
+  MD_UNLOCK (md);
 
-  pthread_mutex_unlock (&md->lock);
-  return (0);
+  return ((e != NULL) ? 1 : 0);
 } /* }}} int meta_data_exists */
 
 int meta_data_type (meta_data_t *md, const char *key) /* {{{ */
 {
   meta_entry_t *e;
+  int type;
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock (&md->lock);
-
-  for (e = md->head; e != NULL; e = e->next)
-  {
-    if (strcasecmp (key, e->key) == 0)
-    {
-      pthread_mutex_unlock (&md->lock);
-      return e->type;
-    }
-  }
+  MD_LOCK (md);
+  e = md_entry_lookup (md, key);
+  type = (e != NULL) ? e->type : 0;
+  MD_UNLOCK (md);
 
-  pthread_mutex_unlock (&md->lock);
-  return 0;
+  return type;
 } /* }}} int meta_data_type */
 
 int meta_data_toc (meta_data_t *md, char ***toc) /* {{{ */
 {
-  int i = 0, count = 0;
-  meta_entry_t *e;
+  int i, count = 0;
 
   if ((md == NULL) || (toc == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock (&md->lock);
+  MD_LOCK (md);
 
-  for (e = md->head; e != NULL; e = e->next)
-    ++count;    
+  if (md->block != NULL)
+    count = md->block->entries_num;
 
   *toc = malloc(count * sizeof(**toc));
-  for (e = md->head; e != NULL; e = e->next)
-    (*toc)[i++] = strdup(e->key);
-  
-  pthread_mutex_unlock (&md->lock);
+  for (i = 0; i < count; i++)
+    (*toc)[i] = strdup(md->block->entries[i].key);
+
+  MD_UNLOCK (md);
   return count;
 } /* }}} int meta_data_toc */
 
 int meta_data_delete (meta_data_t *md, const char *key) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
+  meta_entry_t *e;
+  int status;
+  int i;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  pthread_mutex_lock (&md->lock);
+  MD_LOCK (md);
 
-  prev = NULL;
-  this = md->head;
-  while (this != NULL)
+  if (md_entry_lookup (md, key) == NULL)
   {
-    if (strcasecmp (key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
+    MD_UNLOCK (md);
+    return (-ENOENT);
   }
 
-  if (this == NULL)
+  /* Lookup again after un-sharing the block, the entries may have moved. */
+  status = md_block_prepare_write (md, md->block->entries_num);
+  if (status != 0)
   {
-    pthread_mutex_unlock (&md->lock);
-    return (-ENOENT);
+    MD_UNLOCK (md);
+    return (status);
   }
 
-  if (prev == NULL)
-    md->head = this->next;
-  else
-    prev->next = this->next;
-
-  pthread_mutex_unlock (&md->lock);
+  e = md_entry_lookup (md, key);
+  assert (e != NULL);
+  i = (int) (e - md->block->entries);
 
-  this->next = NULL;
-  md_entry_free (this);
+  md_entry_free (e);
+  memmove (md->block->entries + i, md->block->entries + i + 1,
+      (md->block->entries_num - i - 1) * sizeof (meta_entry_t));
+  md->block->entries_num--;
 
+  MD_UNLOCK (md);
   return (0);
 } /* }}} int meta_data_delete */
 
@@ -367,97 +577,73 @@ int meta_data_delete (meta_data_t *md, const char *key) /* {{{ */
 int meta_data_add_string (meta_data_t *md, /* {{{ */
     const char *key, const char *value)
 {
-  meta_entry_t *e;
+  meta_value_t v;
+  int status;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
-
-  e->value.mv_string = md_strdup (value);
-  if (e->value.mv_string == NULL)
+  v.mv_string = md_strdup (value);
+  if (v.mv_string == NULL)
   {
     ERROR ("meta_data_add_string: md_strdup failed.");
-    md_entry_free (e);
     return (-ENOMEM);
   }
-  e->type = MD_TYPE_STRING;
 
-  return (md_entry_insert (md, e));
+  status = md_entry_insert (md, key, MD_TYPE_STRING, v);
+  if (status != 0)
+    free (v.mv_string);
+
+  return (status);
 } /* }}} int meta_data_add_string */
 
 int meta_data_add_signed_int (meta_data_t *md, /* {{{ */
     const char *key, int64_t value)
 {
-  meta_entry_t *e;
+  meta_value_t v;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
-
-  e->value.mv_signed_int = value;
-  e->type = MD_TYPE_SIGNED_INT;
-
-  return (md_entry_insert (md, e));
+  v.mv_signed_int = value;
+  return (md_entry_insert (md, key, MD_TYPE_SIGNED_INT, v));
 } /* }}} int meta_data_add_signed_int */
 
 int meta_data_add_unsigned_int (meta_data_t *md, /* {{{ */
     const char *key, uint64_t value)
 {
-  meta_entry_t *e;
+  meta_value_t v;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
-
-  e->value.mv_unsigned_int = value;
-  e->type = MD_TYPE_UNSIGNED_INT;
-
-  return (md_entry_insert (md, e));
+  v.mv_unsigned_int = value;
+  return (md_entry_insert (md, key, MD_TYPE_UNSIGNED_INT, v));
 } /* }}} int meta_data_add_unsigned_int */
 
 int meta_data_add_double (meta_data_t *md, /* {{{ */
     const char *key, double value)
 {
-  meta_entry_t *e;
+  meta_value_t v;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
-
-  e->value.mv_double = value;
-  e->type = MD_TYPE_DOUBLE;
-
-  return (md_entry_insert (md, e));
+  v.mv_double = value;
+  return (md_entry_insert (md, key, MD_TYPE_DOUBLE, v));
 } /* }}} int meta_data_add_double */
 
 int meta_data_add_boolean (meta_data_t *md, /* {{{ */
     const char *key, _Bool value)
 {
-  meta_entry_t *e;
+  meta_value_t v;
 
   if ((md == NULL) || (key == NULL))
     return (-EINVAL);
 
-  e = md_entry_alloc (key);
-  if (e == NULL)
-    return (-ENOMEM);
-
-  e->value.mv_boolean = value;
-  e->type = MD_TYPE_BOOLEAN;
-
-  return (md_entry_insert (md, e));
+  memset (&v, 0, sizeof (v));
+  v.mv_boolean = value;
+  return (md_entry_insert (md, key, MD_TYPE_BOOLEAN, v));
 } /* }}} int meta_data_add_boolean */
 
 /*
@@ -472,155 +658,134 @@ int meta_data_get_string (meta_data_t *md, /* {{{ */
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return (-EINVAL);
 
-  pthread_mutex_lock (&md->lock);
+  MD_LOCK (md);
 
   e = md_entry_lookup (md, key);
   if (e == NULL)
   {
-    pthread_mutex_unlock (&md->lock);
+    MD_UNLOCK (md);
     return (-ENOENT);
   }
 
   if (e->type != MD_TYPE_STRING)
   {
-    ERROR ("meta_data_get_signed_int: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock (&md->lock);
+    ERROR ("meta_data_get_string: Type mismatch for key `%s'", e->key);
+    MD_UNLOCK (md);
     return (-ENOENT);
   }
 
   temp = md_strdup (e->value.mv_string);
   if (temp == NULL)
   {
-    pthread_mutex_unlock (&md->lock);
+    MD_UNLOCK (md);
     ERROR ("meta_data_get_string: md_strdup failed.");
     return (-ENOMEM);
   }
- 
-  pthread_mutex_unlock (&md->lock);
+
+  MD_UNLOCK (md);
 
   *value = temp;
 
   return (0);
 } /* }}} int meta_data_get_string */
 
-int meta_data_get_signed_int (meta_data_t *md, /* {{{ */
-    const char *key, int64_t *value)
+/* Looks up `key' and copies its value to `value' if it has type `type'. */
+static int md_get_value (meta_data_t *md, const char *key, /* {{{ */
+    int type, const char *func, meta_value_t *value)
 {
   meta_entry_t *e;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return (-EINVAL);
 
-  pthread_mutex_lock (&md->lock);
+  MD_LOCK (md);
 
   e = md_entry_lookup (md, key);
   if (e == NULL)
   {
-    pthread_mutex_unlock (&md->lock);
+    MD_UNLOCK (md);
     return (-ENOENT);
   }
 
-  if (e->type != MD_TYPE_SIGNED_INT)
+  if (e->type != type)
   {
-    ERROR ("meta_data_get_signed_int: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock (&md->lock);
+    ERROR ("%s: Type mismatch for key `%s'", func, e->key);
+    MD_UNLOCK (md);
     return (-ENOENT);
   }
 
-  *value = e->value.mv_signed_int;
+  *value = e->value;
 
-  pthread_mutex_unlock (&md->lock);
+  MD_UNLOCK (md);
   return (0);
-} /* }}} int meta_data_get_signed_int */
+} /* }}} int md_get_value */
 
-int meta_data_get_unsigned_int (meta_data_t *md, /* {{{ */
-    const char *key, uint64_t *value)
+int meta_data_get_signed_int (meta_data_t *md, /* {{{ */
+    const char *key, int64_t *value)
 {
-  meta_entry_t *e;
+  meta_value_t v;
+  int status;
 
-  if ((md == NULL) || (key == NULL) || (value == NULL))
+  if (value == NULL)
     return (-EINVAL);
 
-  pthread_mutex_lock (&md->lock);
+  status = md_get_value (md, key, MD_TYPE_SIGNED_INT,
+      "meta_data_get_signed_int", &v);
+  if (status == 0)
+    *value = v.mv_signed_int;
 
-  e = md_entry_lookup (md, key);
-  if (e == NULL)
-  {
-    pthread_mutex_unlock (&md->lock);
-    return (-ENOENT);
-  }
+  return (status);
+} /* }}} int meta_data_get_signed_int */
 
-  if (e->type != MD_TYPE_UNSIGNED_INT)
-  {
-    ERROR ("meta_data_get_unsigned_int: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock (&md->lock);
-    return (-ENOENT);
-  }
+int meta_data_get_unsigned_int (meta_data_t *md, /* {{{ */
+    const char *key, uint64_t *value)
+{
+  meta_value_t v;
+  int status;
 
-  *value = e->value.mv_unsigned_int;
+  if (value == NULL)
+    return (-EINVAL);
 
-  pthread_mutex_unlock (&md->lock);
-  return (0);
+  status = md_get_value (md, key, MD_TYPE_UNSIGNED_INT,
+      "meta_data_get_unsigned_int", &v);
+  if (status == 0)
+    *value = v.mv_unsigned_int;
+
+  return (status);
 } /* }}} int meta_data_get_unsigned_int */
 
 int meta_data_get_double (meta_data_t *md, /* {{{ */
     const char *key, double *value)
 {
-  meta_entry_t *e;
+  meta_value_t v;
+  int status;
 
-  if ((md == NULL) || (key == NULL) || (value == NULL))
+  if (value == NULL)
     return (-EINVAL);
 
-  pthread_mutex_lock (&md->lock);
-
-  e = md_entry_lookup (md, key);
-  if (e == NULL)
-  {
-    pthread_mutex_unlock (&md->lock);
-    return (-ENOENT);
-  }
-
-  if (e->type != MD_TYPE_DOUBLE)
-  {
-    ERROR ("meta_data_get_double: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock (&md->lock);
-    return (-ENOENT);
-  }
-
-  *value = e->value.mv_double;
+  status = md_get_value (md, key, MD_TYPE_DOUBLE,
+      "meta_data_get_double", &v);
+  if (status == 0)
+    *value = v.mv_double;
 
-  pthread_mutex_unlock (&md->lock);
-  return (0);
+  return (status);
 } /* }}} int meta_data_get_double */
 
 int meta_data_get_boolean (meta_data_t *md, /* {{{ */
     const char *key, _Bool *value)
 {
-  meta_entry_t *e;
+  meta_value_t v;
+  int status;
 
-  if ((md == NULL) || (key == NULL) || (value == NULL))
+  if (value == NULL)
     return (-EINVAL);
 
-  pthread_mutex_lock (&md->lock);
-
-  e = md_entry_lookup (md, key);
-  if (e == NULL)
-  {
-    pthread_mutex_unlock (&md->lock);
-    return (-ENOENT);
-  }
-
-  if (e->type != MD_TYPE_BOOLEAN)
-  {
-    ERROR ("meta_data_get_boolean: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock (&md->lock);
-    return (-ENOENT);
-  }
-
-  *value = e->value.mv_boolean;
+  status = md_get_value (md, key, MD_TYPE_BOOLEAN,
+      "meta_data_get_boolean", &v);
+  if (status == 0)
+    *value = v.mv_boolean;
 
-  pthread_mutex_unlock (&md->lock);
-  return (0);
+  return (status);
 } /* }}} int meta_data_get_boolean */
 
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -37,6 +37,11 @@ struct meta_data_s;
 typedef struct meta_data_s meta_data_t;
 
 meta_data_t *meta_data_create (void);
+/* Creates an object without an internal lock. It must only be used by one
+ * thread at a time, e.g. because it is attached to a value list which is
+ * being dispatched or because all accesses are protected by another lock.
+ * Clones inherit this property. */
+meta_data_t *meta_data_create_unlocked (void);
 meta_data_t *meta_data_clone (meta_data_t *orig);
 void meta_data_destroy (meta_data_t *md);
 
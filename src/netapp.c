@@ -574,10 +574,10 @@ static int submit_values (const char *host, /* {{{ */
 	vl.values_len = values_len;
 
 	if (timestamp > 0)
-		vl.time = timestamp;
+		vl.time = TIME_T_TO_CDTIME_T (timestamp);
 
 	if (interval > 0)
-		vl.interval = interval;
+		vl.interval = TIME_T_TO_CDTIME_T (interval);
 
 	if (host != NULL)
 		sstrncpy (vl.host, host, sizeof (vl.host));
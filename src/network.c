@@ -32,6 +32,8 @@
 #include "utils_avltree.h"
 #include "utils_cache.h"
 #include "utils_complain.h"
+#include "utils_atomic.h"
+#include "filter_chain.h"
 
 #include "network.h"
 
@@ -79,6 +81,10 @@
 GCRY_THREAD_OPTION_PTHREAD_IMPL;
 #endif
 
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 # ifdef IPV6_JOIN_GROUP
 #  define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
@@ -97,6 +103,23 @@ GCRY_THREAD_OPTION_PTHREAD_IMPL;
  */
 #define BUFF_SIG_SIZE 106
 
+/* Largest payload of an UDP datagram sent over IPv4. `MaxPacketSize' may be
+ * larger, but that only affects the receive buffer. */
+#define NET_MAX_UDP_PAYLOAD 65507
+
+/*
+ * A deflate compressed part consists of
+ *
+ *     4 bytes for the part header
+ * +   4 bytes for the size of the uncompressed data
+ * +   n bytes zlib stream
+ *
+ * The uncompressed data is a sequence of parts, i.e. a packet, and can
+ * therefore not be larger than a packet.
+ */
+#define PART_COMPR_DEFLATE_SIZE 8
+#define NET_MAX_DECOMPRESSED    65535
+
 /*
  * Private data types
  */
@@ -105,18 +128,66 @@ GCRY_THREAD_OPTION_PTHREAD_IMPL;
 # define SECURITY_LEVEL_SIGN    1
 # define SECURITY_LEVEL_ENCRYPT 2
 #endif
+
+#define DISTRIBUTION_ALL             0
+#define DISTRIBUTION_CONSISTENT_HASH 1
+
+/* Number of points each server occupies on the hash ring. */
+#define HASH_RING_POINTS 160
+/* A server is considered down after this many send errors within
+ * NETWORK_SERVER_RETRY seconds and will then not receive any values for
+ * NETWORK_SERVER_RETRY seconds. */
+#define NETWORK_SERVER_MAX_ERRORS 3
+#define NETWORK_SERVER_RETRY      30
+/* Values forwarded with `Relay' wait at most this many seconds in a partially
+ * filled buffer before it is sent. */
+#define NETWORK_RELAY_MAX_DELAY   1
+
+/* Buffer in which to-be-sent network packets are constructed. `first_value'
+ * is the time the first value was added since the last flush. */
+struct send_buffer_s
+{
+	char            *buffer;
+	char            *ptr;
+	int              fill;
+	value_list_t     vl;
+	pthread_mutex_t  lock;
+	cdtime_t         first_value;
+	struct send_buffer_s *next;
+};
+typedef struct send_buffer_s send_buffer_t;
+
 struct sockent_client
 {
 	int fd;
 	struct sockaddr_storage *addr;
 	socklen_t                addrlen;
+	_Bool                    connected;
 #if HAVE_LIBGCRYPT
 	int security_level;
 	char *username;
 	char *password;
 	gcry_cipher_hd_t cypher;
+	/* Packets may be sent by several threads at once. */
+	pthread_mutex_t  cypher_lock;
 	unsigned char password_hash[32];
 #endif
+#if HAVE_ZLIB
+	int              compress;
+	z_stream        *zstream;
+	pthread_mutex_t  zstream_lock;
+#endif
+
+	/* The following members are only used with
+	 * `Distribution ConsistentHash'. They are protected by `buffer.lock'. */
+	send_buffer_t buffer;
+	int           send_errors;
+	time_t        last_error;
+	time_t        down_until;
+	uint64_t      stats_octets_tx;
+	uint64_t      stats_packets_tx;
+	uint64_t      stats_values_sent;
+	uint64_t      stats_send_errors;
 };
 
 struct sockent_server
@@ -272,15 +343,30 @@ struct receive_list_entry_s
 };
 typedef struct receive_list_entry_s receive_list_entry_t;
 
+struct hash_ring_point_s
+{
+	uint32_t   hash;
+	sockent_t *se;
+};
+typedef struct hash_ring_point_s hash_ring_point_t;
+
 /*
  * Private variables
  */
 static int network_config_ttl = 0;
 static size_t network_config_packet_size = 1024;
 static int network_config_forward = 0;
+static int network_config_relay = 0;
 static int network_config_stats = 0;
+static int network_config_distribution = DISTRIBUTION_ALL;
+static int network_config_replicas = 1;
 
 static sockent_t *sending_sockets = NULL;
+static int        sending_sockets_num = 0;
+
+/* Sorted by hash; only used with `Distribution ConsistentHash'. */
+static hash_ring_point_t *hash_ring = NULL;
+static size_t             hash_ring_num = 0;
 
 static receive_list_entry_t *receive_list_head = NULL;
 static receive_list_entry_t *receive_list_tail = NULL;
@@ -300,28 +386,56 @@ static pthread_t receive_thread_id;
 static int       dispatch_thread_running = 0;
 static pthread_t dispatch_thread_id;
 
-/* Buffer in which to-be-sent network packets are constructed. */
-static char            *send_buffer;
-static char            *send_buffer_ptr;
-static int              send_buffer_fill;
-static value_list_t     send_buffer_vl = VALUE_LIST_STATIC;
-static pthread_mutex_t  send_buffer_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Size of the buffers in which outgoing packets are assembled. */
+static size_t network_send_size = 1024;
+
+/* Value lists written by the daemon are encoded into a buffer private to the
+ * writing thread, so the threads don't have to wait for each other. The
+ * buffers are created on demand and linked into `send_buffers', so they can
+ * be flushed by any thread. Each is sent when full, when its oldest value is
+ * older than the interval or when the plugin is flushed. */
+static pthread_key_t  send_buffer_key;
+static send_buffer_t *send_buffers = NULL;
+static pthread_mutex_t send_buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Time the buffers have last been checked for old values. Protected by
+ * `send_buffers_lock'. */
+static cdtime_t       send_buffers_checked = 0;
+
+/* Buffer for values forwarded by the dispatch thread with `Relay'. Values
+ * are only appended by the dispatch thread, which also takes care of sending
+ * the buffer after NETWORK_RELAY_MAX_DELAY seconds. `relay_pending_since' is
+ * the time the first value was added to an empty buffer, or zero. */
+static send_buffer_t relay_buffer = { NULL, NULL, 0, VALUE_LIST_STATIC,
+	PTHREAD_MUTEX_INITIALIZER };
+static time_t relay_pending_since = 0;
 
 /* XXX: These counters are incremented from one place only. The spot in which
- * the values are incremented is either only reachable by one thread (the
- * dispatch thread, for example) or locked by some lock (send_buffer_lock for
- * example). Only if neither is true, the stats_lock is acquired. The counters
- * are always read without holding a lock in the hope that writing 8 bytes to
- * memory is an atomic operation. */
+ * the values are incremented is only reachable by one thread (the dispatch
+ * thread, for example). The counters are always read without holding a lock
+ * in the hope that writing 8 bytes to memory is an atomic operation. */
 static uint64_t stats_octets_rx  = 0;
-static uint64_t stats_octets_tx  = 0;
 static uint64_t stats_packets_rx = 0;
-static uint64_t stats_packets_tx = 0;
 static uint64_t stats_values_dispatched = 0;
 static uint64_t stats_values_not_dispatched = 0;
+static uint64_t stats_octets_relay_rx = 0;
+static uint64_t stats_octets_relay_tx = 0;
+static uint64_t stats_values_relayed = 0;
+static uint64_t stats_values_not_relayed = 0;
+
+/* These counters are updated by all writing threads and are therefore only
+ * accessed using the catomic_* functions. `stats_flush_fill' and
+ * `stats_flush_num' are reset when read. */
+static uint64_t stats_octets_tx  = 0;
+static uint64_t stats_packets_tx = 0;
 static uint64_t stats_values_sent = 0;
 static uint64_t stats_values_not_sent = 0;
-static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t stats_flush_fill = 0;
+static uint64_t stats_flush_num = 0;
+/* Octets before and after compressing / decompressing; reset when read. */
+static uint64_t stats_compress_in = 0;
+static uint64_t stats_compress_out = 0;
+static uint64_t stats_decompress_in = 0;
+static uint64_t stats_decompress_out = 0;
 
 /*
  * Private functions
@@ -410,7 +524,7 @@ static int network_dispatch_values (value_list_t *vl, /* {{{ */
 {
   int status;
 
-  if ((vl->time <= 0)
+  if ((vl->time == 0)
       || (strlen (vl->host) <= 0)
       || (strlen (vl->plugin) <= 0)
       || (strlen (vl->type) <= 0))
@@ -431,10 +545,11 @@ static int network_dispatch_values (value_list_t *vl, /* {{{ */
 
   assert (vl->meta == NULL);
 
-  vl->meta = meta_data_create ();
+  /* The meta data is only used while dispatching the values. */
+  vl->meta = meta_data_create_unlocked ();
   if (vl->meta == NULL)
   {
-    ERROR ("network plugin: meta_data_create failed.");
+    ERROR ("network plugin: meta_data_create_unlocked failed.");
     return (-ENOMEM);
   }
 
@@ -976,10 +1091,18 @@ static int parse_part_string (void **ret_buffer, size_t *ret_buffer_len,
 	return (0);
 } /* int parse_part_string */
 
+/* Forward declarations: with `Relay', parse_packet hands received value lists
+ * to network_relay_values and the dispatch thread sends them using
+ * network_relay_flush. */
+static int network_relay_values (const value_list_t *vl,
+		const void *part, size_t part_len);
+static void network_relay_flush (time_t max_age);
+
 /* Forward declaration: parse_part_sign_sha256 and parse_part_encr_aes256 call
  * parse_packet and vice versa. */
-#define PP_SIGNED    0x01
-#define PP_ENCRYPTED 0x02
+#define PP_SIGNED     0x01
+#define PP_ENCRYPTED  0x02
+#define PP_COMPRESSED 0x04
 static int parse_packet (sockent_t *se,
 		void *buffer, size_t buffer_size, int flags,
 		const char *username);
@@ -1343,6 +1466,128 @@ static int parse_part_encr_aes256 (sockent_t *se, /* {{{ */
 
 #undef BUFFER_READ
 
+#if HAVE_ZLIB
+/* Only used by the dispatch thread. */
+static z_stream *receive_zstream = NULL;
+
+static int parse_part_compr_deflate (sockent_t *se, /* {{{ */
+		void **ret_buffer, size_t *ret_buffer_size, int flags,
+		const char *username)
+{
+	char *buffer = *ret_buffer;
+	size_t buffer_size = *ret_buffer_size;
+	uint16_t tmp16;
+	uint32_t tmp32;
+	size_t part_size;
+	size_t data_size;
+	int status;
+
+	if (buffer_size < PART_COMPR_DEFLATE_SIZE)
+		return (-1);
+
+	memcpy (&tmp16, buffer + sizeof (uint16_t), sizeof (tmp16));
+	part_size = (size_t) ntohs (tmp16);
+	memcpy (&tmp32, buffer + 2 * sizeof (uint16_t), sizeof (tmp32));
+	data_size = (size_t) ntohl (tmp32);
+
+	if ((part_size <= PART_COMPR_DEFLATE_SIZE)
+			|| (part_size > buffer_size)
+			|| (data_size == 0)
+			|| (data_size > NET_MAX_DECOMPRESSED))
+	{
+		ERROR ("network plugin: Compressed part with invalid length "
+				"received.");
+		return (-1);
+	}
+
+	/* Compressed data can't contain further compressed parts. */
+	if ((flags & PP_COMPRESSED) != 0)
+	{
+		ERROR ("network plugin: Nested compressed part received.");
+		return (-1);
+	}
+
+	if (receive_zstream == NULL)
+	{
+		receive_zstream = calloc (1, sizeof (*receive_zstream));
+		if (receive_zstream == NULL)
+		{
+			ERROR ("network plugin: calloc failed.");
+			return (-1);
+		}
+
+		status = inflateInit (receive_zstream);
+		if (status != Z_OK)
+		{
+			ERROR ("network plugin: inflateInit failed with status %i.",
+					status);
+			sfree (receive_zstream);
+			return (-1);
+		}
+	}
+	else
+	{
+		inflateReset (receive_zstream);
+	}
+
+	{
+		char data[data_size];
+
+		receive_zstream->next_in = (Bytef *) (buffer + PART_COMPR_DEFLATE_SIZE);
+		receive_zstream->avail_in = part_size - PART_COMPR_DEFLATE_SIZE;
+		receive_zstream->next_out = (Bytef *) data;
+		receive_zstream->avail_out = data_size;
+
+		status = inflate (receive_zstream, Z_FINISH);
+		if ((status != Z_STREAM_END)
+				|| (receive_zstream->total_out != data_size))
+		{
+			ERROR ("network plugin: Decompressing part failed "
+					"with status %i.", status);
+			return (-1);
+		}
+
+		catomic_add (&stats_decompress_in, (uint64_t) part_size);
+		catomic_add (&stats_decompress_out, (uint64_t) data_size);
+
+		parse_packet (se, data, data_size, flags | PP_COMPRESSED,
+				username);
+	}
+
+	*ret_buffer = buffer + part_size;
+	*ret_buffer_size = buffer_size - part_size;
+
+	return (0);
+} /* }}} int parse_part_compr_deflate */
+/* #endif HAVE_ZLIB */
+
+#else /* if !HAVE_ZLIB */
+static int parse_part_compr_deflate (sockent_t __attribute__((unused)) *se, /* {{{ */
+		void **ret_buffer, size_t *ret_buffer_size,
+		int __attribute__((unused)) flags,
+		const char __attribute__((unused)) *username)
+{
+	static c_complain_t complain_no_zlib = C_COMPLAIN_INIT_STATIC;
+	uint16_t tmp16;
+	size_t part_size;
+
+	/* parse_packet assures that the header is available. */
+	memcpy (&tmp16, ((char *) *ret_buffer) + sizeof (uint16_t),
+			sizeof (tmp16));
+	part_size = (size_t) ntohs (tmp16);
+
+	c_complain_once (LOG_WARNING, &complain_no_zlib,
+			"network plugin: Received a compressed part, but the "
+			"network plugin was built without zlib support. The part "
+			"will be discarded.");
+
+	*ret_buffer = ((char *) *ret_buffer) + part_size;
+	*ret_buffer_size -= part_size;
+
+	return (0);
+} /* }}} int parse_part_compr_deflate */
+#endif /* !HAVE_ZLIB */
+
 static int parse_packet (sockent_t *se, /* {{{ */
 		void *buffer, size_t buffer_size, int flags,
 		const char *username)
@@ -1438,14 +1683,26 @@ static int parse_packet (sockent_t *se, /* {{{ */
 			continue;
 		}
 #endif /* HAVE_LIBGCRYPT */
+		else if (pkg_type == TYPE_COMPR_DEFLATE)
+		{
+			status = parse_part_compr_deflate (se,
+					&buffer, &buffer_size, flags, username);
+			if (status != 0)
+				break;
+		}
 		else if (pkg_type == TYPE_VALUES)
 		{
+			void *part = buffer;
+
 			status = parse_part_values (&buffer, &buffer_size,
 					&vl.values, &vl.values_len);
 			if (status != 0)
 				break;
 
-			network_dispatch_values (&vl, username);
+			if (network_config_relay)
+				network_relay_values (&vl, part, pkg_length);
+			else
+				network_dispatch_values (&vl, username);
 
 			sfree (vl.values);
 		}
@@ -1456,17 +1713,36 @@ static int parse_packet (sockent_t *se, /* {{{ */
 					&tmp);
 			if (status == 0)
 			{
-				vl.time = (time_t) tmp;
+				vl.time = TIME_T_TO_CDTIME_T (tmp);
 				n.time = (time_t) tmp;
 			}
 		}
+		else if (pkg_type == TYPE_TIME_HR)
+		{
+			uint64_t tmp = 0;
+			status = parse_part_number (&buffer, &buffer_size,
+					&tmp);
+			if (status == 0)
+			{
+				vl.time = (cdtime_t) tmp;
+				n.time = CDTIME_T_TO_TIME_T (tmp);
+			}
+		}
 		else if (pkg_type == TYPE_INTERVAL)
 		{
 			uint64_t tmp = 0;
 			status = parse_part_number (&buffer, &buffer_size,
 					&tmp);
 			if (status == 0)
-				vl.interval = (int) tmp;
+				vl.interval = TIME_T_TO_CDTIME_T (tmp);
+		}
+		else if (pkg_type == TYPE_INTERVAL_HR)
+		{
+			uint64_t tmp = 0;
+			status = parse_part_number (&buffer, &buffer_size,
+					&tmp);
+			if (status == 0)
+				vl.interval = (cdtime_t) tmp;
 		}
 		else if (pkg_type == TYPE_HOST)
 		{
@@ -1575,11 +1851,22 @@ static void free_sockent_client (struct sockent_client *sec) /* {{{ */
     sec->fd = -1;
   }
   sfree (sec->addr);
+  sfree (sec->buffer.buffer);
+  pthread_mutex_destroy (&sec->buffer.lock);
 #if HAVE_LIBGCRYPT
   sfree (sec->username);
   sfree (sec->password);
   if (sec->cypher != NULL)
     gcry_cipher_close (sec->cypher);
+  pthread_mutex_destroy (&sec->cypher_lock);
+#endif
+#if HAVE_ZLIB
+  if (sec->zstream != NULL)
+  {
+    deflateEnd (sec->zstream);
+    sfree (sec->zstream);
+  }
+  pthread_mutex_destroy (&sec->zstream_lock);
 #endif
 } /* }}} void free_sockent_client */
 
@@ -1979,11 +2266,22 @@ static int sockent_init (sockent_t *se, int type) /* {{{ */
 	{
 		se->data.client.fd = -1;
 		se->data.client.addr = NULL;
+		se->data.client.buffer.buffer = NULL;
+		pthread_mutex_init (&se->data.client.buffer.lock,
+				/* attr = */ NULL);
 #if HAVE_LIBGCRYPT
 		se->data.client.security_level = SECURITY_LEVEL_NONE;
 		se->data.client.username = NULL;
 		se->data.client.password = NULL;
 		se->data.client.cypher = NULL;
+		pthread_mutex_init (&se->data.client.cypher_lock,
+				/* attr = */ NULL);
+#endif
+#if HAVE_ZLIB
+		se->data.client.compress = 0;
+		se->data.client.zstream = NULL;
+		pthread_mutex_init (&se->data.client.zstream_lock,
+				/* attr = */ NULL);
 #endif
 	}
 
@@ -2218,6 +2516,8 @@ static int sockent_add (sockent_t *se) /* {{{ */
 	}
 	else /* if (se->type == SOCKENT_TYPE_CLIENT) */
 	{
+		sending_sockets_num++;
+
 		if (sending_sockets == NULL)
 		{
 			sending_sockets = se;
@@ -2240,19 +2540,42 @@ static void *dispatch_thread (void __attribute__((unused)) *arg) /* {{{ */
     receive_list_entry_t *ent;
     sockent_t *se;
 
-    /* Lock and wait for more data to come in */
+    /* Lock and wait for more data to come in. When relaying, wake up
+     * periodically to send values which are waiting in the relay buffer. */
     pthread_mutex_lock (&receive_list_lock);
     while ((listen_loop == 0)
         && (receive_list_head == NULL))
-      pthread_cond_wait (&receive_list_cond, &receive_list_lock);
+    {
+      if (network_config_relay)
+      {
+        struct timespec abstime;
+
+        abstime.tv_sec = time (NULL) + NETWORK_RELAY_MAX_DELAY;
+        abstime.tv_nsec = 0;
+        if (pthread_cond_timedwait (&receive_list_cond, &receive_list_lock,
+              &abstime) == ETIMEDOUT)
+          break;
+      }
+      else
+        pthread_cond_wait (&receive_list_cond, &receive_list_lock);
+    }
 
     /* Remove the head entry and unlock */
     ent = receive_list_head;
     if (ent != NULL)
+    {
       receive_list_head = ent->next;
-    receive_list_length--;
+      receive_list_length--;
+    }
     pthread_mutex_unlock (&receive_list_lock);
 
+    /* Timed out waiting for packets. */
+    if ((ent == NULL) && (listen_loop == 0))
+    {
+      network_relay_flush (NETWORK_RELAY_MAX_DELAY);
+      continue;
+    }
+
     /* Check whether we are supposed to exit. We do NOT check `listen_loop'
      * because we dispatch all missing packets before shutting down. */
     if (ent == NULL)
@@ -2286,6 +2609,13 @@ static void *dispatch_thread (void __attribute__((unused)) *arg) /* {{{ */
 
     parse_packet (se, ent->data, ent->data_len, /* flags = */ 0,
 	/* username = */ NULL);
+
+    if (network_config_relay)
+    {
+      stats_octets_relay_rx += (uint64_t) ent->data_len;
+      network_relay_flush (NETWORK_RELAY_MAX_DELAY);
+    }
+
     sfree (ent->data);
     sfree (ent);
   } /* while (42) */
@@ -2349,6 +2679,9 @@ static int network_receive (void) /* {{{ */
 			stats_octets_rx += ((uint64_t) buffer_len);
 			stats_packets_rx++;
 
+			if (buffer_len == 0)
+				continue;
+
 			/* TODO: Possible performance enhancement: Do not free
 			 * these entries in the dispatch thread but put them in
 			 * another list, so we don't have to allocate more and
@@ -2360,7 +2693,9 @@ static int network_receive (void) /* {{{ */
 				return (-1);
 			}
 			memset (ent, 0, sizeof (receive_list_entry_t));
-			ent->data = malloc (network_config_packet_size);
+			/* Only allocate what's been received: with a large
+			 * `MaxPacketSize' most packets are much smaller. */
+			ent->data = malloc (buffer_len);
 			if (ent->data == NULL)
 			{
 				sfree (ent);
@@ -2432,26 +2767,33 @@ static void *receive_thread (void __attribute__((unused)) *arg)
 	return (network_receive () ? (void *) 1 : (void *) 0);
 } /* void *receive_thread */
 
-static void network_init_buffer (void)
+static void network_init_buffer (send_buffer_t *sb)
 {
-	memset (send_buffer, 0, network_config_packet_size);
-	send_buffer_ptr = send_buffer;
-	send_buffer_fill = 0;
+	memset (sb->buffer, 0, network_send_size);
+	sb->ptr = sb->buffer;
+	sb->fill = 0;
+	sb->first_value = 0;
 
-	memset (&send_buffer_vl, 0, sizeof (send_buffer_vl));
+	memset (&sb->vl, 0, sizeof (sb->vl));
 } /* int network_init_buffer */
 
-static void networt_send_buffer_plain (const sockent_t *se, /* {{{ */
+static int networt_send_buffer_plain (const sockent_t *se, /* {{{ */
 		const char *buffer, size_t buffer_size)
 {
 	int status;
 
 	while (42)
 	{
-		status = sendto (se->data.client.fd, buffer, buffer_size,
-                    /* flags = */ 0,
-                    (struct sockaddr *) se->data.client.addr,
-                    se->data.client.addrlen);
+		/* Connected sockets report ICMP errors, such as "port
+		 * unreachable", on the next send. */
+		if (se->data.client.connected)
+			status = send (se->data.client.fd, buffer, buffer_size,
+					/* flags = */ 0);
+		else
+			status = sendto (se->data.client.fd, buffer, buffer_size,
+					/* flags = */ 0,
+					(struct sockaddr *) se->data.client.addr,
+					se->data.client.addrlen);
                 if (status < 0)
 		{
 			char errbuf[1024];
@@ -2460,12 +2802,14 @@ static void networt_send_buffer_plain (const sockent_t *se, /* {{{ */
 			ERROR ("network plugin: sendto failed: %s",
 					sstrerror (errno, errbuf,
 						sizeof (errbuf)));
-			break;
+			return (-1);
 		}
 
 		break;
 	} /* while (42) */
-} /* }}} void networt_send_buffer_plain */
+
+	return (0);
+} /* }}} int networt_send_buffer_plain */
 
 #if HAVE_LIBGCRYPT
 #define BUFFER_ADD(p,s) do { \
@@ -2473,7 +2817,7 @@ static void networt_send_buffer_plain (const sockent_t *se, /* {{{ */
   buffer_offset += (s); \
 } while (0)
 
-static void networt_send_buffer_signed (const sockent_t *se, /* {{{ */
+static int networt_send_buffer_signed (const sockent_t *se, /* {{{ */
 		const char *in_buffer, size_t in_buffer_size)
 {
   part_signature_sha256_t ps;
@@ -2491,7 +2835,7 @@ static void networt_send_buffer_signed (const sockent_t *se, /* {{{ */
   {
     ERROR ("network plugin: Creating HMAC object failed: %s",
         gcry_strerror (err));
-    return;
+    return (-1);
   }
 
   err = gcry_md_setkey (hd, se->data.client.password,
@@ -2501,7 +2845,7 @@ static void networt_send_buffer_signed (const sockent_t *se, /* {{{ */
     ERROR ("network plugin: gcry_md_setkey failed: %s",
         gcry_strerror (err));
     gcry_md_close (hd);
-    return;
+    return (-1);
   }
 
   username_len = strlen (se->data.client.username);
@@ -2509,7 +2853,7 @@ static void networt_send_buffer_signed (const sockent_t *se, /* {{{ */
   {
     ERROR ("network plugin: Username too long: %s",
         se->data.client.username);
-    return;
+    return (-1);
   }
 
   memcpy (buffer + PART_SIGNATURE_SHA256_SIZE,
@@ -2530,7 +2874,7 @@ static void networt_send_buffer_signed (const sockent_t *se, /* {{{ */
   {
     ERROR ("network plugin: gcry_md_read failed.");
     gcry_md_close (hd);
-    return;
+    return (-1);
   }
   memcpy (ps.hash, hash, sizeof (ps.hash));
 
@@ -2547,10 +2891,10 @@ static void networt_send_buffer_signed (const sockent_t *se, /* {{{ */
   hd = NULL;
 
   buffer_offset = PART_SIGNATURE_SHA256_SIZE + username_len + in_buffer_size;
-  networt_send_buffer_plain (se, buffer, buffer_offset);
-} /* }}} void networt_send_buffer_signed */
+  return (networt_send_buffer_plain (se, buffer, buffer_offset));
+} /* }}} int networt_send_buffer_signed */
 
-static void networt_send_buffer_encrypted (sockent_t *se, /* {{{ */
+static int networt_send_buffer_encrypted (sockent_t *se, /* {{{ */
 		const char *in_buffer, size_t in_buffer_size)
 {
   part_encryption_aes256_t pea;
@@ -2572,7 +2916,7 @@ static void networt_send_buffer_encrypted (sockent_t *se, /* {{{ */
   if ((PART_ENCRYPTION_AES256_SIZE + username_len) > BUFF_SIG_SIZE)
   {
     ERROR ("network plugin: Username too long: %s", pea.username);
-    return;
+    return (-1);
   }
 
   buffer_size = PART_ENCRYPTION_AES256_SIZE + username_len + in_buffer_size;
@@ -2609,29 +2953,140 @@ static void networt_send_buffer_encrypted (sockent_t *se, /* {{{ */
 
   assert (buffer_offset == buffer_size);
 
+  pthread_mutex_lock (&se->data.client.cypher_lock);
+
   cypher = network_get_aes256_cypher (se, pea.iv, sizeof (pea.iv),
       se->data.client.password);
   if (cypher == NULL)
-    return;
+  {
+    pthread_mutex_unlock (&se->data.client.cypher_lock);
+    return (-1);
+  }
 
   /* Encrypt the buffer in-place */
   err = gcry_cipher_encrypt (cypher,
       buffer      + header_size,
       buffer_size - header_size,
       /* in = */ NULL, /* in len = */ 0);
+  pthread_mutex_unlock (&se->data.client.cypher_lock);
   if (err != 0)
   {
     ERROR ("network plugin: gcry_cipher_encrypt returned: %s",
         gcry_strerror (err));
-    return;
+    return (-1);
   }
 
   /* Send it out without further modifications */
-  networt_send_buffer_plain (se, buffer, buffer_size);
-} /* }}} void networt_send_buffer_encrypted */
+  return (networt_send_buffer_plain (se, buffer, buffer_size));
+} /* }}} int networt_send_buffer_encrypted */
 #undef BUFFER_ADD
 #endif /* HAVE_LIBGCRYPT */
 
+#if HAVE_ZLIB
+/* Compresses `in_buffer' into a TYPE_COMPR_DEFLATE part in `out_buffer'.
+ * Returns the size of that part or zero if the result wouldn't be smaller
+ * than the input. */
+static size_t network_compress (sockent_t *se, /* {{{ */
+		char *out_buffer, size_t out_buffer_size,
+		const char *in_buffer, size_t in_buffer_size)
+{
+	struct sockent_client *client = &se->data.client;
+	z_stream *zs;
+	uint16_t tmp16;
+	uint32_t tmp32;
+	size_t part_size;
+	int status;
+
+	if (out_buffer_size <= PART_COMPR_DEFLATE_SIZE)
+		return (0);
+
+	pthread_mutex_lock (&client->zstream_lock);
+
+	if (client->zstream == NULL)
+	{
+		client->zstream = calloc (1, sizeof (*client->zstream));
+		if (client->zstream == NULL)
+		{
+			pthread_mutex_unlock (&client->zstream_lock);
+			ERROR ("network plugin: calloc failed.");
+			return (0);
+		}
+
+		status = deflateInit (client->zstream, Z_DEFAULT_COMPRESSION);
+		if (status != Z_OK)
+		{
+			sfree (client->zstream);
+			pthread_mutex_unlock (&client->zstream_lock);
+			ERROR ("network plugin: deflateInit failed with status %i.",
+					status);
+			return (0);
+		}
+	}
+	else
+	{
+		deflateReset (client->zstream);
+	}
+
+	zs = client->zstream;
+	zs->next_in = (Bytef *) in_buffer;
+	zs->avail_in = in_buffer_size;
+	zs->next_out = (Bytef *) (out_buffer + PART_COMPR_DEFLATE_SIZE);
+	zs->avail_out = out_buffer_size - PART_COMPR_DEFLATE_SIZE;
+
+	/* Z_OK means the output didn't fit. */
+	status = deflate (zs, Z_FINISH);
+	part_size = PART_COMPR_DEFLATE_SIZE + zs->total_out;
+
+	pthread_mutex_unlock (&client->zstream_lock);
+
+	if ((status != Z_STREAM_END) || (part_size >= in_buffer_size))
+		return (0);
+
+	tmp16 = htons (TYPE_COMPR_DEFLATE);
+	memcpy (out_buffer, &tmp16, sizeof (tmp16));
+	tmp16 = htons ((uint16_t) part_size);
+	memcpy (out_buffer + sizeof (uint16_t), &tmp16, sizeof (tmp16));
+	tmp32 = htonl ((uint32_t) in_buffer_size);
+	memcpy (out_buffer + 2 * sizeof (uint16_t), &tmp32, sizeof (tmp32));
+
+	return (part_size);
+} /* }}} size_t network_compress */
+#endif /* HAVE_ZLIB */
+
+static int network_send_buffer_se (sockent_t *se, /* {{{ */
+    const char *buffer, size_t buffer_len)
+{
+#if HAVE_ZLIB
+  char compressed[buffer_len];
+
+  if (se->data.client.compress)
+  {
+    size_t compressed_len;
+
+    catomic_add (&stats_compress_in, (uint64_t) buffer_len);
+
+    compressed_len = network_compress (se, compressed, sizeof (compressed),
+        buffer, buffer_len);
+    if (compressed_len > 0)
+    {
+      buffer = compressed;
+      buffer_len = compressed_len;
+    }
+
+    catomic_add (&stats_compress_out, (uint64_t) buffer_len);
+  }
+#endif /* HAVE_ZLIB */
+
+#if HAVE_LIBGCRYPT
+  if (se->data.client.security_level == SECURITY_LEVEL_ENCRYPT)
+    return (networt_send_buffer_encrypted (se, buffer, buffer_len));
+  else if (se->data.client.security_level == SECURITY_LEVEL_SIGN)
+    return (networt_send_buffer_signed (se, buffer, buffer_len));
+  else /* if (se->data.client.security_level == SECURITY_LEVEL_NONE) */
+#endif /* HAVE_LIBGCRYPT */
+    return (networt_send_buffer_plain (se, buffer, buffer_len));
+} /* }}} int network_send_buffer_se */
+
 static void network_send_buffer (char *buffer, size_t buffer_len) /* {{{ */
 {
   sockent_t *se;
@@ -2639,21 +3094,27 @@ static void network_send_buffer (char *buffer, size_t buffer_len) /* {{{ */
   DEBUG ("network plugin: network_send_buffer: buffer_len = %zu", buffer_len);
 
   for (se = sending_sockets; se != NULL; se = se->next)
-  {
-#if HAVE_LIBGCRYPT
-    if (se->data.client.security_level == SECURITY_LEVEL_ENCRYPT)
-      networt_send_buffer_encrypted (se, buffer, buffer_len);
-    else if (se->data.client.security_level == SECURITY_LEVEL_SIGN)
-      networt_send_buffer_signed (se, buffer, buffer_len);
-    else /* if (se->data.client.security_level == SECURITY_LEVEL_NONE) */
-#endif /* HAVE_LIBGCRYPT */
-      networt_send_buffer_plain (se, buffer, buffer_len);
-  } /* for (sending_sockets) */
+    network_send_buffer_se (se, buffer, buffer_len);
 } /* }}} void network_send_buffer */
 
+/* Returns the interval in whole seconds, rounded up, as sent in the
+ * TYPE_INTERVAL part. */
+static uint64_t interval_seconds (cdtime_t interval) /* {{{ */
+{
+	uint64_t seconds = (uint64_t) CDTIME_T_TO_TIME_T (interval);
+
+	if ((seconds == 0) || ((interval & 0x3fffffff) != 0))
+		seconds++;
+
+	return (seconds);
+} /* }}} uint64_t interval_seconds */
+
+/* Appends the parts describing `vl' to the buffer. If `part' is not NULL, it
+ * is copied as values part instead of encoding the values using `ds'. */
 static int add_to_buffer (char *buffer, int buffer_size, /* {{{ */
 		value_list_t *vl_def,
-		const data_set_t *ds, const value_list_t *vl)
+		const data_set_t *ds, const value_list_t *vl,
+		const void *part, size_t part_len)
 {
 	char *buffer_orig = buffer;
 
@@ -2665,9 +3126,18 @@ static int add_to_buffer (char *buffer, int buffer_size, /* {{{ */
 		sstrncpy (vl_def->host, vl->host, sizeof (vl_def->host));
 	}
 
+	/* The time and interval are sent in whole seconds for receivers which
+	 * don't know the high resolution parts, which follow them and take
+	 * precedence. Receivers skip parts they don't know. */
 	if (vl_def->time != vl->time)
 	{
-		if (write_part_number (&buffer, &buffer_size, TYPE_TIME,
+		if ((vl_def->time == 0)
+				|| (CDTIME_T_TO_TIME_T (vl_def->time)
+					!= CDTIME_T_TO_TIME_T (vl->time)))
+			if (write_part_number (&buffer, &buffer_size, TYPE_TIME,
+						(uint64_t) CDTIME_T_TO_TIME_T (vl->time)))
+				return (-1);
+		if (write_part_number (&buffer, &buffer_size, TYPE_TIME_HR,
 					(uint64_t) vl->time))
 			return (-1);
 		vl_def->time = vl->time;
@@ -2675,7 +3145,13 @@ static int add_to_buffer (char *buffer, int buffer_size, /* {{{ */
 
 	if (vl_def->interval != vl->interval)
 	{
-		if (write_part_number (&buffer, &buffer_size, TYPE_INTERVAL,
+		if ((vl_def->interval == 0)
+				|| (interval_seconds (vl_def->interval)
+					!= interval_seconds (vl->interval)))
+			if (write_part_number (&buffer, &buffer_size, TYPE_INTERVAL,
+						interval_seconds (vl->interval)))
+				return (-1);
+		if (write_part_number (&buffer, &buffer_size, TYPE_INTERVAL_HR,
 					(uint64_t) vl->interval))
 			return (-1);
 		vl_def->interval = vl->interval;
@@ -2703,7 +3179,7 @@ static int add_to_buffer (char *buffer, int buffer_size, /* {{{ */
 		if (write_part_string (&buffer, &buffer_size, TYPE_TYPE,
 					vl->type, strlen (vl->type)) != 0)
 			return (-1);
-		sstrncpy (vl_def->type, ds->type, sizeof (vl_def->type));
+		sstrncpy (vl_def->type, vl->type, sizeof (vl_def->type));
 	}
 
 	if (strcmp (vl_def->type_instance, vl->type_instance) != 0)
@@ -2715,28 +3191,505 @@ static int add_to_buffer (char *buffer, int buffer_size, /* {{{ */
 		sstrncpy (vl_def->type_instance, vl->type_instance, sizeof (vl_def->type_instance));
 	}
 
-	if (write_part_values (&buffer, &buffer_size, ds, vl) != 0)
+	if (part != NULL)
+	{
+		if ((buffer_size < 0) || ((size_t) buffer_size < part_len))
+			return (-1);
+		memcpy (buffer, part, part_len);
+		buffer += part_len;
+	}
+	else if (write_part_values (&buffer, &buffer_size, ds, vl) != 0)
 		return (-1);
 
 	return (buffer - buffer_orig);
 } /* }}} int add_to_buffer */
 
-static void flush_buffer (void)
+/* Marks a server as down after too many send errors. Since ICMP errors are
+ * reported on the send following the failed one, successful sends
+ * alternate with failed ones for unreachable servers. The error count is
+ * therefore only reset after a period without errors. The caller must hold
+ * `buffer.lock'. */
+static void network_server_update_health (sockent_t *se, int status) /* {{{ */
 {
-	DEBUG ("network plugin: flush_buffer: send_buffer_fill = %i",
-			send_buffer_fill);
+	struct sockent_client *client = &se->data.client;
+	time_t now;
+
+	if (status == 0)
+		return;
+
+	now = time (NULL);
+	if ((now - client->last_error) > NETWORK_SERVER_RETRY)
+		client->send_errors = 0;
+
+	client->stats_send_errors++;
+	client->send_errors++;
+	client->last_error = now;
+
+	if (client->send_errors >= NETWORK_SERVER_MAX_ERRORS)
+	{
+		WARNING ("network plugin: Sending to server `%s:%s' failed "
+				"%i times. Sending its values to other servers "
+				"for the next %i seconds.",
+				se->node,
+				(se->service != NULL) ? se->service : NET_DEFAULT_PORT,
+				client->send_errors, NETWORK_SERVER_RETRY);
+		client->down_until = now + NETWORK_SERVER_RETRY;
+	}
+} /* }}} void network_server_update_health */
+
+/* Sends the buffer to `se' or, if `se' is NULL, to all servers. The caller
+ * must hold `sb->lock'. */
+static void flush_buffer (send_buffer_t *sb, sockent_t *se)
+{
+	DEBUG ("network plugin: flush_buffer: fill = %i", sb->fill);
+
+	if (se == NULL)
+	{
+		network_send_buffer (sb->buffer, (size_t) sb->fill);
+	}
+	else
+	{
+		int status;
+
+		status = network_send_buffer_se (se, sb->buffer,
+				(size_t) sb->fill);
+		network_server_update_health (se, status);
 
-	network_send_buffer (send_buffer, (size_t) send_buffer_fill);
+		se->data.client.stats_octets_tx += ((uint64_t) sb->fill);
+		se->data.client.stats_packets_tx++;
+	}
 
-	stats_octets_tx += ((uint64_t) send_buffer_fill);
-	stats_packets_tx++;
+	catomic_add (&stats_octets_tx, (uint64_t) sb->fill);
+	catomic_add (&stats_packets_tx, 1);
+	catomic_add (&stats_flush_fill, (uint64_t) sb->fill);
+	catomic_add (&stats_flush_num, 1);
 
-	network_init_buffer ();
+	network_init_buffer (sb);
 }
 
+/* Appends a value list to the buffer, flushing it when it's full. `part'
+ * and `part_len' are passed to add_to_buffer. Returns the number of bytes
+ * added or less than zero on error. The caller must hold `sb->lock'. */
+static int network_buffer_add (send_buffer_t *sb, sockent_t *se, /* {{{ */
+		const data_set_t *ds, const value_list_t *vl,
+		const void *part, size_t part_len)
+{
+	int status;
+
+	status = add_to_buffer (sb->ptr,
+			network_send_size - (sb->fill + BUFF_SIG_SIZE),
+			&sb->vl,
+			ds, vl, part, part_len);
+	if (status < 0)
+	{
+		flush_buffer (sb, se);
+
+		status = add_to_buffer (sb->ptr,
+				network_send_size - (sb->fill + BUFF_SIG_SIZE),
+				&sb->vl,
+				ds, vl, part, part_len);
+	}
+
+	if (status < 0)
+	{
+		ERROR ("network plugin: Unable to append to the "
+				"buffer for some weird reason");
+		return (-1);
+	}
+
+	/* status == bytes added to the buffer */
+	sb->fill += status;
+	sb->ptr  += status;
+
+	if (sb->first_value == 0)
+		sb->first_value = cdtime ();
+
+	if (se != NULL)
+		se->data.client.stats_values_sent++;
+
+	if ((network_send_size - sb->fill) < 15)
+		flush_buffer (sb, se);
+
+	return (status);
+} /* }}} int network_buffer_add */
+
+static uint32_t network_hash (const char *str) /* {{{ */
+{
+	uint32_t hash = 2166136261U;
+
+	/* FNV-1a ... */
+	for (; *str != 0; str++)
+	{
+		hash ^= (uint32_t) ((unsigned char) *str);
+		hash *= 16777619U;
+	}
+
+	/* ... followed by a finalizer that spreads similar strings, e.g.
+	 * "foo#1" and "foo#2", over the whole ring. */
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+
+	return (hash);
+} /* }}} uint32_t network_hash */
+
+static int hash_ring_point_compare (const void *a, const void *b) /* {{{ */
+{
+	const hash_ring_point_t *p0 = a;
+	const hash_ring_point_t *p1 = b;
+
+	if (p0->hash < p1->hash)
+		return (-1);
+	else if (p0->hash > p1->hash)
+		return (1);
+	return (0);
+} /* }}} int hash_ring_point_compare */
+
+static int hash_ring_create (void) /* {{{ */
+{
+	sockent_t *se;
+	size_t i;
+
+	hash_ring_num = (size_t) sending_sockets_num * HASH_RING_POINTS;
+	hash_ring = calloc (hash_ring_num, sizeof (*hash_ring));
+	if (hash_ring == NULL)
+	{
+		ERROR ("network plugin: calloc failed.");
+		hash_ring_num = 0;
+		return (-1);
+	}
+
+	i = 0;
+	for (se = sending_sockets; se != NULL; se = se->next)
+	{
+		int j;
+
+		for (j = 0; j < HASH_RING_POINTS; j++)
+		{
+			char name[1024];
+
+			ssnprintf (name, sizeof (name), "%s:%s#%i", se->node,
+					(se->service != NULL) ? se->service : NET_DEFAULT_PORT,
+					j);
+
+			hash_ring[i].hash = network_hash (name);
+			hash_ring[i].se = se;
+			i++;
+		}
+	}
+	assert (i == hash_ring_num);
+
+	qsort (hash_ring, hash_ring_num, sizeof (*hash_ring),
+			hash_ring_point_compare);
+
+	return (0);
+} /* }}} int hash_ring_create */
+
+static _Bool network_server_is_up (sockent_t *se, time_t now) /* {{{ */
+{
+	_Bool is_up;
+
+	pthread_mutex_lock (&se->data.client.buffer.lock);
+	is_up = (se->data.client.down_until <= now);
+	pthread_mutex_unlock (&se->data.client.buffer.lock);
+
+	return (is_up);
+} /* }}} _Bool network_server_is_up */
+
+/* Selects up to `network_config_replicas' distinct servers for `vl' by
+ * walking the hash ring clockwise, starting at the hash of the identifier.
+ * Servers which are down are skipped. If all servers are down, the values
+ * are sent to the servers they'd go to if all were up. */
+static int hash_ring_lookup (const value_list_t *vl, /* {{{ */
+		sockent_t **ret, int ret_size)
+{
+	char name[6 * DATA_MAX_NAME_LEN];
+	uint32_t hash;
+	size_t lo;
+	size_t hi;
+	size_t i;
+	time_t now;
+	int ret_num = 0;
+	int pass;
+
+	FORMAT_VL (name, sizeof (name), vl);
+	hash = network_hash (name);
+
+	/* Find the first point with a hash >= `hash'. */
+	lo = 0;
+	hi = hash_ring_num;
+	while (lo < hi)
+	{
+		size_t mid = lo + ((hi - lo) / 2);
+
+		if (hash_ring[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	now = time (NULL);
+	for (pass = 0; (pass < 2) && (ret_num == 0); pass++)
+	{
+		for (i = 0; (i < hash_ring_num) && (ret_num < ret_size); i++)
+		{
+			sockent_t *se = hash_ring[(lo + i) % hash_ring_num].se;
+			int j;
+
+			for (j = 0; j < ret_num; j++)
+				if (ret[j] == se)
+					break;
+			if (j < ret_num)
+				continue;
+
+			if ((pass == 0) && !network_server_is_up (se, now))
+				continue;
+
+			ret[ret_num] = se;
+			ret_num++;
+		}
+	}
+
+	return (ret_num);
+} /* }}} int hash_ring_lookup */
+
+static int network_write_hashed (const data_set_t *ds, /* {{{ */
+		const value_list_t *vl)
+{
+	sockent_t *servers[network_config_replicas];
+	int servers_num;
+	int status = 0;
+	int i;
+
+	servers_num = hash_ring_lookup (vl, servers, network_config_replicas);
+
+	for (i = 0; i < servers_num; i++)
+	{
+		struct sockent_client *client = &servers[i]->data.client;
+
+		pthread_mutex_lock (&client->buffer.lock);
+		if (network_buffer_add (&client->buffer, servers[i],
+					ds, vl, /* part = */ NULL, 0) < 0)
+			status = -1;
+		pthread_mutex_unlock (&client->buffer.lock);
+	}
+
+	catomic_add (&stats_values_sent, 1);
+
+	return (status);
+} /* }}} int network_write_hashed */
+
+/* Sends the thread buffers and, with `Distribution ConsistentHash', the
+ * server buffers whose oldest value has been added at least `max_age'
+ * seconds before `now'. With a `max_age' greater than zero this is only done
+ * once per `max_age' seconds. */
+static void network_send_buffers_flush (cdtime_t now, cdtime_t max_age) /* {{{ */
+{
+	send_buffer_t *sb;
+	sockent_t *se;
+
+	pthread_mutex_lock (&send_buffers_lock);
+
+	if ((max_age > 0) && ((now - send_buffers_checked) < max_age))
+	{
+		pthread_mutex_unlock (&send_buffers_lock);
+		return;
+	}
+	send_buffers_checked = now;
+
+	for (sb = send_buffers; sb != NULL; sb = sb->next)
+	{
+		pthread_mutex_lock (&sb->lock);
+		if ((sb->fill > 0) && ((now - sb->first_value) >= max_age))
+			flush_buffer (sb, /* all servers */ NULL);
+		pthread_mutex_unlock (&sb->lock);
+	}
+
+	pthread_mutex_unlock (&send_buffers_lock);
+
+	if (network_config_distribution != DISTRIBUTION_CONSISTENT_HASH)
+		return;
+
+	for (se = sending_sockets; se != NULL; se = se->next)
+	{
+		sb = &se->data.client.buffer;
+
+		pthread_mutex_lock (&sb->lock);
+		if ((sb->fill > 0) && ((now - sb->first_value) >= max_age))
+			flush_buffer (sb, se);
+		pthread_mutex_unlock (&sb->lock);
+	}
+} /* }}} void network_send_buffers_flush */
+
+/* Called when a thread exits: sends the remaining values and frees the
+ * thread's buffer. */
+static void network_thread_buffer_destroy (void *arg) /* {{{ */
+{
+	send_buffer_t *sb = arg;
+	send_buffer_t **prev;
+
+	if (sb == NULL)
+		return;
+
+	pthread_mutex_lock (&send_buffers_lock);
+	for (prev = &send_buffers; *prev != NULL; prev = &(*prev)->next)
+	{
+		if (*prev == sb)
+		{
+			*prev = sb->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock (&send_buffers_lock);
+
+	if (sb->fill > 0)
+		flush_buffer (sb, /* all servers */ NULL);
+
+	sfree (sb->buffer);
+	pthread_mutex_destroy (&sb->lock);
+	sfree (sb);
+} /* }}} void network_thread_buffer_destroy */
+
+/* Returns the calling thread's buffer, creating it if necessary. */
+static send_buffer_t *network_thread_buffer (void) /* {{{ */
+{
+	send_buffer_t *sb;
+
+	sb = pthread_getspecific (send_buffer_key);
+	if (sb != NULL)
+		return (sb);
+
+	sb = malloc (sizeof (*sb));
+	if (sb == NULL)
+	{
+		ERROR ("network plugin: malloc failed.");
+		return (NULL);
+	}
+	memset (sb, 0, sizeof (*sb));
+
+	sb->buffer = malloc (network_send_size);
+	if (sb->buffer == NULL)
+	{
+		ERROR ("network plugin: malloc failed.");
+		sfree (sb);
+		return (NULL);
+	}
+	pthread_mutex_init (&sb->lock, /* attr = */ NULL);
+	network_init_buffer (sb);
+
+	pthread_mutex_lock (&send_buffers_lock);
+	sb->next = send_buffers;
+	send_buffers = sb;
+	pthread_mutex_unlock (&send_buffers_lock);
+
+	pthread_setspecific (send_buffer_key, sb);
+
+	return (sb);
+} /* }}} send_buffer_t *network_thread_buffer */
+
+static int network_relay_values (const value_list_t *vl, /* {{{ */
+		const void *part, size_t part_len)
+{
+	int status;
+
+	if ((vl->time == 0)
+			|| (strlen (vl->host) <= 0)
+			|| (strlen (vl->plugin) <= 0)
+			|| (strlen (vl->type) <= 0))
+	{
+		stats_values_not_relayed++;
+		return (-EINVAL);
+	}
+
+	if (network_config_distribution == DISTRIBUTION_CONSISTENT_HASH)
+	{
+		sockent_t *servers[network_config_replicas];
+		int servers_num;
+		int i;
+
+		status = 0;
+		servers_num = hash_ring_lookup (vl, servers,
+				network_config_replicas);
+		for (i = 0; i < servers_num; i++)
+		{
+			struct sockent_client *client = &servers[i]->data.client;
+			int tmp;
+
+			pthread_mutex_lock (&client->buffer.lock);
+			tmp = network_buffer_add (&client->buffer, servers[i],
+					/* ds = */ NULL, vl, part, part_len);
+			pthread_mutex_unlock (&client->buffer.lock);
+
+			if (tmp < 0)
+				status = tmp;
+			else
+				stats_octets_relay_tx += (uint64_t) tmp;
+		}
+	}
+	else
+	{
+		pthread_mutex_lock (&relay_buffer.lock);
+		status = network_buffer_add (&relay_buffer,
+				/* all servers */ NULL,
+				/* ds = */ NULL, vl, part, part_len);
+		pthread_mutex_unlock (&relay_buffer.lock);
+
+		if (status > 0)
+			stats_octets_relay_tx += (uint64_t) status;
+	}
+
+	if (status < 0)
+	{
+		stats_values_not_relayed++;
+		return (-1);
+	}
+
+	if (relay_pending_since == 0)
+		relay_pending_since = time (NULL);
+	stats_values_relayed++;
+
+	return (0);
+} /* }}} int network_relay_values */
+
+/* Sends the buffers holding relayed values if the oldest of these values has
+ * been waiting for at least `max_age' seconds. Only called by the dispatch
+ * thread. */
+static void network_relay_flush (time_t max_age) /* {{{ */
+{
+	sockent_t *se;
+
+	if ((relay_pending_since == 0)
+			|| ((time (NULL) - relay_pending_since) < max_age))
+		return;
+
+	relay_pending_since = 0;
+
+	if (network_config_distribution != DISTRIBUTION_CONSISTENT_HASH)
+	{
+		pthread_mutex_lock (&relay_buffer.lock);
+		if (relay_buffer.fill > 0)
+			flush_buffer (&relay_buffer, /* all servers */ NULL);
+		pthread_mutex_unlock (&relay_buffer.lock);
+		return;
+	}
+
+	for (se = sending_sockets; se != NULL; se = se->next)
+	{
+		send_buffer_t *sb = &se->data.client.buffer;
+
+		pthread_mutex_lock (&sb->lock);
+		if (sb->fill > 0)
+			flush_buffer (sb, se);
+		pthread_mutex_unlock (&sb->lock);
+	}
+} /* }}} void network_relay_flush */
+
 static int network_write (const data_set_t *ds, const value_list_t *vl,
 		user_data_t __attribute__((unused)) *user_data)
 {
+	cdtime_t now;
 	int status;
 
 	if (!check_send_okay (vl))
@@ -2748,60 +3701,39 @@ static int network_write (const data_set_t *ds, const value_list_t *vl,
 	  DEBUG ("network plugin: network_write: "
 	      "NOT sending %s.", name);
 #endif
-	  /* Counter is not protected by another lock and may be reached by
-	   * multiple threads */
-	  pthread_mutex_lock (&stats_lock);
-	  stats_values_not_sent++;
-	  pthread_mutex_unlock (&stats_lock);
+	  catomic_add (&stats_values_not_sent, 1);
 	  return (0);
 	}
 
 	uc_meta_data_add_unsigned_int (vl,
 	    "network:time_sent", (uint64_t) vl->time);
 
-	pthread_mutex_lock (&send_buffer_lock);
-
-	status = add_to_buffer (send_buffer_ptr,
-			network_config_packet_size - (send_buffer_fill + BUFF_SIG_SIZE),
-			&send_buffer_vl,
-			ds, vl);
-	if (status >= 0)
+	if (network_config_distribution == DISTRIBUTION_CONSISTENT_HASH)
 	{
-		/* status == bytes added to the buffer */
-		send_buffer_fill += status;
-		send_buffer_ptr  += status;
-
-		stats_values_sent++;
+		status = network_write_hashed (ds, vl);
 	}
 	else
 	{
-		flush_buffer ();
+		send_buffer_t *sb;
 
-		status = add_to_buffer (send_buffer_ptr,
-				network_config_packet_size - (send_buffer_fill + BUFF_SIG_SIZE),
-				&send_buffer_vl,
-				ds, vl);
-
-		if (status >= 0)
-		{
-			send_buffer_fill += status;
-			send_buffer_ptr  += status;
+		sb = network_thread_buffer ();
+		if (sb == NULL)
+			return (-1);
 
-			stats_values_sent++;
-		}
-	}
+		pthread_mutex_lock (&sb->lock);
+		status = network_buffer_add (sb, /* all servers */ NULL,
+				ds, vl, /* part = */ NULL, 0);
+		pthread_mutex_unlock (&sb->lock);
 
-	if (status < 0)
-	{
-		ERROR ("network plugin: Unable to append to the "
-				"buffer for some weird reason");
-	}
-	else if ((network_config_packet_size - send_buffer_fill) < 15)
-	{
-		flush_buffer ();
+		if (status >= 0)
+			catomic_add (&stats_values_sent, 1);
 	}
 
-	pthread_mutex_unlock (&send_buffer_lock);
+	/* Unlocked read: at worst, network_send_buffers_flush returns
+	 * right away. */
+	now = cdtime ();
+	if ((now - send_buffers_checked) >= interval_g)
+		network_send_buffers_flush (now, interval_g);
 
 	return ((status < 0) ? -1 : 0);
 } /* int network_write */
@@ -2900,6 +3832,53 @@ static int network_config_set_buffer_size (const oconfig_item_t *ci) /* {{{ */
   return (0);
 } /* }}} int network_config_set_buffer_size */
 
+static int network_config_set_distribution (const oconfig_item_t *ci) /* {{{ */
+{
+  const char *str;
+  if ((ci->values_num != 1)
+      || (ci->values[0].type != OCONFIG_TYPE_STRING))
+  {
+    WARNING ("network plugin: The `Distribution' config option needs exactly "
+        "one string argument.");
+    return (-1);
+  }
+
+  str = ci->values[0].value.string;
+  if (strcasecmp ("All", str) == 0)
+    network_config_distribution = DISTRIBUTION_ALL;
+  else if (strcasecmp ("ConsistentHash", str) == 0)
+    network_config_distribution = DISTRIBUTION_CONSISTENT_HASH;
+  else
+  {
+    WARNING ("network plugin: Unknown distribution `%s'.", str);
+    return (-1);
+  }
+
+  return (0);
+} /* }}} int network_config_set_distribution */
+
+static int network_config_set_replicas (const oconfig_item_t *ci) /* {{{ */
+{
+  int tmp;
+  if ((ci->values_num != 1)
+      || (ci->values[0].type != OCONFIG_TYPE_NUMBER))
+  {
+    WARNING ("network plugin: The `Replicas' config option needs exactly "
+        "one numeric argument.");
+    return (-1);
+  }
+
+  tmp = (int) ci->values[0].value.number;
+  if (tmp < 1)
+  {
+    WARNING ("network plugin: `Replicas' must be at least 1.");
+    return (-1);
+  }
+  network_config_replicas = tmp;
+
+  return (0);
+} /* }}} int network_config_set_replicas */
+
 #if HAVE_LIBGCRYPT
 static int network_config_set_string (const oconfig_item_t *ci, /* {{{ */
     char **ret_string)
@@ -3078,6 +4057,13 @@ static int network_config_add_server (const oconfig_item_t *ci) /* {{{ */
     if (strcasecmp ("Interface", child->key) == 0)
       network_config_set_interface (child,
           &se->interface);
+    else if (strcasecmp ("Compress", child->key) == 0)
+#if HAVE_ZLIB
+      network_config_set_boolean (child, &se->data.client.compress);
+#else
+      WARNING ("network plugin: The `Compress' option is not available, "
+          "because the network plugin was built without zlib support.");
+#endif
     else
     {
       WARNING ("network plugin: Option `%s' is not allowed here.",
@@ -3135,8 +4121,14 @@ static int network_config (oconfig_item_t *ci) /* {{{ */
       network_config_set_buffer_size (child);
     else if (strcasecmp ("Forward", child->key) == 0)
       network_config_set_boolean (child, &network_config_forward);
+    else if (strcasecmp ("Relay", child->key) == 0)
+      network_config_set_boolean (child, &network_config_relay);
     else if (strcasecmp ("ReportStats", child->key) == 0)
       network_config_set_boolean (child, &network_config_stats);
+    else if (strcasecmp ("Distribution", child->key) == 0)
+      network_config_set_distribution (child);
+    else if (strcasecmp ("Replicas", child->key) == 0)
+      network_config_set_replicas (child);
     else if (strcasecmp ("CacheFlush", child->key) == 0)
       /* no op for backwards compatibility only */;
     else
@@ -3152,7 +4144,7 @@ static int network_config (oconfig_item_t *ci) /* {{{ */
 static int network_notification (const notification_t *n,
     user_data_t __attribute__((unused)) *user_data)
 {
-  char  buffer[network_config_packet_size];
+  char  buffer[network_send_size];
   char *buffer_ptr = buffer;
   int   buffer_free = sizeof (buffer);
   int   status;
@@ -3250,10 +4242,42 @@ static int network_shutdown (void)
 
 	sockent_destroy (listen_sockets);
 
-	if (send_buffer_fill > 0)
-		flush_buffer ();
+#if HAVE_ZLIB
+	if (receive_zstream != NULL)
+	{
+		inflateEnd (receive_zstream);
+		sfree (receive_zstream);
+	}
+#endif
+
+	network_send_buffers_flush (cdtime (), /* max_age = */ 0);
 
-	sfree (send_buffer);
+	/* Buffers of exited threads have been freed already. The remaining
+	 * ones belong to threads which are still running, e.g. the main
+	 * thread. */
+	pthread_mutex_lock (&send_buffers_lock);
+	while (send_buffers != NULL)
+	{
+		send_buffer_t *sb = send_buffers;
+
+		send_buffers = sb->next;
+		sfree (sb->buffer);
+		pthread_mutex_destroy (&sb->lock);
+		sfree (sb);
+	}
+	pthread_mutex_unlock (&send_buffers_lock);
+	pthread_key_delete (send_buffer_key);
+
+	if (relay_buffer.fill > 0)
+		flush_buffer (&relay_buffer, /* all servers */ NULL);
+
+	sfree (relay_buffer.buffer);
+
+	if (network_config_distribution == DISTRIBUTION_CONSISTENT_HASH)
+	{
+		sfree (hash_ring);
+		hash_ring_num = 0;
+	}
 
 	/* TODO: Close `sending_sockets' */
 
@@ -3265,6 +4289,66 @@ static int network_shutdown (void)
 	return (0);
 } /* int network_shutdown */
 
+/* Per-server statistics, only available with
+ * `Distribution ConsistentHash'. The server is used as plugin instance. */
+static void network_stats_read_servers (void) /* {{{ */
+{
+	sockent_t *se;
+
+	for (se = sending_sockets; se != NULL; se = se->next)
+	{
+		struct sockent_client *client = &se->data.client;
+		value_list_t vl = VALUE_LIST_INIT;
+		value_t values[2];
+		uint64_t copy_octets_tx;
+		uint64_t copy_packets_tx;
+		uint64_t copy_values_sent;
+		uint64_t copy_send_errors;
+
+		pthread_mutex_lock (&client->buffer.lock);
+		copy_octets_tx = client->stats_octets_tx;
+		copy_packets_tx = client->stats_packets_tx;
+		copy_values_sent = client->stats_values_sent;
+		copy_send_errors = client->stats_send_errors;
+		pthread_mutex_unlock (&client->buffer.lock);
+
+		vl.values = values;
+		vl.values_len = 2;
+		vl.time = 0;
+		vl.interval = interval_g;
+		sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+		sstrncpy (vl.plugin, "network", sizeof (vl.plugin));
+		if (se->service != NULL)
+			ssnprintf (vl.plugin_instance, sizeof (vl.plugin_instance),
+					"%s-%s", se->node, se->service);
+		else
+			sstrncpy (vl.plugin_instance, se->node,
+					sizeof (vl.plugin_instance));
+
+		vl.values[0].counter = 0;
+		vl.values[1].counter = (counter_t) copy_octets_tx;
+		sstrncpy (vl.type, "if_octets", sizeof (vl.type));
+		plugin_dispatch_values_secure (&vl);
+
+		vl.values[0].counter = 0;
+		vl.values[1].counter = (counter_t) copy_packets_tx;
+		sstrncpy (vl.type, "if_packets", sizeof (vl.type));
+		plugin_dispatch_values_secure (&vl);
+
+		vl.values[0].counter = 0;
+		vl.values[1].counter = (counter_t) copy_send_errors;
+		sstrncpy (vl.type, "if_errors", sizeof (vl.type));
+		plugin_dispatch_values_secure (&vl);
+
+		vl.values_len = 1;
+		vl.values[0].derive = (derive_t) copy_values_sent;
+		sstrncpy (vl.type, "total_values", sizeof (vl.type));
+		sstrncpy (vl.type_instance, "send-accepted",
+				sizeof (vl.type_instance));
+		plugin_dispatch_values_secure (&vl);
+	}
+} /* }}} void network_stats_read_servers */
+
 static int network_stats_read (void) /* {{{ */
 {
 	uint64_t copy_octets_rx;
@@ -3275,18 +4359,38 @@ static int network_stats_read (void) /* {{{ */
 	uint64_t copy_values_not_dispatched;
 	uint64_t copy_values_sent;
 	uint64_t copy_values_not_sent;
+	uint64_t copy_flush_fill;
+	uint64_t copy_flush_num;
+	uint64_t copy_compress_in;
+	uint64_t copy_compress_out;
+	uint64_t copy_decompress_in;
+	uint64_t copy_decompress_out;
+	uint64_t copy_octets_relay_rx;
+	uint64_t copy_octets_relay_tx;
+	uint64_t copy_values_relayed;
+	uint64_t copy_values_not_relayed;
 	uint64_t copy_receive_list_length;
 	value_list_t vl = VALUE_LIST_INIT;
 	value_t values[2];
 
 	copy_octets_rx = stats_octets_rx;
-	copy_octets_tx = stats_octets_tx;
+	copy_octets_tx = catomic_get (&stats_octets_tx);
 	copy_packets_rx = stats_packets_rx;
-	copy_packets_tx = stats_packets_tx;
+	copy_packets_tx = catomic_get (&stats_packets_tx);
 	copy_values_dispatched = stats_values_dispatched;
 	copy_values_not_dispatched = stats_values_not_dispatched;
-	copy_values_sent = stats_values_sent;
-	copy_values_not_sent = stats_values_not_sent;
+	copy_values_sent = catomic_get (&stats_values_sent);
+	copy_values_not_sent = catomic_get (&stats_values_not_sent);
+	copy_flush_fill = catomic_reset (&stats_flush_fill);
+	copy_flush_num = catomic_reset (&stats_flush_num);
+	copy_compress_in = catomic_reset (&stats_compress_in);
+	copy_compress_out = catomic_reset (&stats_compress_out);
+	copy_decompress_in = catomic_reset (&stats_decompress_in);
+	copy_decompress_out = catomic_reset (&stats_decompress_out);
+	copy_octets_relay_rx = stats_octets_relay_rx;
+	copy_octets_relay_tx = stats_octets_relay_tx;
+	copy_values_relayed = stats_values_relayed;
+	copy_values_not_relayed = stats_values_not_relayed;
 	copy_receive_list_length = receive_list_length;
 
 	/* Initialize `vl' */
@@ -3339,9 +4443,115 @@ static int network_stats_read (void) /* {{{ */
 	vl.type_instance[0] = 0;
 	plugin_dispatch_values_secure (&vl);
 
+	/* Average fill of the packets sent since the last read */
+	if (copy_flush_num > 0)
+		vl.values[0].gauge = 100.0 * ((gauge_t) copy_flush_fill)
+			/ ((gauge_t) (copy_flush_num * network_send_size));
+	else
+		vl.values[0].gauge = NAN;
+	sstrncpy (vl.type, "percent", sizeof (vl.type));
+	sstrncpy (vl.type_instance, "packet-fill", sizeof (vl.type_instance));
+	plugin_dispatch_values_secure (&vl);
+
+	/* Size of compressed packets relative to the uncompressed data */
+	if ((copy_compress_in > 0) || (copy_decompress_out > 0))
+	{
+		if (copy_compress_in > 0)
+			vl.values[0].gauge = 100.0 * ((gauge_t) copy_compress_out)
+				/ ((gauge_t) copy_compress_in);
+		else
+			vl.values[0].gauge = NAN;
+		sstrncpy (vl.type_instance, "compressed-tx",
+				sizeof (vl.type_instance));
+		plugin_dispatch_values_secure (&vl);
+
+		if (copy_decompress_out > 0)
+			vl.values[0].gauge = 100.0 * ((gauge_t) copy_decompress_in)
+				/ ((gauge_t) copy_decompress_out);
+		else
+			vl.values[0].gauge = NAN;
+		sstrncpy (vl.type_instance, "compressed-rx",
+				sizeof (vl.type_instance));
+		plugin_dispatch_values_secure (&vl);
+	}
+
+	if (network_config_relay)
+	{
+		/* Octets of packets handled by / values added by the relay */
+		vl.values_len = 2;
+		vl.values[0].counter = (counter_t) copy_octets_relay_rx;
+		vl.values[1].counter = (counter_t) copy_octets_relay_tx;
+		sstrncpy (vl.type, "if_octets", sizeof (vl.type));
+		sstrncpy (vl.type_instance, "relay", sizeof (vl.type_instance));
+		plugin_dispatch_values_secure (&vl);
+
+		/* Values (not) relayed */
+		vl.values_len = 1;
+		sstrncpy (vl.type, "total_values", sizeof (vl.type));
+
+		vl.values[0].derive = (derive_t) copy_values_relayed;
+		sstrncpy (vl.type_instance, "relay-accepted",
+				sizeof (vl.type_instance));
+		plugin_dispatch_values_secure (&vl);
+
+		vl.values[0].derive = (derive_t) copy_values_not_relayed;
+		sstrncpy (vl.type_instance, "relay-rejected",
+				sizeof (vl.type_instance));
+		plugin_dispatch_values_secure (&vl);
+	}
+
+	if (network_config_distribution == DISTRIBUTION_CONSISTENT_HASH)
+		network_stats_read_servers ();
+
 	return (0);
 } /* }}} int network_stats_read */
 
+/* Sets up the per-server buffers and the hash ring for
+ * `Distribution ConsistentHash'. */
+static int network_init_distribution (void) /* {{{ */
+{
+	sockent_t *se;
+
+	if (network_config_replicas > sending_sockets_num)
+	{
+		WARNING ("network plugin: `Replicas' is %i, but only %i servers "
+				"are configured.", network_config_replicas,
+				sending_sockets_num);
+		network_config_replicas = sending_sockets_num;
+	}
+
+	for (se = sending_sockets; se != NULL; se = se->next)
+	{
+		struct sockent_client *client = &se->data.client;
+
+		client->buffer.buffer = malloc (network_send_size);
+		if (client->buffer.buffer == NULL)
+		{
+			ERROR ("network plugin: malloc failed.");
+			return (-1);
+		}
+		network_init_buffer (&client->buffer);
+
+		/* Connecting the socket makes the kernel report unreachable
+		 * servers, so they can be taken out of the ring. */
+		if (connect (client->fd, (struct sockaddr *) client->addr,
+					client->addrlen) == 0)
+		{
+			client->connected = 1;
+		}
+		else
+		{
+			char errbuf[1024];
+			WARNING ("network plugin: connect to `%s:%s' failed: %s",
+					se->node,
+					(se->service != NULL) ? se->service : NET_DEFAULT_PORT,
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+		}
+	}
+
+	return (hash_ring_create ());
+} /* }}} int network_init_distribution */
+
 static int network_init (void)
 {
 	static _Bool have_init = false;
@@ -3371,13 +4581,53 @@ static int network_init (void)
 
 	plugin_register_shutdown ("network", network_shutdown);
 
-	send_buffer = malloc (network_config_packet_size);
-	if (send_buffer == NULL)
+	network_send_size = network_config_packet_size;
+	if (network_send_size > NET_MAX_UDP_PAYLOAD)
+		network_send_size = NET_MAX_UDP_PAYLOAD;
+
+	if (pthread_key_create (&send_buffer_key,
+				network_thread_buffer_destroy) != 0)
 	{
-		ERROR ("network plugin: malloc failed.");
+		ERROR ("network plugin: pthread_key_create failed.");
 		return (-1);
 	}
-	network_init_buffer ();
+
+	if (network_config_relay && (sending_sockets == NULL))
+	{
+		WARNING ("network plugin: `Relay' is enabled, but no `Server' "
+				"is configured. Disabling `Relay'.");
+		network_config_relay = 0;
+	}
+	else if (network_config_relay
+			&& ((fc_chain_get_by_name (global_option_get ("PreCacheChain")) != NULL)
+				|| (fc_chain_get_by_name (global_option_get ("PostCacheChain")) != NULL)))
+	{
+		/* Relayed values don't pass the filter chains, so use the
+		 * normal dispatch path if any are configured. */
+		WARNING ("network plugin: `Relay' cannot be used together with "
+				"filter chains. Received values will be dispatched "
+				"and forwarded as with `Forward true' instead.");
+		network_config_relay = 0;
+		network_config_forward = 1;
+	}
+
+	if (network_config_relay)
+	{
+		relay_buffer.buffer = malloc (network_send_size);
+		if (relay_buffer.buffer == NULL)
+		{
+			ERROR ("network plugin: malloc failed.");
+			return (-1);
+		}
+		network_init_buffer (&relay_buffer);
+	}
+
+	if ((network_config_distribution == DISTRIBUTION_CONSISTENT_HASH)
+			&& (sending_sockets != NULL))
+	{
+		if (network_init_distribution () != 0)
+			return (-1);
+	}
 
 	/* setup socket(s) and so on */
 	if (sending_sockets != NULL)
@@ -3448,12 +4698,15 @@ static int network_flush (int timeout,
 		const char __attribute__((unused)) *identifier,
 		user_data_t __attribute__((unused)) *user_data)
 {
-	pthread_mutex_lock (&send_buffer_lock);
+	network_send_buffers_flush (cdtime (), /* max_age = */ 0);
 
-	if (send_buffer_fill > 0)
-	  flush_buffer ();
-
-	pthread_mutex_unlock (&send_buffer_lock);
+	if (network_config_relay)
+	{
+		pthread_mutex_lock (&relay_buffer.lock);
+		if (relay_buffer.fill > 0)
+			flush_buffer (&relay_buffer, /* all servers */ NULL);
+		pthread_mutex_unlock (&relay_buffer.lock);
+	}
 
 	return (0);
 } /* int network_flush */
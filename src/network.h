@@ -62,6 +62,9 @@
 #define TYPE_TYPE_INSTANCE   0x0005
 #define TYPE_VALUES          0x0006
 #define TYPE_INTERVAL        0x0007
+/* Time and interval in units of 2^-30 seconds, see utils_time.h */
+#define TYPE_TIME_HR         0x0008
+#define TYPE_INTERVAL_HR     0x0009
 
 /* Types to transmit notifications */
 #define TYPE_MESSAGE         0x0100
@@ -70,4 +73,7 @@
 #define TYPE_SIGN_SHA256     0x0200
 #define TYPE_ENCR_AES256     0x0210
 
+/* Deflate compressed block of other parts */
+#define TYPE_COMPR_DEFLATE   0x0220
+
 #endif /* NETWORK_H */
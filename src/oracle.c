@@ -418,6 +418,7 @@ static int o_read_database_query (o_database_t *db, /* {{{ */
    * space declared above. */
   OCIDefine **oci_defines;
 
+  struct timeval begin;
   int status;
   size_t i;
 
@@ -462,6 +463,8 @@ static int o_read_database_query (o_database_t *db, /* {{{ */
 
   assert (oci_statement != NULL);
 
+  gettimeofday (&begin, /* timezone = */ NULL);
+
   /* Execute the statement */
   status = OCIStmtExecute (db->oci_service_context, /* {{{ */
       oci_statement,
@@ -655,6 +658,9 @@ static int o_read_database_query (o_database_t *db, /* {{{ */
   /* DEBUG ("oracle plugin: o_read_database_query: This statement succeeded: %s", q->statement); */
   FREE_ALL;
 
+  udb_query_submit_time (q, hostname_g, /* plugin = */ "oracle", db->name,
+      /* interval = */ -1, &begin);
+
   return (0);
 #undef FREE_ALL
 #undef ALLOC_OR_FAIL
@@ -52,6 +52,7 @@
 #include "common.h"
 
 #include "filter_chain.h"
+#include "utils_complain.h"
 
 #include <pthread.h>
 
@@ -136,6 +137,29 @@ typedef struct {
 	SV   *user_data;
 } pfc_user_data_t;
 
+/* queued write / notification callback, see perl_pool_* */
+typedef struct c_pool_entry_s {
+	int type;
+
+	const data_set_t *ds;
+	value_list_t      vl;
+	notification_t    n;
+
+	struct c_pool_entry_s *next;
+} c_pool_entry_t;
+
+typedef struct {
+	pthread_t thread;
+
+	/* the worker's Perl interpreter, owned by the worker thread */
+	c_ithread_t *ithread;
+
+	/* usage stats, updated by the worker after each batch */
+	derive_t  processed;
+	gauge_t   sv_count;
+	gauge_t   arena_bytes;
+} c_pool_worker_t;
+
 #define PFC_USER_DATA_FREE(data) \
 	do { \
 		sfree ((data)->name); \
@@ -165,6 +189,24 @@ static char **perl_argv = NULL;
 
 static char base_name[DATA_MAX_NAME_LEN] = "";
 
+/* interpreter pool used for write and notification callbacks;
+ * disabled if pool_size == 0 */
+static int pool_size        = 0;
+static int pool_queue_limit = 4096;
+static int pool_batch_size  = 64;
+
+static c_pool_worker_t *pool_workers = NULL;
+static int              pool_workers_num = 0;
+
+static c_pool_entry_t *pool_queue_head = NULL;
+static c_pool_entry_t *pool_queue_tail = NULL;
+static int             pool_queue_len  = 0;
+static derive_t        pool_dropped    = 0;
+static int             pool_shutdown   = 0;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pool_cond = PTHREAD_COND_INITIALIZER;
+
 static struct {
 	char name[64];
 	XS ((*f));
@@ -231,15 +273,6 @@ struct {
 	{ "", NULL }
 };
 
-struct {
-	char  name[64];
-	int  *var;
-} g_integers[] =
-{
-	{ "Collectd::interval_g", &interval_g },
-	{ "", NULL }
-};
-
 /*
  * Helper functions for data type conversion.
  */
@@ -393,10 +426,10 @@ static int hv2value_list (pTHX_ HV *hash, value_list_t *vl)
 	}
 
 	if (NULL != (tmp = hv_fetch (hash, "time", 4, 0)))
-		vl->time = (time_t)SvIV (*tmp);
+		vl->time = DOUBLE_TO_CDTIME_T (SvNV (*tmp));
 
 	if (NULL != (tmp = hv_fetch (hash, "interval", 8, 0)))
-		vl->interval = SvIV (*tmp);
+		vl->interval = DOUBLE_TO_CDTIME_T (SvNV (*tmp));
 
 	if (NULL != (tmp = hv_fetch (hash, "host", 4, 0)))
 		sstrncpy (vl->host, SvPV_nolen (*tmp), sizeof (vl->host));
@@ -668,10 +701,12 @@ static int value_list2hv (pTHX_ value_list_t *vl, data_set_t *ds, HV *hash)
 		return -1;
 
 	if (0 != vl->time)
-		if (NULL == hv_store (hash, "time", 4, newSViv (vl->time), 0))
+		if (NULL == hv_store (hash, "time", 4,
+					newSVnv (CDTIME_T_TO_DOUBLE (vl->time)), 0))
 			return -1;
 
-	if (NULL == hv_store (hash, "interval", 8, newSViv (vl->interval), 0))
+	if (NULL == hv_store (hash, "interval", 8,
+				newSVnv (CDTIME_T_TO_DOUBLE (vl->interval)), 0))
 		return -1;
 
 	if ('\0' != vl->host[0])
@@ -1236,6 +1271,306 @@ static c_ithread_t *c_ithread_create (PerlInterpreter *base)
 	return t;
 } /* static c_ithread_t *c_ithread_create (PerlInterpreter *) */
 
+/*
+ * Interpreter pool.
+ *
+ * If enabled, write and notification callbacks are not executed by the
+ * calling thread but copied into a queue which is processed by a fixed
+ * number of worker threads, each of which owns exactly one Perl
+ * interpreter. This limits the number of cloned interpreters to
+ * "WriteThreads" + the number of read threads, no matter how many threads
+ * dispatch values.
+ */
+
+static void pool_entry_free (c_pool_entry_t *e)
+{
+	if (NULL == e)
+		return;
+
+	if (PLUGIN_WRITE == e->type) {
+		sfree (e->vl.values);
+		meta_data_destroy (e->vl.meta);
+	}
+	else if (PLUGIN_NOTIF == e->type) {
+		plugin_notification_meta_free (e->n.meta);
+	}
+
+	sfree (e);
+	return;
+} /* static void pool_entry_free (c_pool_entry_t *) */
+
+static int pool_enqueue (c_pool_entry_t *e)
+{
+	static c_complain_t complaint = C_COMPLAIN_INIT_STATIC;
+
+	pthread_mutex_lock (&pool_lock);
+
+	if (pool_queue_len >= pool_queue_limit) {
+		++pool_dropped;
+		pthread_mutex_unlock (&pool_lock);
+
+		c_complain (LOG_WARNING, &complaint,
+				"perl plugin: Queue limit of %i entries reached; "
+				"dropping callbacks.", pool_queue_limit);
+		pool_entry_free (e);
+		return -1;
+	}
+
+	e->next = NULL;
+	if (NULL == pool_queue_tail)
+		pool_queue_head = e;
+	else
+		pool_queue_tail->next = e;
+	pool_queue_tail = e;
+	++pool_queue_len;
+
+	pthread_cond_signal (&pool_cond);
+	pthread_mutex_unlock (&pool_lock);
+
+	c_release (LOG_INFO, &complaint,
+			"perl plugin: Queue is accepting callbacks again.");
+	return 0;
+} /* static int pool_enqueue (c_pool_entry_t *) */
+
+static int pool_enqueue_write (const data_set_t *ds, const value_list_t *vl)
+{
+	c_pool_entry_t *e;
+
+	e = (c_pool_entry_t *)smalloc (sizeof (*e));
+	memset (e, 0, sizeof (*e));
+
+	e->type = PLUGIN_WRITE;
+	e->ds   = ds;
+	e->vl   = *vl;
+
+	e->vl.values = (value_t *)smalloc (vl->values_len * sizeof (value_t));
+	memcpy (e->vl.values, vl->values, vl->values_len * sizeof (value_t));
+
+	e->vl.meta = NULL;
+	if (NULL != vl->meta)
+		e->vl.meta = meta_data_clone (vl->meta);
+
+	return pool_enqueue (e);
+} /* static int pool_enqueue_write (const data_set_t *, const value_list_t *) */
+
+static int pool_enqueue_notif (const notification_t *n)
+{
+	c_pool_entry_t *e;
+
+	e = (c_pool_entry_t *)smalloc (sizeof (*e));
+	memset (e, 0, sizeof (*e));
+
+	e->type = PLUGIN_NOTIF;
+	e->n    = *n;
+
+	e->n.meta = NULL;
+	plugin_notification_meta_copy (&e->n, n);
+
+	return pool_enqueue (e);
+} /* static int pool_enqueue_notif (const notification_t *) */
+
+/* Returns the number of bytes allocated for SV arenas by the interpreter.
+ * Must be called by the thread owning the interpreter. */
+static size_t pool_arena_size (pTHX)
+{
+	SV *sva;
+	size_t size = 0;
+
+	for (sva = PL_sv_arenaroot; NULL != sva; sva = (SV *)SvANY (sva))
+		size += SvREFCNT (sva) * sizeof (SV);
+	return size;
+} /* static size_t pool_arena_size (pTHX) */
+
+static void *pool_worker (void *arg)
+{
+	c_pool_worker_t *w = (c_pool_worker_t *)arg;
+	dTHXa (NULL);
+
+	pthread_mutex_lock (&perl_threads->mutex);
+	w->ithread = c_ithread_create (perl_threads->head->interp);
+	pthread_mutex_unlock (&perl_threads->mutex);
+
+	aTHX = w->ithread->interp;
+	PERL_SET_CONTEXT (aTHX);
+
+	log_debug ("pool_worker: c_ithread: interp = %p", aTHX);
+
+	pthread_mutex_lock (&pool_lock);
+	while (42) {
+		c_pool_entry_t *batch;
+		c_pool_entry_t *e;
+		int num = 0;
+
+		while ((NULL == pool_queue_head) && (! pool_shutdown))
+			pthread_cond_wait (&pool_cond, &pool_lock);
+
+		/* drain the queue before shutting down */
+		if (NULL == pool_queue_head)
+			break;
+
+		/* take up to "WriteBatchSize" entries at once */
+		batch = pool_queue_head;
+		for (e = batch; (NULL != e->next) && (num < pool_batch_size - 1);
+				e = e->next)
+			++num;
+
+		pool_queue_head = e->next;
+		if (NULL == pool_queue_head)
+			pool_queue_tail = NULL;
+		e->next = NULL;
+		pool_queue_len -= num + 1;
+
+		pthread_mutex_unlock (&pool_lock);
+
+		num = 0;
+		while (NULL != batch) {
+			e = batch;
+			batch = batch->next;
+
+			if (PLUGIN_WRITE == e->type)
+				pplugin_call_all (aTHX_ PLUGIN_WRITE, e->ds, &e->vl);
+			else if (PLUGIN_NOTIF == e->type)
+				pplugin_call_all (aTHX_ PLUGIN_NOTIF, &e->n);
+
+			pool_entry_free (e);
+			++num;
+		}
+
+		pthread_mutex_lock (&pool_lock);
+		w->processed  += num;
+		w->sv_count    = (gauge_t)PL_sv_count;
+		w->arena_bytes = (gauge_t)pool_arena_size (aTHX);
+	}
+	pthread_mutex_unlock (&pool_lock);
+
+	/* the interpreter is destroyed by c_ithread_destructor() */
+	return NULL;
+} /* static void *pool_worker (void *) */
+
+static int pool_start (void)
+{
+	int i;
+
+	if ((0 >= pool_size) || (NULL != pool_workers))
+		return 0;
+
+	pool_workers = (c_pool_worker_t *)calloc ((size_t)pool_size,
+			sizeof (*pool_workers));
+	if (NULL == pool_workers) {
+		log_err ("pool_start: calloc failed.");
+		return -1;
+	}
+
+	pool_shutdown = 0;
+	for (i = 0; i < pool_size; ++i) {
+		int status;
+
+		status = pthread_create (&pool_workers[i].thread, /* attr = */ NULL,
+				pool_worker, pool_workers + i);
+		if (0 != status) {
+			char errbuf[1024];
+			log_err ("pool_start: pthread_create failed: %s",
+					sstrerror (status, errbuf, sizeof (errbuf)));
+			break;
+		}
+		++pool_workers_num;
+	}
+
+	if (0 == pool_workers_num) {
+		sfree (pool_workers);
+		return -1;
+	}
+
+	log_info ("Started %i interpreter pool worker%s.", pool_workers_num,
+			(1 == pool_workers_num) ? "" : "s");
+	return 0;
+} /* static int pool_start (void) */
+
+static void pool_stop (void)
+{
+	int i;
+
+	if (NULL == pool_workers)
+		return;
+
+	pthread_mutex_lock (&pool_lock);
+	pool_shutdown = 1;
+	pthread_cond_broadcast (&pool_cond);
+	pthread_mutex_unlock (&pool_lock);
+
+	for (i = 0; i < pool_workers_num; ++i)
+		pthread_join (pool_workers[i].thread, /* retval = */ NULL);
+
+	sfree (pool_workers);
+	pool_workers_num = 0;
+	return;
+} /* static void pool_stop (void) */
+
+static void pool_submit (const char *plugin_instance, const char *type,
+		const char *type_instance, value_t value)
+{
+	value_list_t vl = VALUE_LIST_INIT;
+
+	vl.values = &value;
+	vl.values_len = 1;
+
+	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+	sstrncpy (vl.plugin, "perl", sizeof (vl.plugin));
+	sstrncpy (vl.plugin_instance, plugin_instance,
+			sizeof (vl.plugin_instance));
+	sstrncpy (vl.type, type, sizeof (vl.type));
+	if (NULL != type_instance)
+		sstrncpy (vl.type_instance, type_instance,
+				sizeof (vl.type_instance));
+
+	plugin_dispatch_values (&vl);
+} /* static void pool_submit (const char *, const char *, const char *,
+		value_t) */
+
+/* dispatch queue and per-interpreter statistics */
+static void pool_stats (void)
+{
+	c_pool_worker_t *workers;
+	gauge_t queue_len;
+	derive_t dropped;
+	value_t v;
+	int num;
+	int i;
+
+	if (NULL == pool_workers)
+		return;
+
+	num = pool_workers_num;
+	workers = (c_pool_worker_t *)smalloc (num * sizeof (*workers));
+
+	pthread_mutex_lock (&pool_lock);
+	memcpy (workers, pool_workers, num * sizeof (*workers));
+	queue_len = (gauge_t)pool_queue_len;
+	dropped = pool_dropped;
+	pthread_mutex_unlock (&pool_lock);
+
+	v.gauge = queue_len;
+	pool_submit ("pool", "queue_length", NULL, v);
+	v.derive = dropped;
+	pool_submit ("pool", "derive", "dropped", v);
+
+	for (i = 0; i < num; ++i) {
+		char plugin_instance[DATA_MAX_NAME_LEN];
+
+		ssnprintf (plugin_instance, sizeof (plugin_instance),
+				"interpreter-%i", i);
+
+		v.gauge = workers[i].arena_bytes;
+		pool_submit (plugin_instance, "memory", "sv_arenas", v);
+		v.gauge = workers[i].sv_count;
+		pool_submit (plugin_instance, "records", "sv", v);
+		v.derive = workers[i].processed;
+		pool_submit (plugin_instance, "total_values", "processed", v);
+	}
+
+	sfree (workers);
+} /* static void pool_stats (void) */
+
 /*
  * Filter chains implementation.
  */
@@ -1886,6 +2221,7 @@ static XS (Collectd_call_by_name)
 
 static int perl_init (void)
 {
+	int status;
 	dTHX;
 
 	if (NULL == perl_threads)
@@ -1903,7 +2239,14 @@ static int perl_init (void)
 
 	log_debug ("perl_init: c_ithread: interp = %p (active threads: %i)",
 			aTHX, perl_threads->number_of_threads);
-	return pplugin_call_all (aTHX_ PLUGIN_INIT);
+	status = pplugin_call_all (aTHX_ PLUGIN_INIT);
+
+	/* start the pool after the plugins have been initialized to make sure
+	 * the cloned interpreters see the same state as the other threads */
+	if (0 != pool_start ())
+		log_warn ("Unable to start the interpreter pool - falling back to "
+				"per-thread interpreters.");
+	return status;
 } /* static int perl_init (void) */
 
 static int perl_read (void)
@@ -1930,6 +2273,8 @@ static int perl_read (void)
 
 	log_debug ("perl_read: c_ithread: interp = %p (active threads: %i)",
 			aTHX, perl_threads->number_of_threads);
+
+	pool_stats ();
 	return pplugin_call_all (aTHX_ PLUGIN_READ);
 } /* static int perl_read (void) */
 
@@ -1942,6 +2287,9 @@ static int perl_write (const data_set_t *ds, const value_list_t *vl,
 	if (NULL == perl_threads)
 		return 0;
 
+	if (NULL != pool_workers)
+		return pool_enqueue_write (ds, vl);
+
 	if (NULL == aTHX) {
 		c_ithread_t *t = NULL;
 
@@ -2008,6 +2356,9 @@ static int perl_notify (const notification_t *notif,
 	if (NULL == perl_threads)
 		return 0;
 
+	if (NULL != pool_workers)
+		return pool_enqueue_notif (notif);
+
 	if (NULL == aTHX) {
 		c_ithread_t *t = NULL;
 
@@ -2073,6 +2424,9 @@ static int perl_shutdown (void)
 	plugin_unregister_write ("perl");
 	plugin_unregister_flush ("perl");
 
+	/* process all queued callbacks before shutting down the plugins */
+	pool_stop ();
+
 	ret = pplugin_call_all (aTHX_ PLUGIN_SHUTDOWN);
 
 	pthread_mutex_lock (&perl_threads->mutex);
@@ -2122,19 +2476,23 @@ static int g_pv_set (pTHX_ SV *var, MAGIC *mg)
 	return 0;
 } /* static int g_pv_set (pTHX_ SV *, MAGIC *) */
 
-static int g_iv_get (pTHX_ SV *var, MAGIC *mg)
+/* interval_g is exported in (possibly fractional) seconds. */
+static int g_interval_get (pTHX_ SV *var, MAGIC *mg)
 {
-	int *iv = (int *)mg->mg_ptr;
-	sv_setiv (var, *iv);
+	cdtime_t *interval = (cdtime_t *)mg->mg_ptr;
+	sv_setnv (var, CDTIME_T_TO_DOUBLE (*interval));
 	return 0;
-} /* static int g_iv_get (pTHX_ SV *, MAGIC *) */
+} /* static int g_interval_get (pTHX_ SV *, MAGIC *) */
 
-static int g_iv_set (pTHX_ SV *var, MAGIC *mg)
+static int g_interval_set (pTHX_ SV *var, MAGIC *mg)
 {
-	int *iv = (int *)mg->mg_ptr;
-	*iv = (int)SvIV (var);
+	cdtime_t *interval = (cdtime_t *)mg->mg_ptr;
+	double value = SvNV (var);
+
+	if (value > 0.0)
+		*interval = DOUBLE_TO_CDTIME_T (value);
 	return 0;
-} /* static int g_iv_set (pTHX_ SV *, MAGIC *) */
+} /* static int g_interval_set (pTHX_ SV *, MAGIC *) */
 
 static MGVTBL g_pv_vtbl = {
 	g_pv_get, g_pv_set, NULL, NULL, NULL, NULL, NULL
@@ -2142,8 +2500,8 @@ static MGVTBL g_pv_vtbl = {
 		, NULL
 #endif
 };
-static MGVTBL g_iv_vtbl = {
-	g_iv_get, g_iv_set, NULL, NULL, NULL, NULL, NULL
+static MGVTBL g_interval_vtbl = {
+	g_interval_get, g_interval_set, NULL, NULL, NULL, NULL, NULL
 #if HAVE_PERL_STRUCT_MGVTBL_SVT_LOCAL
 		, NULL
 #endif
@@ -2185,12 +2543,9 @@ static void xs_init (pTHX)
 				g_strings[i].var, 0);
 	}
 
-	/* global integers */
-	for (i = 0; '\0' != g_integers[i].name[0]; ++i) {
-		tmp = get_sv (g_integers[i].name, 1);
-		sv_magicext (tmp, NULL, PERL_MAGIC_ext, &g_iv_vtbl,
-				(char *)g_integers[i].var, 0);
-	}
+	tmp = get_sv ("Collectd::interval_g", 1);
+	sv_magicext (tmp, NULL, PERL_MAGIC_ext, &g_interval_vtbl,
+			(char *)&interval_g, 0);
 	return;
 } /* static void xs_init (pTHX) */
 
@@ -2471,6 +2826,39 @@ static int perl_config_plugin (pTHX_ oconfig_item_t *ci)
 	return ret;
 } /* static int perl_config_plugin (oconfig_item_it *) */
 
+/*
+ * WriteThreads <Num>
+ * WriteQueueLimit <Num>
+ * WriteBatchSize <Num>
+ */
+static int perl_config_pool (oconfig_item_t *ci)
+{
+	int value = 0;
+
+	if (0 != cf_util_get_int (ci, &value))
+		return 1;
+
+	if (0 == strcasecmp (ci->key, "WriteThreads")) {
+		if (0 > value) {
+			log_err ("WriteThreads must not be negative.");
+			return 1;
+		}
+		pool_size = value;
+	}
+	else {
+		if (0 >= value) {
+			log_err ("%s must be a positive integer.", ci->key);
+			return 1;
+		}
+
+		if (0 == strcasecmp (ci->key, "WriteQueueLimit"))
+			pool_queue_limit = value;
+		else
+			pool_batch_size = value;
+	}
+	return 0;
+} /* static int perl_config_pool (oconfig_item_t *) */
+
 static int perl_config (oconfig_item_t *ci)
 {
 	int status = 0;
@@ -2495,6 +2883,10 @@ static int perl_config (oconfig_item_t *ci)
 			current_status = perl_config_includedir (aTHX_ c);
 		else if (0 == strcasecmp (c->key, "Plugin"))
 			current_status = perl_config_plugin (aTHX_ c);
+		else if ((0 == strcasecmp (c->key, "WriteThreads"))
+				|| (0 == strcasecmp (c->key, "WriteQueueLimit"))
+				|| (0 == strcasecmp (c->key, "WriteBatchSize")))
+			current_status = perl_config_pool (c);
 		else
 		{
 			log_warn ("Ignoring unknown config key \"%s\".", c->key);
@@ -27,6 +27,7 @@
 #include "common.h"
 #include "plugin.h"
 #include "configfile.h"
+#include "utils_avltree.h"
 
 #include <pthread.h>
 #include <sys/socket.h>
@@ -54,6 +55,17 @@
 # define PINBA_MAX_SOCKETS 16
 #endif
 
+#ifndef PINBA_MAX_THREADS
+# define PINBA_MAX_THREADS 64
+#endif
+
+/* Fields a view matches on. Views are indexed by the combination of fields
+ * they have set, so there are up to eight indexes. */
+#define PINBA_FIELD_HOST   0x01
+#define PINBA_FIELD_SERVER 0x02
+#define PINBA_FIELD_SCRIPT 0x04
+#define PINBA_FIELDS_NUM   8
+
 /*
  * Private data structures
  */
@@ -73,6 +85,21 @@ struct float_counter_s
 };
 typedef struct float_counter_s float_counter_t;
 
+/* Per-view counters. Each receiver thread has its own set, which are summed
+ * up in the read callback. */
+struct pinba_counters_s
+{
+  derive_t req_count;
+
+  float_counter_t req_time;
+  float_counter_t ru_utime;
+  float_counter_t ru_stime;
+
+  derive_t doc_size;
+  gauge_t mem_peak;
+};
+typedef struct pinba_counters_s pinba_counters_t;
+
 struct pinba_statnode_s
 {
   /* collector name, used as plugin instance */
@@ -82,33 +109,54 @@ struct pinba_statnode_s
   char *host;
   char *server;
   char *script;
+};
+typedef struct pinba_statnode_s pinba_statnode_t;
 
-  derive_t req_count;
+/* Entry of the view index: All views with the same host, server and script
+ * (unused fields are NULL). */
+struct pinba_index_entry_s
+{
+  const char *host;
+  const char *server;
+  const char *script;
 
-  float_counter_t req_time;
-  float_counter_t ru_utime;
-  float_counter_t ru_stime;
+  unsigned int *nodes;
+  size_t nodes_num;
+};
+typedef struct pinba_index_entry_s pinba_index_entry_t;
 
-  derive_t doc_size;
-  gauge_t mem_peak;
+struct pinba_receiver_s
+{
+  pthread_t id;
+  _Bool running;
+
+  /* Protects "counters". Only contended while the read callback collects
+   * the data. */
+  pthread_mutex_t lock;
+  pinba_counters_t *counters;
 };
-typedef struct pinba_statnode_s pinba_statnode_t;
+typedef struct pinba_receiver_s pinba_receiver_t;
 /* }}} */
 
 /*
  * Module global variables
  */
 /* {{{ */
+/* The views are only modified by the config callback, before any receiver
+ * thread has been started. */
 static pinba_statnode_t *stat_nodes = NULL;
 static unsigned int stat_nodes_num = 0;
-static pthread_mutex_t stat_nodes_lock;
+
+/* One tree per combination of set fields, see PINBA_FIELD_*. */
+static c_avl_tree_t *stat_index[PINBA_FIELDS_NUM];
 
 static char *conf_node = NULL;
 static char *conf_service = NULL;
+static int conf_receive_threads = 1;
 
-static _Bool collector_thread_running = 0;
+static pinba_receiver_t *receivers = NULL;
+static int receivers_num = 0;
 static _Bool collector_thread_do_shutdown = 0;
-static pthread_t collector_thread_id;
 /* }}} */
 
 /*
@@ -135,6 +183,20 @@ static void float_counter_add (float_counter_t *fc, float val) /* {{{ */
   }
 } /* }}} void float_counter_add */
 
+static void float_counter_merge (float_counter_t *dst, /* {{{ */
+    const float_counter_t *src)
+{
+  dst->i += src->i;
+  dst->n += src->n;
+
+  if (dst->n >= 1000000000)
+  {
+    dst->i += 1;
+    dst->n -= 1000000000;
+    assert (dst->n < 1000000000);
+  }
+} /* }}} void float_counter_merge */
+
 static derive_t float_counter_get (const float_counter_t *fc, /* {{{ */
     uint64_t factor)
 {
@@ -185,8 +247,6 @@ static void service_statnode_add(const char *name, /* {{{ */
   node->host   = NULL;
   node->server = NULL;
   node->script = NULL;
-
-  node->mem_peak = NAN;
   
   /* fill query data */
   strset (&node->name, name);
@@ -198,38 +258,154 @@ static void service_statnode_add(const char *name, /* {{{ */
   stat_nodes_num++;
 } /* }}} void service_statnode_add */
 
-/* Copy the data from the global "stat_nodes" list into the buffer pointed to
- * by "res", doing the derivation in the process. Returns the next index or
- * zero if the end of the list has been reached. */
-static unsigned int service_statnode_collect (pinba_statnode_t *res, /* {{{ */
-    unsigned int index)
+static int strcmp_null (const char *a, const char *b) /* {{{ */
 {
-  pinba_statnode_t *node;
-  
-  if (stat_nodes_num == 0)
-    return 0;
-  
-  /* begin collecting */
-  if (index == 0)
-    pthread_mutex_lock (&stat_nodes_lock);
-  
-  /* end collecting */
-  if (index >= stat_nodes_num)
+  if ((a == NULL) || (b == NULL))
+    return ((a == NULL) ? ((b == NULL) ? 0 : -1) : 1);
+
+  return (strcmp (a, b));
+} /* }}} int strcmp_null */
+
+static int service_index_compare (const void *a_ptr, /* {{{ */
+    const void *b_ptr)
+{
+  const pinba_index_entry_t *a = a_ptr;
+  const pinba_index_entry_t *b = b_ptr;
+  int status;
+
+  status = strcmp_null (a->host, b->host);
+  if (status == 0)
+    status = strcmp_null (a->server, b->server);
+  if (status == 0)
+    status = strcmp_null (a->script, b->script);
+
+  return (status);
+} /* }}} int service_index_compare */
+
+/* Adds the view with index "node_index" to the view index. */
+static int service_index_add (unsigned int node_index) /* {{{ */
+{
+  pinba_statnode_t *node = stat_nodes + node_index;
+  pinba_index_entry_t *entry = NULL;
+  pinba_index_entry_t key;
+  unsigned int *nodes;
+  int fields = 0;
+
+  memset (&key, 0, sizeof (key));
+  key.host = node->host;
+  key.server = node->server;
+  key.script = node->script;
+
+  if (node->host != NULL)
+    fields |= PINBA_FIELD_HOST;
+  if (node->server != NULL)
+    fields |= PINBA_FIELD_SERVER;
+  if (node->script != NULL)
+    fields |= PINBA_FIELD_SCRIPT;
+
+  if (stat_index[fields] == NULL)
   {
-    pthread_mutex_unlock (&stat_nodes_lock);
-    return 0;
+    stat_index[fields] = c_avl_create (service_index_compare);
+    if (stat_index[fields] == NULL)
+      return (-1);
   }
 
-  node = stat_nodes + index;
-  memcpy (res, node, sizeof (*res));
+  if (c_avl_get (stat_index[fields], &key, (void *) &entry) != 0)
+  {
+    entry = malloc (sizeof (*entry));
+    if (entry == NULL)
+      return (-1);
+    memcpy (entry, &key, sizeof (*entry));
 
-  /* reset node */
-  node->mem_peak = NAN;
-  
-  return (index + 1);
-} /* }}} unsigned int service_statnode_collect */
+    if (c_avl_insert (stat_index[fields], entry, entry) != 0)
+    {
+      sfree (entry);
+      return (-1);
+    }
+  }
+
+  nodes = realloc (entry->nodes, sizeof (*nodes) * (entry->nodes_num + 1));
+  if (nodes == NULL)
+    return (-1);
+  entry->nodes = nodes;
+  entry->nodes[entry->nodes_num] = node_index;
+  entry->nodes_num++;
+
+  return (0);
+} /* }}} int service_index_add */
+
+static void service_index_free (void) /* {{{ */
+{
+  int i;
+
+  for (i = 0; i < PINBA_FIELDS_NUM; i++)
+  {
+    void *key;
+    void *value;
+
+    if (stat_index[i] == NULL)
+      continue;
+
+    while (c_avl_pick (stat_index[i], &key, &value) == 0)
+    {
+      pinba_index_entry_t *entry = value;
+      sfree (entry->nodes);
+      sfree (entry);
+    }
+
+    c_avl_destroy (stat_index[i]);
+    stat_index[i] = NULL;
+  }
+} /* }}} void service_index_free */
+
+static void service_counters_reset (pinba_counters_t *counters, /* {{{ */
+    unsigned int counters_num)
+{
+  unsigned int i;
+
+  memset (counters, 0, sizeof (*counters) * counters_num);
+  for (i = 0; i < counters_num; i++)
+    counters[i].mem_peak = NAN;
+} /* }}} void service_counters_reset */
+
+/* Sums up the counters of all receiver threads and stores the result in
+ * "res", which must have room for "stat_nodes_num" entries. The memory peak
+ * is reset in the process. */
+static void service_statnode_collect (pinba_counters_t *res) /* {{{ */
+{
+  int i;
+  unsigned int j;
+
+  service_counters_reset (res, stat_nodes_num);
+
+  for (i = 0; i < receivers_num; i++)
+  {
+    pinba_receiver_t *r = receivers + i;
 
-static void service_statnode_process (pinba_statnode_t *node, /* {{{ */
+    pthread_mutex_lock (&r->lock);
+    for (j = 0; j < stat_nodes_num; j++)
+    {
+      pinba_counters_t *src = r->counters + j;
+      pinba_counters_t *dst = res + j;
+
+      dst->req_count += src->req_count;
+      float_counter_merge (&dst->req_time, &src->req_time);
+      float_counter_merge (&dst->ru_utime, &src->ru_utime);
+      float_counter_merge (&dst->ru_stime, &src->ru_stime);
+      dst->doc_size += src->doc_size;
+
+      if (!isnan (src->mem_peak)
+          && (isnan (dst->mem_peak) || (dst->mem_peak < src->mem_peak)))
+        dst->mem_peak = src->mem_peak;
+
+      /* reset node */
+      src->mem_peak = NAN;
+    }
+    pthread_mutex_unlock (&r->lock);
+  }
+} /* }}} void service_statnode_collect */
+
+static void service_statnode_process (pinba_counters_t *node, /* {{{ */
     Pinba__Request* request)
 {
   node->req_count++;
@@ -246,30 +422,38 @@ static void service_statnode_process (pinba_statnode_t *node, /* {{{ */
 
 } /* }}} void service_statnode_process */
 
-static void service_process_request (Pinba__Request *request) /* {{{ */
+static void service_process_request (pinba_receiver_t *r, /* {{{ */
+    Pinba__Request *request)
 {
-  unsigned int i;
+  pinba_index_entry_t key;
+  int fields;
+  size_t i;
 
-  pthread_mutex_lock (&stat_nodes_lock);
-  
-  for (i = 0; i < stat_nodes_num; i++)
+  memset (&key, 0, sizeof (key));
+
+  pthread_mutex_lock (&r->lock);
+
+  /* Look up the request in each index, using only the fields the views in
+   * that index match on. */
+  for (fields = 0; fields < PINBA_FIELDS_NUM; fields++)
   {
-    if ((stat_nodes[i].host != NULL)
-        && (strcmp (request->hostname, stat_nodes[i].host) != 0))
-      continue;
+    pinba_index_entry_t *entry = NULL;
 
-    if ((stat_nodes[i].server != NULL)
-      && (strcmp (request->server_name, stat_nodes[i].server) != 0))
+    if (stat_index[fields] == NULL)
       continue;
 
-    if ((stat_nodes[i].script != NULL)
-      && (strcmp (request->script_name, stat_nodes[i].script) != 0))
+    key.host   = (fields & PINBA_FIELD_HOST)   ? request->hostname    : NULL;
+    key.server = (fields & PINBA_FIELD_SERVER) ? request->server_name : NULL;
+    key.script = (fields & PINBA_FIELD_SCRIPT) ? request->script_name : NULL;
+
+    if (c_avl_get (stat_index[fields], &key, (void *) &entry) != 0)
       continue;
 
-    service_statnode_process(&stat_nodes[i], request);
+    for (i = 0; i < entry->nodes_num; i++)
+      service_statnode_process (r->counters + entry->nodes[i], request);
   }
-  
-  pthread_mutex_unlock(&stat_nodes_lock);
+
+  pthread_mutex_unlock (&r->lock);
 } /* }}} void service_process_request */
 
 static int pb_del_socket (pinba_socket_t *s, /* {{{ */
@@ -293,7 +477,7 @@ static int pb_del_socket (pinba_socket_t *s, /* {{{ */
 } /* }}} int pb_del_socket */
 
 static int pb_add_socket (pinba_socket_t *s, /* {{{ */
-    const struct addrinfo *ai)
+    const struct addrinfo *ai, _Bool reuseport)
 {
   int fd;
   int tmp;
@@ -325,6 +509,26 @@ static int pb_add_socket (pinba_socket_t *s, /* {{{ */
         sstrerror (errno, errbuf, sizeof (errbuf)));
   }
 
+#ifdef SO_REUSEPORT
+  /* Let each receiver thread bind its own socket to the same address. The
+   * kernel distributes the packets among them. */
+  if (reuseport)
+  {
+    tmp = 1;
+    status = setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &tmp, sizeof (tmp));
+    if (status != 0)
+    {
+      char errbuf[1024];
+      ERROR ("pinba plugin: setsockopt(SO_REUSEPORT) failed: %s",
+          sstrerror (errno, errbuf, sizeof (errbuf)));
+      close (fd);
+      return (0);
+    }
+  }
+#else
+  assert (!reuseport);
+#endif
+
   status = bind (fd, ai->ai_addr, ai->ai_addrlen);
   if (status != 0)
   {
@@ -343,7 +547,7 @@ static int pb_add_socket (pinba_socket_t *s, /* {{{ */
 } /* }}} int pb_add_socket */
 
 static pinba_socket_t *pinba_socket_open (const char *node, /* {{{ */
-    const char *service)
+    const char *service, _Bool reuseport)
 {
   pinba_socket_t *s;
   struct addrinfo *ai_list;
@@ -387,7 +591,7 @@ static pinba_socket_t *pinba_socket_open (const char *node, /* {{{ */
 
   for (ai_ptr = ai_list; ai_ptr != NULL; ai_ptr = ai_ptr->ai_next)
   {
-    status = pb_add_socket (s, ai_ptr);
+    status = pb_add_socket (s, ai_ptr, reuseport);
     if (status != 0)
       break;
   } /* for (ai_list) */
@@ -422,8 +626,8 @@ static void pinba_socket_free (pinba_socket_t *socket) /* {{{ */
   sfree(socket);
 } /* }}} void pinba_socket_free */
 
-static int pinba_process_stats_packet (const uint8_t *buffer, /* {{{ */
-    size_t buffer_size)
+static int pinba_process_stats_packet (pinba_receiver_t *r, /* {{{ */
+    const uint8_t *buffer, size_t buffer_size)
 {
   Pinba__Request *request;  
   
@@ -432,13 +636,14 @@ static int pinba_process_stats_packet (const uint8_t *buffer, /* {{{ */
   if (!request)
     return (-1);
 
-  service_process_request(request);
+  service_process_request (r, request);
   pinba__request__free_unpacked (request, NULL);
     
   return (0);
 } /* }}} int pinba_process_stats_packet */
 
-static int pinba_udp_read_callback_fn (int sock) /* {{{ */
+static int pinba_udp_read_callback_fn (pinba_receiver_t *r, /* {{{ */
+    int sock)
 {
   uint8_t buffer[PINBA_UDP_BUFFER_SIZE];
   size_t buffer_size;
@@ -476,7 +681,7 @@ static int pinba_udp_read_callback_fn (int sock) /* {{{ */
       buffer_size = (size_t) status;
       buffer[buffer_size] = 0;
 
-      status = pinba_process_stats_packet (buffer, buffer_size);
+      status = pinba_process_stats_packet (r, buffer, buffer_size);
       if (status != 0)
         DEBUG("pinba plugin: Parsing packet failed.");
       return (status);
@@ -488,11 +693,12 @@ static int pinba_udp_read_callback_fn (int sock) /* {{{ */
   return (-1);
 } /* }}} void pinba_udp_read_callback_fn */
 
-static int receive_loop (void) /* {{{ */
+static int receive_loop (pinba_receiver_t *r) /* {{{ */
 {
   pinba_socket_t *s;
 
-  s = pinba_socket_open (conf_node, conf_service);
+  s = pinba_socket_open (conf_node, conf_service,
+      /* reuseport = */ (receivers_num > 1));
   if (s == NULL)
   {
     ERROR ("pinba plugin: Collector thread is exiting prematurely.");
@@ -534,7 +740,7 @@ static int receive_loop (void) /* {{{ */
       }
       else if (s->fd[i].revents & (POLLIN | POLLPRI))
       {
-        pinba_udp_read_callback_fn (s->fd[i].fd);
+        pinba_udp_read_callback_fn (r, s->fd[i].fd);
       }
     } /* for (s->fd) */
   } /* while (!collector_thread_do_shutdown) */
@@ -547,10 +753,11 @@ static int receive_loop (void) /* {{{ */
 
 static void *collector_thread (void *arg) /* {{{ */
 {
-  receive_loop ();
+  pinba_receiver_t *r = arg;
+
+  receive_loop (r);
 
-  memset (&collector_thread_id, 0, sizeof (collector_thread_id));
-  collector_thread_running = 0;
+  r->running = 0;
   pthread_exit (NULL);
   return (NULL);
 } /* }}} void *collector_thread */
@@ -606,10 +813,6 @@ static int plugin_config (oconfig_item_t *ci) /* {{{ */
 {
   int i;
   
-  /* The lock should not be necessary in the config callback, but let's be
-   * sure.. */
-  pthread_mutex_lock (&stat_nodes_lock);
-
   for (i = 0; i < ci->children_num; i++)
   {
     oconfig_item_t *child = ci->children + i;
@@ -620,18 +823,55 @@ static int plugin_config (oconfig_item_t *ci) /* {{{ */
       cf_util_get_string (child, &conf_service);
     else if (strcasecmp ("View", child->key) == 0)
       pinba_config_view (child);
+    else if (strcasecmp ("ReceiveThreads", child->key) == 0)
+    {
+      int tmp = conf_receive_threads;
+
+      if ((cf_util_get_int (child, &tmp) != 0)
+          || (tmp < 1) || (tmp > PINBA_MAX_THREADS))
+        WARNING ("pinba plugin: The \"ReceiveThreads\" option requires "
+            "a number between 1 and %i.", PINBA_MAX_THREADS);
+      else
+        conf_receive_threads = tmp;
+    }
     else
       WARNING ("pinba plugin: Unknown config option: %s", child->key);
   }
 
-  pthread_mutex_unlock(&stat_nodes_lock);
+#ifndef SO_REUSEPORT
+  if (conf_receive_threads > 1)
+  {
+    WARNING ("pinba plugin: Multiple receive threads require SO_REUSEPORT, "
+        "which is not available on this system. Using one thread.");
+    conf_receive_threads = 1;
+  }
+#endif
   
   return (0);
 } /* }}} int pinba_config */
 
+static void receivers_free (void) /* {{{ */
+{
+  int i;
+
+  for (i = 0; i < receivers_num; i++)
+  {
+    sfree (receivers[i].counters);
+    pthread_mutex_destroy (&receivers[i].lock);
+  }
+
+  sfree (receivers);
+  receivers_num = 0;
+} /* }}} void receivers_free */
+
 static int plugin_init (void) /* {{{ */
 {
+  unsigned int j;
   int status;
+  int i;
+
+  if (receivers != NULL)
+    return (0);
 
   if (stat_nodes == NULL)
   {
@@ -642,35 +882,72 @@ static int plugin_init (void) /* {{{ */
         /* script = */ NULL);
   }
 
-  if (collector_thread_running)
-    return (0);
+  for (j = 0; j < stat_nodes_num; j++)
+  {
+    if (service_index_add (j) != 0)
+    {
+      ERROR ("pinba plugin: Building the view index failed.");
+      service_index_free ();
+      return (-1);
+    }
+  }
 
-  status = pthread_create (&collector_thread_id,
-      /* attrs = */ NULL,
-      collector_thread,
-      /* args = */ NULL);
-  if (status != 0)
+  receivers = calloc ((size_t) conf_receive_threads, sizeof (*receivers));
+  if (receivers == NULL)
   {
-    char errbuf[1024];
-    ERROR ("pinba plugin: pthread_create(3) failed: %s",
-        sstrerror (errno, errbuf, sizeof (errbuf)));
+    ERROR ("pinba plugin: calloc failed.");
     return (-1);
   }
-  collector_thread_running = 1;
+  receivers_num = conf_receive_threads;
+
+  for (i = 0; i < receivers_num; i++)
+  {
+    pthread_mutex_init (&receivers[i].lock, /* attr = */ NULL);
+    receivers[i].counters = calloc (stat_nodes_num,
+        sizeof (*receivers[i].counters));
+    if (receivers[i].counters == NULL)
+    {
+      ERROR ("pinba plugin: calloc failed.");
+      receivers_free ();
+      return (-1);
+    }
+    service_counters_reset (receivers[i].counters, stat_nodes_num);
+  }
+
+  for (i = 0; i < receivers_num; i++)
+  {
+    status = pthread_create (&receivers[i].id,
+        /* attrs = */ NULL,
+        collector_thread,
+        /* args = */ receivers + i);
+    if (status != 0)
+    {
+      char errbuf[1024];
+      ERROR ("pinba plugin: pthread_create(3) failed: %s",
+          sstrerror (errno, errbuf, sizeof (errbuf)));
+      return (-1);
+    }
+    receivers[i].running = 1;
+  }
 
   return (0);
 } /* }}} */
 
 static int plugin_shutdown (void) /* {{{ */
 {
-  if (collector_thread_running)
+  int i;
+
+  DEBUG ("pinba plugin: Shutting down collector threads.");
+  collector_thread_do_shutdown = 1;
+
+  for (i = 0; i < receivers_num; i++)
   {
     int status;
 
-    DEBUG ("pinba plugin: Shutting down collector thread.");
-    collector_thread_do_shutdown = 1;
+    if (!receivers[i].running)
+      continue;
 
-    status = pthread_join (collector_thread_id, /* retval = */ NULL);
+    status = pthread_join (receivers[i].id, /* retval = */ NULL);
     if (status != 0)
     {
       char errbuf[1024];
@@ -678,14 +955,18 @@ static int plugin_shutdown (void) /* {{{ */
           sstrerror (status, errbuf, sizeof (errbuf)));
     }
 
-    collector_thread_running = 0;
-    collector_thread_do_shutdown = 0;
-  } /* if (collector_thread_running) */
+    receivers[i].running = 0;
+  }
+
+  receivers_free ();
+  service_index_free ();
+  collector_thread_do_shutdown = 0;
 
   return (0);
 } /* }}} int plugin_shutdown */
 
-static int plugin_submit (const pinba_statnode_t *res) /* {{{ */
+static int plugin_submit (const pinba_statnode_t *node, /* {{{ */
+    const pinba_counters_t *res)
 {
   value_t value;
   value_list_t vl = VALUE_LIST_INIT;
@@ -694,7 +975,7 @@ static int plugin_submit (const pinba_statnode_t *res) /* {{{ */
   vl.values_len = 1;
   sstrncpy (vl.host, hostname_g, sizeof (vl.host));
   sstrncpy (vl.plugin, "pinba", sizeof (vl.plugin));
-  sstrncpy (vl.plugin_instance, res->name, sizeof (vl.plugin_instance));
+  sstrncpy (vl.plugin_instance, node->name, sizeof (vl.plugin_instance));
 
   value.derive = res->req_count;
   sstrncpy (vl.type, "total_requests", sizeof (vl.type)); 
@@ -728,14 +1009,25 @@ static int plugin_submit (const pinba_statnode_t *res) /* {{{ */
 
 static int plugin_read (void) /* {{{ */
 {
-  unsigned int i=0;
-  pinba_statnode_t data;
-  
-  while ((i = service_statnode_collect (&data, i)) != 0)
+  pinba_counters_t *data;
+  unsigned int i;
+
+  if ((receivers_num < 1) || (stat_nodes_num < 1))
+    return (0);
+
+  data = calloc (stat_nodes_num, sizeof (*data));
+  if (data == NULL)
   {
-    plugin_submit (&data);
+    ERROR ("pinba plugin: calloc failed.");
+    return (-1);
   }
-  
+
+  service_statnode_collect (data);
+
+  for (i = 0; i < stat_nodes_num; i++)
+    plugin_submit (stat_nodes + i, data + i);
+
+  sfree (data);
   return 0;
 } /* }}} int plugin_read */
 
@@ -62,12 +62,96 @@ struct read_func_s
 	char rf_group[DATA_MAX_NAME_LEN];
 	char rf_name[DATA_MAX_NAME_LEN];
 	int rf_type;
-	struct timespec rf_interval;
-	struct timespec rf_effective_interval;
-	struct timespec rf_next_read;
+	cdtime_t rf_interval;
+	cdtime_t rf_effective_interval;
+	cdtime_t rf_next_read;
 };
 typedef struct read_func_s read_func_t;
 
+/* Once the daemon is running, log messages are passed to the log callbacks
+ * by a separate thread, so that threads which log a lot don't wait for slow
+ * log targets. Messages are dropped when the queue is full. */
+#define LOG_QUEUE_SIZE 256
+
+/* Each call site, identified by its format string, may log at most
+ * LOG_RATELIMIT_BURST messages within LOG_RATELIMIT_INTERVAL seconds. The
+ * number of messages suppressed beyond that is logged afterwards. */
+#define LOG_RATELIMIT_SLOTS    256
+#define LOG_RATELIMIT_INTERVAL 10
+#define LOG_RATELIMIT_BURST    20
+
+struct log_msg_s
+{
+	int level;
+	char msg[1024];
+};
+typedef struct log_msg_s log_msg_t;
+
+struct log_ratelimit_s
+{
+	const char *format;
+	int level;
+	time_t window_start;
+	unsigned int count;
+	unsigned int suppressed;
+};
+typedef struct log_ratelimit_s log_ratelimit_t;
+
+/* Notifications are passed to each notification callback by a thread of its
+ * own, so that slow callbacks (exec, notify_email, ...) don't block the
+ * threads dispatching notifications. Each callback has a bounded queue.
+ * Notifications which are identical to the last notification queued for
+ * the same identifier are dropped while that notification is still queued
+ * or has been queued within the last `NotificationCoalesceInterval'
+ * seconds. */
+#define NOTIF_RECENT_SLOTS 256
+
+struct notif_entry_s;
+typedef struct notif_entry_s notif_entry_t;
+struct notif_entry_s
+{
+	notification_t n;
+	struct timeval queued;
+	notif_entry_t *next;
+};
+
+struct notif_recent_s
+{
+	uint64_t id_hash;
+	uint64_t hash;
+	time_t time;
+	notif_entry_t *queued;
+};
+typedef struct notif_recent_s notif_recent_t;
+
+struct notif_handler_s;
+typedef struct notif_handler_s notif_handler_t;
+struct notif_handler_s
+{
+	char *name;
+	callback_func_t *cf;
+
+	notif_entry_t *head;
+	notif_entry_t *tail;
+	int queue_length;
+	notif_recent_t recent[NOTIF_RECENT_SLOTS];
+	c_complain_t complaint;
+
+	_Bool loop;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	/* Statistics, protected by `lock', too. */
+	uint64_t delivered;
+	uint64_t coalesced;
+	uint64_t dropped;
+	double latency_sum;
+	uint64_t latency_num;
+
+	notif_handler_t *next;
+};
+
 /*
  * Private variables
  */
@@ -93,6 +177,25 @@ static pthread_cond_t  read_cond = PTHREAD_COND_INITIALIZER;
 static pthread_t      *read_threads = NULL;
 static int             read_threads_num = 0;
 
+/* All of the following is protected by `log_lock'. */
+static log_msg_t        log_queue[LOG_QUEUE_SIZE];
+static size_t           log_queue_head = 0;
+static size_t           log_queue_num = 0;
+static uint64_t         log_queue_dropped = 0;
+static log_ratelimit_t  log_ratelimit[LOG_RATELIMIT_SLOTS];
+static int              log_loop = 0;
+static int              log_thread_running = 0;
+static pthread_t        log_thread_id;
+static pthread_mutex_t  log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   log_cond = PTHREAD_COND_INITIALIZER;
+
+/* The list of handlers is protected by `notif_handlers_lock'. Handlers are
+ * only removed with the write lock held and freed after it is released. */
+static notif_handler_t *notif_handlers = NULL;
+static pthread_rwlock_t notif_handlers_lock = PTHREAD_RWLOCK_INITIALIZER;
+static int              notif_queue_limit = 0;
+static int              notif_coalesce_interval = 0;
+
 /*
  * Static functions
  */
@@ -334,11 +437,9 @@ static int plugin_load_file (char *file, uint32_t flags)
 	return (0);
 }
 
-static _Bool timeout_reached(struct timespec timeout)
+static _Bool timeout_reached (cdtime_t timeout)
 {
-	struct timeval now;
-	gettimeofday(&now, NULL);
-	return (now.tv_sec >= timeout.tv_sec && now.tv_usec >= (timeout.tv_nsec / 1000));
+	return (cdtime () >= timeout);
 }
 
 static void *plugin_read_thread (void __attribute__((unused)) *args)
@@ -346,7 +447,8 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 	while (read_loop != 0)
 	{
 		read_func_t *rf;
-		struct timeval now;
+		struct timespec abstime;
+		cdtime_t now;
 		int status;
 		int rf_type;
 		int rc;
@@ -355,12 +457,7 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 		rf = c_heap_get_root (read_heap);
 		if (rf == NULL)
 		{
-			struct timespec abstime;
-
-			gettimeofday (&now, /* timezone = */ NULL);
-
-			abstime.tv_sec = now.tv_sec + interval_g;
-			abstime.tv_nsec = 1000 * now.tv_usec;
+			CDTIME_T_TO_TIMESPEC (cdtime () + interval_g, &abstime);
 
 			pthread_mutex_lock (&read_lock);
 			pthread_cond_timedwait (&read_cond, &read_lock,
@@ -369,17 +466,11 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 			continue;
 		}
 
-		if ((rf->rf_interval.tv_sec == 0) && (rf->rf_interval.tv_nsec == 0))
+		if (rf->rf_interval == 0)
 		{
-			gettimeofday (&now, /* timezone = */ NULL);
-
-			rf->rf_interval.tv_sec = interval_g;
-			rf->rf_interval.tv_nsec = 0;
-
+			rf->rf_interval = interval_g;
 			rf->rf_effective_interval = rf->rf_interval;
-
-			rf->rf_next_read.tv_sec = now.tv_sec;
-			rf->rf_next_read.tv_nsec = 1000 * now.tv_usec;
+			rf->rf_next_read = cdtime ();
 		}
 
 		/* sleep until this entry is due,
@@ -389,13 +480,14 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 		 * (and really happen, at least on NetBSD with > 1 CPU), thus
 		 * we need to re-evaluate the condition every time
 		 * pthread_cond_timedwait returns. */
+		CDTIME_T_TO_TIMESPEC (rf->rf_next_read, &abstime);
 		rc = 0;
 		while ((read_loop != 0)
-				&& !timeout_reached(rf->rf_next_read)
+				&& !timeout_reached (rf->rf_next_read)
 				&& rc == 0)
 		{
 			rc = pthread_cond_timedwait (&read_cond, &read_lock,
-				&rf->rf_next_read);
+				&abstime);
 		}
 
 		/* Must hold `read_lock' when accessing `rf->rf_type'. */
@@ -447,20 +539,14 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 		 * intervals in which it will be called. */
 		if (status != 0)
 		{
-			rf->rf_effective_interval.tv_sec *= 2;
-			rf->rf_effective_interval.tv_nsec *= 2;
-			NORMALIZE_TIMESPEC (rf->rf_effective_interval);
-
-			if (rf->rf_effective_interval.tv_sec >= 86400)
-			{
-				rf->rf_effective_interval.tv_sec = 86400;
-				rf->rf_effective_interval.tv_nsec = 0;
-			}
+			rf->rf_effective_interval *= 2;
+			if (rf->rf_effective_interval >= TIME_T_TO_CDTIME_T (86400))
+				rf->rf_effective_interval = TIME_T_TO_CDTIME_T (86400);
 
 			NOTICE ("read-function of plugin `%s' failed. "
-					"Will suspend it for %i seconds.",
+					"Will suspend it for %.3f seconds.",
 					rf->rf_name,
-					(int) rf->rf_effective_interval.tv_sec);
+					CDTIME_T_TO_DOUBLE (rf->rf_effective_interval));
 		}
 		else
 		{
@@ -469,38 +555,29 @@ static void *plugin_read_thread (void __attribute__((unused)) *args)
 		}
 
 		/* update the ``next read due'' field */
-		gettimeofday (&now, /* timezone = */ NULL);
+		now = cdtime ();
 
 		DEBUG ("plugin_read_thread: Effective interval of the "
-				"%s plugin is %i.%09i.",
+				"%s plugin is %.3f.",
 				rf->rf_name,
-				(int) rf->rf_effective_interval.tv_sec,
-				(int) rf->rf_effective_interval.tv_nsec);
+				CDTIME_T_TO_DOUBLE (rf->rf_effective_interval));
 
 		/* Calculate the next (absolute) time at which this function
 		 * should be called. */
-		rf->rf_next_read.tv_sec = rf->rf_next_read.tv_sec
-			+ rf->rf_effective_interval.tv_sec;
-		rf->rf_next_read.tv_nsec = rf->rf_next_read.tv_nsec
-			+ rf->rf_effective_interval.tv_nsec;
-		NORMALIZE_TIMESPEC (rf->rf_next_read);
+		rf->rf_next_read += rf->rf_effective_interval;
 
 		/* Check, if `rf_next_read' is in the past. */
-		if ((rf->rf_next_read.tv_sec < now.tv_sec)
-				|| ((rf->rf_next_read.tv_sec == now.tv_sec)
-					&& (rf->rf_next_read.tv_nsec < (1000 * now.tv_usec))))
+		if (rf->rf_next_read < now)
 		{
 			/* `rf_next_read' is in the past. Insert `now'
 			 * so this value doesn't trail off into the
 			 * past too much. */
-			rf->rf_next_read.tv_sec = now.tv_sec;
-			rf->rf_next_read.tv_nsec = 1000 * now.tv_usec;
+			rf->rf_next_read = now;
 		}
 
-		DEBUG ("plugin_read_thread: Next read of the %s plugin at %i.%09i.",
+		DEBUG ("plugin_read_thread: Next read of the %s plugin at %.3f.",
 				rf->rf_name,
-				(int) rf->rf_next_read.tv_sec,
-				(int) rf->rf_next_read.tv_nsec);
+				CDTIME_T_TO_DOUBLE (rf->rf_next_read));
 
 		/* Re-insert this read function into the heap again. */
 		c_heap_insert (read_heap, rf);
@@ -700,13 +777,9 @@ static int plugin_compare_read_func (const void *arg0, const void *arg1)
 	rf0 = arg0;
 	rf1 = arg1;
 
-	if (rf0->rf_next_read.tv_sec < rf1->rf_next_read.tv_sec)
+	if (rf0->rf_next_read < rf1->rf_next_read)
 		return (-1);
-	else if (rf0->rf_next_read.tv_sec > rf1->rf_next_read.tv_sec)
-		return (1);
-	else if (rf0->rf_next_read.tv_nsec < rf1->rf_next_read.tv_nsec)
-		return (-1);
-	else if (rf0->rf_next_read.tv_nsec > rf1->rf_next_read.tv_nsec)
+	else if (rf0->rf_next_read > rf1->rf_next_read)
 		return (1);
 	else
 		return (0);
@@ -789,8 +862,7 @@ int plugin_register_read (const char *name,
 	rf->rf_group[0] = '\0';
 	sstrncpy (rf->rf_name, name, sizeof (rf->rf_name));
 	rf->rf_type = RF_SIMPLE;
-	rf->rf_interval.tv_sec = 0;
-	rf->rf_interval.tv_nsec = 0;
+	rf->rf_interval = 0;
 	rf->rf_effective_interval = rf->rf_interval;
 
 	return (plugin_insert_read (rf));
@@ -820,7 +892,7 @@ int plugin_register_complex_read (const char *group, const char *name,
 	rf->rf_type = RF_COMPLEX;
 	if (interval != NULL)
 	{
-		rf->rf_interval = *interval;
+		rf->rf_interval = TIMESPEC_TO_CDTIME_T (interval);
 	}
 	rf->rf_effective_interval = rf->rf_interval;
 
@@ -1059,6 +1131,602 @@ int plugin_unregister_data_set (const char *name)
 	return (0);
 } /* int plugin_unregister_data_set */
 
+/* Passes a message to all log callbacks. */
+static void log_deliver (int level, const char *msg) /* {{{ */
+{
+	llentry_t *le;
+
+	if (list_log == NULL)
+	{
+		fprintf (stderr, "%s\n", msg);
+		return;
+	}
+
+	le = llist_head (list_log);
+	while (le != NULL)
+	{
+		callback_func_t *cf;
+		plugin_log_cb callback;
+
+		cf = le->value;
+		callback = cf->cf_callback;
+
+		(*callback) (level, msg, &cf->cf_udata);
+
+		le = le->next;
+	}
+} /* }}} void log_deliver */
+
+/* Appends a message to the log queue. The caller must hold `log_lock'. */
+static void log_queue_push (int level, const char *msg) /* {{{ */
+{
+	log_msg_t *lm;
+	size_t len;
+
+	if (log_queue_num >= LOG_QUEUE_SIZE)
+	{
+		log_queue_dropped++;
+		return;
+	}
+
+	lm = log_queue + ((log_queue_head + log_queue_num) % LOG_QUEUE_SIZE);
+	lm->level = level;
+
+	len = strlen (msg);
+	if (len >= sizeof (lm->msg))
+		len = sizeof (lm->msg) - 1;
+	memcpy (lm->msg, msg, len);
+	lm->msg[len] = 0;
+
+	log_queue_num++;
+	pthread_cond_signal (&log_cond);
+} /* }}} void log_queue_push */
+
+/* Logs how many messages of a call site have been suppressed and starts a
+ * new interval. The caller must hold `log_lock'. */
+static void log_ratelimit_reset (log_ratelimit_t *rl, time_t now) /* {{{ */
+{
+	if (rl->suppressed > 0)
+	{
+		char msg[1024];
+
+		ssnprintf (msg, sizeof (msg), "plugin_log: Suppressed %u messages "
+				"like \"%s\" during the last %i seconds.",
+				rl->suppressed, rl->format,
+				(int) (now - rl->window_start));
+		log_queue_push (rl->level, msg);
+	}
+
+	rl->window_start = now;
+	rl->count = 0;
+	rl->suppressed = 0;
+} /* }}} void log_ratelimit_reset */
+
+/* Returns true if a message from the call site using `format' may be logged.
+ * The caller must hold `log_lock'. */
+static _Bool log_ratelimit_check (int level, const char *format, /* {{{ */
+		time_t now)
+{
+	log_ratelimit_t *rl;
+
+	/* Format strings are literals, so the address identifies the call
+	 * site. */
+	rl = log_ratelimit + ((((uintptr_t) format) >> 3) % LOG_RATELIMIT_SLOTS);
+
+	if (rl->format != format)
+	{
+		/* The slot is used by another call site which is still
+		 * being limited. Don't limit this one. */
+		if ((rl->format != NULL) && ((rl->suppressed > 0)
+					|| ((now - rl->window_start) < LOG_RATELIMIT_INTERVAL)))
+			return (1);
+
+		rl->format = format;
+		rl->level = level;
+		rl->window_start = now;
+		rl->count = 0;
+		rl->suppressed = 0;
+	}
+	else if ((now - rl->window_start) >= LOG_RATELIMIT_INTERVAL)
+	{
+		log_ratelimit_reset (rl, now);
+	}
+
+	rl->count++;
+	if (rl->count <= LOG_RATELIMIT_BURST)
+		return (1);
+
+	rl->suppressed++;
+	return (0);
+} /* }}} _Bool log_ratelimit_check */
+
+/* Logs the summaries of call sites whose interval has passed. If `force' is
+ * true, all pending summaries are logged. The caller must hold `log_lock'. */
+static void log_ratelimit_flush (time_t now, _Bool force) /* {{{ */
+{
+	size_t i;
+
+	for (i = 0; i < LOG_RATELIMIT_SLOTS; i++)
+	{
+		log_ratelimit_t *rl = log_ratelimit + i;
+
+		if (rl->suppressed == 0)
+			continue;
+
+		if (force || ((now - rl->window_start) >= LOG_RATELIMIT_INTERVAL))
+			log_ratelimit_reset (rl, now);
+	}
+} /* }}} void log_ratelimit_flush */
+
+static void *log_thread (void __attribute__((unused)) *arg) /* {{{ */
+{
+	pthread_mutex_lock (&log_lock);
+	while (42)
+	{
+		log_msg_t lm;
+
+		while ((log_loop != 0) && (log_queue_num == 0)
+				&& (log_queue_dropped == 0))
+		{
+			struct timespec abstime;
+
+			abstime.tv_sec = time (NULL) + 1;
+			abstime.tv_nsec = 0;
+			if (pthread_cond_timedwait (&log_cond, &log_lock,
+						&abstime) == ETIMEDOUT)
+				log_ratelimit_flush (time (NULL), /* force = */ 0);
+		}
+
+		if (log_loop == 0)
+			log_ratelimit_flush (time (NULL), /* force = */ 1);
+
+		if (log_queue_dropped > 0)
+		{
+			lm.level = LOG_WARNING;
+			ssnprintf (lm.msg, sizeof (lm.msg), "plugin_log: %"PRIu64
+					" messages have been dropped because the "
+					"log queue was full.", log_queue_dropped);
+			log_queue_dropped = 0;
+		}
+		else if (log_queue_num > 0)
+		{
+			memcpy (&lm, log_queue + log_queue_head, sizeof (lm));
+			log_queue_head = (log_queue_head + 1) % LOG_QUEUE_SIZE;
+			log_queue_num--;
+		}
+		else /* if (log_loop == 0) */
+		{
+			break;
+		}
+
+		pthread_mutex_unlock (&log_lock);
+		log_deliver (lm.level, lm.msg);
+		pthread_mutex_lock (&log_lock);
+	}
+	log_thread_running = 0;
+	pthread_mutex_unlock (&log_lock);
+
+	return ((void *) 0);
+} /* }}} void *log_thread */
+
+static void start_log_thread (void) /* {{{ */
+{
+	pthread_mutex_lock (&log_lock);
+
+	if (log_thread_running != 0)
+	{
+		pthread_mutex_unlock (&log_lock);
+		return;
+	}
+
+	log_loop = 1;
+	if (pthread_create (&log_thread_id, /* attr = */ NULL, log_thread,
+				/* arg = */ NULL) != 0)
+	{
+		log_loop = 0;
+		pthread_mutex_unlock (&log_lock);
+		ERROR ("plugin: start_log_thread: pthread_create failed.");
+		return;
+	}
+	log_thread_running = 1;
+
+	pthread_mutex_unlock (&log_lock);
+} /* }}} void start_log_thread */
+
+/* Logs all queued messages and stops the log thread. Messages logged
+ * afterwards are passed to the log callbacks directly. */
+static void stop_log_thread (void) /* {{{ */
+{
+	pthread_mutex_lock (&log_lock);
+	if (log_thread_running == 0)
+	{
+		pthread_mutex_unlock (&log_lock);
+		return;
+	}
+	log_loop = 0;
+	pthread_cond_broadcast (&log_cond);
+	pthread_mutex_unlock (&log_lock);
+
+	pthread_join (log_thread_id, /* retval = */ NULL);
+} /* }}} void stop_log_thread */
+
+static uint64_t notif_hash_string (uint64_t hash, const char *str) /* {{{ */
+{
+	/* FNV-1a, including the terminating null byte. */
+	do
+	{
+		hash ^= (uint64_t) ((unsigned char) *str);
+		hash *= 0x100000001b3ULL;
+	} while (*(str++) != 0);
+
+	return (hash);
+} /* }}} uint64_t notif_hash_string */
+
+/* Returns a hash of the identifier of `n' in `*id_hash' and a hash of the
+ * identifier, severity and message in `*hash'. The time and the meta data
+ * are ignored. */
+static void notif_hash (const notification_t *n, /* {{{ */
+		uint64_t *id_hash, uint64_t *hash)
+{
+	char severity[16];
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	h = notif_hash_string (h, n->host);
+	h = notif_hash_string (h, n->plugin);
+	h = notif_hash_string (h, n->plugin_instance);
+	h = notif_hash_string (h, n->type);
+	h = notif_hash_string (h, n->type_instance);
+	*id_hash = h;
+
+	ssnprintf (severity, sizeof (severity), "%i", n->severity);
+	h = notif_hash_string (h, severity);
+	h = notif_hash_string (h, n->message);
+	*hash = h;
+} /* }}} void notif_hash */
+
+static void notif_entry_free (notif_entry_t *ne) /* {{{ */
+{
+	if (ne->n.meta != NULL)
+		plugin_notification_meta_free (ne->n.meta);
+	sfree (ne);
+} /* }}} void notif_entry_free */
+
+/* Appends a copy of `n' to the queue of `nh'. Returns zero if the
+ * notification has been queued or coalesced and non-zero if it has been
+ * dropped. */
+static int notif_enqueue (notif_handler_t *nh, /* {{{ */
+		const notification_t *n)
+{
+	notif_entry_t *ne;
+	notif_recent_t *nr;
+	uint64_t id_hash;
+	uint64_t hash;
+	time_t now;
+
+	notif_hash (n, &id_hash, &hash);
+	now = time (NULL);
+	nr = nh->recent + (id_hash % NOTIF_RECENT_SLOTS);
+
+	/* Copy the notification before taking the lock, so that the checks
+	 * and the append happen in one critical section. */
+	ne = (notif_entry_t *) malloc (sizeof (*ne));
+	if (ne == NULL)
+	{
+		ERROR ("plugin_dispatch_notification: malloc failed.");
+		return (-1);
+	}
+	memcpy (&ne->n, n, sizeof (ne->n));
+	ne->n.meta = NULL;
+	plugin_notification_meta_copy (&ne->n, n);
+	gettimeofday (&ne->queued, /* timezone = */ NULL);
+	ne->next = NULL;
+
+	pthread_mutex_lock (&nh->lock);
+
+	if ((nr->id_hash == id_hash) && (nr->hash == hash)
+			&& ((nr->queued != NULL)
+				|| ((now - nr->time) < notif_coalesce_interval)))
+	{
+		nh->coalesced++;
+		pthread_mutex_unlock (&nh->lock);
+		notif_entry_free (ne);
+		return (0);
+	}
+
+	if (nh->queue_length >= notif_queue_limit)
+	{
+		nh->dropped++;
+		pthread_mutex_unlock (&nh->lock);
+		notif_entry_free (ne);
+		c_complain (LOG_WARNING, &nh->complaint,
+				"plugin_dispatch_notification: The queue of the "
+				"notification callback %s is full. Dropping "
+				"notifications.", nh->name);
+		return (-1);
+	}
+
+	if (nh->tail == NULL)
+		nh->head = ne;
+	else
+		nh->tail->next = ne;
+	nh->tail = ne;
+	nh->queue_length++;
+
+	nr->id_hash = id_hash;
+	nr->hash = hash;
+	nr->time = now;
+	nr->queued = ne;
+
+	pthread_cond_signal (&nh->cond);
+	pthread_mutex_unlock (&nh->lock);
+
+	return (0);
+} /* }}} int notif_enqueue */
+
+static void *notif_thread (void *arg) /* {{{ */
+{
+	notif_handler_t *nh = arg;
+
+	pthread_mutex_lock (&nh->lock);
+	while (42)
+	{
+		notif_entry_t *ne;
+		plugin_notification_cb callback;
+		struct timeval now;
+		size_t i;
+		int status;
+
+		while (nh->loop && (nh->head == NULL))
+			pthread_cond_wait (&nh->cond, &nh->lock);
+
+		/* Work off the queue before exiting. */
+		if (nh->head == NULL)
+			break;
+
+		ne = nh->head;
+		nh->head = ne->next;
+		if (nh->head == NULL)
+			nh->tail = NULL;
+		nh->queue_length--;
+
+		if (nh->head == NULL)
+			c_release (LOG_INFO, &nh->complaint,
+					"plugin_dispatch_notification: The queue "
+					"of the notification callback %s is "
+					"empty again.", nh->name);
+
+		for (i = 0; i < NOTIF_RECENT_SLOTS; i++)
+			if (nh->recent[i].queued == ne)
+				nh->recent[i].queued = NULL;
+
+		gettimeofday (&now, /* timezone = */ NULL);
+		nh->latency_sum += (double) (now.tv_sec - ne->queued.tv_sec)
+			+ ((double) (now.tv_usec - ne->queued.tv_usec)) / 1000000.0;
+		nh->latency_num++;
+		pthread_mutex_unlock (&nh->lock);
+
+		callback = nh->cf->cf_callback;
+		status = (*callback) (&ne->n, &nh->cf->cf_udata);
+		if (status != 0)
+		{
+			WARNING ("plugin_dispatch_notification: Notification "
+					"callback %s returned %i.",
+					nh->name, status);
+		}
+
+		notif_entry_free (ne);
+
+		pthread_mutex_lock (&nh->lock);
+		nh->delivered++;
+	}
+	pthread_mutex_unlock (&nh->lock);
+
+	return ((void *) 0);
+} /* }}} void *notif_thread */
+
+static void notif_submit (const char *plugin_instance, /* {{{ */
+		const char *type, const char *type_instance, value_t value)
+{
+	value_list_t vl = VALUE_LIST_INIT;
+
+	vl.values = &value;
+	vl.values_len = 1;
+	sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+	sstrncpy (vl.plugin, "notification", sizeof (vl.plugin));
+	sstrncpy (vl.plugin_instance, plugin_instance,
+			sizeof (vl.plugin_instance));
+	sstrncpy (vl.type, type, sizeof (vl.type));
+	if (type_instance != NULL)
+		sstrncpy (vl.type_instance, type_instance,
+				sizeof (vl.type_instance));
+
+	plugin_dispatch_values (&vl);
+} /* }}} void notif_submit */
+
+/* Reports queue length, queueing latency and the number of delivered,
+ * coalesced and dropped notifications of each notification callback. */
+static int notif_read (void) /* {{{ */
+{
+	size_t i;
+
+	/* The values are dispatched without holding `notif_handlers_lock',
+	 * because write callbacks may dispatch notifications. */
+	for (i = 0; ; i++)
+	{
+		notif_handler_t *nh;
+		char name[DATA_MAX_NAME_LEN];
+		value_t queue_length;
+		value_t latency;
+		value_t delivered;
+		value_t coalesced;
+		value_t dropped;
+		size_t j;
+
+		pthread_rwlock_rdlock (&notif_handlers_lock);
+		nh = notif_handlers;
+		for (j = 0; (nh != NULL) && (j < i); j++)
+			nh = nh->next;
+		if (nh == NULL)
+		{
+			pthread_rwlock_unlock (&notif_handlers_lock);
+			break;
+		}
+
+		sstrncpy (name, nh->name, sizeof (name));
+		pthread_mutex_lock (&nh->lock);
+		queue_length.gauge = (gauge_t) nh->queue_length;
+		if (nh->latency_num > 0)
+			latency.gauge = nh->latency_sum
+				/ ((gauge_t) nh->latency_num);
+		else
+			latency.gauge = NAN;
+		nh->latency_sum = 0.0;
+		nh->latency_num = 0;
+		delivered.derive = (derive_t) nh->delivered;
+		coalesced.derive = (derive_t) nh->coalesced;
+		dropped.derive = (derive_t) nh->dropped;
+		pthread_mutex_unlock (&nh->lock);
+		pthread_rwlock_unlock (&notif_handlers_lock);
+
+		notif_submit (name, "queue_length", NULL, queue_length);
+		notif_submit (name, "delay", NULL, latency);
+		notif_submit (name, "derive", "delivered", delivered);
+		notif_submit (name, "derive", "coalesced", coalesced);
+		notif_submit (name, "derive", "dropped", dropped);
+	}
+
+	return (0);
+} /* }}} int notif_read */
+
+/* Stops the thread of `nh' after it has worked off its queue and frees
+ * `nh'. */
+static void notif_handler_destroy (notif_handler_t *nh) /* {{{ */
+{
+	if (nh == NULL)
+		return;
+
+	pthread_mutex_lock (&nh->lock);
+	nh->loop = 0;
+	pthread_cond_broadcast (&nh->cond);
+	pthread_mutex_unlock (&nh->lock);
+
+	pthread_join (nh->thread, /* retval = */ NULL);
+
+	pthread_mutex_destroy (&nh->lock);
+	pthread_cond_destroy (&nh->cond);
+	sfree (nh->name);
+	sfree (nh);
+} /* }}} void notif_handler_destroy */
+
+/* Starts one thread for each registered notification callback. Callbacks
+ * registered afterwards are called synchronously. */
+static void start_notification_threads (void) /* {{{ */
+{
+	notif_handler_t *handlers = NULL;
+	const char *str;
+	llentry_t *le;
+
+	if ((notif_handlers != NULL) || (list_notification == NULL))
+		return;
+
+	str = global_option_get ("NotificationQueueLength");
+	notif_queue_limit = (str != NULL) ? atoi (str) : 0;
+	if (notif_queue_limit <= 0)
+		return;
+
+	str = global_option_get ("NotificationCoalesceInterval");
+	notif_coalesce_interval = (str != NULL) ? atoi (str) : 0;
+
+	for (le = llist_head (list_notification); le != NULL; le = le->next)
+	{
+		notif_handler_t *nh;
+		int status;
+
+		nh = (notif_handler_t *) malloc (sizeof (*nh));
+		if (nh == NULL)
+		{
+			ERROR ("plugin: start_notification_threads: "
+					"malloc failed.");
+			continue;
+		}
+		memset (nh, 0, sizeof (*nh));
+
+		nh->name = strdup (le->key);
+		if (nh->name == NULL)
+		{
+			ERROR ("plugin: start_notification_threads: "
+					"strdup failed.");
+			sfree (nh);
+			continue;
+		}
+		nh->cf = le->value;
+		C_COMPLAIN_INIT (&nh->complaint);
+		nh->loop = 1;
+		pthread_mutex_init (&nh->lock, /* attr = */ NULL);
+		pthread_cond_init (&nh->cond, /* attr = */ NULL);
+
+		status = pthread_create (&nh->thread, /* attr = */ NULL,
+				notif_thread, (void *) nh);
+		if (status != 0)
+		{
+			char errbuf[1024];
+			ERROR ("plugin: start_notification_threads: "
+					"pthread_create failed: %s",
+					sstrerror (status, errbuf, sizeof (errbuf)));
+			pthread_mutex_destroy (&nh->lock);
+			pthread_cond_destroy (&nh->cond);
+			sfree (nh->name);
+			sfree (nh);
+			continue;
+		}
+
+		nh->next = handlers;
+		handlers = nh;
+	}
+
+	if (handlers == NULL)
+		return;
+
+	pthread_rwlock_wrlock (&notif_handlers_lock);
+	notif_handlers = handlers;
+	pthread_rwlock_unlock (&notif_handlers_lock);
+
+	plugin_register_read ("notification", notif_read);
+} /* }}} void start_notification_threads */
+
+/* Delivers all queued notifications and stops the notification threads. */
+static void stop_notification_threads (void) /* {{{ */
+{
+	notif_handler_t *handlers;
+
+	pthread_rwlock_wrlock (&notif_handlers_lock);
+	handlers = notif_handlers;
+	notif_handlers = NULL;
+	pthread_rwlock_unlock (&notif_handlers_lock);
+
+	/* Notifications dispatched by the callbacks while they work off their
+	 * queues are delivered synchronously. */
+	while (handlers != NULL)
+	{
+		notif_handler_t *nh = handlers;
+
+		handlers = nh->next;
+		notif_handler_destroy (nh);
+	}
+} /* }}} void stop_notification_threads */
+
+/* The caller must hold `notif_handlers_lock'. */
+static notif_handler_t *notif_handler_get (const char *name) /* {{{ */
+{
+	notif_handler_t *nh;
+
+	for (nh = notif_handlers; nh != NULL; nh = nh->next)
+		if (strcmp (nh->name, name) == 0)
+			return (nh);
+
+	return (NULL);
+} /* }}} notif_handler_t *notif_handler_get */
+
 int plugin_unregister_log (const char *name)
 {
 	return (plugin_unregister (list_log, name));
@@ -1066,6 +1734,24 @@ int plugin_unregister_log (const char *name)
 
 int plugin_unregister_notification (const char *name)
 {
+	notif_handler_t **prev;
+	notif_handler_t *nh = NULL;
+
+	pthread_rwlock_wrlock (&notif_handlers_lock);
+	for (prev = &notif_handlers; *prev != NULL; prev = &(*prev)->next)
+	{
+		if (strcmp ((*prev)->name, name) != 0)
+			continue;
+
+		nh = *prev;
+		*prev = nh->next;
+		break;
+	}
+	pthread_rwlock_unlock (&notif_handlers_lock);
+
+	/* Stop the thread using the callback before removing it. */
+	notif_handler_destroy (nh);
+
 	return (plugin_unregister (list_notification, name));
 }
 
@@ -1117,6 +1803,9 @@ void plugin_init_all (void)
 		le = le->next;
 	}
 
+	start_log_thread ();
+	start_notification_threads ();
+
 	/* Start read-threads */
 	if (read_heap != NULL)
 	{
@@ -1309,6 +1998,11 @@ void plugin_shutdown_all (void)
 	plugin_flush (/* plugin = */ NULL, /* timeout = */ -1,
 			/* identifier = */ NULL);
 
+	/* Notification and log callbacks may be unregistered by the shutdown
+	 * callbacks. */
+	stop_notification_threads ();
+	stop_log_thread ();
+
 	le = NULL;
 	if (list_shutdown != NULL)
 		le = llist_head (list_shutdown);
@@ -1395,16 +2089,17 @@ int plugin_dispatch_values (value_list_t *vl)
 	}
 
 	if (vl->time == 0)
-		vl->time = time (NULL);
+		vl->time = cdtime ();
 
-	if (vl->interval <= 0)
+	if (vl->interval == 0)
 		vl->interval = interval_g;
 
-	DEBUG ("plugin_dispatch_values: time = %u; interval = %i; "
+	DEBUG ("plugin_dispatch_values: time = %.3f; interval = %.3f; "
 			"host = %s; "
 			"plugin = %s; plugin_instance = %s; "
 			"type = %s; type_instance = %s;",
-			(unsigned int) vl->time, vl->interval,
+			CDTIME_T_TO_DOUBLE (vl->time),
+			CDTIME_T_TO_DOUBLE (vl->interval),
 			vl->host,
 			vl->plugin, vl->plugin_instance,
 			vl->type, vl->type_instance);
@@ -1590,6 +2285,25 @@ int plugin_dispatch_notification (const notification_t *notif)
 		plugin_notification_cb callback;
 		int status;
 
+		/* Callbacks with a thread of their own only get a copy of
+		 * the notification queued. */
+		if (notif_queue_limit > 0)
+		{
+			notif_handler_t *nh;
+
+			pthread_rwlock_rdlock (&notif_handlers_lock);
+			nh = notif_handler_get (le->key);
+			if (nh != NULL)
+				notif_enqueue (nh, notif);
+			pthread_rwlock_unlock (&notif_handlers_lock);
+
+			if (nh != NULL)
+			{
+				le = le->next;
+				continue;
+			}
+		}
+
 		cf = le->value;
 		callback = cf->cf_callback;
 		status = (*callback) (notif, &cf->cf_udata);
@@ -1610,37 +2324,45 @@ void plugin_log (int level, const char *format, ...)
 {
 	char msg[1024];
 	va_list ap;
-	llentry_t *le;
 
 #if !COLLECT_DEBUG
 	if (level >= LOG_DEBUG)
 		return;
 #endif
 
+	/* Check the rate limit before formatting the message, so that
+	 * floods of messages are cheap. Debug messages are never limited.
+	 * Neither are messages passed through a plain "%s" format, which is
+	 * used by the Perl, Python and Java bindings and by c_complain(), so
+	 * it doesn't identify a call site. */
+	if ((level < LOG_DEBUG) && (strcmp (format, "%s") != 0))
+	{
+		_Bool log_okay = 1;
+
+		pthread_mutex_lock (&log_lock);
+		if (log_thread_running != 0)
+			log_okay = log_ratelimit_check (level, format, time (NULL));
+		pthread_mutex_unlock (&log_lock);
+
+		if (!log_okay)
+			return;
+	}
+
 	va_start (ap, format);
 	vsnprintf (msg, sizeof (msg), format, ap);
 	msg[sizeof (msg) - 1] = '\0';
 	va_end (ap);
 
-	if (list_log == NULL)
+	pthread_mutex_lock (&log_lock);
+	if (log_thread_running != 0)
 	{
-		fprintf (stderr, "%s\n", msg);
+		log_queue_push (level, msg);
+		pthread_mutex_unlock (&log_lock);
 		return;
 	}
+	pthread_mutex_unlock (&log_lock);
 
-	le = llist_head (list_log);
-	while (le != NULL)
-	{
-		callback_func_t *cf;
-		plugin_log_cb callback;
-
-		cf = le->value;
-		callback = cf->cf_callback;
-
-		(*callback) (level, msg, &cf->cf_udata);
-
-		le = le->next;
-	}
+	log_deliver (level, msg);
 } /* void plugin_log */
 
 const data_set_t *plugin_get_ds (const char *name)
@@ -117,6 +117,13 @@ typedef struct {
 	udb_query_t    **queries;
 	size_t           queries_num;
 
+	/* server-side prepared statements, valid for the current connection */
+	_Bool  prepare_statements;
+	_Bool *prepared;
+
+	/* number of connections the queries are distributed over */
+	int connections;
+
 	int interval;
 
 	char *host;
@@ -169,6 +176,11 @@ static c_psql_database_t *c_psql_database_new (const char *name)
 	db->queries        = NULL;
 	db->queries_num    = 0;
 
+	db->prepare_statements = 0;
+	db->prepared           = NULL;
+
+	db->connections = 1;
+
 	db->interval   = 0;
 
 	db->database   = sstrdup (name);
@@ -202,6 +214,8 @@ static void c_psql_database_delete (void *data)
 	sfree (db->queries);
 	db->queries_num = 0;
 
+	sfree (db->prepared);
+
 	sfree (db->database);
 	sfree (db->host);
 	sfree (db->port);
@@ -245,6 +259,14 @@ static int c_psql_connect (c_psql_database_t *db)
 	return 0;
 } /* c_psql_connect */
 
+/* Prepared statements are bound to a connection. Forget about them
+ * whenever the connection is (re-)established. */
+static void c_psql_forget_prepared (c_psql_database_t *db)
+{
+	if (NULL != db->prepared)
+		memset (db->prepared, 0, db->queries_num * sizeof (*db->prepared));
+} /* c_psql_forget_prepared */
+
 static int c_psql_check_connection (c_psql_database_t *db)
 {
 	_Bool init = 0;
@@ -257,6 +279,7 @@ static int c_psql_check_connection (c_psql_database_t *db)
 			db->conn_complaint.interval = 1;
 
 		c_psql_connect (db);
+		c_psql_forget_prepared (db);
 	}
 
 	/* "ping" */
@@ -264,6 +287,7 @@ static int c_psql_check_connection (c_psql_database_t *db)
 
 	if (CONNECTION_OK != PQstatus (db->conn)) {
 		PQreset (db->conn);
+		c_psql_forget_prepared (db);
 
 		/* trigger c_release() */
 		if (0 == db->conn_complaint.interval)
@@ -310,19 +334,57 @@ static PGresult *c_psql_exec_query_noparams (c_psql_database_t *db,
 	return PQexec (db->conn, udb_query_get_statement (q));
 } /* c_psql_exec_query_noparams */
 
+/* Prepares the statement of the query with the given index on the server
+ * unless that has already been done for the current connection. On success,
+ * the name of the prepared statement is stored in 'name'. */
+static int c_psql_prepare_query (c_psql_database_t *db, udb_query_t *q,
+		size_t idx, int params_num, char *name, size_t name_len)
+{
+	PGresult *res;
+
+	ssnprintf (name, name_len, "collectd_%s_%zu",
+			udb_query_get_name (q), idx);
+
+	if (db->prepared[idx])
+		return 0;
+
+	res = PQprepare (db->conn, name, udb_query_get_statement (q),
+			params_num, /* param types = */ NULL);
+	if (PGRES_COMMAND_OK != PQresultStatus (res)) {
+		log_err ("Failed to prepare SQL query \"%s\": %s",
+				udb_query_get_name (q), PQerrorMessage (db->conn));
+		PQclear (res);
+		name[0] = '\0';
+		return -1;
+	}
+	PQclear (res);
+
+	db->prepared[idx] = 1;
+	return 0;
+} /* c_psql_prepare_query */
+
 static PGresult *c_psql_exec_query_params (c_psql_database_t *db,
-		udb_query_t *q, c_psql_user_data_t *data)
+		udb_query_t *q, size_t idx, c_psql_user_data_t *data)
 {
-	char *params[db->max_params_num];
+	char *params[db->max_params_num + 1];
 	char  interval[64];
+	char  stmt_name[2 * DATA_MAX_NAME_LEN];
+	int   params_num;
 	int   i;
 
-	if ((data == NULL) || (data->params_num == 0))
+	params_num = (NULL == data) ? 0 : data->params_num;
+
+	stmt_name[0] = '\0';
+	if (db->prepare_statements)
+		c_psql_prepare_query (db, q, idx, params_num,
+				stmt_name, sizeof (stmt_name));
+
+	if (('\0' == stmt_name[0]) && (0 == params_num))
 		return (c_psql_exec_query_noparams (db, q));
 
-	assert (db->max_params_num >= data->params_num);
+	assert (db->max_params_num >= params_num);
 
-	for (i = 0; i < data->params_num; ++i) {
+	for (i = 0; i < params_num; ++i) {
 		switch (data->params[i]) {
 			case C_PSQL_PARAM_HOST:
 				params[i] = C_PSQL_IS_UNIX_DOMAIN_SOCKET (db->host)
@@ -335,8 +397,10 @@ static PGresult *c_psql_exec_query_params (c_psql_database_t *db,
 				params[i] = db->user;
 				break;
 			case C_PSQL_PARAM_INTERVAL:
-				ssnprintf (interval, sizeof (interval), "%i",
-						db->interval > 0 ? db->interval : interval_g);
+				ssnprintf (interval, sizeof (interval), "%g",
+						(db->interval > 0)
+						? (double) db->interval
+						: CDTIME_T_TO_DOUBLE (interval_g));
 				params[i] = interval;
 				break;
 			default:
@@ -344,15 +408,30 @@ static PGresult *c_psql_exec_query_params (c_psql_database_t *db,
 		}
 	}
 
+	if ('\0' != stmt_name[0])
+		return PQexecPrepared (db->conn, stmt_name, params_num,
+				(const char *const *) params,
+				NULL, NULL, /* return text data */ 0);
+
 	return PQexecParams (db->conn, udb_query_get_statement (q),
-			data->params_num, NULL,
+			params_num, NULL,
 			(const char *const *) params,
 			NULL, NULL, /* return text data */ 0);
 } /* c_psql_exec_query_params */
 
-static int c_psql_exec_query (c_psql_database_t *db, udb_query_t *q,
-		udb_query_preparation_area_t *prep_area)
+static const char *c_psql_get_host (c_psql_database_t *db)
+{
+	if (C_PSQL_IS_UNIX_DOMAIN_SOCKET (db->host)
+			|| (0 == strcmp (db->host, "localhost")))
+		return hostname_g;
+	return db->host;
+} /* c_psql_get_host */
+
+static int c_psql_exec_query (c_psql_database_t *db, size_t idx)
 {
+	udb_query_t *q = db->queries[idx];
+	udb_query_preparation_area_t *prep_area = db->q_prep_areas[idx];
+
 	PGresult *res;
 
 	c_psql_user_data_t *data;
@@ -372,7 +451,7 @@ static int c_psql_exec_query (c_psql_database_t *db, udb_query_t *q,
 
 	/* Versions up to `3' don't know how to handle parameters. */
 	if (3 <= db->proto_version)
-		res = c_psql_exec_query_params (db, q, data);
+		res = c_psql_exec_query_params (db, q, idx, data);
 	else if ((NULL == data) || (0 == data->params_num))
 		res = c_psql_exec_query_noparams (db, q);
 	else {
@@ -428,11 +507,7 @@ static int c_psql_exec_query (c_psql_database_t *db, udb_query_t *q,
 		}
 	}
 
-	if (C_PSQL_IS_UNIX_DOMAIN_SOCKET (db->host)
-			|| (0 == strcmp (db->host, "localhost")))
-		host = hostname_g;
-	else
-		host = db->host;
+	host = c_psql_get_host (db);
 
 	status = udb_query_prepare_result (q, prep_area, host, "postgresql",
 			db->database, column_names, (size_t) column_num, db->interval);
@@ -492,18 +567,22 @@ static int c_psql_read (user_data_t *ud)
 
 	for (i = 0; i < db->queries_num; ++i)
 	{
-		udb_query_preparation_area_t *prep_area;
 		udb_query_t *q;
+		struct timeval begin;
 
-		prep_area = db->q_prep_areas[i];
 		q = db->queries[i];
 
 		if ((0 != db->server_version)
 				&& (udb_query_check_version (q, db->server_version) <= 0))
 			continue;
 
-		if (0 == c_psql_exec_query (db, q, prep_area))
+		gettimeofday (&begin, /* timezone = */ NULL);
+
+		if (0 == c_psql_exec_query (db, (size_t) i))
 			success = 1;
+
+		udb_query_submit_time (q, c_psql_get_host (db), "postgresql",
+				db->database, db->interval, &begin);
 	}
 
 	if (! success)
@@ -613,14 +692,101 @@ static int config_query_callback (udb_query_t *q, oconfig_item_t *ci)
 	return (-1);
 } /* config_query_callback */
 
-static int c_psql_config_database (oconfig_item_t *ci)
+/* Creates a new database object sharing the connection settings of 'src'
+ * but without any queries. */
+static c_psql_database_t *c_psql_database_copy (const c_psql_database_t *src)
 {
 	c_psql_database_t *db;
 
+	db = c_psql_database_new (src->database);
+	if (NULL == db)
+		return NULL;
+
+	db->prepare_statements = src->prepare_statements;
+	db->connections        = src->connections;
+	db->interval           = src->interval;
+
+#define COPY_STRING(member) \
+	if (NULL != src->member) \
+		db->member = sstrdup (src->member)
+
+	COPY_STRING (host);
+	COPY_STRING (port);
+	COPY_STRING (user);
+	COPY_STRING (password);
+	COPY_STRING (sslmode);
+	COPY_STRING (krbsrvname);
+	COPY_STRING (service);
+
+#undef COPY_STRING
+	return db;
+} /* c_psql_database_copy */
+
+/* Allocates the per-query data of 'db' and registers its read callback. The
+ * database object is freed in case of an error. */
+static int c_psql_register_database (c_psql_database_t *db, int slot)
+{
 	char cb_name[DATA_MAX_NAME_LEN];
 	struct timespec cb_interval;
 	user_data_t ud;
 
+	size_t i;
+
+	memset (&ud, 0, sizeof (ud));
+
+	if (db->queries_num > 0) {
+		db->q_prep_areas = (udb_query_preparation_area_t **) calloc (
+				db->queries_num, sizeof (*db->q_prep_areas));
+		db->prepared = (_Bool *) calloc (db->queries_num,
+				sizeof (*db->prepared));
+
+		if ((db->q_prep_areas == NULL) || (db->prepared == NULL)) {
+			log_err ("Out of memory.");
+			c_psql_database_delete (db);
+			return -1;
+		}
+	}
+
+	for (i = 0; i < db->queries_num; ++i) {
+		c_psql_user_data_t *data;
+		data = udb_query_get_user_data (db->queries[i]);
+		if ((data != NULL) && (data->params_num > db->max_params_num))
+			db->max_params_num = data->params_num;
+
+		db->q_prep_areas[i]
+			= udb_query_allocate_preparation_area (db->queries[i]);
+
+		if (db->q_prep_areas[i] == NULL) {
+			log_err ("Out of memory.");
+			c_psql_database_delete (db);
+			return -1;
+		}
+	}
+
+	ud.data = db;
+	ud.free_func = c_psql_database_delete;
+
+	if (0 == slot)
+		ssnprintf (cb_name, sizeof (cb_name), "postgresql-%s", db->database);
+	else
+		ssnprintf (cb_name, sizeof (cb_name), "postgresql-%s-%i",
+				db->database, slot);
+
+	memset (&cb_interval, 0, sizeof (cb_interval));
+	if (db->interval > 0)
+		cb_interval.tv_sec = (time_t)db->interval;
+
+	plugin_register_complex_read ("postgresql", cb_name, c_psql_read,
+			/* interval = */ &cb_interval, &ud);
+	return 0;
+} /* c_psql_register_database */
+
+static int c_psql_config_database (oconfig_item_t *ci)
+{
+	c_psql_database_t *db;
+
+	size_t kept;
+	int slot;
 	int i;
 
 	if ((1 != ci->values_num)
@@ -629,8 +795,6 @@ static int c_psql_config_database (oconfig_item_t *ci)
 		return 1;
 	}
 
-	memset (&ud, 0, sizeof (ud));
-
 	db = c_psql_database_new (ci->values[0].value.string);
 	if (db == NULL)
 		return -1;
@@ -657,6 +821,10 @@ static int c_psql_config_database (oconfig_item_t *ci)
 					&db->queries, &db->queries_num);
 		else if (0 == strcasecmp (c->key, "Interval"))
 			config_set_i ("Interval", &db->interval, c, /* min = */ 1);
+		else if (0 == strcasecmp (c->key, "PrepareStatements"))
+			cf_util_get_boolean (c, &db->prepare_statements);
+		else if (0 == strcasecmp (c->key, "Connections"))
+			config_set_i ("Connections", &db->connections, c, /* min = */ 1);
 		else
 			log_warn ("Ignoring unknown config key \"%s\".", c->key);
 	}
@@ -669,45 +837,53 @@ static int c_psql_config_database (oconfig_item_t *ci)
 					&db->queries, &db->queries_num);
 	}
 
-	if (db->queries_num > 0) {
-		db->q_prep_areas = (udb_query_preparation_area_t **) calloc (
-				db->queries_num, sizeof (*db->q_prep_areas));
+	if ((size_t)db->connections > db->queries_num)
+		db->connections = (db->queries_num > 0) ? (int)db->queries_num : 1;
 
-		if (db->q_prep_areas == NULL) {
-			log_err ("Out of memory.");
+	/* Distribute the queries over "Connections" database objects, each of
+	 * which uses its own connection and read callback. Thus, the queries are
+	 * executed concurrently by the read threads and a slow query only delays
+	 * the queries sharing its connection. */
+	for (slot = 1; slot < db->connections; ++slot) {
+		c_psql_database_t *copy;
+		size_t q;
+
+		copy = c_psql_database_copy (db);
+		if (NULL == copy) {
 			c_psql_database_delete (db);
 			return -1;
 		}
-	}
 
-	for (i = 0; (size_t)i < db->queries_num; ++i) {
-		c_psql_user_data_t *data;
-		data = udb_query_get_user_data (db->queries[i]);
-		if ((data != NULL) && (data->params_num > db->max_params_num))
-			db->max_params_num = data->params_num;
-
-		db->q_prep_areas[i]
-			= udb_query_allocate_preparation_area (db->queries[i]);
+		for (q = (size_t)slot; q < db->queries_num;
+				q += (size_t)db->connections) {
+			udb_query_t **tmp;
+
+			tmp = (udb_query_t **) realloc (copy->queries,
+					(copy->queries_num + 1) * sizeof (*copy->queries));
+			if (NULL == tmp) {
+				log_err ("Out of memory.");
+				c_psql_database_delete (copy);
+				c_psql_database_delete (db);
+				return -1;
+			}
+			copy->queries = tmp;
+			copy->queries[copy->queries_num] = db->queries[q];
+			copy->queries_num++;
+		}
 
-		if (db->q_prep_areas[i] == NULL) {
-			log_err ("Out of memory.");
+		if (0 != c_psql_register_database (copy, slot)) {
 			c_psql_database_delete (db);
 			return -1;
 		}
 	}
 
-	ud.data = db;
-	ud.free_func = c_psql_database_delete;
-
-	ssnprintf (cb_name, sizeof (cb_name), "postgresql-%s", db->database);
+	/* The first object keeps every "Connections"-th query. */
+	kept = 0;
+	for (i = 0; (size_t)i < db->queries_num; i += db->connections)
+		db->queries[kept++] = db->queries[i];
+	db->queries_num = kept;
 
-	memset (&cb_interval, 0, sizeof (cb_interval));
-	if (db->interval > 0)
-		cb_interval.tv_sec = (time_t)db->interval;
-
-	plugin_register_complex_read ("postgresql", cb_name, c_psql_read,
-			/* interval = */ &cb_interval, &ud);
-	return 0;
+	return c_psql_register_database (db, /* slot = */ 0);
 } /* c_psql_config_database */
 
 static int c_psql_config (oconfig_item_t *ci)
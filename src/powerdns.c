@@ -363,8 +363,8 @@ static int powerdns_get_data_dgram (list_item_t *item, /* {{{ */
 
     struct timeval timeout;
     timeout.tv_sec=2;
-    if (timeout.tv_sec < interval_g * 3 / 4)
-      timeout.tv_sec = interval_g * 3 / 4;
+    if (timeout.tv_sec < CDTIME_T_TO_TIME_T (interval_g) * 3 / 4)
+      timeout.tv_sec = CDTIME_T_TO_TIME_T (interval_g) * 3 / 4;
     timeout.tv_usec=0;
     status = setsockopt (sd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
     if (status != 0)
@@ -117,6 +117,30 @@
 # include <regex.h>
 #endif
 
+#if KERNEL_LINUX
+# include <pthread.h>
+#endif
+
+/*
+ * On Linux, process events and the accounting data of exiting processes can
+ * be received from the kernel using the process connector and the taskstats
+ * netlink family, so only the processes belonging to a group are read on each
+ * interval. Both need the CAP_NET_ADMIN capability.
+ */
+#if KERNEL_LINUX && HAVE_LINUX_CN_PROC_H && HAVE_LINUX_TASKSTATS_H \
+	&& HAVE_LINUX_GENETLINK_H
+# define PS_NETLINK 1
+# include <poll.h>
+# include <sys/socket.h>
+# include <linux/netlink.h>
+# include <linux/connector.h>
+# include <linux/cn_proc.h>
+# include <linux/genetlink.h>
+# include <linux/taskstats.h>
+#else
+# define PS_NETLINK 0
+#endif
+
 #ifndef ARG_MAX
 #  define ARG_MAX 4096
 #endif
@@ -181,12 +205,24 @@ typedef struct procstat
 	derive_t io_syscr;
 	derive_t io_syscw;
 
+#if PS_NETLINK
+	/* io data of processes which have exited */
+	derive_t io_rchar_exited;
+	derive_t io_wchar_exited;
+	derive_t io_syscr_exited;
+	derive_t io_syscw_exited;
+#endif
+
 	struct procstat   *next;
 	struct procstat_entry_s *instances;
 } procstat_t;
 
 static procstat_t *list_head_g = NULL;
 
+/* Set if a `ProcessMatch' is configured, i. e. the command line of processes
+ * is needed to assign them to the configured groups. */
+static _Bool need_cmdline_g = 0;
+
 #if HAVE_THREAD_INFO
 static mach_port_t port_host_self;
 static mach_port_t port_task_self;
@@ -197,6 +233,113 @@ static mach_msg_type_number_t     pset_list_len;
 
 #elif KERNEL_LINUX
 static long pagesize_g;
+
+/*
+ * State kept for every process between reads. The processes are found by PID
+ * in a hash table. The groups a process belongs to are only determined when
+ * it is first seen or changes its name, and the files needed for the group
+ * statistics are only read for processes belonging to at least one group.
+ */
+typedef struct ps_proc_s
+{
+	pid_t pid;
+	unsigned long long starttime;
+	char name[PROCSTAT_NAME_LEN];
+	unsigned int scan;
+
+	_Bool matched;
+	procstat_t **groups;
+	int groups_num;
+
+	/* Counters as of the previous read, see ps_entry_update. */
+	procstat_entry_t entry;
+
+	/* Result of the current read. */
+	int status;
+	char state;
+	procstat_entry_t sample;
+
+#if PS_NETLINK
+	/* Set by the process events: the process has exited, and its
+	 * accounting data at that time. */
+	_Bool dead;
+	/* The main thread has exited while other threads were still running.
+	 * The process is read until it is gone. */
+	_Bool exiting;
+	_Bool exit_valid;
+	procstat_entry_t exit;
+#endif
+
+	struct ps_proc_s *next;
+} ps_proc_t;
+
+#define PS_PROC_TABLE_MIN 1024
+static ps_proc_t **proc_table = NULL;
+static size_t proc_table_size = 0;
+static size_t proc_table_num = 0;
+
+/* `/proc', kept open. The files of the processes are opened relative to it. */
+static DIR *proc_dir = NULL;
+static unsigned int proc_scan = 0;
+
+/* Processes found by the current scan. */
+static ps_proc_t **scan_list = NULL;
+static size_t scan_list_size = 0;
+static size_t scan_num = 0;
+
+/* Threads reading the processes found by a scan. Each job is a chunk of
+ * PS_CHUNK_SIZE entries of `scan_list'. */
+#define PS_CHUNK_SIZE 256
+static int ps_threads_num = 0;
+static pthread_t *ps_threads = NULL;
+static int ps_threads_running = 0;
+
+static pthread_mutex_t ps_work_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ps_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ps_work_done_cond = PTHREAD_COND_INITIALIZER;
+static size_t ps_work_next = 0;
+static size_t ps_work_num = 0;
+static size_t ps_work_pending = 0;
+static _Bool ps_work_shutdown = 0;
+
+/* Protects the process table against the thread receiving process events. */
+static pthread_mutex_t ps_lock = PTHREAD_MUTEX_INITIALIZER;
+
+# if PS_NETLINK
+#  define PS_NL_RCVBUF (4 * 1024 * 1024)
+static _Bool ps_nl_enabled = 0;
+static int ps_cn_sock = -1;
+static int ps_ts_sock = -1;
+static uint16_t ps_ts_family = 0;
+static uint32_t ps_nl_seq = 0;
+static char ps_nl_buffer[65536];
+static char ps_ts_cpumask[256];
+
+static pthread_t ps_nl_thread_id;
+static _Bool ps_nl_running = 0;
+static _Bool ps_nl_shutdown = 0;
+static _Bool ps_nl_failed = 0;
+/* Set once the kernel has acknowledged the subscription to the events. */
+static _Bool ps_nl_listening = 0;
+/* Set if events may have been lost, so all of /proc has to be scanned. */
+static _Bool ps_nl_resync = 1;
+
+/* Messages received while the processes are read without holding `ps_lock'.
+ * They are handled once the read is done. */
+typedef struct ps_nl_msg_s
+{
+	void (*handler) (const struct nlmsghdr *);
+	char *data;
+	ssize_t len;
+	struct ps_nl_msg_s *next;
+} ps_nl_msg_t;
+
+#  define PS_NL_DEFERRED_MAX (4 * PS_NL_RCVBUF)
+static _Bool ps_nl_reading = 0;
+static ps_nl_msg_t *ps_nl_deferred_head = NULL;
+static ps_nl_msg_t *ps_nl_deferred_tail = NULL;
+static size_t ps_nl_deferred_size = 0;
+# endif /* PS_NETLINK */
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKVM_GETPROCS && HAVE_STRUCT_KINFO_PROC_FREEBSD
@@ -252,6 +395,8 @@ static void ps_list_register (const char *name, const char *regexp)
 			sfree(new->re);
 			return;
 		}
+
+		need_cmdline_g = 1;
 	}
 #else
 	if (regexp != NULL)
@@ -320,6 +465,115 @@ static int ps_list_match (const char *name, const char *cmdline, procstat_t *ps)
 	return (0);
 } /* int ps_list_match */
 
+/* update the process entry `pse' with the values just read into `entry' */
+static void ps_entry_update (procstat_entry_t *pse, const procstat_entry_t *entry)
+{
+	pse->age = 0;
+	pse->num_proc   = entry->num_proc;
+	pse->num_lwp    = entry->num_lwp;
+	pse->vmem_size  = entry->vmem_size;
+	pse->vmem_rss   = entry->vmem_rss;
+	pse->vmem_data  = entry->vmem_data;
+	pse->vmem_code  = entry->vmem_code;
+	pse->stack_size = entry->stack_size;
+	pse->io_rchar   = entry->io_rchar;
+	pse->io_wchar   = entry->io_wchar;
+	pse->io_syscr   = entry->io_syscr;
+	pse->io_syscw   = entry->io_syscw;
+
+	if ((entry->vmem_minflt_counter == 0)
+			&& (entry->vmem_majflt_counter == 0))
+	{
+		pse->vmem_minflt_counter += entry->vmem_minflt;
+		pse->vmem_minflt = entry->vmem_minflt;
+
+		pse->vmem_majflt_counter += entry->vmem_majflt;
+		pse->vmem_majflt = entry->vmem_majflt;
+	}
+	else
+	{
+		if (entry->vmem_minflt_counter < pse->vmem_minflt_counter)
+		{
+			pse->vmem_minflt = entry->vmem_minflt_counter
+				+ (ULONG_MAX - pse->vmem_minflt_counter);
+		}
+		else
+		{
+			pse->vmem_minflt = entry->vmem_minflt_counter - pse->vmem_minflt_counter;
+		}
+		pse->vmem_minflt_counter = entry->vmem_minflt_counter;
+
+		if (entry->vmem_majflt_counter < pse->vmem_majflt_counter)
+		{
+			pse->vmem_majflt = entry->vmem_majflt_counter
+				+ (ULONG_MAX - pse->vmem_majflt_counter);
+		}
+		else
+		{
+			pse->vmem_majflt = entry->vmem_majflt_counter - pse->vmem_majflt_counter;
+		}
+		pse->vmem_majflt_counter = entry->vmem_majflt_counter;
+	}
+
+	if ((entry->cpu_user_counter == 0)
+			&& (entry->cpu_system_counter == 0))
+	{
+		pse->cpu_user_counter += entry->cpu_user;
+		pse->cpu_user = entry->cpu_user;
+
+		pse->cpu_system_counter += entry->cpu_system;
+		pse->cpu_system = entry->cpu_system;
+	}
+	else
+	{
+		if (entry->cpu_user_counter < pse->cpu_user_counter)
+		{
+			pse->cpu_user = entry->cpu_user_counter
+				+ (ULONG_MAX - pse->cpu_user_counter);
+		}
+		else
+		{
+			pse->cpu_user = entry->cpu_user_counter - pse->cpu_user_counter;
+		}
+		pse->cpu_user_counter = entry->cpu_user_counter;
+
+		if (entry->cpu_system_counter < pse->cpu_system_counter)
+		{
+			pse->cpu_system = entry->cpu_system_counter
+				+ (ULONG_MAX - pse->cpu_system_counter);
+		}
+		else
+		{
+			pse->cpu_system = entry->cpu_system_counter - pse->cpu_system_counter;
+		}
+		pse->cpu_system_counter = entry->cpu_system_counter;
+	}
+} /* void ps_entry_update */
+
+/* add the values of the process entry `pse' to process `ps' */
+static void ps_entry_sum (procstat_t *ps, const procstat_entry_t *pse)
+{
+	ps->num_proc   += pse->num_proc;
+	ps->num_lwp    += pse->num_lwp;
+	ps->vmem_size  += pse->vmem_size;
+	ps->vmem_rss   += pse->vmem_rss;
+	ps->vmem_data  += pse->vmem_data;
+	ps->vmem_code  += pse->vmem_code;
+	ps->stack_size += pse->stack_size;
+
+	ps->io_rchar   += ((pse->io_rchar == -1)?0:pse->io_rchar);
+	ps->io_wchar   += ((pse->io_wchar == -1)?0:pse->io_wchar);
+	ps->io_syscr   += ((pse->io_syscr == -1)?0:pse->io_syscr);
+	ps->io_syscw   += ((pse->io_syscw == -1)?0:pse->io_syscw);
+
+	ps->vmem_minflt_counter += pse->vmem_minflt;
+	ps->vmem_majflt_counter += pse->vmem_majflt;
+
+	ps->cpu_user_counter   += pse->cpu_user;
+	ps->cpu_system_counter += pse->cpu_system;
+} /* void ps_entry_sum */
+
+#if !KERNEL_LINUX
 /* add process entry to 'instances' of process 'name' (or refresh it) */
 static void ps_list_add (const char *name, const char *cmdline, procstat_entry_t *entry)
 {
@@ -356,107 +610,11 @@ static void ps_list_add (const char *name, const char *cmdline, procstat_entry_t
 			pse = new;
 		}
 
-		pse->age = 0;
-		pse->num_proc   = entry->num_proc;
-		pse->num_lwp    = entry->num_lwp;
-		pse->vmem_size  = entry->vmem_size;
-		pse->vmem_rss   = entry->vmem_rss;
-		pse->vmem_data  = entry->vmem_data;
-		pse->vmem_code  = entry->vmem_code;
-		pse->stack_size = entry->stack_size;
-		pse->io_rchar   = entry->io_rchar;
-		pse->io_wchar   = entry->io_wchar;
-		pse->io_syscr   = entry->io_syscr;
-		pse->io_syscw   = entry->io_syscw;
-
-		ps->num_proc   += pse->num_proc;
-		ps->num_lwp    += pse->num_lwp;
-		ps->vmem_size  += pse->vmem_size;
-		ps->vmem_rss   += pse->vmem_rss;
-		ps->vmem_data  += pse->vmem_data;
-		ps->vmem_code  += pse->vmem_code;
-		ps->stack_size += pse->stack_size;
-
-		ps->io_rchar   += ((pse->io_rchar == -1)?0:pse->io_rchar);
-		ps->io_wchar   += ((pse->io_wchar == -1)?0:pse->io_wchar);
-		ps->io_syscr   += ((pse->io_syscr == -1)?0:pse->io_syscr);
-		ps->io_syscw   += ((pse->io_syscw == -1)?0:pse->io_syscw);
-
-		if ((entry->vmem_minflt_counter == 0)
-				&& (entry->vmem_majflt_counter == 0))
-		{
-			pse->vmem_minflt_counter += entry->vmem_minflt;
-			pse->vmem_minflt = entry->vmem_minflt;
-
-			pse->vmem_majflt_counter += entry->vmem_majflt;
-			pse->vmem_majflt = entry->vmem_majflt;
-		}
-		else
-		{
-			if (entry->vmem_minflt_counter < pse->vmem_minflt_counter)
-			{
-				pse->vmem_minflt = entry->vmem_minflt_counter
-					+ (ULONG_MAX - pse->vmem_minflt_counter);
-			}
-			else
-			{
-				pse->vmem_minflt = entry->vmem_minflt_counter - pse->vmem_minflt_counter;
-			}
-			pse->vmem_minflt_counter = entry->vmem_minflt_counter;
-
-			if (entry->vmem_majflt_counter < pse->vmem_majflt_counter)
-			{
-				pse->vmem_majflt = entry->vmem_majflt_counter
-					+ (ULONG_MAX - pse->vmem_majflt_counter);
-			}
-			else
-			{
-				pse->vmem_majflt = entry->vmem_majflt_counter - pse->vmem_majflt_counter;
-			}
-			pse->vmem_majflt_counter = entry->vmem_majflt_counter;
-		}
-
-		ps->vmem_minflt_counter += pse->vmem_minflt;
-		ps->vmem_majflt_counter += pse->vmem_majflt;
-
-		if ((entry->cpu_user_counter == 0)
-				&& (entry->cpu_system_counter == 0))
-		{
-			pse->cpu_user_counter += entry->cpu_user;
-			pse->cpu_user = entry->cpu_user;
-
-			pse->cpu_system_counter += entry->cpu_system;
-			pse->cpu_system = entry->cpu_system;
-		}
-		else
-		{
-			if (entry->cpu_user_counter < pse->cpu_user_counter)
-			{
-				pse->cpu_user = entry->cpu_user_counter
-					+ (ULONG_MAX - pse->cpu_user_counter);
-			}
-			else
-			{
-				pse->cpu_user = entry->cpu_user_counter - pse->cpu_user_counter;
-			}
-			pse->cpu_user_counter = entry->cpu_user_counter;
-
-			if (entry->cpu_system_counter < pse->cpu_system_counter)
-			{
-				pse->cpu_system = entry->cpu_system_counter
-					+ (ULONG_MAX - pse->cpu_system_counter);
-			}
-			else
-			{
-				pse->cpu_system = entry->cpu_system_counter - pse->cpu_system_counter;
-			}
-			pse->cpu_system_counter = entry->cpu_system_counter;
-		}
-
-		ps->cpu_user_counter   += pse->cpu_user;
-		ps->cpu_system_counter += pse->cpu_system;
+		ps_entry_update (pse, entry);
+		ps_entry_sum (ps, pse);
 	}
 }
+#endif /* !KERNEL_LINUX */
 
 /* remove old entries from instances of processes in list_head_g */
 static void ps_list_reset (void)
@@ -562,6 +720,60 @@ static int ps_config (oconfig_item_t *ci)
 			ps_list_register (c->values[0].value.string,
 					c->values[1].value.string);
 		}
+		else if (strcasecmp (c->key, "Threads") == 0)
+		{
+			if ((c->values_num != 1)
+					|| (OCONFIG_TYPE_NUMBER != c->values[0].type))
+			{
+				ERROR ("processes plugin: `Threads' expects exactly "
+						"one numeric argument.");
+				continue;
+			}
+
+#if KERNEL_LINUX
+			ps_threads_num = (int) c->values[0].value.number;
+			if (ps_threads_num < 0)
+				ps_threads_num = 0;
+#else
+			WARNING ("processes plugin: The `Threads' option is only "
+					"supported on Linux and will be ignored.");
+#endif
+		}
+		else if (strcasecmp (c->key, "Backend") == 0)
+		{
+			const char *backend;
+
+			if ((c->values_num != 1)
+					|| (OCONFIG_TYPE_STRING != c->values[0].type))
+			{
+				ERROR ("processes plugin: `Backend' expects exactly "
+						"one string argument.");
+				continue;
+			}
+
+			backend = c->values[0].value.string;
+			if (strcasecmp ("procfs", backend) == 0)
+			{
+#if PS_NETLINK
+				ps_nl_enabled = 0;
+#endif
+			}
+			else if (strcasecmp ("netlink", backend) == 0)
+			{
+#if PS_NETLINK
+				ps_nl_enabled = 1;
+#else
+				WARNING ("processes plugin: The `netlink' backend is "
+						"not available on this system. Reading "
+						"/proc instead.");
+#endif
+			}
+			else
+			{
+				ERROR ("processes plugin: Unknown backend `%s'.",
+						backend);
+			}
+		}
 		else
 		{
 			ERROR ("processes plugin: The `%s' configuration option is not "
@@ -728,59 +940,92 @@ static void ps_submit_proc_list (procstat_t *ps)
 
 /* ------- additional functions for KERNEL_LINUX/HAVE_THREAD_INFO ------- */
 #if KERNEL_LINUX
-static int ps_read_tasks (int pid)
+/* Reads the file `name' of the process `pid' into `buf' and terminates it
+ * with a null byte. The file is opened relative to the cached `/proc'
+ * directory if possible. Returns the number of bytes read or -1 with `errno'
+ * set on failure. */
+static ssize_t ps_read_file (pid_t pid, const char *name,
+		char *buf, size_t buf_len)
 {
-	char           dirname[64];
-	DIR           *dh;
-	struct dirent *ent;
-	int count = 0;
+	char file[64];
+	size_t n;
+	int fd;
 
-	ssnprintf (dirname, sizeof (dirname), "/proc/%i/task", pid);
+	if (buf_len < 1)
+		return (-1);
 
-	if ((dh = opendir (dirname)) == NULL)
+#if HAVE_OPENAT
+	if (proc_dir != NULL)
 	{
-		DEBUG ("Failed to open directory `%s'", dirname);
-		return (-1);
+		ssnprintf (file, sizeof (file), "%u/%s", (unsigned int) pid, name);
+		fd = openat (dirfd (proc_dir), file, O_RDONLY);
+	}
+	else
+#endif
+	{
+		ssnprintf (file, sizeof (file), "/proc/%u/%s", (unsigned int) pid, name);
+		fd = open (file, O_RDONLY);
 	}
+	if (fd < 0)
+		return (-1);
 
-	while ((ent = readdir (dh)) != NULL)
+	n = 0;
+	while (n < buf_len - 1)
 	{
-		if (!isdigit ((int) ent->d_name[0]))
-			continue;
-		else
-			count++;
+		ssize_t status;
+
+		status = read (fd, buf + n, buf_len - 1 - n);
+		if (status < 0)
+		{
+			int saved_errno = errno;
+
+			if ((errno == EAGAIN) || (errno == EINTR))
+				continue;
+
+			close (fd);
+			errno = saved_errno;
+			return (-1);
+		}
+		else if (status == 0)
+			break;
+
+		n += status;
 	}
-	closedir (dh);
 
-	return ((count >= 1) ? count : 1);
-} /* int *ps_read_tasks */
+	close (fd);
+	buf[n] = 0;
+
+	return ((ssize_t) n);
+} /* ssize_t ps_read_file */
 
 /* Read advanced virtual memory data from /proc/pid/status */
-static procstat_t *ps_read_vmem (int pid, procstat_t *ps)
+static int ps_read_vmem (pid_t pid, procstat_entry_t *entry)
 {
-	FILE *fh;
-	char buffer[1024];
-	char filename[64];
+	char buffer[4096];
+	char *line;
+	char *saveptr;
 	unsigned long long lib = 0;
 	unsigned long long exe = 0;
 	unsigned long long data = 0;
 	char *fields[8];
 	int numfields;
 
-	ssnprintf (filename, sizeof (filename), "/proc/%i/status", pid);
-	if ((fh = fopen (filename, "r")) == NULL)
-		return (NULL);
+	if (ps_read_file (pid, "status", buffer, sizeof (buffer)) < 0)
+		return (-1);
 
-	while (fgets (buffer, sizeof(buffer), fh) != NULL)
+	saveptr = NULL;
+	for (line = strtok_r (buffer, "\n", &saveptr);
+			line != NULL;
+			line = strtok_r (NULL, "\n", &saveptr))
 	{
 		long long tmp;
 		char *endptr;
 
-		if (strncmp (buffer, "Vm", 2) != 0)
+		if (strncmp (line, "Vm", 2) != 0)
 			continue;
 
-		numfields = strsplit (buffer, fields,
-                                      STATIC_ARRAY_SIZE (fields));
+		numfields = strsplit (line, fields,
+				STATIC_ARRAY_SIZE (fields));
 
 		if (numfields < 2)
 			continue;
@@ -790,65 +1035,60 @@ static procstat_t *ps_read_vmem (int pid, procstat_t *ps)
 		tmp = strtoll (fields[1], &endptr, /* base = */ 10);
 		if ((errno == 0) && (endptr != fields[1]))
 		{
-			if (strncmp (buffer, "VmData", 6) == 0) 
+			if (strncmp (fields[0], "VmData", 6) == 0)
 			{
 				data = tmp;
 			}
-			else if (strncmp (buffer, "VmLib", 5) == 0)
+			else if (strncmp (fields[0], "VmLib", 5) == 0)
 			{
 				lib = tmp;
 			}
-			else if  (strncmp(buffer, "VmExe", 5) == 0)
+			else if  (strncmp(fields[0], "VmExe", 5) == 0)
 			{
 				exe = tmp;
 			}
 		}
-	} /* while (fgets) */
+	} /* for (line) */
 
-	if (fclose (fh))
-	{
-		char errbuf[1024];
-		WARNING ("processes: fclose: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
-	}
+	entry->vmem_data = data * 1024;
+	entry->vmem_code = (exe + lib) * 1024;
 
-	ps->vmem_data = data * 1024;
-	ps->vmem_code = (exe + lib) * 1024;
-
-	return (ps);
-} /* procstat_t *ps_read_vmem */
+	return (0);
+} /* int ps_read_vmem */
 
-static procstat_t *ps_read_io (int pid, procstat_t *ps)
+static int ps_read_io (pid_t pid, procstat_entry_t *entry)
 {
-	FILE *fh;
 	char buffer[1024];
-	char filename[64];
+	char *line;
+	char *saveptr;
 
 	char *fields[8];
 	int numfields;
 
-	ssnprintf (filename, sizeof (filename), "/proc/%i/io", pid);
-	if ((fh = fopen (filename, "r")) == NULL)
-		return (NULL);
+	if (ps_read_file (pid, "io", buffer, sizeof (buffer)) < 0)
+		return (-1);
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	saveptr = NULL;
+	for (line = strtok_r (buffer, "\n", &saveptr);
+			line != NULL;
+			line = strtok_r (NULL, "\n", &saveptr))
 	{
 		derive_t *val = NULL;
 		long long tmp;
 		char *endptr;
 
-		if (strncasecmp (buffer, "rchar:", 6) == 0)
-			val = &(ps->io_rchar);
-		else if (strncasecmp (buffer, "wchar:", 6) == 0)
-			val = &(ps->io_wchar);
-		else if (strncasecmp (buffer, "syscr:", 6) == 0)
-			val = &(ps->io_syscr);
-		else if (strncasecmp (buffer, "syscw:", 6) == 0)
-			val = &(ps->io_syscw);
+		if (strncasecmp (line, "rchar:", 6) == 0)
+			val = &(entry->io_rchar);
+		else if (strncasecmp (line, "wchar:", 6) == 0)
+			val = &(entry->io_wchar);
+		else if (strncasecmp (line, "syscr:", 6) == 0)
+			val = &(entry->io_syscr);
+		else if (strncasecmp (line, "syscw:", 6) == 0)
+			val = &(entry->io_syscw);
 		else
 			continue;
 
-		numfields = strsplit (buffer, fields,
+		numfields = strsplit (line, fields,
 				STATIC_ARRAY_SIZE (fields));
 
 		if (numfields < 2)
@@ -861,48 +1101,120 @@ static procstat_t *ps_read_io (int pid, procstat_t *ps)
 			*val = -1;
 		else
 			*val = (derive_t) tmp;
-	} /* while (fgets) */
+	} /* for (line) */
 
-	if (fclose (fh))
-	{
+	return (0);
+} /* int ps_read_io */
+
+static char *ps_get_cmdline (pid_t pid, char *name, char *buf, size_t buf_len)
+{
+	ssize_t n;
+
+	if ((pid < 1) || (NULL == buf) || (buf_len < 2))
+		return NULL;
+
+	errno = 0;
+	n = ps_read_file (pid, "cmdline", buf, buf_len);
+	if (n < 0) {
 		char errbuf[1024];
-		WARNING ("processes: fclose: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
+		/* ENOENT and ESRCH mean the process exited while we were
+		 * handling it. Don't complain about this, it only fills the
+		 * logs. */
+		if ((errno != ENOENT) && (errno != ESRCH))
+			WARNING ("processes plugin: Failed to read "
+					"`/proc/%u/cmdline': %s.", (unsigned int) pid,
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+		return NULL;
+	}
+
+	if (0 == n) {
+		/* cmdline not available; e.g. kernel thread, zombie */
+		if (NULL == name)
+			return NULL;
+
+		ssnprintf (buf, buf_len, "[%s]", name);
+		return buf;
+	}
+
+	--n;
+	/* remove trailing whitespace */
+	while ((n > 0) && (isspace (buf[n]) || ('\0' == buf[n]))) {
+		buf[n] = '\0';
+		--n;
 	}
 
-	return (ps);
-} /* procstat_t *ps_read_io */
+	/* arguments are separated by '\0' in /proc/<pid>/cmdline */
+	while (n > 0) {
+		if ('\0' == buf[n])
+			buf[n] = ' ';
+		--n;
+	}
+	return buf;
+} /* char *ps_get_cmdline (...) */
 
-int ps_read_process (int pid, procstat_t *ps, char *state)
+/* Determines the groups the process `proc' belongs to. */
+static void ps_proc_match (ps_proc_t *proc)
 {
-	char  filename[64];
-	char  buffer[1024];
+	char  cmdline_buffer[ARG_MAX];
+	char *cmdline = NULL;
 
-	char *fields[64];
-	char  fields_len;
+	procstat_t **groups = NULL;
+	int groups_num = 0;
+	procstat_t *ps;
+
+	if (need_cmdline_g)
+		cmdline = ps_get_cmdline (proc->pid, proc->name,
+				cmdline_buffer, sizeof (cmdline_buffer));
+
+	for (ps = list_head_g; ps != NULL; ps = ps->next)
+		if (ps_list_match (proc->name, cmdline, ps) != 0)
+			groups_num++;
+
+	if (groups_num > 0)
+	{
+		groups = (procstat_t **) malloc (groups_num * sizeof (*groups));
+		if (groups == NULL)
+			return;
+
+		groups_num = 0;
+		for (ps = list_head_g; ps != NULL; ps = ps->next)
+			if (ps_list_match (proc->name, cmdline, ps) != 0)
+				groups[groups_num++] = ps;
+	}
 
-	int   buffer_len;
+	/* The counters are accounted to other groups now: start over, like for
+	 * a new process. */
+	if ((groups_num != proc->groups_num)
+			|| ((groups_num > 0) && (memcmp (groups, proc->groups,
+						groups_num * sizeof (*groups)) != 0)))
+		memset (&proc->entry, 0, sizeof (proc->entry));
+
+	sfree (proc->groups);
+	proc->groups = groups;
+	proc->groups_num = groups_num;
+	proc->matched = 1;
+} /* void ps_proc_match */
+
+/* Reads `/proc/<pid>/stat' of the process `proc' into `buffer' and splits it
+ * into `fields', starting after the name. Updates the name, state and groups
+ * of the process. Returns the number of fields or -1 on failure. */
+static int ps_proc_read_stat (ps_proc_t *proc, char *buffer, size_t buffer_size,
+		char **fields, size_t fields_num)
+{
+	ssize_t buffer_len;
+	int     fields_len;
 
 	char *buffer_ptr;
 	size_t name_start_pos;
 	size_t name_end_pos;
 	size_t name_len;
+	char   name[PROCSTAT_NAME_LEN];
 
-	long long unsigned cpu_user_counter;
-	long long unsigned cpu_system_counter;
-	long long unsigned vmem_size;
-	long long unsigned vmem_rss;
-	long long unsigned stack_size;
-
-	memset (ps, 0, sizeof (procstat_t));
-
-	ssnprintf (filename, sizeof (filename), "/proc/%i/stat", pid);
+	unsigned long long starttime;
 
-	buffer_len = read_file_contents (filename,
-			buffer, sizeof(buffer) - 1);
+	buffer_len = ps_read_file (proc->pid, "stat", buffer, buffer_size);
 	if (buffer_len <= 0)
 		return (-1);
-	buffer[buffer_len] = 0;
 
 	/* The name of the process is enclosed in parens. Since the name can
 	 * contain parens itself, spaces, numbers and pretty much everything
@@ -911,213 +1223,1312 @@ int ps_read_process (int pid, procstat_t *ps, char *state)
 	 * otherwise be required to determine name_len. */
 	name_start_pos = 0;
 	while ((buffer[name_start_pos] != '(')
-			&& (name_start_pos < buffer_len))
+			&& (name_start_pos < (size_t) buffer_len))
 		name_start_pos++;
 
-	name_end_pos = buffer_len;
-	while ((buffer[name_end_pos] != ')')
-			&& (name_end_pos > 0))
-		name_end_pos--;
+	name_end_pos = buffer_len;
+	while ((buffer[name_end_pos] != ')')
+			&& (name_end_pos > 0))
+		name_end_pos--;
+
+	/* Either '(' or ')' is not found or they are in the wrong order.
+	 * Anyway, something weird that shouldn't happen ever. */
+	if (name_start_pos >= name_end_pos)
+	{
+		ERROR ("processes plugin: name_start_pos = %zu >= name_end_pos = %zu",
+				name_start_pos, name_end_pos);
+		return (-1);
+	}
+
+	name_len = (name_end_pos - name_start_pos) - 1;
+	if (name_len >= sizeof (name))
+		name_len = sizeof (name) - 1;
+
+	sstrncpy (name, &buffer[name_start_pos + 1], name_len + 1);
+
+	if ((buffer_len - name_end_pos) < 2)
+		return (-1);
+	buffer_ptr = &buffer[name_end_pos + 2];
+
+	fields_len = strsplit (buffer_ptr, fields, fields_num);
+	if (fields_len < 27)
+	{
+		DEBUG ("processes plugin: ps_proc_read_stat (pid = %i):"
+				" `stat' has only %i fields..",
+				(int) proc->pid, fields_len);
+		return (-1);
+	}
+
+	proc->state = fields[0][0];
+
+	/* A different start time means the PID has been reused by another
+	 * process. */
+	starttime = atoll (fields[19]);
+	if (starttime != proc->starttime)
+	{
+		proc->starttime = starttime;
+		proc->matched = 0;
+		sfree (proc->groups);
+		proc->groups_num = 0;
+		memset (&proc->entry, 0, sizeof (proc->entry));
+	}
+
+	if (strcmp (name, proc->name) != 0)
+	{
+		sstrncpy (proc->name, name, sizeof (proc->name));
+		proc->matched = 0;
+	}
+
+	if (!proc->matched)
+		ps_proc_match (proc);
+
+	return (fields_len);
+} /* int ps_proc_read_stat */
+
+/* Reads `/proc/<pid>/stat' of the process `proc' and, if it belongs to any
+ * group, the other values into `proc->sample'. */
+static int ps_proc_read (ps_proc_t *proc)
+{
+	char  buffer[1024];
+	char *fields[64];
+
+	long long unsigned cpu_user_counter;
+	long long unsigned cpu_system_counter;
+	long long unsigned vmem_size;
+	long long unsigned vmem_rss;
+	long long unsigned stack_size;
+
+	procstat_entry_t *ps = &proc->sample;
+
+	if (ps_proc_read_stat (proc, buffer, sizeof (buffer),
+				fields, STATIC_ARRAY_SIZE (fields)) < 0)
+		return (-1);
+
+	/* Only the state is needed for processes not belonging to any group. */
+	if (proc->groups_num == 0)
+		return (0);
+
+	memset (ps, 0, sizeof (*ps));
+	ps->id = proc->pid;
+
+	/* Leave the rest at zero if this is only a zombi */
+	if (proc->state == 'Z')
+	{
+		DEBUG ("processes plugin: This is only a zombi: pid = %i; "
+				"name = %s;", (int) proc->pid, proc->name);
+		return (0);
+	}
+
+	ps->num_proc = 1;
+	ps->num_lwp  = atol (fields[17]);
+	if (ps->num_lwp < 1)
+		ps->num_lwp = 1;
+
+	cpu_user_counter   = atoll (fields[11]);
+	cpu_system_counter = atoll (fields[12]);
+	vmem_size          = atoll (fields[20]);
+	vmem_rss           = atoll (fields[21]);
+	ps->vmem_minflt_counter = atol (fields[7]);
+	ps->vmem_majflt_counter = atol (fields[9]);
+
+	{
+		unsigned long long stack_start = atoll (fields[25]);
+		unsigned long long stack_ptr   = atoll (fields[26]);
+
+		stack_size = (stack_start > stack_ptr)
+			? stack_start - stack_ptr
+			: stack_ptr - stack_start;
+	}
+
+	/* Convert jiffies to useconds */
+	cpu_user_counter   = cpu_user_counter   * 1000000 / CONFIG_HZ;
+	cpu_system_counter = cpu_system_counter * 1000000 / CONFIG_HZ;
+	vmem_rss = vmem_rss * pagesize_g;
+
+	if (ps_read_vmem (proc->pid, ps) != 0)
+	{
+		/* No VMem data */
+		ps->vmem_data = -1;
+		ps->vmem_code = -1;
+		DEBUG("ps_proc_read: did not get vmem data for pid %i",
+				(int) proc->pid);
+	}
+
+	ps->cpu_user_counter = (unsigned long) cpu_user_counter;
+	ps->cpu_system_counter = (unsigned long) cpu_system_counter;
+	ps->vmem_size = (unsigned long) vmem_size;
+	ps->vmem_rss = (unsigned long) vmem_rss;
+	ps->stack_size = (unsigned long) stack_size;
+
+	if (ps_read_io (proc->pid, ps) != 0)
+	{
+		/* no io data */
+		ps->io_rchar = -1;
+		ps->io_wchar = -1;
+		ps->io_syscr = -1;
+		ps->io_syscw = -1;
+
+		DEBUG("ps_proc_read: not get io data for pid %i",
+				(int) proc->pid);
+	}
+
+	/* success */
+	return (0);
+} /* int ps_proc_read */
+
+static int ps_proc_table_resize (size_t size)
+{
+	ps_proc_t **table;
+	size_t i;
+
+	table = (ps_proc_t **) calloc (size, sizeof (*table));
+	if (table == NULL)
+		return (-1);
+
+	for (i = 0; i < proc_table_size; i++)
+	{
+		ps_proc_t *proc = proc_table[i];
+
+		while (proc != NULL)
+		{
+			ps_proc_t *next = proc->next;
+			size_t hash = ((size_t) proc->pid) & (size - 1);
+
+			proc->next = table[hash];
+			table[hash] = proc;
+			proc = next;
+		}
+	}
+
+	sfree (proc_table);
+	proc_table = table;
+	proc_table_size = size;
+
+	return (0);
+} /* int ps_proc_table_resize */
+
+/* Returns the state of the process `pid' or NULL if it is not known. */
+static ps_proc_t *ps_proc_find (pid_t pid)
+{
+	ps_proc_t *proc;
+
+	if (proc_table_size == 0)
+		return (NULL);
+
+	proc = proc_table[((size_t) pid) & (proc_table_size - 1)];
+	for (; proc != NULL; proc = proc->next)
+		if (proc->pid == pid)
+			return (proc);
+
+	return (NULL);
+} /* ps_proc_t *ps_proc_find */
+
+/* Returns the state of the process `pid', creating it if necessary. */
+static ps_proc_t *ps_proc_get (pid_t pid)
+{
+	ps_proc_t *proc;
+	size_t hash;
+
+	proc = ps_proc_find (pid);
+	if (proc != NULL)
+		return (proc);
+
+	if ((proc_table_size == 0)
+			&& (ps_proc_table_resize (PS_PROC_TABLE_MIN) != 0))
+		return (NULL);
+	hash = ((size_t) pid) & (proc_table_size - 1);
+
+	/* Keep the chains short. Failing to grow the table is not fatal. */
+	if ((proc_table_num >= proc_table_size)
+			&& (ps_proc_table_resize (2 * proc_table_size) == 0))
+		hash = ((size_t) pid) & (proc_table_size - 1);
+
+	proc = (ps_proc_t *) calloc (1, sizeof (*proc));
+	if (proc == NULL)
+		return (NULL);
+	proc->pid = pid;
+
+	proc->next = proc_table[hash];
+	proc_table[hash] = proc;
+	proc_table_num++;
+
+	return (proc);
+} /* ps_proc_t *ps_proc_get */
+
+/* Removes processes which have not been found by the last scan. */
+static void ps_proc_expire (void)
+{
+	size_t i;
+
+	for (i = 0; i < proc_table_size; i++)
+	{
+		ps_proc_t **prev = &proc_table[i];
+
+		while (*prev != NULL)
+		{
+			ps_proc_t *proc = *prev;
+
+			if (proc->scan == proc_scan)
+			{
+				prev = &proc->next;
+				continue;
+			}
+
+			*prev = proc->next;
+			sfree (proc->groups);
+			free (proc);
+			proc_table_num--;
+		}
+	}
+} /* void ps_proc_expire */
+
+/* Appends `proc' to `scan_list'. */
+static int ps_scan_add (ps_proc_t *proc)
+{
+	if (scan_num >= scan_list_size)
+	{
+		size_t size = (scan_list_size > 0)
+			? 2 * scan_list_size : PS_PROC_TABLE_MIN;
+		ps_proc_t **tmp;
+
+		tmp = (ps_proc_t **) realloc (scan_list, size * sizeof (*tmp));
+		if (tmp == NULL)
+		{
+			ERROR ("processes plugin: realloc failed.");
+			return (-1);
+		}
+		scan_list = tmp;
+		scan_list_size = size;
+	}
+
+	proc->scan = proc_scan;
+	scan_list[scan_num] = proc;
+	scan_num++;
+
+	return (0);
+} /* int ps_scan_add */
+
+/* Lists the processes currently in `/proc' in `scan_list'. */
+static int ps_scan (void)
+{
+	struct dirent *ent;
+
+	if (proc_dir == NULL)
+	{
+		proc_dir = opendir ("/proc");
+		if (proc_dir == NULL)
+		{
+			char errbuf[1024];
+			ERROR ("Cannot open `/proc': %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			return (-1);
+		}
+	}
+	else
+	{
+		rewinddir (proc_dir);
+	}
+
+	proc_scan++;
+	scan_num = 0;
+
+	while ((ent = readdir (proc_dir)) != NULL)
+	{
+		ps_proc_t *proc;
+		int pid;
+
+		if (!isdigit ((int) ent->d_name[0]))
+			continue;
+
+		if ((pid = atoi (ent->d_name)) < 1)
+			continue;
+
+		proc = ps_proc_get ((pid_t) pid);
+		if (proc == NULL)
+		{
+			ERROR ("processes plugin: calloc failed.");
+			break;
+		}
+
+		if (ps_scan_add (proc) != 0)
+			break;
+	}
+
+	return (0);
+} /* int ps_scan */
+
+static void ps_scan_read_chunk (size_t chunk)
+{
+	size_t i;
+	size_t end;
+
+	end = (chunk + 1) * PS_CHUNK_SIZE;
+	if (end > scan_num)
+		end = scan_num;
+
+	for (i = chunk * PS_CHUNK_SIZE; i < end; i++)
+		scan_list[i]->status = ps_proc_read (scan_list[i]);
+} /* void ps_scan_read_chunk */
+
+static void *ps_worker (void *arg)
+{
+	pthread_mutex_lock (&ps_work_lock);
+	while (!ps_work_shutdown)
+	{
+		size_t chunk;
+
+		if (ps_work_next >= ps_work_num)
+		{
+			pthread_cond_wait (&ps_work_cond, &ps_work_lock);
+			continue;
+		}
+
+		chunk = ps_work_next;
+		ps_work_next++;
+		pthread_mutex_unlock (&ps_work_lock);
+
+		ps_scan_read_chunk (chunk);
+
+		pthread_mutex_lock (&ps_work_lock);
+		ps_work_pending--;
+		if (ps_work_pending == 0)
+			pthread_cond_signal (&ps_work_done_cond);
+	}
+	pthread_mutex_unlock (&ps_work_lock);
+
+	return (NULL);
+} /* void *ps_worker */
+
+static int ps_start_threads (void)
+{
+	int i;
+
+	if (ps_threads_running > 0)
+		return (0);
+
+	ps_threads = (pthread_t *) calloc (ps_threads_num, sizeof (*ps_threads));
+	if (ps_threads == NULL)
+	{
+		ERROR ("processes plugin: calloc failed.");
+		return (-1);
+	}
+
+	ps_work_shutdown = 0;
+	for (i = 0; i < ps_threads_num; i++)
+	{
+		if (pthread_create (ps_threads + i, /* attr = */ NULL,
+					ps_worker, /* arg = */ NULL) != 0)
+		{
+			char errbuf[1024];
+			ERROR ("processes plugin: pthread_create failed: %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			break;
+		}
+		ps_threads_running++;
+	}
+
+	if (ps_threads_running == 0)
+	{
+		sfree (ps_threads);
+		return (-1);
+	}
+
+	return (0);
+} /* int ps_start_threads */
+
+static void ps_stop_threads (void)
+{
+	int i;
+
+	if (ps_threads_running == 0)
+		return;
+
+	pthread_mutex_lock (&ps_work_lock);
+	ps_work_shutdown = 1;
+	pthread_cond_broadcast (&ps_work_cond);
+	pthread_mutex_unlock (&ps_work_lock);
+
+	for (i = 0; i < ps_threads_running; i++)
+		pthread_join (ps_threads[i], /* retval = */ NULL);
+
+	sfree (ps_threads);
+	ps_threads_running = 0;
+} /* void ps_stop_threads */
+
+/* Reads the processes found by the last scan, using the worker threads if
+ * there are enough of them. */
+static void ps_scan_read (void)
+{
+	size_t chunks;
+	size_t i;
+
+	chunks = (scan_num + PS_CHUNK_SIZE - 1) / PS_CHUNK_SIZE;
+
+	if ((ps_threads_num < 2) || (chunks < 2) || (ps_start_threads () != 0))
+	{
+		for (i = 0; i < chunks; i++)
+			ps_scan_read_chunk (i);
+		return;
+	}
+
+	pthread_mutex_lock (&ps_work_lock);
+	ps_work_next = 0;
+	ps_work_num = chunks;
+	ps_work_pending = chunks;
+	pthread_cond_broadcast (&ps_work_cond);
+
+	while (ps_work_pending > 0)
+		pthread_cond_wait (&ps_work_done_cond, &ps_work_lock);
+
+	ps_work_next = 0;
+	ps_work_num = 0;
+	pthread_mutex_unlock (&ps_work_lock);
+} /* void ps_scan_read */
+
+#if PS_NETLINK
+/* Resets the state of `proc' for a new process with the same PID. */
+static void ps_proc_reset (ps_proc_t *proc)
+{
+	pid_t pid = proc->pid;
+	ps_proc_t *next = proc->next;
+
+	sfree (proc->groups);
+	memset (proc, 0, sizeof (*proc));
+	proc->pid = pid;
+	proc->next = next;
+} /* void ps_proc_reset */
+
+/* Lists the processes which have to be read in `scan_list': the processes
+ * belonging to a group and those which haven't been matched yet. */
+static void ps_nl_scan (void)
+{
+	size_t i;
+
+	proc_scan++;
+	scan_num = 0;
+
+	for (i = 0; i < proc_table_size; i++)
+	{
+		ps_proc_t *proc;
+
+		for (proc = proc_table[i]; proc != NULL; proc = proc->next)
+		{
+			if (proc->dead)
+				continue;
+
+			proc->scan = proc_scan;
+			if (proc->matched && (proc->groups_num == 0)
+					&& !proc->exiting)
+				continue;
+
+			if (ps_scan_add (proc) != 0)
+				return;
+		}
+	}
+} /* void ps_nl_scan */
+
+/* Accounts the final counters of the exited process `proc' to its groups. */
+static void ps_proc_account_exit (ps_proc_t *proc)
+{
+	procstat_entry_t *last = &proc->entry;
+	procstat_entry_t *final = &proc->exit;
+	int i;
+
+	/* The accounting data only covers the main thread. Don't let the
+	 * counters of multi-threaded processes go backwards. */
+	if (final->cpu_user_counter < last->cpu_user_counter)
+		final->cpu_user_counter = last->cpu_user_counter;
+	if (final->cpu_system_counter < last->cpu_system_counter)
+		final->cpu_system_counter = last->cpu_system_counter;
+	if (final->vmem_minflt_counter < last->vmem_minflt_counter)
+		final->vmem_minflt_counter = last->vmem_minflt_counter;
+	if (final->vmem_majflt_counter < last->vmem_majflt_counter)
+		final->vmem_majflt_counter = last->vmem_majflt_counter;
+	if (final->io_rchar < last->io_rchar)
+		final->io_rchar = last->io_rchar;
+	if (final->io_wchar < last->io_wchar)
+		final->io_wchar = last->io_wchar;
+	if (final->io_syscr < last->io_syscr)
+		final->io_syscr = last->io_syscr;
+	if (final->io_syscw < last->io_syscw)
+		final->io_syscw = last->io_syscw;
+
+	ps_entry_update (last, final);
+
+	for (i = 0; i < proc->groups_num; i++)
+	{
+		procstat_t *ps = proc->groups[i];
+
+		ps->vmem_minflt_counter += last->vmem_minflt;
+		ps->vmem_majflt_counter += last->vmem_majflt;
+
+		ps->cpu_user_counter   += last->cpu_user;
+		ps->cpu_system_counter += last->cpu_system;
+
+		ps->io_rchar_exited += final->io_rchar;
+		ps->io_wchar_exited += final->io_wchar;
+		ps->io_syscr_exited += final->io_syscr;
+		ps->io_syscw_exited += final->io_syscw;
+	}
+} /* void ps_proc_account_exit */
+
+/* Accounts the processes which have exited since the last read to their
+ * groups and marks them for removal by ps_proc_expire. */
+static void ps_nl_collect_exits (void)
+{
+	procstat_t *ps;
+	size_t i;
+
+	for (i = 0; i < proc_table_size; i++)
+	{
+		ps_proc_t *proc;
+
+		for (proc = proc_table[i]; proc != NULL; proc = proc->next)
+		{
+			if (!proc->dead)
+				continue;
+
+			proc->scan = proc_scan - 1;
+			if (proc->exit_valid && (proc->groups_num > 0))
+				ps_proc_account_exit (proc);
+		}
+	}
+
+	/* Keep the io counters of the groups from going backwards when
+	 * processes exit. */
+	for (ps = list_head_g; ps != NULL; ps = ps->next)
+	{
+		if ((ps->io_rchar_exited == 0) && (ps->io_syscr_exited == 0))
+			continue;
+
+		if (ps->io_rchar == -1)
+		{
+			ps->io_rchar = 0;
+			ps->io_wchar = 0;
+			ps->io_syscr = 0;
+			ps->io_syscw = 0;
+		}
+
+		ps->io_rchar += ps->io_rchar_exited;
+		ps->io_wchar += ps->io_wchar_exited;
+		ps->io_syscr += ps->io_syscr_exited;
+		ps->io_syscw += ps->io_syscw_exited;
+	}
+} /* void ps_nl_collect_exits */
+
+/* A new process has been forked. Until it calls exec(2), it belongs to the
+ * same groups as its parent. */
+static void ps_nl_fork (pid_t ppid, pid_t pid)
+{
+	ps_proc_t *parent;
+	ps_proc_t *proc;
+
+	proc = ps_proc_get (pid);
+	if (proc == NULL)
+		return;
+	ps_proc_reset (proc);
+
+	parent = ps_proc_find (ppid);
+	if ((parent == NULL) || !parent->matched || parent->dead)
+		return;
+
+	if (parent->groups_num > 0)
+	{
+		proc->groups = (procstat_t **) malloc (parent->groups_num
+				* sizeof (*proc->groups));
+		if (proc->groups == NULL)
+			return;
+		memcpy (proc->groups, parent->groups,
+				parent->groups_num * sizeof (*proc->groups));
+		proc->groups_num = parent->groups_num;
+	}
+
+	sstrncpy (proc->name, parent->name, sizeof (proc->name));
+	proc->matched = 1;
+} /* void ps_nl_fork */
+
+/* A process has called exec(2). Determine its groups right away, it may be
+ * gone by the next read. */
+static void ps_nl_exec (pid_t pid)
+{
+	char  buffer[1024];
+	char *fields[64];
+	ps_proc_t *proc;
+
+	proc = ps_proc_get (pid);
+	if (proc == NULL)
+		return;
+
+	if (proc->dead)
+		ps_proc_reset (proc);
+	/* The thread calling exec(2) becomes the main thread. */
+	proc->exiting = 0;
+	proc->matched = 0;
+
+	ps_proc_read_stat (proc, buffer, sizeof (buffer),
+			fields, STATIC_ARRAY_SIZE (fields));
+} /* void ps_nl_exec */
+
+/* Returns the number of threads of the process `pid' or -1 on failure. */
+static int ps_read_threads (pid_t pid)
+{
+	char buffer[4096];
+	char *line;
+	char *saveptr;
+
+	if (ps_read_file (pid, "status", buffer, sizeof (buffer)) < 0)
+		return (-1);
+
+	saveptr = NULL;
+	for (line = strtok_r (buffer, "\n", &saveptr);
+			line != NULL;
+			line = strtok_r (NULL, "\n", &saveptr))
+	{
+		if (strncmp (line, "Threads:", 8) == 0)
+			return (atoi (line + 8));
+	}
+
+	return (-1);
+} /* int ps_read_threads */
+
+static void ps_cn_handle (const struct nlmsghdr *nlh)
+{
+	const struct cn_msg *cn;
+	struct proc_event ev;
+
+	if (nlh->nlmsg_len < NLMSG_LENGTH (sizeof (*cn)))
+		return;
+	cn = NLMSG_DATA (nlh);
+
+	if ((cn->id.idx != CN_IDX_PROC) || (cn->id.val != CN_VAL_PROC)
+			|| (nlh->nlmsg_len < NLMSG_LENGTH (sizeof (*cn) + cn->len))
+			|| (cn->len < offsetof (struct proc_event, event_data)
+				+ sizeof (ev.event_data.fork)))
+		return;
+
+	/* The data isn't necessarily aligned. */
+	memset (&ev, 0, sizeof (ev));
+	memcpy (&ev, cn->data, (cn->len < sizeof (ev)) ? cn->len : sizeof (ev));
+
+	switch (ev.what)
+	{
+		case PROC_EVENT_NONE:
+			/* The acknowledgement of PROC_CN_MCAST_LISTEN. Events
+			 * before it may have been missed. */
+			if (cn->ack != (uint32_t) getpid () + 1)
+				break;
+			if (ev.event_data.ack.err != 0)
+			{
+				char errbuf[1024];
+				ERROR ("processes plugin: Subscribing to process "
+						"events failed: %s", sstrerror (ev.event_data.ack.err,
+							errbuf, sizeof (errbuf)));
+				ps_nl_failed = 1;
+			}
+			else if (!ps_nl_listening)
+			{
+				ps_nl_listening = 1;
+				ps_nl_resync = 1;
+			}
+			break;
+
+		case PROC_EVENT_FORK:
+			/* Threads are accounted to their process. */
+			if (ev.event_data.fork.child_pid
+					!= ev.event_data.fork.child_tgid)
+				break;
+			ps_nl_fork (ev.event_data.fork.parent_tgid,
+					ev.event_data.fork.child_pid);
+			break;
+
+		case PROC_EVENT_EXEC:
+			ps_nl_exec (ev.event_data.exec.process_tgid);
+			break;
+
+#if HAVE_DECL_PROC_EVENT_COMM
+		case PROC_EVENT_COMM:
+			if (ev.event_data.comm.process_pid
+					!= ev.event_data.comm.process_tgid)
+				break;
+			ps_nl_exec (ev.event_data.comm.process_pid);
+			break;
+#endif
+
+		case PROC_EVENT_EXIT:
+		{
+			ps_proc_t *proc;
+
+			/* Threads are accounted to their process. */
+			if (ev.event_data.exit.process_pid
+					!= ev.event_data.exit.process_tgid)
+				break;
+
+			proc = ps_proc_find (ev.event_data.exit.process_pid);
+			if (proc == NULL)
+				break;
+
+			/* The exiting main thread is still counted. If other
+			 * threads keep running, the process is read until the
+			 * read fails. */
+			if (ps_read_threads (proc->pid) > 1)
+				proc->exiting = 1;
+			else
+				proc->dead = 1;
+			break;
+		}
+
+		default:
+			break;
+	}
+} /* void ps_cn_handle */
+
+/* Returns the attribute `type' of the `len' bytes of attributes at `data' or
+ * NULL if there is no such attribute. */
+static const struct nlattr *ps_nl_attr_find (const void *data, size_t len,
+		int type)
+{
+	const char *ptr = data;
+
+	while (len >= NLA_HDRLEN)
+	{
+		const struct nlattr *nla = (const struct nlattr *) ptr;
+		size_t nla_len = nla->nla_len;
+
+		if ((nla_len < NLA_HDRLEN) || (nla_len > len))
+			break;
+
+		if ((nla->nla_type & NLA_TYPE_MASK) == type)
+			return (nla);
+
+		nla_len = NLA_ALIGN (nla_len);
+		if (nla_len >= len)
+			break;
+		ptr += nla_len;
+		len -= nla_len;
+	}
+
+	return (NULL);
+} /* const struct nlattr *ps_nl_attr_find */
+
+#define PS_NLA_DATA(nla) ((const void *) (((const char *) (nla)) + NLA_HDRLEN))
+#define PS_NLA_LEN(nla) ((size_t) ((nla)->nla_len - NLA_HDRLEN))
+
+/* Appends the attribute `type' to the message `nlh'. */
+static void ps_nl_attr_put (struct nlmsghdr *nlh, int type,
+		const void *data, size_t data_len)
+{
+	struct nlattr *nla;
+
+	nla = (struct nlattr *) (((char *) nlh) + NLMSG_ALIGN (nlh->nlmsg_len));
+	nla->nla_type = type;
+	nla->nla_len = NLA_HDRLEN + data_len;
+	memcpy (((char *) nla) + NLA_HDRLEN, data, data_len);
+
+	nlh->nlmsg_len = NLMSG_ALIGN (nlh->nlmsg_len) + NLA_ALIGN (nla->nla_len);
+} /* void ps_nl_attr_put */
+
+/* Handles the accounting data the kernel sends when a task exits. */
+static void ps_ts_handle (const struct nlmsghdr *nlh)
+{
+	const struct genlmsghdr *genlh;
+	const struct nlattr *aggr;
+	const struct nlattr *nla;
+	struct taskstats ts;
+	ps_proc_t *proc;
+	uint32_t pid;
+
+	if ((nlh->nlmsg_type != ps_ts_family)
+			|| (nlh->nlmsg_len < NLMSG_LENGTH (GENL_HDRLEN)))
+		return;
+
+	genlh = NLMSG_DATA (nlh);
+	if (genlh->cmd != TASKSTATS_CMD_NEW)
+		return;
+
+	aggr = ps_nl_attr_find (((const char *) genlh) + GENL_HDRLEN,
+			nlh->nlmsg_len - NLMSG_LENGTH (GENL_HDRLEN),
+			TASKSTATS_TYPE_AGGR_PID);
+	if (aggr == NULL)
+		return;
+
+	nla = ps_nl_attr_find (PS_NLA_DATA (aggr), PS_NLA_LEN (aggr),
+			TASKSTATS_TYPE_PID);
+	if ((nla == NULL) || (PS_NLA_LEN (nla) < sizeof (pid)))
+		return;
+	memcpy (&pid, PS_NLA_DATA (nla), sizeof (pid));
+
+	/* Only processes are in the table, the exits of other threads are
+	 * ignored. */
+	proc = ps_proc_find ((pid_t) pid);
+	if (proc == NULL)
+		return;
+
+	nla = ps_nl_attr_find (PS_NLA_DATA (aggr), PS_NLA_LEN (aggr),
+			TASKSTATS_TYPE_STATS);
+	if (nla == NULL)
+		return;
 
-	/* Either '(' or ')' is not found or they are in the wrong order.
-	 * Anyway, something weird that shouldn't happen ever. */
-	if (name_start_pos >= name_end_pos)
+	memset (&ts, 0, sizeof (ts));
+	memcpy (&ts, PS_NLA_DATA (nla),
+			(PS_NLA_LEN (nla) < sizeof (ts)) ? PS_NLA_LEN (nla) : sizeof (ts));
+
+	/* The process has not been read yet, so only `Process' can match. */
+	if (!proc->matched)
 	{
-		ERROR ("processes plugin: name_start_pos = %zu >= name_end_pos = %zu",
-				name_start_pos, name_end_pos);
-		return (-1);
+		sstrncpy (proc->name, ts.ac_comm, sizeof (proc->name));
+		ps_proc_match (proc);
 	}
 
-	name_len = (name_end_pos - name_start_pos) - 1;
-	if (name_len >= sizeof (ps->name))
-		name_len = sizeof (ps->name) - 1;
-
-	sstrncpy (ps->name, &buffer[name_start_pos + 1], name_len + 1);
+	if (proc->groups_num == 0)
+		return;
 
-	if ((buffer_len - name_end_pos) < 2)
-		return (-1);
-	buffer_ptr = &buffer[name_end_pos + 2];
+	memset (&proc->exit, 0, sizeof (proc->exit));
+	proc->exit.id = proc->pid;
+	proc->exit.cpu_user_counter    = (unsigned long) ts.ac_utime;
+	proc->exit.cpu_system_counter  = (unsigned long) ts.ac_stime;
+	proc->exit.vmem_minflt_counter = (unsigned long) ts.ac_minflt;
+	proc->exit.vmem_majflt_counter = (unsigned long) ts.ac_majflt;
+	proc->exit.io_rchar = (derive_t) ts.read_char;
+	proc->exit.io_wchar = (derive_t) ts.write_char;
+	proc->exit.io_syscr = (derive_t) ts.read_syscalls;
+	proc->exit.io_syscw = (derive_t) ts.write_syscalls;
+	proc->exit_valid = 1;
+} /* void ps_ts_handle */
+
+static int ps_nl_open (int protocol, uint32_t groups)
+{
+	struct sockaddr_nl sa;
+	int bufsize = PS_NL_RCVBUF;
+	int fd;
 
-	fields_len = strsplit (buffer_ptr, fields, STATIC_ARRAY_SIZE (fields));
-	if (fields_len < 22)
+	fd = socket (AF_NETLINK, SOCK_DGRAM, protocol);
+	if (fd < 0)
 	{
-		DEBUG ("processes plugin: ps_read_process (pid = %i):"
-				" `%s' has only %i fields..",
-				(int) pid, filename, fields_len);
+		char errbuf[1024];
+		ERROR ("processes plugin: socket (AF_NETLINK) failed: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	*state = fields[0][0];
+	/* SO_RCVBUF is limited by net.core.rmem_max, SO_RCVBUFFORCE requires
+	 * CAP_NET_ADMIN, which is needed for the process events anyway. Not
+	 * fatal, only more events may be lost. */
+#ifdef SO_RCVBUFFORCE
+	if (setsockopt (fd, SOL_SOCKET, SO_RCVBUFFORCE,
+				&bufsize, sizeof (bufsize)) != 0)
+#endif
+		setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof (bufsize));
 
-	if (*state == 'Z')
+	memset (&sa, 0, sizeof (sa));
+	sa.nl_family = AF_NETLINK;
+	sa.nl_groups = groups;
+	if (bind (fd, (struct sockaddr *) &sa, sizeof (sa)) != 0)
 	{
-		ps->num_lwp  = 0;
-		ps->num_proc = 0;
+		char errbuf[1024];
+		ERROR ("processes plugin: bind (AF_NETLINK) failed: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		close (fd);
+		return (-1);
 	}
-	else
+
+	return (fd);
+} /* int ps_nl_open */
+
+/* Subscribes to or unsubscribes from the process events. The kernel
+ * acknowledges the request with an event, see ps_cn_handle. Returns zero or a
+ * negative error code. */
+static int ps_cn_control (enum proc_cn_mcast_op op)
+{
+	char buffer[NLMSG_SPACE (sizeof (struct cn_msg)
+			+ sizeof (enum proc_cn_mcast_op))];
+	struct nlmsghdr *nlh = (struct nlmsghdr *) buffer;
+	struct cn_msg *cn;
+
+	memset (buffer, 0, sizeof (buffer));
+	nlh->nlmsg_len = NLMSG_LENGTH (sizeof (*cn) + sizeof (op));
+	nlh->nlmsg_type = NLMSG_DONE;
+	nlh->nlmsg_seq = ++ps_nl_seq;
+
+	cn = NLMSG_DATA (nlh);
+	cn->id.idx = CN_IDX_PROC;
+	cn->id.val = CN_VAL_PROC;
+	cn->seq = nlh->nlmsg_seq;
+	/* Tells our acknowledgement apart from those of other listeners. */
+	cn->ack = (uint32_t) getpid ();
+	cn->len = sizeof (op);
+	memcpy (cn->data, &op, sizeof (op));
+
+	if (send (ps_cn_sock, buffer, nlh->nlmsg_len, 0) < 0)
+		return (-errno);
+
+	return (0);
+} /* int ps_cn_control */
+
+/* Sends a request to the generic netlink socket and waits for the
+ * acknowledgement. Replies are passed to `handler'. Returns zero or a
+ * negative error code. */
+static int ps_ts_request (struct nlmsghdr *nlh,
+		void (*handler) (const struct nlmsghdr *))
+{
+	nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+	nlh->nlmsg_seq = ++ps_nl_seq;
+
+	if (send (ps_ts_sock, nlh, nlh->nlmsg_len, 0) < 0)
+		return (-errno);
+
+	while (42)
 	{
-		if ( (ps->num_lwp = ps_read_tasks (pid)) == -1 )
+		struct nlmsghdr *h;
+		ssize_t len;
+
+		len = recv (ps_ts_sock, ps_nl_buffer, sizeof (ps_nl_buffer), 0);
+		if (len < 0)
 		{
-			/* returns -1 => kernel 2.4 */
-			ps->num_lwp = 1;
+			if ((errno == EINTR) || (errno == ENOBUFS))
+				continue;
+			return (-errno);
 		}
-		ps->num_proc = 1;
-	}
 
-	/* Leave the rest at zero if this is only a zombi */
-	if (ps->num_proc == 0)
-	{
-		DEBUG ("processes plugin: This is only a zombi: pid = %i; "
-				"name = %s;", pid, ps->name);
-		return (0);
+		for (h = (struct nlmsghdr *) ps_nl_buffer;
+				NLMSG_OK (h, (size_t) len);
+				h = NLMSG_NEXT (h, len))
+		{
+			if (h->nlmsg_seq != nlh->nlmsg_seq)
+				continue;
+
+			if (h->nlmsg_type == NLMSG_ERROR)
+			{
+				const struct nlmsgerr *err = NLMSG_DATA (h);
+				return (err->error);
+			}
+
+			if (handler != NULL)
+				handler (h);
+		}
 	}
 
-	cpu_user_counter   = atoll (fields[11]);
-	cpu_system_counter = atoll (fields[12]);
-	vmem_size          = atoll (fields[20]);
-	vmem_rss           = atoll (fields[21]);
-	ps->vmem_minflt_counter = atol (fields[7]);
-	ps->vmem_majflt_counter = atol (fields[9]);
+	/* not reached */
+	return (-EIO);
+} /* int ps_ts_request */
 
-	{
-		unsigned long long stack_start = atoll (fields[25]);
-		unsigned long long stack_ptr   = atoll (fields[26]);
+static void ps_ts_family_handle (const struct nlmsghdr *nlh)
+{
+	const struct genlmsghdr *genlh;
+	const struct nlattr *nla;
 
-		stack_size = (stack_start > stack_ptr)
-			? stack_start - stack_ptr
-			: stack_ptr - stack_start;
-	}
+	if (nlh->nlmsg_len < NLMSG_LENGTH (GENL_HDRLEN))
+		return;
+	genlh = NLMSG_DATA (nlh);
+
+	nla = ps_nl_attr_find (((const char *) genlh) + GENL_HDRLEN,
+			nlh->nlmsg_len - NLMSG_LENGTH (GENL_HDRLEN),
+			CTRL_ATTR_FAMILY_ID);
+	if ((nla != NULL) && (PS_NLA_LEN (nla) >= sizeof (ps_ts_family)))
+		memcpy (&ps_ts_family, PS_NLA_DATA (nla), sizeof (ps_ts_family));
+} /* void ps_ts_family_handle */
+
+/* Sends the command `cmd' with the attribute `attr' of `attr_len' bytes to
+ * the generic netlink family `family'. */
+static int ps_ts_command (uint16_t family, uint8_t cmd, uint8_t version,
+		int attr, const void *attr_data, size_t attr_len,
+		void (*handler) (const struct nlmsghdr *))
+{
+	char buffer[512];
+	struct nlmsghdr *nlh = (struct nlmsghdr *) buffer;
+	struct genlmsghdr *genlh;
 
-	/* Convert jiffies to useconds */
-	cpu_user_counter   = cpu_user_counter   * 1000000 / CONFIG_HZ;
-	cpu_system_counter = cpu_system_counter * 1000000 / CONFIG_HZ;
-	vmem_rss = vmem_rss * pagesize_g;
+	if (NLMSG_SPACE (GENL_HDRLEN) + NLA_HDRLEN + NLA_ALIGN (attr_len)
+			> sizeof (buffer))
+		return (-EINVAL);
+
+	memset (buffer, 0, sizeof (buffer));
+	nlh->nlmsg_len = NLMSG_LENGTH (GENL_HDRLEN);
+	nlh->nlmsg_type = family;
+
+	genlh = NLMSG_DATA (nlh);
+	genlh->cmd = cmd;
+	genlh->version = version;
+
+	ps_nl_attr_put (nlh, attr, attr_data, attr_len);
 
-	if ( (ps_read_vmem(pid, ps)) == NULL)
+	return (ps_ts_request (nlh, handler));
+} /* int ps_ts_command */
+
+/* Passes the messages in the `len' bytes at `data' to `handler'. */
+static void ps_nl_handle (void (*handler) (const struct nlmsghdr *),
+		char *data, ssize_t len)
+{
+	struct nlmsghdr *nlh;
+
+	for (nlh = (struct nlmsghdr *) data;
+			NLMSG_OK (nlh, (size_t) len);
+			nlh = NLMSG_NEXT (nlh, len))
+		handler (nlh);
+} /* void ps_nl_handle */
+
+/* Keeps the `len' bytes of messages in `ps_nl_buffer' until ps_read is done
+ * reading the processes. Must be called with `ps_lock' held. */
+static void ps_nl_defer (void (*handler) (const struct nlmsghdr *),
+		ssize_t len)
+{
+	ps_nl_msg_t *msg;
+
+	msg = NULL;
+	if (ps_nl_deferred_size + len <= PS_NL_DEFERRED_MAX)
+		msg = (ps_nl_msg_t *) malloc (sizeof (*msg) + len);
+	if (msg == NULL)
 	{
-		/* No VMem data */
-		ps->vmem_data = -1;
-		ps->vmem_code = -1;
-		DEBUG("ps_read_process: did not get vmem data for pid %i",pid);
+		/* Events have been lost. */
+		ps_nl_resync = 1;
+		return;
 	}
 
-	ps->cpu_user_counter = (unsigned long) cpu_user_counter;
-	ps->cpu_system_counter = (unsigned long) cpu_system_counter;
-	ps->vmem_size = (unsigned long) vmem_size;
-	ps->vmem_rss = (unsigned long) vmem_rss;
-	ps->stack_size = (unsigned long) stack_size;
+	msg->handler = handler;
+	msg->data = (char *) (msg + 1);
+	memcpy (msg->data, ps_nl_buffer, len);
+	msg->len = len;
+	msg->next = NULL;
 
-	if ( (ps_read_io (pid, ps)) == NULL)
+	if (ps_nl_deferred_tail == NULL)
+		ps_nl_deferred_head = msg;
+	else
+		ps_nl_deferred_tail->next = msg;
+	ps_nl_deferred_tail = msg;
+	ps_nl_deferred_size += len;
+} /* void ps_nl_defer */
+
+/* Handles the messages received while reading the processes. Must be called
+ * with `ps_lock' held. */
+static void ps_nl_handle_deferred (void)
+{
+	while (ps_nl_deferred_head != NULL)
 	{
-		/* no io data */
-		ps->io_rchar = -1;
-		ps->io_wchar = -1;
-		ps->io_syscr = -1;
-		ps->io_syscw = -1;
+		ps_nl_msg_t *msg = ps_nl_deferred_head;
 
-		DEBUG("ps_read_process: not get io data for pid %i",pid);
+		ps_nl_deferred_head = msg->next;
+		ps_nl_handle (msg->handler, msg->data, msg->len);
+		free (msg);
 	}
 
-	/* success */
-	return (0);
-} /* int ps_read_process (...) */
+	ps_nl_deferred_tail = NULL;
+	ps_nl_deferred_size = 0;
+} /* void ps_nl_handle_deferred */
 
-static char *ps_get_cmdline (pid_t pid, char *name, char *buf, size_t buf_len)
+/* Receives the pending messages of the socket `fd' and passes them to
+ * `handler'. Returns -1 if the socket has failed. */
+static int ps_nl_receive (int fd, void (*handler) (const struct nlmsghdr *))
 {
-	char  *buf_ptr;
-	size_t len;
-
-	char file[PATH_MAX];
-	int  fd;
-
-	size_t n;
+	while (42)
+	{
+		ssize_t len;
 
-	if ((pid < 1) || (NULL == buf) || (buf_len < 2))
-		return NULL;
+		len = recv (fd, ps_nl_buffer, sizeof (ps_nl_buffer), MSG_DONTWAIT);
+		if (len < 0)
+		{
+			char errbuf[1024];
 
-	ssnprintf (file, sizeof (file), "/proc/%u/cmdline",
-		       	(unsigned int) pid);
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return (0);
+			if (errno == ENOBUFS)
+			{
+				/* Events have been lost. */
+				pthread_mutex_lock (&ps_lock);
+				ps_nl_resync = 1;
+				pthread_mutex_unlock (&ps_lock);
+				continue;
+			}
 
-	errno = 0;
-	fd = open (file, O_RDONLY);
-	if (fd < 0) {
-		char errbuf[4096];
-		/* ENOENT means the process exited while we were handling it.
-		 * Don't complain about this, it only fills the logs. */
-		if (errno != ENOENT)
-			WARNING ("processes plugin: Failed to open `%s': %s.", file,
+			ERROR ("processes plugin: recv (AF_NETLINK) failed: %s",
 					sstrerror (errno, errbuf, sizeof (errbuf)));
-		return NULL;
+			return (-1);
+		}
+
+		/* Keep receiving while the processes are read, so the
+		 * socket's buffer doesn't overflow. */
+		pthread_mutex_lock (&ps_lock);
+		if (ps_nl_reading)
+			ps_nl_defer (handler, len);
+		else
+			ps_nl_handle (handler, ps_nl_buffer, len);
+		pthread_mutex_unlock (&ps_lock);
 	}
 
-	buf_ptr = buf;
-	len     = buf_len;
+	/* not reached */
+	return (-1);
+} /* int ps_nl_receive */
 
-	n = 0;
+static void *ps_nl_thread (void *arg)
+{
+	while (42)
+	{
+		struct pollfd fds[2];
+		_Bool shutdown;
+		int status;
 
-	while (42) {
-		ssize_t status;
+		pthread_mutex_lock (&ps_lock);
+		shutdown = ps_nl_shutdown || ps_nl_failed;
+		pthread_mutex_unlock (&ps_lock);
+		if (shutdown)
+			break;
 
-		status = read (fd, (void *)buf_ptr, len);
+		memset (fds, 0, sizeof (fds));
+		fds[0].fd = ps_cn_sock;
+		fds[0].events = POLLIN;
+		fds[1].fd = ps_ts_sock;
+		fds[1].events = POLLIN;
 
-		if (status < 0) {
+		status = poll (fds, STATIC_ARRAY_SIZE (fds), /* timeout = */ 1000);
+		if (status < 0)
+		{
 			char errbuf[1024];
 
-			if ((EAGAIN == errno) || (EINTR == errno))
+			if (errno == EINTR)
 				continue;
-
-			WARNING ("processes plugin: Failed to read from `%s': %s.", file,
+			ERROR ("processes plugin: poll failed: %s",
 					sstrerror (errno, errbuf, sizeof (errbuf)));
-			close (fd);
-			return NULL;
+			break;
 		}
 
-		n += status;
-
-		if (status == 0)
+		if ((fds[0].revents != 0)
+				&& (ps_nl_receive (ps_cn_sock, ps_cn_handle) != 0))
 			break;
+		if ((fds[1].revents != 0)
+				&& (ps_nl_receive (ps_ts_sock, ps_ts_handle) != 0))
+			break;
+	}
 
-		buf_ptr += status;
-		len     -= status;
+	pthread_mutex_lock (&ps_lock);
+	if (!ps_nl_shutdown && !ps_nl_failed)
+	{
+		ERROR ("processes plugin: Receiving process events failed. "
+				"Reading all processes from now on.");
+		ps_nl_failed = 1;
+	}
+	ps_nl_listening = 0;
+	pthread_mutex_unlock (&ps_lock);
 
-		if (len <= 0)
-			break;
+	return (NULL);
+} /* void *ps_nl_thread */
+
+static void ps_nl_stop (void)
+{
+	if (ps_nl_running)
+	{
+		pthread_mutex_lock (&ps_lock);
+		ps_nl_shutdown = 1;
+		pthread_mutex_unlock (&ps_lock);
+
+		pthread_join (ps_nl_thread_id, /* retval = */ NULL);
+		ps_nl_running = 0;
 	}
 
-	close (fd);
+	if (ps_ts_sock >= 0)
+	{
+		if (ps_ts_family != 0)
+			ps_ts_command (ps_ts_family, TASKSTATS_CMD_GET,
+					TASKSTATS_GENL_VERSION,
+					TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK,
+					ps_ts_cpumask, strlen (ps_ts_cpumask) + 1,
+					/* handler = */ NULL);
+		close (ps_ts_sock);
+		ps_ts_sock = -1;
+		ps_ts_family = 0;
+	}
 
-	if (0 == n) {
-		/* cmdline not available; e.g. kernel thread, zombie */
-		if (NULL == name)
-			return NULL;
+	if (ps_cn_sock >= 0)
+	{
+		ps_cn_control (PROC_CN_MCAST_IGNORE);
+		close (ps_cn_sock);
+		ps_cn_sock = -1;
+	}
+} /* void ps_nl_stop */
 
-		ssnprintf (buf, buf_len, "[%s]", name);
-		return buf;
+static int ps_nl_start (void)
+{
+	char errbuf[1024];
+	int status;
+
+	ps_cn_sock = ps_nl_open (NETLINK_CONNECTOR, CN_IDX_PROC);
+	if (ps_cn_sock < 0)
+		return (-1);
+
+	status = ps_cn_control (PROC_CN_MCAST_LISTEN);
+	if (status != 0)
+	{
+		ERROR ("processes plugin: Subscribing to process events failed: %s",
+				sstrerror (-status, errbuf, sizeof (errbuf)));
+		ps_nl_stop ();
+		return (-1);
 	}
 
-	assert (n <= buf_len);
+	ps_ts_sock = ps_nl_open (NETLINK_GENERIC, /* groups = */ 0);
+	if (ps_ts_sock < 0)
+	{
+		ps_nl_stop ();
+		return (-1);
+	}
 
-	if (n == buf_len)
-		--n;
-	buf[n] = '\0';
+	status = ps_ts_command (GENL_ID_CTRL, CTRL_CMD_GETFAMILY, /* version = */ 1,
+			CTRL_ATTR_FAMILY_NAME,
+			TASKSTATS_GENL_NAME, strlen (TASKSTATS_GENL_NAME) + 1,
+			ps_ts_family_handle);
+	if ((status != 0) || (ps_ts_family == 0))
+	{
+		ERROR ("processes plugin: Looking up the taskstats netlink family "
+				"failed: %s", sstrerror (-status, errbuf, sizeof (errbuf)));
+		ps_ts_family = 0;
+		ps_nl_stop ();
+		return (-1);
+	}
 
-	--n;
-	/* remove trailing whitespace */
-	while ((n > 0) && (isspace (buf[n]) || ('\0' == buf[n]))) {
-		buf[n] = '\0';
-		--n;
+	/* The accounting data of exiting tasks is sent for the CPUs
+	 * registered for. */
+	memset (ps_ts_cpumask, 0, sizeof (ps_ts_cpumask));
+	if (read_file_contents ("/sys/devices/system/cpu/possible",
+				ps_ts_cpumask, sizeof (ps_ts_cpumask) - 1) <= 0)
+		ssnprintf (ps_ts_cpumask, sizeof (ps_ts_cpumask), "0-%li",
+				sysconf (_SC_NPROCESSORS_CONF) - 1);
+	else
+		ps_ts_cpumask[strcspn (ps_ts_cpumask, "\n")] = 0;
+
+	status = ps_ts_command (ps_ts_family, TASKSTATS_CMD_GET,
+			TASKSTATS_GENL_VERSION, TASKSTATS_CMD_ATTR_REGISTER_CPUMASK,
+			ps_ts_cpumask, strlen (ps_ts_cpumask) + 1,
+			/* handler = */ NULL);
+	if (status != 0)
+	{
+		ERROR ("processes plugin: Registering for taskstats of CPUs %s "
+				"failed: %s", ps_ts_cpumask,
+				sstrerror (-status, errbuf, sizeof (errbuf)));
+		ps_ts_family = 0;
+		ps_nl_stop ();
+		return (-1);
 	}
 
-	/* arguments are separated by '\0' in /proc/<pid>/cmdline */
-	while (n > 0) {
-		if ('\0' == buf[n])
-			buf[n] = ' ';
-		--n;
+	ps_nl_shutdown = 0;
+	ps_nl_failed = 0;
+	ps_nl_listening = 0;
+	ps_nl_resync = 1;
+	if (pthread_create (&ps_nl_thread_id, /* attr = */ NULL,
+				ps_nl_thread, /* arg = */ NULL) != 0)
+	{
+		ERROR ("processes plugin: pthread_create failed: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		ps_nl_stop ();
+		return (-1);
 	}
-	return buf;
-} /* char *ps_get_cmdline (...) */
+	ps_nl_running = 1;
 
-static unsigned long read_fork_rate ()
+	return (0);
+} /* int ps_nl_start */
+#endif /* PS_NETLINK */
+
+/* Reads the number of forks since boot from /proc/stat. If `running' and
+ * `blocked' are not NULL, the number of runnable and blocked tasks is
+ * stored there, too. */
+static unsigned long read_fork_rate (int *running, int *blocked)
 {
 	FILE *proc_stat;
 	char buf[1024];
@@ -1141,6 +2552,18 @@ static unsigned long read_fork_rate ()
 		if (numfields != 2)
 			continue;
 
+		if ((running != NULL) && (strcmp ("procs_running", fields[0]) == 0))
+		{
+			*running = atoi (fields[1]);
+			continue;
+		}
+		else if ((blocked != NULL)
+				&& (strcmp ("procs_blocked", fields[0]) == 0))
+		{
+			*blocked = atoi (fields[1]);
+			continue;
+		}
+
 		if (strcmp ("processes", fields[0]) != 0)
 			continue;
 
@@ -1154,7 +2577,9 @@ static unsigned long read_fork_rate ()
 			break;
 		}
 
-		break;
+		/* procs_running and procs_blocked follow. */
+		if ((running == NULL) && (blocked == NULL))
+			break;
 	}
 
 	fclose(proc_stat);
@@ -1495,74 +2920,78 @@ static int ps_read (void)
 	int paging   = 0;
 	int blocked  = 0;
 
-	struct dirent *ent;
-	DIR           *proc;
-	int            pid;
-
-	char cmdline[ARG_MAX];
+	size_t i;
+	int j;
 
-	int        status;
-	procstat_t ps;
-	procstat_entry_t pse;
-	char       state;
+	/* If process events are received, only the processes belonging to a
+	 * group are read. */
+	_Bool events = 0;
 
 	unsigned long fork_rate;
 
 	procstat_t *ps_ptr;
 
 	running = sleeping = zombies = stopped = paging = blocked = 0;
+
+#if PS_NETLINK
+	if (ps_nl_enabled && !ps_nl_running && (ps_nl_start () != 0))
+	{
+		ERROR ("processes plugin: Receiving process events failed. "
+				"Reading all processes instead.");
+		ps_nl_enabled = 0;
+	}
+#endif
+
+	pthread_mutex_lock (&ps_lock);
 	ps_list_reset ();
 
-	if ((proc = opendir ("/proc")) == NULL)
+#if PS_NETLINK
+	events = ps_nl_running && ps_nl_listening && !ps_nl_failed;
+	if (events && !ps_nl_resync)
+		ps_nl_scan ();
+	else
+#endif
+	if (ps_scan () != 0)
 	{
-		char errbuf[1024];
-		ERROR ("Cannot open `/proc': %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
+		pthread_mutex_unlock (&ps_lock);
 		return (-1);
 	}
+#if PS_NETLINK
+	ps_nl_resync = 0;
+	/* The thread receiving the events only modifies the process table
+	 * while holding `ps_lock' and defers its messages while this is set,
+	 * so the processes in `scan_list' can be read without the lock. */
+	ps_nl_reading = 1;
+#endif
+	pthread_mutex_unlock (&ps_lock);
 
-	while ((ent = readdir (proc)) != NULL)
+	ps_scan_read ();
+
+	pthread_mutex_lock (&ps_lock);
+#if PS_NETLINK
+	ps_nl_reading = 0;
+#endif
+
+	for (i = 0; i < scan_num; i++)
 	{
-		if (!isdigit (ent->d_name[0]))
-			continue;
+		ps_proc_t *proc = scan_list[i];
 
-		if ((pid = atoi (ent->d_name)) < 1)
+#if PS_NETLINK
+		if (proc->dead)
 			continue;
 
-		status = ps_read_process (pid, &ps, &state);
-		if (status != 0)
+		/* The process is gone, but the exit event is missing. */
+		if (events && (proc->status != 0))
+			proc->dead = 1;
+#endif
+
+		if (proc->status != 0)
 		{
-			DEBUG ("ps_read_process failed: %i", status);
+			DEBUG ("ps_proc_read failed: %i", proc->status);
 			continue;
 		}
 
-		pse.id       = pid;
-		pse.age      = 0;
-
-		pse.num_proc   = ps.num_proc;
-		pse.num_lwp    = ps.num_lwp;
-		pse.vmem_size  = ps.vmem_size;
-		pse.vmem_rss   = ps.vmem_rss;
-		pse.vmem_data  = ps.vmem_data;
-		pse.vmem_code  = ps.vmem_code;
-		pse.stack_size = ps.stack_size;
-
-		pse.vmem_minflt = 0;
-		pse.vmem_minflt_counter = ps.vmem_minflt_counter;
-		pse.vmem_majflt = 0;
-		pse.vmem_majflt_counter = ps.vmem_majflt_counter;
-
-		pse.cpu_user = 0;
-		pse.cpu_user_counter = ps.cpu_user_counter;
-		pse.cpu_system = 0;
-		pse.cpu_system_counter = ps.cpu_system_counter;
-
-		pse.io_rchar = ps.io_rchar;
-		pse.io_wchar = ps.io_wchar;
-		pse.io_syscr = ps.io_syscr;
-		pse.io_syscw = ps.io_syscw;
-
-		switch (state)
+		switch (proc->state)
 		{
 			case 'R': running++;  break;
 			case 'S': sleeping++; break;
@@ -1572,24 +3001,47 @@ static int ps_read (void)
 			case 'W': paging++;   break;
 		}
 
-		ps_list_add (ps.name,
-				ps_get_cmdline (pid, ps.name, cmdline, sizeof (cmdline)),
-				&pse);
+		if (proc->groups_num == 0)
+			continue;
+
+		ps_entry_update (&proc->entry, &proc->sample);
+		for (j = 0; j < proc->groups_num; j++)
+			ps_entry_sum (proc->groups[j], &proc->entry);
 	}
 
-	closedir (proc);
+#if PS_NETLINK
+	ps_nl_collect_exits ();
+#endif
+	ps_proc_expire ();
+#if PS_NETLINK
+	ps_nl_handle_deferred ();
+#endif
+	pthread_mutex_unlock (&ps_lock);
 
-	ps_submit_state ("running",  running);
-	ps_submit_state ("sleeping", sleeping);
-	ps_submit_state ("zombies",  zombies);
-	ps_submit_state ("stopped",  stopped);
-	ps_submit_state ("paging",   paging);
-	ps_submit_state ("blocked",  blocked);
+	if (events)
+	{
+		/* Not all processes have been read: take the number of
+		 * runnable and blocked tasks from the kernel instead. */
+		fork_rate = read_fork_rate (&running, &blocked);
+
+		ps_submit_state ("running",  running);
+		ps_submit_state ("blocked",  blocked);
+	}
+	else
+	{
+		fork_rate = read_fork_rate (NULL, NULL);
+
+		ps_submit_state ("running",  running);
+		ps_submit_state ("sleeping", sleeping);
+		ps_submit_state ("zombies",  zombies);
+		ps_submit_state ("stopped",  stopped);
+		ps_submit_state ("paging",   paging);
+		ps_submit_state ("blocked",  blocked);
+	}
 
 	for (ps_ptr = list_head_g; ps_ptr != NULL; ps_ptr = ps_ptr->next)
 		ps_submit_proc_list (ps_ptr);
 
-	fork_rate = read_fork_rate();
 	if (fork_rate != ULONG_MAX)
 		ps_submit_fork_rate(fork_rate);
 /* #endif KERNEL_LINUX */
@@ -1863,9 +3315,51 @@ static int ps_read (void)
 	return (0);
 } /* int ps_read */
 
+static int ps_shutdown (void)
+{
+#if KERNEL_LINUX
+	size_t i;
+
+# if PS_NETLINK
+	ps_nl_stop ();
+# endif
+	ps_stop_threads ();
+
+	if (proc_dir != NULL)
+	{
+		closedir (proc_dir);
+		proc_dir = NULL;
+	}
+
+	for (i = 0; i < proc_table_size; i++)
+	{
+		ps_proc_t *proc = proc_table[i];
+
+		while (proc != NULL)
+		{
+			ps_proc_t *next = proc->next;
+
+			sfree (proc->groups);
+			free (proc);
+			proc = next;
+		}
+	}
+	sfree (proc_table);
+	proc_table_size = 0;
+	proc_table_num = 0;
+
+	sfree (scan_list);
+	scan_list_size = 0;
+	scan_num = 0;
+#endif /* KERNEL_LINUX */
+
+	return (0);
+} /* int ps_shutdown */
+
 void module_register (void)
 {
 	plugin_register_complex_config ("processes", ps_config);
 	plugin_register_init ("processes", ps_init);
 	plugin_register_read ("processes", ps_read);
+	plugin_register_shutdown ("processes", ps_shutdown);
 } /* void module_register */
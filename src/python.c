@@ -34,6 +34,7 @@
 
 #include "collectd.h"
 #include "common.h"
+#include "utils_complain.h"
 
 #include "cpython.h"
 
@@ -150,6 +151,34 @@ static char reg_write_doc[] = "register_write(callback[, data][, name]) -> ident
 		"data: The optional data parameter passed to the register function.\n"
 		"    If the parameter was omitted it will be omitted here, too.";
 
+static char reg_write_batch_doc[] = "register_write_batch(callback[, data][, name][, size][, timeout]) -> identifier\n"
+		"\n"
+		"Register a callback function to receive values dispatched by other plugins\n"
+		"in batches. Values are queued in C and passed to the callback from a\n"
+		"dedicated thread, so dispatching threads don't have to wait for the GIL.\n"
+		"'callback' is a callable object that will be called with a batch of values.\n"
+		"'data' is an optional object that will be passed back to the callback\n"
+		"    function every time it is called.\n"
+		"'name' is an optional identifier for this callback. The default name\n"
+		"    is 'python.<module>'.\n"
+		"    Every callback needs a unique identifier, so if you want to\n"
+		"    register this callback multiple time from the same module you need\n"
+		"    to specify a name here.\n"
+		"'size' is the number of values after which the callback is called.\n"
+		"    Defaults to 256. At most ten times this number of values are queued,\n"
+		"    further values are dropped.\n"
+		"'timeout' is the number of seconds after which the callback is called\n"
+		"    even if fewer than 'size' values have been queued. Defaults to 1.0.\n"
+		"'identifier' is the full identifier assigned to this callback.\n"
+		"\n"
+		"The callback function will be called with one or two parameters:\n"
+		"values: A ValuesBatch object, a read-only sequence of ValueView objects.\n"
+		"    A ValueView has the same attributes as a Values object, but they\n"
+		"    are only converted to python objects when accessed. Keeping a\n"
+		"    reference to an item keeps the whole batch in memory.\n"
+		"data: The optional data parameter passed to the register function.\n"
+		"    If the parameter was omitted it will be omitted here, too.";
+
 static char reg_notification_doc[] = "register_notification(callback[, data][, name]) -> identifier\n"
 		"\n"
 		"Register a callback function for notifications.\n"
@@ -223,6 +252,32 @@ static cpy_callback_t *cpy_config_callbacks;
 static cpy_callback_t *cpy_init_callbacks;
 static cpy_callback_t *cpy_shutdown_callbacks;
 
+/* Queue of value lists for a write callback registered with
+ * register_write_batch. The lists are copied by the dispatching thread and
+ * handed to python in batches by a dedicated thread. */
+typedef struct cpy_batch_s {
+	cpy_callback_t *c;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	value_list_t *vl;
+	const data_set_t **ds;
+	size_t len;
+	size_t alloc;
+	size_t size;
+	double timeout;
+	c_complain_t complaint;
+	pthread_t thread;
+	_Bool thread_running;
+	_Bool shutdown;
+	struct cpy_batch_s *next;
+} cpy_batch_t;
+
+#define CPY_BATCH_SIZE_DEFAULT 256
+#define CPY_BATCH_TIMEOUT_DEFAULT 1.0
+
+static cpy_batch_t *cpy_batches;
+static pthread_mutex_t cpy_batches_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static void cpy_destroy_user_data(void *data) {
 	cpy_callback_t *c = data;
 	free(c->name);
@@ -331,110 +386,126 @@ static int cpy_read_callback(user_data_t *data) {
 	return 0;
 }
 
-static int cpy_write_callback(const data_set_t *ds, const value_list_t *value_list, user_data_t *data) {
+/* You must hold the GIL to call this function! */
+
+PyObject *cpy_build_values_list(const data_set_t *ds, const value_list_t *value_list) {
 	int i;
+	PyObject *list;
+
+	list = PyList_New(value_list->values_len); /* New reference. */
+	if (list == NULL)
+		return NULL;
+	for (i = 0; i < value_list->values_len; ++i) {
+		if (ds->ds[i].type == DS_TYPE_COUNTER) {
+			if ((long) value_list->values[i].counter == value_list->values[i].counter)
+				PyList_SetItem(list, i, PyInt_FromLong(value_list->values[i].counter));
+			else
+				PyList_SetItem(list, i, PyLong_FromUnsignedLongLong(value_list->values[i].counter));
+		} else if (ds->ds[i].type == DS_TYPE_GAUGE) {
+			PyList_SetItem(list, i, PyFloat_FromDouble(value_list->values[i].gauge));
+		} else if (ds->ds[i].type == DS_TYPE_DERIVE) {
+			if ((long) value_list->values[i].derive == value_list->values[i].derive)
+				PyList_SetItem(list, i, PyInt_FromLong(value_list->values[i].derive));
+			else
+				PyList_SetItem(list, i, PyLong_FromLongLong(value_list->values[i].derive));
+		} else if (ds->ds[i].type == DS_TYPE_ABSOLUTE) {
+			if ((long) value_list->values[i].absolute == value_list->values[i].absolute)
+				PyList_SetItem(list, i, PyInt_FromLong(value_list->values[i].absolute));
+			else
+				PyList_SetItem(list, i, PyLong_FromUnsignedLongLong(value_list->values[i].absolute));
+		} else {
+			Py_DECREF(list);
+			PyErr_Format(PyExc_TypeError, "Unknown value type %d.", ds->ds[i].type);
+			return NULL;
+		}
+		if (PyErr_Occurred() != NULL) {
+			Py_DECREF(list);
+			return NULL;
+		}
+	}
+	return list;
+}
+
+/* You must hold the GIL to call this function! */
+
+PyObject *cpy_build_meta_dict(meta_data_t *meta) {
+	int i, num;
+	char **table;
+	PyObject *temp, *dict;
+
+	dict = PyDict_New();  /* New reference. */
+	if (dict == NULL || meta == NULL)
+		return dict;
+
+	num = meta_data_toc(meta, &table);
+	for (i = 0; i < num; ++i) {
+		int type;
+		char *string;
+		int64_t si;
+		uint64_t ui;
+		double d;
+		_Bool b;
+		
+		type = meta_data_type(meta, table[i]);
+		if (type == MD_TYPE_STRING) {
+			if (meta_data_get_string(meta, table[i], &string))
+				continue;
+			temp = cpy_string_to_unicode_or_bytes(string);  /* New reference. */
+			free(string);
+			PyDict_SetItemString(dict, table[i], temp);
+			Py_XDECREF(temp);
+		} else if (type == MD_TYPE_SIGNED_INT) {
+			if (meta_data_get_signed_int(meta, table[i], &si))
+				continue;
+			temp = PyObject_CallFunctionObjArgs((void *) &SignedType, PyLong_FromLongLong(si), (void *) 0);  /* New reference. */
+			PyDict_SetItemString(dict, table[i], temp);
+			Py_XDECREF(temp);
+		} else if (type == MD_TYPE_UNSIGNED_INT) {
+			if (meta_data_get_unsigned_int(meta, table[i], &ui))
+				continue;
+			temp = PyObject_CallFunctionObjArgs((void *) &UnsignedType, PyLong_FromUnsignedLongLong(ui), (void *) 0);  /* New reference. */
+			PyDict_SetItemString(dict, table[i], temp);
+			Py_XDECREF(temp);
+		} else if (type == MD_TYPE_DOUBLE) {
+			if (meta_data_get_double(meta, table[i], &d))
+				continue;
+			temp = PyFloat_FromDouble(d);  /* New reference. */
+			PyDict_SetItemString(dict, table[i], temp);
+			Py_XDECREF(temp);
+		} else if (type == MD_TYPE_BOOLEAN) {
+			if (meta_data_get_boolean(meta, table[i], &b))
+				continue;
+			if (b)
+				PyDict_SetItemString(dict, table[i], Py_True);
+			else
+				PyDict_SetItemString(dict, table[i], Py_False);
+		}
+		free(table[i]);
+	}
+	free(table);
+	return dict;
+}
+
+static int cpy_write_callback(const data_set_t *ds, const value_list_t *value_list, user_data_t *data) {
 	cpy_callback_t *c = data->data;
-	PyObject *ret, *list, *temp, *dict = NULL;
+	PyObject *ret, *list, *dict = NULL;
 	Values *v;
 
 	CPY_LOCK_THREADS
-		list = PyList_New(value_list->values_len); /* New reference. */
+		list = cpy_build_values_list(ds, value_list); /* New reference. */
 		if (list == NULL) {
-			cpy_log_exception("write callback");
+			cpy_log_exception("value building for write callback");
 			CPY_RETURN_FROM_THREADS 0;
 		}
-		for (i = 0; i < value_list->values_len; ++i) {
-			if (ds->ds[i].type == DS_TYPE_COUNTER) {
-				if ((long) value_list->values[i].counter == value_list->values[i].counter)
-					PyList_SetItem(list, i, PyInt_FromLong(value_list->values[i].counter));
-				else
-					PyList_SetItem(list, i, PyLong_FromUnsignedLongLong(value_list->values[i].counter));
-			} else if (ds->ds[i].type == DS_TYPE_GAUGE) {
-				PyList_SetItem(list, i, PyFloat_FromDouble(value_list->values[i].gauge));
-			} else if (ds->ds[i].type == DS_TYPE_DERIVE) {
-				if ((long) value_list->values[i].derive == value_list->values[i].derive)
-					PyList_SetItem(list, i, PyInt_FromLong(value_list->values[i].derive));
-				else
-					PyList_SetItem(list, i, PyLong_FromLongLong(value_list->values[i].derive));
-			} else if (ds->ds[i].type == DS_TYPE_ABSOLUTE) {
-				if ((long) value_list->values[i].absolute == value_list->values[i].absolute)
-					PyList_SetItem(list, i, PyInt_FromLong(value_list->values[i].absolute));
-				else
-					PyList_SetItem(list, i, PyLong_FromUnsignedLongLong(value_list->values[i].absolute));
-			} else {
-				Py_BEGIN_ALLOW_THREADS
-				ERROR("cpy_write_callback: Unknown value type %d.", ds->ds[i].type);
-				Py_END_ALLOW_THREADS
-				Py_DECREF(list);
-				CPY_RETURN_FROM_THREADS 0;
-			}
-			if (PyErr_Occurred() != NULL) {
-				cpy_log_exception("value building for write callback");
-				Py_DECREF(list);
-				CPY_RETURN_FROM_THREADS 0;
-			}
-		}
-		dict = PyDict_New();  /* New reference. */
-		if (value_list->meta) {
-			int i, num;
-			char **table;
-			meta_data_t *meta = value_list->meta;
-
-			num = meta_data_toc(meta, &table);
-			for (i = 0; i < num; ++i) {
-				int type;
-				char *string;
-				int64_t si;
-				uint64_t ui;
-				double d;
-				_Bool b;
-				
-				type = meta_data_type(meta, table[i]);
-				if (type == MD_TYPE_STRING) {
-					if (meta_data_get_string(meta, table[i], &string))
-						continue;
-					temp = cpy_string_to_unicode_or_bytes(string);  /* New reference. */
-					free(string);
-					PyDict_SetItemString(dict, table[i], temp);
-					Py_XDECREF(temp);
-				} else if (type == MD_TYPE_SIGNED_INT) {
-					if (meta_data_get_signed_int(meta, table[i], &si))
-						continue;
-					temp = PyObject_CallFunctionObjArgs((void *) &SignedType, PyLong_FromLongLong(si), (void *) 0);  /* New reference. */
-					PyDict_SetItemString(dict, table[i], temp);
-					Py_XDECREF(temp);
-				} else if (type == MD_TYPE_UNSIGNED_INT) {
-					if (meta_data_get_unsigned_int(meta, table[i], &ui))
-						continue;
-					temp = PyObject_CallFunctionObjArgs((void *) &UnsignedType, PyLong_FromUnsignedLongLong(ui), (void *) 0);  /* New reference. */
-					PyDict_SetItemString(dict, table[i], temp);
-					Py_XDECREF(temp);
-				} else if (type == MD_TYPE_DOUBLE) {
-					if (meta_data_get_double(meta, table[i], &d))
-						continue;
-					temp = PyFloat_FromDouble(d);  /* New reference. */
-					PyDict_SetItemString(dict, table[i], temp);
-					Py_XDECREF(temp);
-				} else if (type == MD_TYPE_BOOLEAN) {
-					if (meta_data_get_boolean(meta, table[i], &b))
-						continue;
-					if (b)
-						PyDict_SetItemString(dict, table[i], Py_True);
-					else
-						PyDict_SetItemString(dict, table[i], Py_False);
-				}
-				free(table[i]);
-			}
-			free(table);
-		}
+		dict = cpy_build_meta_dict(value_list->meta); /* New reference. */
 		v = (Values *) Values_New(); /* New reference. */
 		sstrncpy(v->data.host, value_list->host, sizeof(v->data.host));
 		sstrncpy(v->data.type, value_list->type, sizeof(v->data.type));
 		sstrncpy(v->data.type_instance, value_list->type_instance, sizeof(v->data.type_instance));
 		sstrncpy(v->data.plugin, value_list->plugin, sizeof(v->data.plugin));
 		sstrncpy(v->data.plugin_instance, value_list->plugin_instance, sizeof(v->data.plugin_instance));
-		v->data.time = value_list->time;
-		v->interval = value_list->interval;
+		v->data.time = CDTIME_T_TO_DOUBLE(value_list->time);
+		v->interval = CDTIME_T_TO_DOUBLE(value_list->interval);
 		Py_CLEAR(v->values);
 		v->values = list;
 		Py_CLEAR(v->meta);
@@ -450,6 +521,206 @@ static int cpy_write_callback(const data_set_t *ds, const value_list_t *value_li
 	return 0;
 }
 
+static void *cpy_batch_thread(void *arg);
+
+static int cpy_write_batch_callback(const data_set_t *ds, const value_list_t *value_list, user_data_t *data) {
+	cpy_batch_t *b = data->data;
+	value_list_t *copy;
+	value_t *values;
+	meta_data_t *meta = NULL;
+
+	values = malloc(value_list->values_len * sizeof(*values));
+	if (values == NULL) {
+		ERROR("python plugin: malloc failed.");
+		return -1;
+	}
+	memcpy(values, value_list->values, value_list->values_len * sizeof(*values));
+	if (value_list->meta != NULL)
+		meta = meta_data_clone(value_list->meta);
+
+	pthread_mutex_lock(&b->lock);
+	/* The delivery thread is started by the first write, i.e. after
+	 * collectd has forked and cpy_init has set up python threads. */
+	if (!b->thread_running && !b->shutdown) {
+		if (pthread_create(&b->thread, NULL, cpy_batch_thread, b) != 0) {
+			pthread_mutex_unlock(&b->lock);
+			c_complain(LOG_ERR, &b->complaint, "python plugin: Unable to "
+					"create the delivery thread of %s. Dropping values.",
+					b->c->name);
+			free(values);
+			meta_data_destroy(meta);
+			return -1;
+		}
+		b->thread_running = 1;
+	}
+	if (b->len >= 10 * b->size) {
+		pthread_mutex_unlock(&b->lock);
+		c_complain(LOG_WARNING, &b->complaint, "python plugin: The queue "
+				"of %s is full. Dropping values.", b->c->name);
+		free(values);
+		meta_data_destroy(meta);
+		return -1;
+	}
+	if (b->len >= b->alloc) {
+		size_t alloc = (b->alloc == 0) ? b->size : 2 * b->alloc;
+		value_list_t *vl;
+		const data_set_t **dsp;
+
+		vl = realloc(b->vl, alloc * sizeof(*vl));
+		if (vl != NULL)
+			b->vl = vl;
+		dsp = realloc(b->ds, alloc * sizeof(*dsp));
+		if (dsp != NULL)
+			b->ds = dsp;
+		if (vl == NULL || dsp == NULL) {
+			pthread_mutex_unlock(&b->lock);
+			ERROR("python plugin: realloc failed.");
+			free(values);
+			meta_data_destroy(meta);
+			return -1;
+		}
+		b->alloc = alloc;
+	}
+	copy = b->vl + b->len;
+	memcpy(copy, value_list, sizeof(*copy));
+	copy->values = values;
+	copy->meta = meta;
+	b->ds[b->len] = ds;
+	b->len++;
+	if (b->len >= b->size)
+		pthread_cond_signal(&b->cond);
+	pthread_mutex_unlock(&b->lock);
+
+	c_release(LOG_INFO, &b->complaint, "python plugin: The queue of %s "
+			"is accepting values again.", b->c->name);
+	return 0;
+}
+
+static void *cpy_batch_thread(void *arg) {
+	cpy_batch_t *b = arg;
+
+	pthread_mutex_lock(&b->lock);
+	while (42) {
+		struct timeval tv;
+		struct timespec deadline;
+		value_list_t *vl;
+		const data_set_t **ds;
+		size_t len;
+		PyObject *batch, *ret;
+
+		gettimeofday(&tv, NULL);
+		deadline.tv_sec = tv.tv_sec + (time_t) b->timeout;
+		deadline.tv_nsec = tv.tv_usec * 1000
+			+ (long) ((b->timeout - (time_t) b->timeout) * 1000000000.0);
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+
+		while (b->len < b->size && !b->shutdown) {
+			if (pthread_cond_timedwait(&b->cond, &b->lock, &deadline) == ETIMEDOUT)
+				break;
+		}
+
+		if (b->len == 0) {
+			if (b->shutdown)
+				break;
+			continue;
+		}
+
+		vl = b->vl;
+		ds = b->ds;
+		len = b->len;
+		b->vl = NULL;
+		b->ds = NULL;
+		b->len = 0;
+		b->alloc = 0;
+		pthread_mutex_unlock(&b->lock);
+
+		CPY_LOCK_THREADS
+			batch = ValuesBatch_New(vl, ds, len); /* New reference. Takes ownership of "vl" and "ds". */
+			if (batch == NULL) {
+				cpy_log_exception("write batch callback");
+			} else {
+				ret = PyObject_CallFunctionObjArgs(b->c->callback, batch, b->c->data, (void *) 0); /* New reference. */
+				if (ret == NULL) {
+					cpy_log_exception("write batch callback");
+				} else {
+					Py_DECREF(ret);
+				}
+				Py_DECREF(batch);
+			}
+		CPY_RELEASE_THREADS
+
+		pthread_mutex_lock(&b->lock);
+	}
+	pthread_mutex_unlock(&b->lock);
+
+	return NULL;
+}
+
+/* Delivers all queued values and stops the delivery thread. Must be called
+ * without holding the GIL. */
+static void cpy_batch_stop(cpy_batch_t *b) {
+	_Bool running;
+
+	pthread_mutex_lock(&b->lock);
+	b->shutdown = 1;
+	pthread_cond_signal(&b->cond);
+	running = b->thread_running;
+	pthread_mutex_unlock(&b->lock);
+
+	if (running) {
+		pthread_join(b->thread, NULL);
+		pthread_mutex_lock(&b->lock);
+		b->thread_running = 0;
+		pthread_mutex_unlock(&b->lock);
+	}
+}
+
+static void cpy_destroy_batch(void *data) {
+	cpy_batch_t *b = data;
+	cpy_batch_t *prev;
+	size_t i;
+
+	pthread_mutex_lock(&cpy_batches_lock);
+	if (cpy_batches == b) {
+		cpy_batches = b->next;
+	} else {
+		for (prev = cpy_batches; prev != NULL; prev = prev->next) {
+			if (prev->next == b) {
+				prev->next = b->next;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&cpy_batches_lock);
+
+	if (b->thread_running) {
+		/* Called from python (unregister_write), so we hold the GIL. */
+		Py_BEGIN_ALLOW_THREADS
+		cpy_batch_stop(b);
+		Py_END_ALLOW_THREADS
+	}
+
+	for (i = 0; i < b->len; ++i) {
+		free(b->vl[i].values);
+		meta_data_destroy(b->vl[i].meta);
+	}
+	free(b->vl);
+	free(b->ds);
+	pthread_mutex_destroy(&b->lock);
+	pthread_cond_destroy(&b->cond);
+	/* The python interpreter might be gone already. */
+	if (Py_IsInitialized()) {
+		cpy_destroy_user_data(b->c);
+	} else {
+		free(b->c->name);
+		free(b->c);
+	}
+	free(b);
+}
+
 static int cpy_notification_callback(const notification_t *notification, user_data_t *data) {
 	cpy_callback_t *c = data->data;
 	PyObject *ret, *notify;
@@ -650,6 +921,67 @@ static PyObject *cpy_register_write(PyObject *self, PyObject *args, PyObject *kw
 			(void *) cpy_write_callback, args, kwds);
 }
 
+static PyObject *cpy_register_write_batch(PyObject *self, PyObject *args, PyObject *kwds) {
+	char buf[512];
+	cpy_callback_t *c = NULL;
+	cpy_batch_t *b = NULL;
+	user_data_t *user_data = NULL;
+	int size = CPY_BATCH_SIZE_DEFAULT;
+	double timeout = CPY_BATCH_TIMEOUT_DEFAULT;
+	char *name = NULL;
+	PyObject *callback = NULL, *data = NULL;
+	static char *kwlist[] = {"callback", "data", "name", "size", "timeout", NULL};
+	
+	if (PyArg_ParseTupleAndKeywords(args, kwds, "O|Oetid", kwlist, &callback, &data, NULL, &name, &size, &timeout) == 0) return NULL;
+	if (PyCallable_Check(callback) == 0) {
+		PyMem_Free(name);
+		PyErr_SetString(PyExc_TypeError, "callback needs a be a callable object.");
+		return NULL;
+	}
+	if (size < 1 || timeout <= 0) {
+		PyMem_Free(name);
+		PyErr_SetString(PyExc_ValueError, "size and timeout need to be positive.");
+		return NULL;
+	}
+	cpy_build_name(buf, sizeof(buf), callback, name);
+	PyMem_Free(name);
+	
+	c = malloc(sizeof(*c));
+	b = calloc(1, sizeof(*b));
+	user_data = malloc(sizeof(*user_data));
+	if (c != NULL)
+		c->name = strdup(buf);
+	if (c == NULL || c->name == NULL || b == NULL || user_data == NULL) {
+		if (c != NULL)
+			free(c->name);
+		free(c);
+		free(b);
+		free(user_data);
+		return PyErr_NoMemory();
+	}
+	Py_INCREF(callback);
+	Py_XINCREF(data);
+	c->callback = callback;
+	c->data = data;
+	c->next = NULL;
+	b->c = c;
+	pthread_mutex_init(&b->lock, NULL);
+	pthread_cond_init(&b->cond, NULL);
+	b->size = (size_t) size;
+	b->timeout = timeout;
+	C_COMPLAIN_INIT(&b->complaint);
+
+	pthread_mutex_lock(&cpy_batches_lock);
+	b->next = cpy_batches;
+	cpy_batches = b;
+	pthread_mutex_unlock(&cpy_batches_lock);
+
+	user_data->free_func = cpy_destroy_batch;
+	user_data->data = b;
+	plugin_register_write(buf, cpy_write_batch_callback, user_data);
+	return cpy_string_to_unicode_or_bytes(buf);
+}
+
 static PyObject *cpy_register_notification(PyObject *self, PyObject *args, PyObject *kwds) {
 	return cpy_register_generic_userdata((void *) plugin_register_notification,
 			(void *) cpy_notification_callback, args, kwds);
@@ -823,6 +1155,7 @@ static PyMethodDef cpy_methods[] = {
 	{"register_config", (PyCFunction) cpy_register_config, METH_VARARGS | METH_KEYWORDS, reg_config_doc},
 	{"register_read", (PyCFunction) cpy_register_read, METH_VARARGS | METH_KEYWORDS, reg_read_doc},
 	{"register_write", (PyCFunction) cpy_register_write, METH_VARARGS | METH_KEYWORDS, reg_write_doc},
+	{"register_write_batch", (PyCFunction) cpy_register_write_batch, METH_VARARGS | METH_KEYWORDS, reg_write_batch_doc},
 	{"register_notification", (PyCFunction) cpy_register_notification, METH_VARARGS | METH_KEYWORDS, reg_notification_doc},
 	{"register_flush", (PyCFunction) cpy_register_flush, METH_VARARGS | METH_KEYWORDS, reg_flush_doc},
 	{"register_shutdown", (PyCFunction) cpy_register_shutdown, METH_VARARGS | METH_KEYWORDS, reg_shutdown_doc},
@@ -839,8 +1172,15 @@ static PyMethodDef cpy_methods[] = {
 
 static int cpy_shutdown(void) {
 	cpy_callback_t *c;
+	cpy_batch_t *b;
 	PyObject *ret;
 	
+	/* Deliver all queued values before the interpreter goes away. */
+	pthread_mutex_lock(&cpy_batches_lock);
+	for (b = cpy_batches; b; b = b->next)
+		cpy_batch_stop(b);
+	pthread_mutex_unlock(&cpy_batches_lock);
+
 	/* This can happen if the module was loaded but not configured. */
 	if (state != NULL)
 		PyEval_RestoreThread(state);
@@ -1009,6 +1349,8 @@ static int cpy_init_python() {
 	PyType_Ready(&SignedType);
 	UnsignedType.tp_base = &PyLong_Type;
 	PyType_Ready(&UnsignedType);
+	PyType_Ready(&ValuesBatchType);
+	PyType_Ready(&ValueViewType);
 	sys = PyImport_ImportModule("sys"); /* New reference. */
 	if (sys == NULL) {
 		cpy_log_exception("python initialization");
@@ -1033,6 +1375,8 @@ static int cpy_init_python() {
 	PyModule_AddObject(module, "Notification", (void *) &NotificationType); /* Steals a reference. */
 	PyModule_AddObject(module, "Signed", (void *) &SignedType); /* Steals a reference. */
 	PyModule_AddObject(module, "Unsigned", (void *) &UnsignedType); /* Steals a reference. */
+	PyModule_AddObject(module, "ValuesBatch", (void *) &ValuesBatchType); /* Steals a reference. */
+	PyModule_AddObject(module, "ValueView", (void *) &ValueViewType); /* Steals a reference. */
 	PyModule_AddIntConstant(module, "LOG_DEBUG", LOG_DEBUG);
 	PyModule_AddIntConstant(module, "LOG_INFO", LOG_INFO);
 	PyModule_AddIntConstant(module, "LOG_NOTICE", LOG_NOTICE);
@@ -301,10 +301,9 @@ PyTypeObject PluginDataType = {
 };
 
 static char interval_doc[] = "The interval is the timespan in seconds between two submits for\n"
-		"the same data source. This value has to be a positive integer, so you can't\n"
-		"submit more than one value per second. If this member is set to a\n"
-		"non-positive value, the default value as specified in the config file will\n"
-		"be used (default: 10).\n"
+		"the same data source. This value has to be a positive number and may be a\n"
+		"fraction of a second. If this member is set to a non-positive value, the\n"
+		"default value as specified in the config file will be used (default: 10).\n"
 		"\n"
 		"If you submit values more often than the specified interval, the average\n"
 		"will be used. If you submit less values, your graphs will have gaps.";
@@ -362,14 +361,14 @@ static PyObject *Values_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 
 static int Values_init(PyObject *s, PyObject *args, PyObject *kwds) {
 	Values *self = (Values *) s;
-	int interval = 0;
+	double interval = 0;
 	double time = 0;
 	PyObject *values = NULL, *meta = NULL, *tmp;
 	char *type = NULL, *plugin_instance = NULL, *type_instance = NULL, *plugin = NULL, *host = NULL;
 	static char *kwlist[] = {"type", "values", "plugin_instance", "type_instance",
 			"plugin", "host", "time", "interval", "meta", NULL};
 	
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|etOetetetetdiO", kwlist,
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|etOetetetetddO", kwlist,
 			NULL, &type, &values, NULL, &plugin_instance, NULL, &type_instance,
 			NULL, &plugin, NULL, &host, &time, &interval, &meta))
 		return -1;
@@ -505,12 +504,12 @@ static PyObject *Values_dispatch(Values *self, PyObject *args, PyObject *kwds) {
 	value_list_t value_list = VALUE_LIST_INIT;
 	PyObject *values = self->values, *meta = self->meta;
 	double time = self->data.time;
-	int interval = self->interval;
+	double interval = self->interval;
 	char *host = NULL, *plugin = NULL, *plugin_instance = NULL, *type = NULL, *type_instance = NULL;
 	
 	static char *kwlist[] = {"type", "values", "plugin_instance", "type_instance",
 			"plugin", "host", "time", "interval", "meta", NULL};
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|etOetetetetdiO", kwlist,
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|etOetetetetddO", kwlist,
 			NULL, &type, &values, NULL, &plugin_instance, NULL, &type_instance,
 			NULL, &plugin, NULL, &host, &time, &interval, &meta))
 		return NULL;
@@ -589,8 +588,8 @@ static PyObject *Values_dispatch(Values *self, PyObject *args, PyObject *kwds) {
 	value_list.values = value;
 	value_list.meta = cpy_build_meta(meta);
 	value_list.values_len = size;
-	value_list.time = time;
-	value_list.interval = interval;
+	value_list.time = (time > 0) ? DOUBLE_TO_CDTIME_T(time) : 0;
+	value_list.interval = (interval > 0) ? DOUBLE_TO_CDTIME_T(interval) : 0;
 	if (value_list.host[0] == 0)
 		sstrncpy(value_list.host, hostname_g, sizeof(value_list.host));
 	if (value_list.plugin[0] == 0)
@@ -615,12 +614,12 @@ static PyObject *Values_write(Values *self, PyObject *args, PyObject *kwds) {
 	value_list_t value_list = VALUE_LIST_INIT;
 	PyObject *values = self->values, *meta = self->meta;
 	double time = self->data.time;
-	int interval = self->interval;
+	double interval = self->interval;
 	char *host = NULL, *plugin = NULL, *plugin_instance = NULL, *type = NULL, *type_instance = NULL, *dest = NULL;
 	
 	static char *kwlist[] = {"destination", "type", "values", "plugin_instance", "type_instance",
 			"plugin", "host", "time", "interval", "meta", NULL};
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "et|etOetetetetdiO", kwlist, NULL, &dest,
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "et|etOetetetetddO", kwlist, NULL, &dest,
 			NULL, &type, &values, NULL, &plugin_instance, NULL, &type_instance,
 			NULL, &plugin, NULL, &host, &time, &interval, &meta))
 		return NULL;
@@ -693,8 +692,8 @@ static PyObject *Values_write(Values *self, PyObject *args, PyObject *kwds) {
 	}
 	value_list.values = value;
 	value_list.values_len = size;
-	value_list.time = time;
-	value_list.interval = interval;
+	value_list.time = (time > 0) ? DOUBLE_TO_CDTIME_T(time) : 0;
+	value_list.interval = (interval > 0) ? DOUBLE_TO_CDTIME_T(interval) : 0;
 	value_list.meta = cpy_build_meta(meta);;
 	if (value_list.host[0] == 0)
 		sstrncpy(value_list.host, hostname_g, sizeof(value_list.host));
@@ -732,7 +731,7 @@ static PyObject *Values_repr(PyObject *s) {
 	ret = cpy_common_repr(s);
 	if (self->interval != 0) {
 		CPY_STRCAT(&ret, l_interval);
-		tmp = PyInt_FromLong(self->interval);
+		tmp = PyFloat_FromDouble(self->interval);
 		CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
 		CPY_STRCAT_AND_DEL(&ret, tmp);
 	}
@@ -770,7 +769,7 @@ static void Values_dealloc(PyObject *self) {
 }
 
 static PyMemberDef Values_members[] = {
-	{"interval", T_INT, offsetof(Values, interval), 0, interval_doc},
+	{"interval", T_DOUBLE, offsetof(Values, interval), 0, interval_doc},
 	{"values", T_OBJECT_EX, offsetof(Values, values), 0, values_doc},
 	{"meta", T_OBJECT_EX, offsetof(Values, meta), 0, meta_doc},
 	{NULL}
@@ -1096,3 +1095,184 @@ PyTypeObject UnsignedType = {
 	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
 	Unsigned_doc               /* tp_doc */
 };
+
+static char ValuesBatch_doc[] = "A read-only sequence of ValueView objects passed to write callbacks\n"
+		"registered with register_write_batch. The values are kept in C and are\n"
+		"only converted to python objects when they are accessed.";
+
+PyObject *ValuesBatch_New(value_list_t *vl, const data_set_t **ds, size_t size) {
+	ValuesBatch *self;
+	size_t i;
+	
+	self = PyObject_New(ValuesBatch, &ValuesBatchType);
+	if (self == NULL) {
+		for (i = 0; i < size; ++i) {
+			free(vl[i].values);
+			meta_data_destroy(vl[i].meta);
+		}
+		free(vl);
+		free(ds);
+		return NULL;
+	}
+	self->vl = vl;
+	self->ds = ds;
+	self->size = (Py_ssize_t) size;
+	return (PyObject *) self;
+}
+
+static void ValuesBatch_dealloc(PyObject *s) {
+	ValuesBatch *self = (ValuesBatch *) s;
+	Py_ssize_t i;
+	
+	for (i = 0; i < self->size; ++i) {
+		free(self->vl[i].values);
+		meta_data_destroy(self->vl[i].meta);
+	}
+	free(self->vl);
+	free(self->ds);
+	PyObject_Del(s);
+}
+
+static Py_ssize_t ValuesBatch_length(PyObject *s) {
+	return ((ValuesBatch *) s)->size;
+}
+
+static PyObject *ValuesBatch_item(PyObject *s, Py_ssize_t i) {
+	ValuesBatch *self = (ValuesBatch *) s;
+	ValueView *view;
+	
+	if (i < 0 || i >= self->size) {
+		PyErr_SetString(PyExc_IndexError, "ValuesBatch index out of range");
+		return NULL;
+	}
+	view = PyObject_New(ValueView, &ValueViewType);
+	if (view == NULL)
+		return NULL;
+	Py_INCREF(s);
+	view->batch = self;
+	view->index = i;
+	return (PyObject *) view;
+}
+
+static PySequenceMethods ValuesBatch_as_sequence = {
+	ValuesBatch_length,        /* sq_length */
+	0,                         /* sq_concat */
+	0,                         /* sq_repeat */
+	ValuesBatch_item,          /* sq_item */
+};
+
+PyTypeObject ValuesBatchType = {
+	CPY_INIT_TYPE
+	"collectd.ValuesBatch",    /* tp_name */
+	sizeof(ValuesBatch),       /* tp_basicsize */
+	0,                         /* Will be filled in later */
+	ValuesBatch_dealloc,       /* tp_dealloc */
+	0,                         /* tp_print */
+	0,                         /* tp_getattr */
+	0,                         /* tp_setattr */
+	0,                         /* tp_compare */
+	0,                         /* tp_repr */
+	0,                         /* tp_as_number */
+	&ValuesBatch_as_sequence,  /* tp_as_sequence */
+	0,                         /* tp_as_mapping */
+	0,                         /* tp_hash */
+	0,                         /* tp_call */
+	0,                         /* tp_str */
+	0,                         /* tp_getattro */
+	0,                         /* tp_setattro */
+	0,                         /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,        /* tp_flags */
+	ValuesBatch_doc            /* tp_doc */
+};
+
+static char ValueView_doc[] = "A read-only view of one entry of a ValuesBatch. It has the same\n"
+		"attributes as a Values object.";
+
+#define ValueView_vl(self) ((self)->batch->vl + (self)->index)
+
+static void ValueView_dealloc(PyObject *s) {
+	Py_DECREF(((ValueView *) s)->batch);
+	PyObject_Del(s);
+}
+
+static PyObject *ValueView_getstring(PyObject *s, void *data) {
+	const char *value = ((char *) ValueView_vl((ValueView *) s)) + (intptr_t) data;
+	
+	return cpy_string_to_unicode_or_bytes(value);
+}
+
+static PyObject *ValueView_gettime(PyObject *s, void *data) {
+	return PyFloat_FromDouble(CDTIME_T_TO_DOUBLE(ValueView_vl((ValueView *) s)->time));
+}
+
+static PyObject *ValueView_getinterval(PyObject *s, void *data) {
+	return PyFloat_FromDouble(CDTIME_T_TO_DOUBLE(ValueView_vl((ValueView *) s)->interval));
+}
+
+static PyObject *ValueView_getvalues(PyObject *s, void *data) {
+	ValueView *self = (ValueView *) s;
+	
+	return cpy_build_values_list(self->batch->ds[self->index], ValueView_vl(self));
+}
+
+static PyObject *ValueView_getmeta(PyObject *s, void *data) {
+	return cpy_build_meta_dict(ValueView_vl((ValueView *) s)->meta);
+}
+
+static PyObject *ValueView_repr(PyObject *s) {
+	ValueView *self = (ValueView *) s;
+	value_list_t *vl = ValueView_vl(self);
+	char buf[512];
+	
+	snprintf(buf, sizeof(buf), "collectd.ValueView(type='%s',type_instance='%s',"
+			"plugin='%s',plugin_instance='%s',host='%s',time=%.3f)",
+			vl->type, vl->type_instance, vl->plugin, vl->plugin_instance,
+			vl->host, CDTIME_T_TO_DOUBLE(vl->time));
+	return cpy_string_to_unicode_or_bytes(buf);
+}
+
+static PyGetSetDef ValueView_getseters[] = {
+	{"host", ValueView_getstring, NULL, host_doc, (void *) offsetof(value_list_t, host)},
+	{"plugin", ValueView_getstring, NULL, plugin_doc, (void *) offsetof(value_list_t, plugin)},
+	{"plugin_instance", ValueView_getstring, NULL, plugin_instance_doc, (void *) offsetof(value_list_t, plugin_instance)},
+	{"type", ValueView_getstring, NULL, type_doc, (void *) offsetof(value_list_t, type)},
+	{"type_instance", ValueView_getstring, NULL, type_instance_doc, (void *) offsetof(value_list_t, type_instance)},
+	{"time", ValueView_gettime, NULL, time_doc, NULL},
+	{"interval", ValueView_getinterval, NULL, interval_doc, NULL},
+	{"values", ValueView_getvalues, NULL, values_doc, NULL},
+	{"meta", ValueView_getmeta, NULL, meta_doc, NULL},
+	{NULL}
+};
+
+PyTypeObject ValueViewType = {
+	CPY_INIT_TYPE
+	"collectd.ValueView",      /* tp_name */
+	sizeof(ValueView),         /* tp_basicsize */
+	0,                         /* Will be filled in later */
+	ValueView_dealloc,         /* tp_dealloc */
+	0,                         /* tp_print */
+	0,                         /* tp_getattr */
+	0,                         /* tp_setattr */
+	0,                         /* tp_compare */
+	ValueView_repr,            /* tp_repr */
+	0,                         /* tp_as_number */
+	0,                         /* tp_as_sequence */
+	0,                         /* tp_as_mapping */
+	0,                         /* tp_hash */
+	0,                         /* tp_call */
+	0,                         /* tp_str */
+	0,                         /* tp_getattro */
+	0,                         /* tp_setattro */
+	0,                         /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,        /* tp_flags */
+	ValueView_doc,             /* tp_doc */
+	0,                         /* tp_traverse */
+	0,                         /* tp_clear */
+	0,                         /* tp_richcompare */
+	0,                         /* tp_weaklistoffset */
+	0,                         /* tp_iter */
+	0,                         /* tp_iternext */
+	0,                         /* tp_methods */
+	0,                         /* tp_members */
+	ValueView_getseters        /* tp_getset */
+};
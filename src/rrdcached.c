@@ -23,11 +23,39 @@
 #include "plugin.h"
 #include "common.h"
 #include "utils_rrdcreate.h"
+#include "utils_avltree.h"
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
 
 #undef HAVE_CONFIG_H
 #include <rrd.h>
 #include <rrd_client.h>
 
+#ifndef RRDCACHED_DEFAULT_PORT
+# define RRDCACHED_DEFAULT_PORT "42217"
+#endif
+
+/* Timeout for sending a batch to and receiving the reply from the daemon. */
+#define RC_SOCKET_TIMEOUT 10
+
+/*
+ * Private data types
+ */
+/* Values which have been written but not yet been sent to the daemon. The
+ * entries are kept in `cache', indexed by the file name. */
+struct rc_cache_s
+{
+  char *filename;
+  char **values;
+  int values_num;
+
+  struct rc_cache_s *next;
+};
+typedef struct rc_cache_s rc_cache_t;
+
 /*
  * Private variables
  */
@@ -36,7 +64,8 @@ static const char *config_keys[] =
   "DaemonAddress",
   "DataDir",
   "CreateFiles",
-  "CollectStatistics"
+  "CollectStatistics",
+  "FlushInterval"
 };
 static int config_keys_num = STATIC_ARRAY_SIZE (config_keys);
 
@@ -44,6 +73,7 @@ static char *datadir = NULL;
 static char *daemon_address = NULL;
 static int config_create_files = 1;
 static int config_collect_stats = 1;
+static int config_flush_interval = 0;
 static rrdcreate_config_t rrdcreate_config =
 {
 	/* stepsize = */ 0,
@@ -58,6 +88,27 @@ static rrdcreate_config_t rrdcreate_config =
 	/* consolidation_functions_num = */ 0
 };
 
+/* `cache' holds the values waiting to be sent, `known_files' the names of all
+ * files which are known to exist, so we don't need to stat(2) them for every
+ * value. Both are protected by `cache_lock'. */
+static c_avl_tree_t   *cache = NULL;
+static c_avl_tree_t   *known_files = NULL;
+static int             cache_values_num = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cache_cond = PTHREAD_COND_INITIALIZER;
+
+/* Round-trip times of the batches sent since the last read. */
+static double          batch_time_sum = 0.0;
+static int             batch_time_num = 0;
+
+static pthread_t       flush_thread;
+static int             flush_thread_running = 0;
+static int             do_shutdown = 0;
+
+/* The connection to the daemon. Only used by the flush thread. */
+static int             daemon_fd = -1;
+static FILE           *daemon_fh = NULL;
+
 static int value_list_to_string (char *buffer, int buffer_len,
     const data_set_t *ds, const value_list_t *vl)
 {
@@ -69,7 +120,10 @@ static int value_list_to_string (char *buffer, int buffer_len,
 
   memset (buffer, '\0', buffer_len);
 
-  status = ssnprintf (buffer, buffer_len, "%u", (unsigned int) vl->time);
+  /* rrdcached is part of RRDtool 1.4 and later, which accept fractional
+   * timestamps. */
+  status = ssnprintf (buffer, buffer_len, "%.3f",
+      CDTIME_T_TO_DOUBLE (vl->time));
   if ((status < 1) || (status >= buffer_len))
     return (-1);
   offset = status;
@@ -160,6 +214,550 @@ static int value_list_to_filename (char *buffer, int buffer_len,
   return (0);
 } /* int value_list_to_filename */
 
+static void rc_cache_free (rc_cache_t *rc)
+{
+  int i;
+
+  while (rc != NULL)
+  {
+    rc_cache_t *next = rc->next;
+
+    for (i = 0; i < rc->values_num; i++)
+      sfree (rc->values[i]);
+    sfree (rc->values);
+    sfree (rc->filename);
+    sfree (rc);
+
+    rc = next;
+  }
+} /* void rc_cache_free */
+
+/* Removes `filename' from the list of known files, so the file is checked
+ * (and possibly created) again with the next value. */
+static void rc_forget_file (const char *filename)
+{
+  void *key = NULL;
+
+  pthread_mutex_lock (&cache_lock);
+  if ((known_files != NULL)
+      && (c_avl_remove (known_files, filename, &key, NULL) == 0))
+    sfree (key);
+  pthread_mutex_unlock (&cache_lock);
+} /* void rc_forget_file */
+
+static void rc_disconnect (void)
+{
+  if (daemon_fh != NULL)
+    fclose (daemon_fh);
+  else if (daemon_fd >= 0)
+    close (daemon_fd);
+
+  daemon_fh = NULL;
+  daemon_fd = -1;
+} /* void rc_disconnect */
+
+static int rc_connect_unix (const char *path)
+{
+  struct sockaddr_un sa;
+  int fd;
+
+  memset (&sa, 0, sizeof (sa));
+  sa.sun_family = AF_UNIX;
+  sstrncpy (sa.sun_path, path, sizeof (sa.sun_path));
+
+  fd = socket (PF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return (-1);
+
+  if (connect (fd, (struct sockaddr *) &sa, sizeof (sa)) != 0)
+  {
+    close (fd);
+    return (-1);
+  }
+
+  return (fd);
+} /* int rc_connect_unix */
+
+static int rc_connect_network (const char *address)
+{
+  struct addrinfo  ai_hints;
+  struct addrinfo *ai_list;
+  struct addrinfo *ai_ptr;
+  char host[NI_MAXHOST];
+  const char *port;
+  char *ptr;
+  int fd;
+  int status;
+
+  sstrncpy (host, address, sizeof (host));
+  port = RRDCACHED_DEFAULT_PORT;
+
+  if (host[0] == '[') /* "[address]:port" */
+  {
+    ptr = strchr (host, ']');
+    if (ptr == NULL)
+      return (-1);
+    *ptr = 0;
+    if (ptr[1] == ':')
+      port = address + (ptr - host) + 2;
+    memmove (host, host + 1, strlen (host + 1) + 1);
+  }
+  else
+  {
+    /* Only treat the colon as port separator if there is exactly one, so
+     * IPv6 addresses without brackets are handled correctly. */
+    ptr = strchr (host, ':');
+    if ((ptr != NULL) && (strchr (ptr + 1, ':') == NULL))
+    {
+      *ptr = 0;
+      port = address + (ptr - host) + 1;
+    }
+  }
+
+  memset (&ai_hints, 0, sizeof (ai_hints));
+  ai_hints.ai_flags    = 0;
+#ifdef AI_ADDRCONFIG
+  ai_hints.ai_flags   |= AI_ADDRCONFIG;
+#endif
+  ai_hints.ai_family   = AF_UNSPEC;
+  ai_hints.ai_socktype = SOCK_STREAM;
+
+  ai_list = NULL;
+  status = getaddrinfo (host, port, &ai_hints, &ai_list);
+  if (status != 0)
+  {
+    ERROR ("rrdcached plugin: getaddrinfo (%s, %s) failed: %s",
+        host, port, gai_strerror (status));
+    return (-1);
+  }
+
+  fd = -1;
+  for (ai_ptr = ai_list; ai_ptr != NULL; ai_ptr = ai_ptr->ai_next)
+  {
+    fd = socket (ai_ptr->ai_family, ai_ptr->ai_socktype,
+        ai_ptr->ai_protocol);
+    if (fd < 0)
+      continue;
+
+    if (connect (fd, ai_ptr->ai_addr, ai_ptr->ai_addrlen) == 0)
+      break;
+
+    close (fd);
+    fd = -1;
+  }
+
+  freeaddrinfo (ai_list);
+  return (fd);
+} /* int rc_connect_network */
+
+/* Opens the connection to the daemon unless it is still open from a previous
+ * batch. */
+static int rc_connect (void)
+{
+  struct timeval tv;
+
+  if (daemon_fh != NULL)
+    return (0);
+
+  if (strncmp ("unix:", daemon_address, strlen ("unix:")) == 0)
+    daemon_fd = rc_connect_unix (daemon_address + strlen ("unix:"));
+  else if (daemon_address[0] == '/')
+    daemon_fd = rc_connect_unix (daemon_address);
+  else
+    daemon_fd = rc_connect_network (daemon_address);
+
+  if (daemon_fd < 0)
+  {
+    char errbuf[1024];
+    ERROR ("rrdcached plugin: Connecting to %s failed: %s",
+        daemon_address, sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  memset (&tv, 0, sizeof (tv));
+  tv.tv_sec = RC_SOCKET_TIMEOUT;
+  setsockopt (daemon_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+  setsockopt (daemon_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv));
+
+  /* The stream is only used for reading the replies; requests are written to
+   * the file descriptor directly. */
+  daemon_fh = fdopen (daemon_fd, "r");
+  if (daemon_fh == NULL)
+  {
+    rc_disconnect ();
+    return (-1);
+  }
+
+  return (0);
+} /* int rc_connect */
+
+/* Appends `str' to the dynamically growing buffer `*buffer'. If `escape' is
+ * true, blanks and backslashes are escaped the way the daemon expects it for
+ * file names. */
+static int rc_buffer_add (char **buffer, size_t *buffer_size,
+    size_t *buffer_len, const char *str, int escape)
+{
+  size_t str_len;
+  size_t i;
+
+  str_len = strlen (str);
+
+  /* Reserve room for every character being escaped. */
+  if ((*buffer_len + 2 * str_len + 1) > *buffer_size)
+  {
+    size_t new_size;
+    char *new_buffer;
+
+    new_size = 2 * (*buffer_size);
+    if (new_size < (*buffer_len + 2 * str_len + 1))
+      new_size = *buffer_len + 2 * str_len + 1;
+
+    new_buffer = realloc (*buffer, new_size);
+    if (new_buffer == NULL)
+      return (-1);
+
+    *buffer = new_buffer;
+    *buffer_size = new_size;
+  }
+
+  for (i = 0; i < str_len; i++)
+  {
+    if (escape && ((str[i] == ' ') || (str[i] == '\\')))
+      (*buffer)[(*buffer_len)++] = '\\';
+    (*buffer)[(*buffer_len)++] = str[i];
+  }
+  (*buffer)[*buffer_len] = 0;
+
+  return (0);
+} /* int rc_buffer_add */
+
+/* Sends all values in the list `head' to the daemon, using one `UPDATE'
+ * command per file. The commands are sent in one `BATCH' together with the
+ * `BATCH' command itself and the terminating dot, so the whole list only
+ * costs one round-trip. Returns -1 on connection errors and the number of
+ * failed commands otherwise. */
+static int rc_send_batch (rc_cache_t *head, const char *buffer,
+    size_t buffer_len)
+{
+  char line[1024];
+  int errors_num;
+  int status;
+  int i;
+
+  status = swrite (daemon_fd, buffer, buffer_len);
+  if (status != 0)
+    return (-1);
+
+  /* "0 Go ahead.  End with dot '.' on its own line." */
+  if ((fgets (line, sizeof (line), daemon_fh) == NULL)
+      || (atoi (line) != 0))
+    return (-1);
+
+  /* "<N> errors", followed by one line per failed command. */
+  if (fgets (line, sizeof (line), daemon_fh) == NULL)
+    return (-1);
+  errors_num = atoi (line);
+
+  for (i = 0; i < errors_num; i++)
+  {
+    rc_cache_t *rc;
+    char *message;
+    int command;
+    size_t len;
+
+    if (fgets (line, sizeof (line), daemon_fh) == NULL)
+      return (-1);
+
+    len = strlen (line);
+    while ((len > 0)
+        && ((line[len - 1] == '\n') || (line[len - 1] == '\r')))
+      line[--len] = 0;
+
+    /* Commands are numbered starting with one. */
+    command = (int) strtol (line, &message, 10);
+    for (rc = head; (rc != NULL) && (command > 1); rc = rc->next)
+      command--;
+
+    while (*message == ' ')
+      message++;
+
+    if (rc == NULL)
+    {
+      ERROR ("rrdcached plugin: Batch update failed: %s", line);
+      continue;
+    }
+
+    ERROR ("rrdcached plugin: Updating `%s' failed: %s",
+        rc->filename, message);
+
+    /* The file may have been removed. Check it again with the next value. */
+    if (config_create_files != 0)
+      rc_forget_file (rc->filename);
+  }
+
+  return (errors_num);
+} /* int rc_send_batch */
+
+static void rc_flush (rc_cache_t *head)
+{
+  struct timeval tv_begin;
+  struct timeval tv_end;
+  char *buffer = NULL;
+  size_t buffer_size = 0;
+  size_t buffer_len = 0;
+  rc_cache_t *rc;
+  int status;
+  int i;
+
+  if (head == NULL)
+    return;
+
+  status = rc_buffer_add (&buffer, &buffer_size, &buffer_len, "BATCH\n", 0);
+  for (rc = head; (rc != NULL) && (status == 0); rc = rc->next)
+  {
+    status = rc_buffer_add (&buffer, &buffer_size, &buffer_len, "UPDATE ", 0);
+    if (status == 0)
+      status = rc_buffer_add (&buffer, &buffer_size, &buffer_len,
+          rc->filename, /* escape = */ 1);
+
+    for (i = 0; (i < rc->values_num) && (status == 0); i++)
+    {
+      status = rc_buffer_add (&buffer, &buffer_size, &buffer_len, " ", 0);
+      if (status == 0)
+        status = rc_buffer_add (&buffer, &buffer_size, &buffer_len,
+            rc->values[i], 0);
+    }
+
+    if (status == 0)
+      status = rc_buffer_add (&buffer, &buffer_size, &buffer_len, "\n", 0);
+  }
+  if (status == 0)
+    status = rc_buffer_add (&buffer, &buffer_size, &buffer_len, ".\n", 0);
+
+  if (status != 0)
+  {
+    ERROR ("rrdcached plugin: rc_flush: realloc failed.");
+    sfree (buffer);
+    return;
+  }
+
+  gettimeofday (&tv_begin, /* timezone = */ NULL);
+
+  /* If the connection was kept open since the last batch, the daemon may
+   * have closed it in the meantime. In that case, try again once with a new
+   * connection. */
+  for (i = 0; i < 2; i++)
+  {
+    int reused = (daemon_fh != NULL);
+
+    status = rc_connect ();
+    if (status != 0)
+      break;
+
+    status = rc_send_batch (head, buffer, buffer_len);
+    if (status >= 0)
+      break;
+
+    rc_disconnect ();
+    if (!reused)
+    {
+      ERROR ("rrdcached plugin: Sending values to %s failed.",
+          daemon_address);
+      break;
+    }
+  }
+
+  gettimeofday (&tv_end, /* timezone = */ NULL);
+
+  if (status >= 0)
+  {
+    pthread_mutex_lock (&cache_lock);
+    batch_time_sum += ((double) (tv_end.tv_sec - tv_begin.tv_sec))
+      + (((double) (tv_end.tv_usec - tv_begin.tv_usec)) / 1000000.0);
+    batch_time_num++;
+    pthread_mutex_unlock (&cache_lock);
+  }
+
+  sfree (buffer);
+} /* void rc_flush */
+
+/* Removes all entries from the cache and returns them as a linked list.
+ * `cache_lock' must be held by the caller. */
+static rc_cache_t *rc_cache_take (void)
+{
+  rc_cache_t *head = NULL;
+  void *key;
+  void *value;
+
+  while (c_avl_pick (cache, &key, &value) == 0)
+  {
+    rc_cache_t *rc = value;
+
+    rc->filename = key;
+    rc->next = head;
+    head = rc;
+  }
+  cache_values_num = 0;
+
+  return (head);
+} /* rc_cache_t *rc_cache_take */
+
+static void *rc_flush_thread (void __attribute__((unused)) *data)
+{
+  pthread_mutex_lock (&cache_lock);
+  while (42)
+  {
+    rc_cache_t *head;
+
+    while ((do_shutdown == 0) && (cache_values_num == 0))
+      pthread_cond_wait (&cache_cond, &cache_lock);
+
+    /* Give the cache some time to fill up, so more values are sent with
+     * each batch. */
+    if ((do_shutdown == 0) && (config_flush_interval > 0))
+    {
+      struct timespec ts_wait;
+
+      ts_wait.tv_sec = time (NULL) + config_flush_interval;
+      ts_wait.tv_nsec = 0;
+
+      while ((do_shutdown == 0)
+          && (pthread_cond_timedwait (&cache_cond, &cache_lock,
+              &ts_wait) != ETIMEDOUT))
+        /* wait */;
+    }
+
+    head = rc_cache_take ();
+    pthread_mutex_unlock (&cache_lock);
+
+    rc_flush (head);
+    rc_cache_free (head);
+
+    pthread_mutex_lock (&cache_lock);
+    if ((do_shutdown != 0) && (cache_values_num == 0))
+      break;
+  } /* while (42) */
+  pthread_mutex_unlock (&cache_lock);
+
+  rc_disconnect ();
+
+  pthread_exit ((void *) 0);
+  return ((void *) 0);
+} /* void *rc_flush_thread */
+
+static int rc_cache_insert (const char *filename, const char *value)
+{
+  rc_cache_t *rc = NULL;
+  char **values_new;
+
+  pthread_mutex_lock (&cache_lock);
+
+  if (cache == NULL)
+  {
+    pthread_mutex_unlock (&cache_lock);
+    ERROR ("rrdcached plugin: cache == NULL.");
+    return (-1);
+  }
+
+  if (c_avl_get (cache, filename, (void *) &rc) != 0)
+  {
+    rc = (rc_cache_t *) malloc (sizeof (*rc));
+    if (rc == NULL)
+    {
+      pthread_mutex_unlock (&cache_lock);
+      ERROR ("rrdcached plugin: malloc failed.");
+      return (-1);
+    }
+    memset (rc, 0, sizeof (*rc));
+
+    rc->filename = strdup (filename);
+    if ((rc->filename == NULL)
+        || (c_avl_insert (cache, rc->filename, rc) != 0))
+    {
+      pthread_mutex_unlock (&cache_lock);
+      ERROR ("rrdcached plugin: Inserting `%s' into the cache failed.",
+          filename);
+      sfree (rc->filename);
+      sfree (rc);
+      return (-1);
+    }
+  }
+
+  values_new = (char **) realloc ((void *) rc->values,
+      (rc->values_num + 1) * sizeof (char *));
+  if (values_new == NULL)
+  {
+    pthread_mutex_unlock (&cache_lock);
+    ERROR ("rrdcached plugin: realloc failed.");
+    return (-1);
+  }
+  rc->values = values_new;
+
+  rc->values[rc->values_num] = strdup (value);
+  if (rc->values[rc->values_num] == NULL)
+  {
+    pthread_mutex_unlock (&cache_lock);
+    ERROR ("rrdcached plugin: strdup failed.");
+    return (-1);
+  }
+  rc->values_num++;
+  cache_values_num++;
+
+  pthread_cond_signal (&cache_cond);
+  pthread_mutex_unlock (&cache_lock);
+
+  return (0);
+} /* int rc_cache_insert */
+
+/* Makes sure the RRD file exists, creating it if necessary. Files which are
+ * known to exist are remembered, so the file system is only checked once per
+ * file. */
+static int rc_check_file (const char *filename, const data_set_t *ds,
+    const value_list_t *vl)
+{
+  struct stat statbuf;
+  char *key;
+  int status;
+
+  pthread_mutex_lock (&cache_lock);
+  status = c_avl_get (known_files, filename, /* value = */ NULL);
+  pthread_mutex_unlock (&cache_lock);
+
+  if (status == 0)
+    return (0);
+
+  status = stat (filename, &statbuf);
+  if (status != 0)
+  {
+    if (errno != ENOENT)
+    {
+      char errbuf[1024];
+      ERROR ("rrdcached plugin: stat (%s) failed: %s",
+          filename, sstrerror (errno, errbuf, sizeof (errbuf)));
+      return (-1);
+    }
+
+    status = cu_rrd_create_file (filename, ds, vl, &rrdcreate_config);
+    if (status != 0)
+    {
+      ERROR ("rrdcached plugin: cu_rrd_create_file (%s) failed.",
+          filename);
+      return (-1);
+    }
+  }
+
+  key = strdup (filename);
+  if (key == NULL)
+    return (0);
+
+  pthread_mutex_lock (&cache_lock);
+  if (c_avl_insert (known_files, key, /* value = */ NULL) != 0)
+    sfree (key);
+  pthread_mutex_unlock (&cache_lock);
+
+  return (0);
+} /* int rc_check_file */
+
 static int rc_config (const char *key, const char *value)
 {
   if (strcasecmp ("DataDir", key) == 0)
@@ -206,6 +804,16 @@ static int rc_config (const char *key, const char *value)
     else
       config_collect_stats = 1;
   }
+  else if (strcasecmp ("FlushInterval", key) == 0)
+  {
+    int tmp = atoi (value);
+    if (tmp < 0)
+    {
+      WARNING ("rrdcached plugin: `FlushInterval' must not be negative.");
+      return (1);
+    }
+    config_flush_interval = tmp;
+  }
   else
   {
     return (-1);
@@ -231,6 +839,34 @@ static int rc_read (void)
   vl.values = values;
   vl.values_len = 1;
 
+  /* Statistics of the plugin itself: The number of values waiting to be
+   * sent and the average round-trip time of the batches. */
+  sstrncpy (vl.host, hostname_g, sizeof (vl.host));
+  sstrncpy (vl.plugin, "rrdcached", sizeof (vl.plugin));
+  sstrncpy (vl.plugin_instance, "client", sizeof (vl.plugin_instance));
+
+  pthread_mutex_lock (&cache_lock);
+  values[0].gauge = (gauge_t) cache_values_num;
+  pthread_mutex_unlock (&cache_lock);
+
+  sstrncpy (vl.type, "queue_length", sizeof (vl.type));
+  plugin_dispatch_values (&vl);
+
+  pthread_mutex_lock (&cache_lock);
+  if (batch_time_num > 0)
+    values[0].gauge = (gauge_t) (batch_time_sum / ((double) batch_time_num));
+  else
+    values[0].gauge = NAN;
+  batch_time_sum = 0.0;
+  batch_time_num = 0;
+  pthread_mutex_unlock (&cache_lock);
+
+  sstrncpy (vl.type, "response_time", sizeof (vl.type));
+  sstrncpy (vl.type_instance, "batch", sizeof (vl.type_instance));
+  plugin_dispatch_values (&vl);
+
+  sstrncpy (vl.plugin_instance, "", sizeof (vl.plugin_instance));
+
   if ((strncmp ("unix:", daemon_address, strlen ("unix:")) == 0)
       || (daemon_address[0] == '/'))
     sstrncpy (vl.host, hostname_g, sizeof (vl.host));
@@ -238,6 +874,14 @@ static int rc_read (void)
     sstrncpy (vl.host, daemon_address, sizeof (vl.host));
   sstrncpy (vl.plugin, "rrdcached", sizeof (vl.plugin));
 
+  status = rrdc_connect (daemon_address);
+  if (status != 0)
+  {
+    ERROR ("rrdcached plugin: rrdc_connect (%s) failed with status %i.",
+        daemon_address, status);
+    return (-1);
+  }
+
   head = NULL;
   status = rrdc_stats_get (&head);
   if (status != 0)
@@ -317,9 +961,34 @@ static int rc_read (void)
 
 static int rc_init (void)
 {
+  int status;
+
   if (config_collect_stats != 0)
     plugin_register_read ("rrdcached", rc_read);
 
+  if (daemon_address == NULL)
+    return (0);
+
+  pthread_mutex_lock (&cache_lock);
+  cache = c_avl_create ((int (*) (const void *, const void *)) strcmp);
+  known_files = c_avl_create ((int (*) (const void *, const void *)) strcmp);
+  pthread_mutex_unlock (&cache_lock);
+
+  if ((cache == NULL) || (known_files == NULL))
+  {
+    ERROR ("rrdcached plugin: c_avl_create failed.");
+    return (-1);
+  }
+
+  status = pthread_create (&flush_thread, /* attr = */ NULL,
+      rc_flush_thread, /* args = */ NULL);
+  if (status != 0)
+  {
+    ERROR ("rrdcached plugin: Cannot create flush thread.");
+    return (-1);
+  }
+  flush_thread_running = 1;
+
   return (0);
 } /* int rc_init */
 
@@ -328,7 +997,6 @@ static int rc_write (const data_set_t *ds, const value_list_t *vl,
 {
   char filename[512];
   char values[512];
-  char *values_array[2];
   int status;
 
   if (daemon_address == NULL)
@@ -356,56 +1024,49 @@ static int rc_write (const data_set_t *ds, const value_list_t *vl,
     return (-1);
   }
 
-  values_array[0] = values;
-  values_array[1] = NULL;
-
   if (config_create_files != 0)
   {
-    struct stat statbuf;
-
-    status = stat (filename, &statbuf);
+    status = rc_check_file (filename, ds, vl);
     if (status != 0)
-    {
-      if (errno != ENOENT)
-      {
-        char errbuf[1024];
-        ERROR ("rrdcached plugin: stat (%s) failed: %s",
-            filename, sstrerror (errno, errbuf, sizeof (errbuf)));
-        return (-1);
-      }
-
-      status = cu_rrd_create_file (filename, ds, vl, &rrdcreate_config);
-      if (status != 0)
-      {
-        ERROR ("rrdcached plugin: cu_rrd_create_file (%s) failed.",
-            filename);
-        return (-1);
-      }
-    }
+      return (-1);
   }
 
-  status = rrdc_connect (daemon_address);
-  if (status != 0)
+  return (rc_cache_insert (filename, values));
+} /* int rc_write */
+
+static int rc_shutdown (void)
+{
+  void *key;
+  void *value;
+
+  /* The flush thread sends all remaining values before exiting. */
+  pthread_mutex_lock (&cache_lock);
+  do_shutdown = 1;
+  pthread_cond_signal (&cache_cond);
+  pthread_mutex_unlock (&cache_lock);
+
+  if (flush_thread_running != 0)
   {
-    ERROR ("rrdcached plugin: rrdc_connect (%s) failed with status %i.",
-        daemon_address, status);
-    return (-1);
+    pthread_join (flush_thread, NULL);
+    flush_thread_running = 0;
   }
 
-  status = rrdc_update (filename, /* values_num = */ 1, (void *) values_array);
-  if (status != 0)
+  pthread_mutex_lock (&cache_lock);
+  if (cache != NULL)
   {
-    ERROR ("rrdcached plugin: rrdc_update (%s, [%s], 1) failed with "
-        "status %i.",
-        filename, values_array[0], status);
-    return (-1);
+    rc_cache_free (rc_cache_take ());
+    c_avl_destroy (cache);
+    cache = NULL;
   }
+  if (known_files != NULL)
+  {
+    while (c_avl_pick (known_files, &key, &value) == 0)
+      sfree (key);
+    c_avl_destroy (known_files);
+    known_files = NULL;
+  }
+  pthread_mutex_unlock (&cache_lock);
 
-  return (0);
-} /* int rc_write */
-
-static int rc_shutdown (void)
-{
   rrdc_disconnect ();
   return (0);
 } /* int rc_shutdown */
@@ -203,7 +203,8 @@ static int value_list_to_string (char *buffer, int buffer_len,
 
 	memset (buffer, '\0', buffer_len);
 
-	status = ssnprintf (buffer, buffer_len, "%u", (unsigned int) vl->time);
+	status = ssnprintf (buffer, buffer_len, "%u",
+			(unsigned int) CDTIME_T_TO_TIME_T (vl->time));
 	if ((status < 1) || (status >= buffer_len))
 		return (-1);
 	offset = status;
@@ -894,7 +895,10 @@ static int rrd_write (const data_set_t *ds, const value_list_t *vl,
 		return (-1);
 	}
 
-	status = rrd_cache_insert (filename, values, vl->time);
+	/* RRD files store one value per second at most. Values which are
+	 * collected more often are dropped by `rrd_cache_insert'. */
+	status = rrd_cache_insert (filename, values,
+			CDTIME_T_TO_TIME_T (vl->time));
 
 	return (status);
 } /* int rrd_write */
@@ -1134,12 +1138,14 @@ static int rrd_init (void)
 		rrdcreate_config.heartbeat = 2 * rrdcreate_config.stepsize;
 
 	if ((rrdcreate_config.heartbeat > 0)
-			&& (rrdcreate_config.heartbeat < interval_g))
+			&& (TIME_T_TO_CDTIME_T (rrdcreate_config.heartbeat)
+				< interval_g))
 		WARNING ("rrdtool plugin: Your `heartbeat' is "
 				"smaller than your `interval'. This will "
 				"likely cause problems.");
 	else if ((rrdcreate_config.stepsize > 0)
-			&& (rrdcreate_config.stepsize < interval_g))
+			&& (TIME_T_TO_CDTIME_T (rrdcreate_config.stepsize)
+				< interval_g))
 		WARNING ("rrdtool plugin: Your `stepsize' is "
 				"smaller than your `interval'. This will "
 				"create needlessly big RRD-files.");
@@ -36,6 +36,10 @@
 #include "common.h"
 #include "plugin.h"
 
+#if KERNEL_LINUX
+# include "utils_procfs.h"
+#endif
+
 #if HAVE_SYS_SWAP_H
 # include <sys/swap.h>
 #endif
@@ -68,7 +72,10 @@
 #define MAX(x,y) ((x) > (y) ? (x) : (y))
 
 #if KERNEL_LINUX
-/* No global variables */
+static cu_procfs_t *proc_meminfo = NULL;
+static cu_procfs_t *proc_vmstat = NULL;
+/* Set if /proc/vmstat does not exist and /proc/stat is read instead. */
+static _Bool old_kernel = 0;
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKSTAT
@@ -187,14 +194,12 @@ static void swap_submit (const char *type_instance, derive_t value, unsigned typ
 static int swap_read (void)
 {
 #if KERNEL_LINUX
-	FILE *fh;
-	char buffer[1024];
+	char *buffer;
+	char *line;
 
 	char *fields[8];
 	int numfields;
 
-	_Bool old_kernel=0;
-
 	derive_t swap_used   = 0;
 	derive_t swap_cached = 0;
 	derive_t swap_free   = 0;
@@ -202,17 +207,29 @@ static int swap_read (void)
 	derive_t swap_in     = 0;
 	derive_t swap_out    = 0;
 
-	if ((fh = fopen ("/proc/meminfo", "r")) == NULL)
+	if (proc_meminfo == NULL)
+	{
+		proc_meminfo = cu_procfs_create ("/proc/meminfo");
+		if (proc_meminfo == NULL)
+		{
+			char errbuf[1024];
+			WARNING ("memory: open: %s",
+					sstrerror (errno, errbuf, sizeof (errbuf)));
+			return (-1);
+		}
+	}
+
+	if ((buffer = cu_procfs_read (proc_meminfo, NULL)) == NULL)
 	{
 		char errbuf[1024];
-		WARNING ("memory: fopen: %s",
+		WARNING ("memory: read: %s",
 				sstrerror (errno, errbuf, sizeof (errbuf)));
 		return (-1);
 	}
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	while ((line = cu_procfs_line (&buffer)) != NULL)
 	{
-		numfields = strsplit (buffer, fields, STATIC_ARRAY_SIZE (fields));
+		numfields = cu_procfs_fields (line, fields, STATIC_ARRAY_SIZE (fields));
 		if (numfields < 2)
 			continue;
 
@@ -224,35 +241,41 @@ static int swap_read (void)
 			strtoderive (fields[1], &swap_cached);
 	}
 
-	if (fclose (fh))
-	{
-		char errbuf[1024];
-		WARNING ("memory: fclose: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
-	}
-
 	if ((swap_total == 0LL) || ((swap_free + swap_cached) > swap_total))
 		return (-1);
 
 	swap_used = swap_total - (swap_free + swap_cached);
 
-	if ((fh = fopen ("/proc/vmstat", "r")) == NULL)
+	if (proc_vmstat == NULL)
 	{
-		// /proc/vmstat does not exist in kernels <2.6
-		if ((fh = fopen ("/proc/stat", "r")) == NULL )
+		old_kernel = 0;
+		proc_vmstat = cu_procfs_create ("/proc/vmstat");
+		if (proc_vmstat == NULL)
 		{
-			char errbuf[1024];
-			WARNING ("swap: fopen: %s",
-					sstrerror (errno, errbuf, sizeof (errbuf)));
-			return (-1);
-		}
-		else
+			// /proc/vmstat does not exist in kernels <2.6
+			proc_vmstat = cu_procfs_create ("/proc/stat");
+			if (proc_vmstat == NULL)
+			{
+				char errbuf[1024];
+				WARNING ("swap: open: %s",
+						sstrerror (errno, errbuf, sizeof (errbuf)));
+				return (-1);
+			}
 			old_kernel = 1;
+		}
 	}
 
-	while (fgets (buffer, sizeof (buffer), fh) != NULL)
+	if ((buffer = cu_procfs_read (proc_vmstat, NULL)) == NULL)
 	{
-		numfields = strsplit (buffer, fields, STATIC_ARRAY_SIZE (fields));
+		char errbuf[1024];
+		WARNING ("swap: read: %s",
+				sstrerror (errno, errbuf, sizeof (errbuf)));
+		return (-1);
+	}
+
+	while ((line = cu_procfs_line (&buffer)) != NULL)
+	{
+		numfields = cu_procfs_fields (line, fields, STATIC_ARRAY_SIZE (fields));
 
 		if (!old_kernel)
 		{
@@ -275,14 +298,7 @@ static int swap_read (void)
 				strtoderive (fields[2], &swap_out);
 			}
 		}
-	} /* while (fgets) */
-
-	if (fclose (fh))
-	{
-		char errbuf[1024];
-		WARNING ("swap: fclose: %s",
-				sstrerror (errno, errbuf, sizeof (errbuf)));
-	}
+	} /* while (cu_procfs_line) */
 
 	swap_submit ("used",   1024 * swap_used,   DS_TYPE_GAUGE);
 	swap_submit ("free",   1024 * swap_free,   DS_TYPE_GAUGE);
@@ -490,8 +506,23 @@ static int swap_read (void)
 	return (0);
 } /* int swap_read */
 
+#if KERNEL_LINUX
+static int swap_shutdown (void)
+{
+	cu_procfs_destroy (proc_meminfo);
+	proc_meminfo = NULL;
+	cu_procfs_destroy (proc_vmstat);
+	proc_vmstat = NULL;
+
+	return (0);
+} /* int swap_shutdown */
+#endif /* KERNEL_LINUX */
+
 void module_register (void)
 {
 	plugin_register_init ("swap", swap_init);
 	plugin_register_read ("swap", swap_read);
+#if KERNEL_LINUX
+	plugin_register_shutdown ("swap", swap_shutdown);
+#endif
 } /* void module_register */
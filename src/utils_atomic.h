@@ -0,0 +1,95 @@
+/**
+ * collectd - src/utils_atomic.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ **/
+
+#ifndef UTILS_ATOMIC_H
+#define UTILS_ATOMIC_H 1
+
+/*
+ * Counters which are incremented by a capture or collector thread and read
+ * by the read callback. If the compiler provides the __sync builtins, the
+ * counters are updated without taking any lock. Otherwise a mutex, private
+ * to the including file, is used.
+ */
+
+#include "collectd.h"
+
+#if !HAVE_SYNC_BUILTINS
+# include <pthread.h>
+static pthread_mutex_t catomic_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Adds `inc' to `*counter' and returns the new value. */
+static inline uint64_t catomic_add (uint64_t *counter, uint64_t inc) /* {{{ */
+{
+#if HAVE_SYNC_BUILTINS
+  return (__sync_add_and_fetch (counter, inc));
+#else
+  uint64_t ret;
+
+  pthread_mutex_lock (&catomic_lock);
+  *counter += inc;
+  ret = *counter;
+  pthread_mutex_unlock (&catomic_lock);
+
+  return (ret);
+#endif
+} /* }}} uint64_t catomic_add */
+
+/* Returns the current value of `*counter'. */
+static inline uint64_t catomic_get (uint64_t *counter) /* {{{ */
+{
+  return (catomic_add (counter, 0));
+} /* }}} uint64_t catomic_get */
+
+/* Returns the current value of `*counter' and sets it to zero. */
+static inline uint64_t catomic_reset (uint64_t *counter) /* {{{ */
+{
+#if HAVE_SYNC_BUILTINS
+  uint64_t old;
+
+  do
+  {
+    old = *((volatile uint64_t *) counter);
+  } while (!__sync_bool_compare_and_swap (counter, old, 0));
+
+  return (old);
+#else
+  uint64_t ret;
+
+  pthread_mutex_lock (&catomic_lock);
+  ret = *counter;
+  *counter = 0;
+  pthread_mutex_unlock (&catomic_lock);
+
+  return (ret);
+#endif
+} /* }}} uint64_t catomic_reset */
+
+/* Makes sure all writes issued before are visible to other threads before
+ * any write issued afterwards. Use this before publishing a pointer to a
+ * newly initialized object. */
+static inline void catomic_barrier (void) /* {{{ */
+{
+#if HAVE_SYNC_BUILTINS
+  __sync_synchronize ();
+#else
+  pthread_mutex_lock (&catomic_lock);
+  pthread_mutex_unlock (&catomic_lock);
+#endif
+} /* }}} void catomic_barrier */
+
+#endif /* UTILS_ATOMIC_H */
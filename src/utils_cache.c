@@ -38,13 +38,13 @@ typedef struct cache_entry_s
 	value_t   *values_raw;
 	/* Time contained in the package
 	 * (for calculating rates) */
-	time_t last_time;
+	cdtime_t last_time;
 	/* Time according to the local clock
 	 * (for purging old entries) */
-	time_t last_update;
+	cdtime_t last_update;
 	/* Interval in which the data is collected
 	 * (for purding old entries) */
-	int interval;
+	cdtime_t interval;
 	int state;
 	int hits;
 
@@ -123,6 +123,7 @@ static void cache_free (cache_entry_t *ce)
 static int uc_send_notification (const char *name)
 {
   cache_entry_t *ce = NULL;
+  cdtime_t now;
   int status;
 
   char *name_copy;
@@ -164,7 +165,8 @@ static int uc_send_notification (const char *name)
    * acquiring the lock takes and we will use this time later to decide
    * whether or not the state is OKAY.
    */
-  n.time = time (NULL);
+  now = cdtime ();
+  n.time = CDTIME_T_TO_TIME_T (now);
 
   status = c_avl_get (cache_tree, name, (void *) &ce);
   if (status != 0)
@@ -174,8 +176,10 @@ static int uc_send_notification (const char *name)
     return (-1);
   }
     
-  /* Check if the entry has been updated in the meantime */
-  if ((n.time - ce->last_update) < (timeout_g * ce->interval))
+  /* Check if the entry has been updated in the meantime. If the clock has
+   * been stepped backwards, `last_update' may be in the future. */
+  if ((ce->last_update > now)
+      || ((now - ce->last_update) < (timeout_g * ce->interval)))
   {
     ce->state = STATE_OKAY;
     pthread_mutex_unlock (&cache_lock);
@@ -184,8 +188,8 @@ static int uc_send_notification (const char *name)
   }
 
   ssnprintf (n.message, sizeof (n.message),
-      "%s has not been updated for %i seconds.", name,
-      (int) (n.time - ce->last_update));
+      "%s has not been updated for %.3f seconds.", name,
+      CDTIME_T_TO_DOUBLE (now - ce->last_update));
 
   pthread_mutex_unlock (&cache_lock);
 
@@ -258,7 +262,7 @@ static int uc_insert (const data_set_t *ds, const value_list_t *vl,
 	ce->values_gauge[i] = NAN;
 	if (vl->interval > 0)
 	  ce->values_gauge[i] = ((double) vl->values[i].absolute)
-	    / ((double) vl->interval);
+	    / CDTIME_T_TO_DOUBLE (vl->interval);
 	ce->values_raw[i].absolute = vl->values[i].absolute;
 	break;
 	
@@ -274,7 +278,7 @@ static int uc_insert (const data_set_t *ds, const value_list_t *vl,
   uc_check_range (ds, ce);
 
   ce->last_time = vl->time;
-  ce->last_update = time (NULL);
+  ce->last_update = cdtime ();
   ce->interval = vl->interval;
   ce->state = STATE_OKAY;
 
@@ -300,7 +304,7 @@ int uc_init (void)
 
 int uc_check_timeout (void)
 {
-  time_t now;
+  cdtime_t now;
   cache_entry_t *ce;
 
   char **keys = NULL;
@@ -312,14 +316,16 @@ int uc_check_timeout (void)
   
   pthread_mutex_lock (&cache_lock);
 
-  now = time (NULL);
+  now = cdtime ();
 
   /* Build a list of entries to be flushed */
   iter = c_avl_get_iterator (cache_tree);
   while (c_avl_iterator_next (iter, (void *) &key, (void *) &ce) == 0)
   {
-    /* If entry has not been updated, add to `keys' array */
-    if ((now - ce->last_update) >= (timeout_g * ce->interval))
+    /* If entry has not been updated, add to `keys' array. Entries updated
+     * "in the future" are fresh, the clock has been stepped backwards. */
+    if ((ce->last_update <= now)
+	&& ((now - ce->last_update) >= (timeout_g * ce->interval)))
     {
       char **tmp;
 
@@ -448,7 +454,7 @@ int uc_update (const data_set_t *ds, const value_list_t *vl)
   char name[6 * DATA_MAX_NAME_LEN];
   cache_entry_t *ce = NULL;
   int send_okay_notification = 0;
-  time_t update_delay = 0;
+  cdtime_t update_delay = 0;
   notification_t n;
   int status;
   int i;
@@ -475,9 +481,10 @@ int uc_update (const data_set_t *ds, const value_list_t *vl)
   if (ce->last_time >= vl->time)
   {
     pthread_mutex_unlock (&cache_lock);
-    NOTICE ("uc_update: Value too old: name = %s; value time = %u; "
-	"last cache update = %u;",
-	name, (unsigned int) vl->time, (unsigned int) ce->last_time);
+    NOTICE ("uc_update: Value too old: name = %s; value time = %.3f; "
+	"last cache update = %.3f;",
+	name, CDTIME_T_TO_DOUBLE (vl->time),
+	CDTIME_T_TO_DOUBLE (ce->last_time));
     return (-1);
   }
 
@@ -487,7 +494,9 @@ int uc_update (const data_set_t *ds, const value_list_t *vl)
   {
     send_okay_notification = 1;
     ce->state = STATE_OKAY;
-    update_delay = time (NULL) - ce->last_update;
+    update_delay = cdtime ();
+    update_delay = (update_delay > ce->last_update)
+      ? (update_delay - ce->last_update) : 0;
   }
 
   for (i = 0; i < ds->ds_num; i++)
@@ -514,7 +523,7 @@ int uc_update (const data_set_t *ds, const value_list_t *vl)
 	  }
 
 	  ce->values_gauge[i] = ((double) diff)
-	    / ((double) (vl->time - ce->last_time));
+	    / CDTIME_T_TO_DOUBLE (vl->time - ce->last_time);
 	  ce->values_raw[i].counter = vl->values[i].counter;
 	}
 	break;
@@ -531,14 +540,14 @@ int uc_update (const data_set_t *ds, const value_list_t *vl)
 	  diff = vl->values[i].derive - ce->values_raw[i].derive;
 
 	  ce->values_gauge[i] = ((double) diff)
-	    / ((double) (vl->time - ce->last_time));
+	    / CDTIME_T_TO_DOUBLE (vl->time - ce->last_time);
 	  ce->values_raw[i].derive = vl->values[i].derive;
 	}
 	break;
 
       case DS_TYPE_ABSOLUTE:
 	ce->values_gauge[i] = ((double) vl->values[i].absolute)
-	  / ((double) (vl->time - ce->last_time));
+	  / CDTIME_T_TO_DOUBLE (vl->time - ce->last_time);
 	ce->values_raw[i].absolute = vl->values[i].absolute;
 	break;
 
@@ -571,7 +580,7 @@ int uc_update (const data_set_t *ds, const value_list_t *vl)
   uc_check_range (ds, ce);
 
   ce->last_time = vl->time;
-  ce->last_update = time (NULL);
+  ce->last_update = cdtime ();
   ce->interval = vl->interval;
 
   pthread_mutex_unlock (&cache_lock);
@@ -590,11 +599,11 @@ int uc_update (const data_set_t *ds, const value_list_t *vl)
   NOTIFICATION_INIT_VL (&n, vl, ds);
 
   n.severity = NOTIF_OKAY;
-  n.time = vl->time;
+  n.time = CDTIME_T_TO_TIME_T (vl->time);
 
   ssnprintf (n.message, sizeof (n.message),
-      "Received a value for %s. It was missing for %u seconds.",
-      name, (unsigned int) update_delay);
+      "Received a value for %s. It was missing for %.3f seconds.",
+      name, CDTIME_T_TO_DOUBLE (update_delay));
 
   plugin_dispatch_notification (&n);
 
@@ -682,14 +691,14 @@ gauge_t *uc_get_rate (const data_set_t *ds, const value_list_t *vl)
   return (ret);
 } /* gauge_t *uc_get_rate */
 
-int uc_get_names (char ***ret_names, time_t **ret_times, size_t *ret_number)
+int uc_get_names (char ***ret_names, cdtime_t **ret_times, size_t *ret_number)
 {
   c_avl_iterator_t *iter;
   char *key;
   cache_entry_t *value;
 
   char **names = NULL;
-  time_t *times = NULL;
+  cdtime_t *times = NULL;
   size_t number = 0;
 
   int status = 0;
@@ -710,9 +719,9 @@ int uc_get_names (char ***ret_names, time_t **ret_times, size_t *ret_number)
 
     if (ret_times != NULL)
     {
-      time_t *tmp_times;
+      cdtime_t *tmp_times;
 
-      tmp_times = (time_t *) realloc (times, sizeof (time_t) * (number + 1));
+      tmp_times = (cdtime_t *) realloc (times, sizeof (cdtime_t) * (number + 1));
       if (tmp_times == NULL)
       {
 	status = -1;
@@ -1000,8 +1009,9 @@ static meta_data_t *uc_get_meta (const value_list_t *vl) /* {{{ */
   }
   assert (ce != NULL);
 
+  /* All accesses are protected by `cache_lock'. */
   if (ce->meta == NULL)
-    ce->meta = meta_data_create ();
+    ce->meta = meta_data_create_unlocked ();
 
   if (ce->meta == NULL)
     pthread_mutex_unlock (&cache_lock);
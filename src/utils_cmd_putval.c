@@ -56,15 +56,9 @@ static int set_option (value_list_t *vl, const char *key, const char *value)
 
 	if (strcasecmp ("interval", key) == 0)
 	{
-		int tmp;
-		char *endptr;
+		cdtime_t tmp;
 
-		endptr = NULL;
-		errno = 0;
-		tmp = strtol (value, &endptr, 0);
-
-		if ((errno == 0) && (endptr != NULL)
-				&& (endptr != value) && (tmp > 0))
+		if ((parse_cdtime (value, &tmp) == 0) && (tmp > 0))
 			vl->interval = tmp;
 	}
 	else
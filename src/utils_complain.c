@@ -30,6 +30,7 @@ static int vcomplain (int level, c_complain_t *c,
 		const char *format, va_list ap)
 {
 	time_t now;
+	time_t min_interval;
 	char   message[512];
 
 	now = time (NULL);
@@ -39,8 +40,13 @@ static int vcomplain (int level, c_complain_t *c,
 
 	c->last = now;
 
-	if (c->interval < interval_g)
-		c->interval = interval_g;
+	/* The interval is counted in whole seconds. */
+	min_interval = CDTIME_T_TO_TIME_T (interval_g);
+	if (min_interval < 1)
+		min_interval = 1;
+
+	if (c->interval < min_interval)
+		c->interval = min_interval;
 	else
 		c->interval *= 2;
 
@@ -62,6 +62,10 @@ struct udb_query_s /* {{{ */
   unsigned int min_version;
   unsigned int max_version;
 
+  /* If non-zero, the time it took to execute the query is dispatched, see
+   * udb_query_submit_time(). */
+  _Bool report_time;
+
   udb_result_t *results;
 }; /* }}} */
 
@@ -231,7 +235,7 @@ static int udb_legacy_result_handle_result (udb_result_t *r, /* {{{ */
   }
 
   if (q_area->interval > 0)
-    vl.interval = q_area->interval;
+    vl.interval = TIME_T_TO_CDTIME_T (q_area->interval);
 
   sstrncpy (vl.host, q_area->host, sizeof (vl.host));
   sstrncpy (vl.plugin, q_area->plugin, sizeof (vl.plugin));
@@ -394,7 +398,7 @@ static int udb_result_submit (udb_result_t *r, /* {{{ */
   }
 
   if (q_area->interval > 0)
-    vl.interval = q_area->interval;
+    vl.interval = TIME_T_TO_CDTIME_T (q_area->interval);
 
   sstrncpy (vl.host, q_area->host, sizeof (vl.host));
   sstrncpy (vl.plugin, q_area->plugin, sizeof (vl.plugin));
@@ -816,6 +820,8 @@ int udb_query_create (udb_query_t ***ret_query_list, /* {{{ */
       status = udb_config_set_uint (&q->min_version, child);
     else if (strcasecmp ("MaxVersion", child->key) == 0)
       status = udb_config_set_uint (&q->max_version, child);
+    else if (strcasecmp ("ReportTime", child->key) == 0)
+      status = cf_util_get_boolean (child, &q->report_time);
 
     /* PostgreSQL compatibility code */
     else if ((strcasecmp ("Query", child->key) == 0)
@@ -1065,6 +1071,49 @@ int udb_query_check_version (udb_query_t *q, unsigned int version) /* {{{ */
   return (1);
 } /* }}} int udb_query_check_version */
 
+int udb_query_submit_time (udb_query_t const *q, /* {{{ */
+    const char *host, const char *plugin, const char *db_name,
+    int interval, const struct timeval *begin)
+{
+  value_list_t vl = VALUE_LIST_INIT;
+  value_t value;
+  struct timeval end;
+
+  if ((q == NULL) || (begin == NULL))
+    return (-EINVAL);
+
+  if (! q->report_time)
+    return (0);
+
+  if (gettimeofday (&end, /* timezone = */ NULL) != 0)
+  {
+    char errbuf[1024];
+    ERROR ("db query utils: udb_query_submit_time: gettimeofday failed: %s",
+        sstrerror (errno, errbuf, sizeof (errbuf)));
+    return (-1);
+  }
+
+  value.gauge = ((gauge_t) (end.tv_sec - begin->tv_sec))
+    + (((gauge_t) (end.tv_usec - begin->tv_usec)) / 1000000.0);
+  if (value.gauge < 0.0)
+    value.gauge = NAN;
+
+  vl.values = &value;
+  vl.values_len = 1;
+
+  if (interval > 0)
+    vl.interval = TIME_T_TO_CDTIME_T (interval);
+
+  sstrncpy (vl.host, host, sizeof (vl.host));
+  sstrncpy (vl.plugin, plugin, sizeof (vl.plugin));
+  sstrncpy (vl.plugin_instance, db_name, sizeof (vl.plugin_instance));
+  sstrncpy (vl.type, "response_time", sizeof (vl.type));
+  sstrncpy (vl.type_instance, q->name, sizeof (vl.type_instance));
+
+  plugin_dispatch_values (&vl);
+  return (0);
+} /* }}} int udb_query_submit_time */
+
 void udb_query_finish_result (udb_query_t const *q, /* {{{ */
     udb_query_preparation_area_t *prep_area)
 {
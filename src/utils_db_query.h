@@ -74,6 +74,17 @@ int udb_query_handle_result (udb_query_t const *q,
 void udb_query_finish_result (udb_query_t const *q,
     udb_query_preparation_area_t *prep_area);
 
+/*
+ * udb_query_submit_time
+ *
+ * Dispatches the time passed since `begin' as the execution time of the
+ * query, if the `ReportTime' option has been enabled for it. Returns 0 if
+ * the option is disabled.
+ */
+int udb_query_submit_time (udb_query_t const *q,
+    const char *host, const char *plugin, const char *db_name,
+    int interval, const struct timeval *begin);
+
 udb_query_preparation_area_t *
 udb_query_allocate_preparation_area (udb_query_t *q);
 void
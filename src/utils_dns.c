@@ -155,10 +155,6 @@ typedef int (printer)(const char *, ...);
 /*
  * Global variables
  */
-int qtype_counts[T_MAX];
-int opcode_counts[OP_MAX];
-int qclass_counts[C_MAX];
-
 #if HAVE_PCAP_H
 static pcap_t *pcap_obj = NULL;
 #endif
@@ -400,11 +396,6 @@ handle_dns(const char *buf, int len)
 
     qh.length = (uint16_t) len;
 
-    /* gather stats */
-    qtype_counts[qh.qtype]++;
-    qclass_counts[qh.qclass]++;
-    opcode_counts[qh.opcode]++;
-
     if (Callback != NULL)
 	    Callback (&qh);
 
@@ -639,54 +630,69 @@ handle_linux_sll (const u_char *pkt, int len)
 }
 #endif /* DLT_LINUX_SLL */
 
-/* public function */
-void handle_pcap(u_char *udata, const struct pcap_pkthdr *hdr, const u_char *pkt)
+/* public function
+ * Parses one captured packet of the given data link type. Unlike
+ * handle_pcap() this does not use any global state besides the (read-only)
+ * ignore list and callback, so it may be called from several threads. */
+int handle_packet(int datalink, const u_char *pkt, int caplen)
 {
     int status;
 
-    DEBUG ("handle_pcap (udata = %p, hdr = %p, pkt = %p): hdr->caplen = %i\n",
-		    (void *) udata, (void *) hdr, (void *) pkt,
-		    hdr->caplen);
-
-    if (hdr->caplen < ETHER_HDR_LEN)
-	return;
+    if (caplen < ETHER_HDR_LEN)
+	return (0);
+    /* The handle_* functions copy the packet into buffers of this size. */
+    if (caplen > PCAP_SNAPLEN)
+	caplen = PCAP_SNAPLEN;
 
-    switch (pcap_datalink (pcap_obj))
+    switch (datalink)
     {
 	case DLT_EN10MB:
-	    status = handle_ether (pkt, hdr->caplen);
+	    status = handle_ether (pkt, caplen);
 	    break;
 #if HAVE_NET_IF_PPP_H
 	case DLT_PPP:
-	    status = handle_ppp (pkt, hdr->caplen);
+	    status = handle_ppp (pkt, caplen);
 	    break;
 #endif
 #ifdef DLT_LOOP
 	case DLT_LOOP:
-	    status = handle_loop (pkt, hdr->caplen);
+	    status = handle_loop (pkt, caplen);
 	    break;
 #endif
 #ifdef DLT_RAW
 	case DLT_RAW:
-	    status = handle_raw (pkt, hdr->caplen);
+	    status = handle_raw (pkt, caplen);
 	    break;
 #endif
 #ifdef DLT_LINUX_SLL
 	case DLT_LINUX_SLL:
-	    status = handle_linux_sll (pkt, hdr->caplen);
+	    status = handle_linux_sll (pkt, caplen);
 	    break;
 #endif
 	case DLT_NULL:
-	    status = handle_null (pkt, hdr->caplen);
+	    status = handle_null (pkt, caplen);
 	    break;
 
 	default:
-	    ERROR ("handle_pcap: unsupported data link type %d\n",
-		    pcap_datalink(pcap_obj));
+	    ERROR ("handle_packet: unsupported data link type %d\n",
+		    datalink);
 	    status = 0;
 	    break;
-    } /* switch (pcap_datalink(pcap_obj)) */
+    } /* switch (datalink) */
+
+    return (status);
+} /* int handle_packet */
+
+/* public function */
+void handle_pcap(u_char *udata, const struct pcap_pkthdr *hdr, const u_char *pkt)
+{
+    int status;
+
+    DEBUG ("handle_pcap (udata = %p, hdr = %p, pkt = %p): hdr->caplen = %i\n",
+		    (void *) udata, (void *) hdr, (void *) pkt,
+		    hdr->caplen);
 
+    status = handle_packet (pcap_datalink (pcap_obj), pkt, hdr->caplen);
     if (0 == status)
 	return;
 
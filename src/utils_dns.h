@@ -70,10 +70,6 @@ struct rfc1035_header_s {
 };
 typedef struct rfc1035_header_s rfc1035_header_t;
 
-extern int qtype_counts[T_MAX];
-extern int opcode_counts[OP_MAX];
-extern int qclass_counts[C_MAX];
-
 #if HAVE_PCAP_H
 void dnstop_set_pcap_obj (pcap_t *po);
 #endif
@@ -81,6 +77,7 @@ void dnstop_set_callback (void (*cb) (const rfc1035_header_t *));
 
 void ignore_list_add_name (const char *name);
 #if HAVE_PCAP_H
+int handle_packet (int datalink, const u_char *pkt, int caplen);
 void handle_pcap (u_char * udata, const struct pcap_pkthdr *hdr, const u_char * pkt);
 #endif
 
@@ -56,64 +56,100 @@
 #include "common.h"
 #include "plugin.h"
 #include "utils_ignorelist.h"
+#include "utils_avltree.h"
+
+#include <pthread.h>
+
+/* Maximum number of match results remembered per list. When the limit is
+ * reached, the cache is cleared, so instances which went away (e. g. virtual
+ * interfaces of containers) don't accumulate. */
+#define IGNORELIST_CACHE_MAX 4096
+
+/* Values stored in the match cache. Zero can not be used, because the cache
+ * stores pointers. */
+#define IGNORELIST_CACHE_NOMATCH ((void *) 1)
+#define IGNORELIST_CACHE_MATCH   ((void *) 2)
 
 /*
  * private prototypes
  */
-struct ignorelist_item_s
+struct ignorelist_s
 {
+	int ignore;		/* ignore entries */
+
+	c_avl_tree_t *strings;	/* string entries */
+	int strings_num;
+
 #if HAVE_REGEX_H
-	regex_t *rmatch;	/* regular expression entry identification */
+	regex_t *regex_list;	/* regular expression entries */
+	char   **regex_source;	/* ... and their source */
+	int      regex_num;
+
+	/* All regular expressions combined into one, so each string is only
+	 * checked once. Built on first use. */
+	regex_t *regex_combined;
+	int      regex_combined_done;
 #endif
-	char *smatch;		/* string entry identification */
-	struct ignorelist_item_s *next;
-};
-typedef struct ignorelist_item_s ignorelist_item_t;
 
-struct ignorelist_s
-{
-	int ignore;		/* ignore entries */
-	ignorelist_item_t *head;	/* pointer to the first entry */
+	c_avl_tree_t *cache;	/* entry -> IGNORELIST_CACHE_* */
+	int cache_num;
+
+	pthread_mutex_t lock;
 };
 
 /* *** *** *** ********************************************* *** *** *** */
 /* *** *** *** *** *** ***   private functions   *** *** *** *** *** *** */
 /* *** *** *** ********************************************* *** *** *** */
 
-static inline void ignorelist_append (ignorelist_t *il, ignorelist_item_t *item)
+static void ignorelist_free_tree (c_avl_tree_t *tree)
 {
-	assert ((il != NULL) && (item != NULL));
+	void *key;
+	void *value;
+
+	if (tree == NULL)
+		return;
 
-	item->next = il->head;
-	il->head = item;
+	while (c_avl_pick (tree, &key, &value) == 0)
+		sfree (key);
+	c_avl_destroy (tree);
+}
+
+/* Forgets all cached match results. The lock must be held (or the list not
+ * be in use yet). */
+static void ignorelist_cache_clear (ignorelist_t *il)
+{
+	void *key;
+	void *value;
+
+	if (il->cache == NULL)
+		return;
+
+	while (c_avl_pick (il->cache, &key, &value) == 0)
+		sfree (key);
+	il->cache_num = 0;
 }
 
 #if HAVE_REGEX_H
 static int ignorelist_append_regex(ignorelist_t *il, const char *entry)
 {
 	int rcompile;
-	regex_t *regtemp;
+	regex_t regtemp;
+	regex_t *list_new;
+	char **source_new;
 	int errsize;
 	char *regerr = NULL;
-	ignorelist_item_t *new;
 
-	/* create buffer */
-	if ((regtemp = malloc(sizeof(regex_t))) == NULL)
-	{
-		ERROR ("cannot allocate new config entry");
-		return (1);
-	}
-	memset (regtemp, '\0', sizeof(regex_t));
+	memset (&regtemp, '\0', sizeof(regex_t));
 
 	/* compile regex */
-	if ((rcompile = regcomp (regtemp, entry, REG_EXTENDED)) != 0)
+	if ((rcompile = regcomp (&regtemp, entry, REG_EXTENDED | REG_NOSUB)) != 0)
 	{
 		/* prepare message buffer */
-		errsize = regerror(rcompile, regtemp, NULL, 0);
+		errsize = regerror(rcompile, &regtemp, NULL, 0);
 		if (errsize)
 			regerr = smalloc(errsize);
 		/* get error message */
-		if (regerror (rcompile, regtemp, regerr, errsize))
+		if (regerror (rcompile, &regtemp, regerr, errsize))
 		{
 			fprintf (stderr, "Cannot compile regex %s: %i/%s",
 					entry, rcompile, regerr);
@@ -130,79 +166,172 @@ static int ignorelist_append_regex(ignorelist_t *il, const char *entry)
 
 		if (errsize)
 			sfree (regerr);
-		regfree (regtemp);
+		regfree (&regtemp);
 		return (1);
 	}
 	DEBUG("regex compiled: %s - %i", entry, rcompile);
 
 	/* create new entry */
-	if ((new = malloc(sizeof(ignorelist_item_t))) == NULL)
+	list_new = realloc (il->regex_list,
+			(il->regex_num + 1) * sizeof (*il->regex_list));
+	if (list_new == NULL)
+	{
+		ERROR ("cannot allocate new config entry");
+		regfree (&regtemp);
+		return (1);
+	}
+	il->regex_list = list_new;
+
+	source_new = realloc (il->regex_source,
+			(il->regex_num + 1) * sizeof (*il->regex_source));
+	if (source_new == NULL)
 	{
 		ERROR ("cannot allocate new config entry");
-		regfree (regtemp);
+		regfree (&regtemp);
 		return (1);
 	}
-	memset (new, '\0', sizeof(ignorelist_item_t));
-	new->rmatch = regtemp;
+	il->regex_source = source_new;
 
 	/* append new entry */
-	ignorelist_append (il, new);
+	il->regex_list[il->regex_num] = regtemp;
+	il->regex_source[il->regex_num] = sstrdup (entry);
+	il->regex_num++;
 
 	return (0);
 } /* int ignorelist_append_regex(ignorelist_t *il, const char *entry) */
-#endif
 
-static int ignorelist_append_string(ignorelist_t *il, const char *entry)
+/*
+ * combine all regular expressions into one "(re1)|(re2)|..." expression.
+ * expressions using back-references can't be combined, because the group
+ * numbers change. in that case, the expressions are matched one by one.
+ */
+static void ignorelist_combine_regex (ignorelist_t *il)
 {
-	ignorelist_item_t *new;
+	char *pattern;
+	size_t pattern_size;
+	regex_t *combined;
+	int status;
+	int i;
 
-	/* create new entry */
-	if ((new = malloc(sizeof(ignorelist_item_t))) == NULL )
+	il->regex_combined_done = 1;
+
+	if (il->regex_num < 2)
+		return;
+
+	pattern_size = 1;
+	for (i = 0; i < il->regex_num; i++)
 	{
-		ERROR ("cannot allocate new entry");
-		return (1);
+		const char *ptr;
+
+		for (ptr = il->regex_source[i]; *ptr != 0; ptr++)
+			if ((ptr[0] == '\\') && isdigit ((int) ptr[1]))
+				return;
+
+		pattern_size += strlen (il->regex_source[i]) + 3;
 	}
-	memset (new, '\0', sizeof(ignorelist_item_t));
-	new->smatch = sstrdup(entry);
 
-	/* append new entry */
-	ignorelist_append (il, new);
+	pattern = malloc (pattern_size);
+	combined = malloc (sizeof (*combined));
+	if ((pattern == NULL) || (combined == NULL))
+	{
+		sfree (pattern);
+		sfree (combined);
+		return;
+	}
 
-	return (0);
-} /* int ignorelist_append_string(ignorelist_t *il, const char *entry) */
+	pattern[0] = 0;
+	for (i = 0; i < il->regex_num; i++)
+	{
+		if (i != 0)
+			strcat (pattern, "|");
+		strcat (pattern, "(");
+		strcat (pattern, il->regex_source[i]);
+		strcat (pattern, ")");
+	}
+
+	memset (combined, 0, sizeof (*combined));
+	status = regcomp (combined, pattern, REG_EXTENDED | REG_NOSUB);
+	if (status != 0)
+	{
+		DEBUG ("ignorelist: Combining the regular expressions failed; "
+				"matching them one by one.");
+		sfree (combined);
+	}
+	else
+	{
+		il->regex_combined = combined;
+	}
+
+	sfree (pattern);
+} /* void ignorelist_combine_regex */
 
-#if HAVE_REGEX_H
 /*
  * check list for entry regex match
  * return 1 if found
  */
-static int ignorelist_match_regex (ignorelist_item_t *item, const char *entry)
+static int ignorelist_match_regex (ignorelist_t *il, const char *entry)
 {
-	assert ((item != NULL) && (item->rmatch != NULL)
-			&& (entry != NULL) && (strlen (entry) > 0));
+	int i;
 
-	/* match regex */
-	if (regexec (item->rmatch, entry, 0, NULL, 0) == 0)
-		return (1);
+	if (il->regex_num == 0)
+		return (0);
+
+	if (!il->regex_combined_done)
+		ignorelist_combine_regex (il);
+
+	if (il->regex_combined != NULL)
+		return (regexec (il->regex_combined, entry, 0, NULL, 0) == 0);
+
+	for (i = 0; i < il->regex_num; i++)
+		if (regexec (il->regex_list + i, entry, 0, NULL, 0) == 0)
+			return (1);
 
 	return (0);
-} /* int ignorelist_match_regex (ignorelist_item_t *item, const char *entry) */
+} /* int ignorelist_match_regex (ignorelist_t *il, const char *entry) */
 #endif
 
+static int ignorelist_append_string(ignorelist_t *il, const char *entry)
+{
+	char *key;
+	int status;
+
+	key = sstrdup (entry);
+
+	/* append new entry */
+	status = c_avl_insert (il->strings, key, /* value = */ NULL);
+	if (status < 0)
+	{
+		ERROR ("cannot allocate new entry");
+		sfree (key);
+		return (1);
+	}
+	else if (status > 0) /* duplicate */
+	{
+		sfree (key);
+		return (0);
+	}
+
+	il->strings_num++;
+	return (0);
+} /* int ignorelist_append_string(ignorelist_t *il, const char *entry) */
+
 /*
- * check list for entry string match
+ * check whether any entry matches, ignoring the cache
  * return 1 if found
  */
-static int ignorelist_match_string (ignorelist_item_t *item, const char *entry)
+static int ignorelist_match_entries (ignorelist_t *il, const char *entry)
 {
-	assert ((item != NULL) && (item->smatch != NULL)
-			&& (entry != NULL) && (strlen (entry) > 0));
+	if ((il->strings_num > 0)
+			&& (c_avl_get (il->strings, entry, /* value = */ NULL) == 0))
+		return (1);
 
-	if (strcmp (entry, item->smatch) == 0)
+#if HAVE_REGEX_H
+	if (ignorelist_match_regex (il, entry))
 		return (1);
+#endif
 
 	return (0);
-} /* int ignorelist_match_string (ignorelist_item_t *item, const char *entry) */
+} /* int ignorelist_match_entries (ignorelist_t *il, const char *entry) */
 
 
 /* *** *** *** ******************************************** *** *** *** */
@@ -227,6 +356,21 @@ ignorelist_t *ignorelist_create (int invert)
 	 */
 	il->ignore = invert ? 0 : 1;
 
+	il->strings = c_avl_create ((int (*) (const void *, const void *))
+			strcmp);
+	il->cache = c_avl_create ((int (*) (const void *, const void *))
+			strcmp);
+	if ((il->strings == NULL) || (il->cache == NULL))
+	{
+		ERROR ("ignorelist_create: c_avl_create failed.");
+		ignorelist_free_tree (il->strings);
+		ignorelist_free_tree (il->cache);
+		sfree (il);
+		return (NULL);
+	}
+
+	pthread_mutex_init (&il->lock, /* attr = */ NULL);
+
 	return (il);
 } /* ignorelist_t *ignorelist_create (int ignore) */
 
@@ -235,29 +379,36 @@ ignorelist_t *ignorelist_create (int invert)
  */
 void ignorelist_free (ignorelist_t *il)
 {
-	ignorelist_item_t *this;
-	ignorelist_item_t *next;
+#if HAVE_REGEX_H
+	int i;
+#endif
 
 	if (il == NULL)
 		return;
 
-	for (this = il->head; this != NULL; this = next)
-	{
-		next = this->next;
+	ignorelist_free_tree (il->strings);
+	il->strings = NULL;
+
+	ignorelist_free_tree (il->cache);
+	il->cache = NULL;
+
 #if HAVE_REGEX_H
-		if (this->rmatch != NULL)
-		{
-			regfree (this->rmatch);
-			this->rmatch = NULL;
-		}
-#endif
-		if (this->smatch != NULL)
-		{
-			sfree (this->smatch);
-			this->smatch = NULL;
-		}
-		sfree (this);
+	for (i = 0; i < il->regex_num; i++)
+	{
+		regfree (il->regex_list + i);
+		sfree (il->regex_source[i]);
 	}
+	sfree (il->regex_list);
+	sfree (il->regex_source);
+
+	if (il->regex_combined != NULL)
+	{
+		regfree (il->regex_combined);
+		sfree (il->regex_combined);
+	}
+#endif
+
+	pthread_mutex_destroy (&il->lock);
 
 	sfree (il);
 	il = NULL;
@@ -301,6 +452,11 @@ int ignorelist_add (ignorelist_t *il, const char *entry)
 		return (1);
 	}
 
+	pthread_mutex_lock (&il->lock);
+
+	/* cached results may be outdated now */
+	ignorelist_cache_clear (il);
+
 #if HAVE_REGEX_H
 	/* regex string is enclosed in "/.../" */
 	if ((entry_len > 2) && (entry[0] == '/') && entry[entry_len - 1] == '/')
@@ -316,6 +472,14 @@ int ignorelist_add (ignorelist_t *il, const char *entry)
 		DEBUG("I'm about to add regex entry: %s", entry_copy);
 		ret = ignorelist_append_regex(il, entry_copy);
 		sfree (entry_copy);
+
+		/* rebuild the combined expression with the next match */
+		if (il->regex_combined != NULL)
+		{
+			regfree (il->regex_combined);
+			sfree (il->regex_combined);
+		}
+		il->regex_combined_done = 0;
 	}
 	else
 #endif
@@ -324,6 +488,8 @@ int ignorelist_add (ignorelist_t *il, const char *entry)
 		ret = ignorelist_append_string(il, entry);
 	}
 
+	pthread_mutex_unlock (&il->lock);
+
 	return (ret);
 } /* int ignorelist_add (ignorelist_t *il, const char *entry) */
 
@@ -333,32 +499,51 @@ int ignorelist_add (ignorelist_t *il, const char *entry)
  */
 int ignorelist_match (ignorelist_t *il, const char *entry)
 {
-	ignorelist_item_t *traverse;
+	void *cached = NULL;
+	int match;
 
 	/* if no entries, collect all */
-	if ((il == NULL) || (il->head == NULL))
+	if (il == NULL)
 		return (0);
 
-	if ((entry == NULL) || (strlen (entry) == 0))
+	if ((entry == NULL) || (entry[0] == 0))
 		return (0);
 
-	/* traverse list and check entries */
-	for (traverse = il->head; traverse != NULL; traverse = traverse->next)
-	{
+	pthread_mutex_lock (&il->lock);
+
+	if ((il->strings_num == 0)
 #if HAVE_REGEX_H
-		if (traverse->rmatch != NULL)
-		{
-			if (ignorelist_match_regex (traverse, entry))
-				return (il->ignore);
-		}
-		else
+			&& (il->regex_num == 0)
 #endif
-		{
-			if (ignorelist_match_string (traverse, entry))
-				return (il->ignore);
-		}
-	} /* for traverse */
+	   )
+	{
+		pthread_mutex_unlock (&il->lock);
+		return (0);
+	}
 
-	return (1 - il->ignore);
-} /* int ignorelist_match (ignorelist_t *il, const char *entry) */
+	if (c_avl_get (il->cache, entry, &cached) == 0)
+	{
+		match = (cached == IGNORELIST_CACHE_MATCH);
+	}
+	else
+	{
+		char *key;
+
+		match = ignorelist_match_entries (il, entry);
+
+		if (il->cache_num >= IGNORELIST_CACHE_MAX)
+			ignorelist_cache_clear (il);
+
+		key = strdup (entry);
+		if ((key != NULL) && (c_avl_insert (il->cache, key,
+						match ? IGNORELIST_CACHE_MATCH
+						: IGNORELIST_CACHE_NOMATCH) == 0))
+			il->cache_num++;
+		else
+			sfree (key);
+	}
 
+	pthread_mutex_unlock (&il->lock);
+
+	return (match ? il->ignore : (1 - il->ignore));
+} /* int ignorelist_match (ignorelist_t *il, const char *entry) */
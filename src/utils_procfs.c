@@ -0,0 +1,290 @@
+/**
+ * collectd - src/utils_procfs.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ **/
+
+#include "collectd.h"
+#include "common.h"
+#include "utils_procfs.h"
+
+#define CU_PROCFS_BUFFER_MIN 4096
+
+struct cu_procfs_s
+{
+	char *file;
+	int fd;
+
+	/* Set if the file doesn't support pread(2). */
+	_Bool no_pread;
+
+	char *buffer;
+	size_t buffer_size;
+};
+
+#define CU_PROCFS_IS_BLANK(c) (((c) == ' ') || ((c) == '\t') \
+		|| ((c) == '\r') || ((c) == '\n'))
+
+static int cu_procfs_open (cu_procfs_t *obj)
+{
+	if (obj->fd >= 0)
+		close (obj->fd);
+
+	obj->fd = open (obj->file, O_RDONLY);
+	if (obj->fd < 0)
+		return (-1);
+
+	return (0);
+} /* int cu_procfs_open */
+
+static ssize_t cu_procfs_pread (cu_procfs_t *obj, char *buf, size_t len,
+		off_t offset)
+{
+	ssize_t status;
+
+	if (!obj->no_pread)
+	{
+		status = pread (obj->fd, buf, len, offset);
+		if ((status >= 0) || (errno != ESPIPE))
+			return (status);
+		obj->no_pread = 1;
+	}
+
+	/* Files are read sequentially, so only the first read has to seek. */
+	if ((offset == 0) && (lseek (obj->fd, 0, SEEK_SET) == (off_t) -1)
+			&& (errno != ESPIPE))
+		return (-1);
+
+	return (read (obj->fd, buf, len));
+} /* ssize_t cu_procfs_pread */
+
+/* Reads the file into the buffer. Returns the number of bytes read or -1 on
+ * failure. */
+static ssize_t cu_procfs_fill (cu_procfs_t *obj)
+{
+	size_t len = 0;
+
+	while (42)
+	{
+		ssize_t status;
+
+		/* Keep room for the terminating null byte. */
+		if ((obj->buffer_size - len) < 2)
+		{
+			size_t size = 2 * obj->buffer_size;
+			char *tmp;
+
+			tmp = (char *) realloc (obj->buffer, size);
+			if (tmp == NULL)
+			{
+				errno = ENOMEM;
+				return (-1);
+			}
+			obj->buffer = tmp;
+			obj->buffer_size = size;
+		}
+
+		status = cu_procfs_pread (obj, obj->buffer + len,
+				obj->buffer_size - len - 1, (off_t) len);
+		if (status < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		else if (status == 0)
+		{
+			break;
+		}
+
+		len += (size_t) status;
+	}
+
+	obj->buffer[len] = 0;
+	return ((ssize_t) len);
+} /* ssize_t cu_procfs_fill */
+
+cu_procfs_t *cu_procfs_create (const char *file)
+{
+	cu_procfs_t *obj;
+
+	obj = (cu_procfs_t *) malloc (sizeof (*obj));
+	if (obj == NULL)
+		return (NULL);
+	memset (obj, 0, sizeof (*obj));
+	obj->fd = -1;
+
+	obj->file = strdup (file);
+	obj->buffer = (char *) malloc (CU_PROCFS_BUFFER_MIN);
+	if ((obj->file == NULL) || (obj->buffer == NULL))
+	{
+		cu_procfs_destroy (obj);
+		errno = ENOMEM;
+		return (NULL);
+	}
+	obj->buffer_size = CU_PROCFS_BUFFER_MIN;
+	obj->buffer[0] = 0;
+
+	if (cu_procfs_open (obj) != 0)
+	{
+		int saved_errno = errno;
+
+		cu_procfs_destroy (obj);
+		errno = saved_errno;
+		return (NULL);
+	}
+
+	return (obj);
+} /* cu_procfs_t *cu_procfs_create */
+
+void cu_procfs_destroy (cu_procfs_t *obj)
+{
+	if (obj == NULL)
+		return;
+
+	if (obj->fd >= 0)
+		close (obj->fd);
+	sfree (obj->file);
+	sfree (obj->buffer);
+	free (obj);
+} /* void cu_procfs_destroy */
+
+char *cu_procfs_read (cu_procfs_t *obj, size_t *ret_len)
+{
+	ssize_t len;
+
+	if (obj == NULL)
+	{
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	len = -1;
+	if (obj->fd >= 0)
+		len = cu_procfs_fill (obj);
+
+	/* The file may have been replaced, e.g. when the entries below /proc/net
+	 * belong to another network namespace. Try opening it again, once. */
+	if ((len < 0) && (errno != ENOMEM))
+	{
+		if (cu_procfs_open (obj) != 0)
+			return (NULL);
+		len = cu_procfs_fill (obj);
+	}
+
+	if (len < 0)
+		return (NULL);
+
+	if (ret_len != NULL)
+		*ret_len = (size_t) len;
+	return (obj->buffer);
+} /* char *cu_procfs_read */
+
+char *cu_procfs_line (char **ptr)
+{
+	char *line;
+	char *end;
+
+	line = *ptr;
+	if ((line == NULL) || (*line == 0))
+		return (NULL);
+
+	end = strchr (line, '\n');
+	if (end == NULL)
+	{
+		*ptr = line + strlen (line);
+	}
+	else
+	{
+		*end = 0;
+		*ptr = end + 1;
+	}
+
+	return (line);
+} /* char *cu_procfs_line */
+
+int cu_procfs_fields (char *string, char **fields, size_t size)
+{
+	size_t i = 0;
+	char *ptr = string;
+
+	while (i < size)
+	{
+		while (CU_PROCFS_IS_BLANK (*ptr))
+			ptr++;
+		if (*ptr == 0)
+			break;
+
+		fields[i] = ptr;
+		i++;
+
+		while ((*ptr != 0) && !CU_PROCFS_IS_BLANK (*ptr))
+			ptr++;
+		if (*ptr == 0)
+			break;
+
+		*ptr = 0;
+		ptr++;
+	}
+
+	return ((int) i);
+} /* int cu_procfs_fields */
+
+uint64_t cu_procfs_u64 (const char *str)
+{
+	uint64_t ret = 0;
+
+	while (CU_PROCFS_IS_BLANK (*str))
+		str++;
+
+	while ((*str >= '0') && (*str <= '9'))
+	{
+		ret = (10 * ret) + (uint64_t) (*str - '0');
+		str++;
+	}
+
+	return (ret);
+} /* uint64_t cu_procfs_u64 */
+
+int cu_procfs_parse_u64 (const char *str, uint64_t *ret)
+{
+	uint64_t value = 0;
+	const char *start;
+
+	while (CU_PROCFS_IS_BLANK (*str))
+		str++;
+
+	start = str;
+	while ((*str >= '0') && (*str <= '9'))
+	{
+		uint64_t digit = (uint64_t) (*str - '0');
+
+		if (value > ((UINT64_MAX - digit) / 10))
+			return (ERANGE);
+
+		value = (10 * value) + digit;
+		str++;
+	}
+
+	if (str == start)
+		return (EINVAL);
+
+	while (CU_PROCFS_IS_BLANK (*str))
+		str++;
+	if (*str != 0)
+		return (EINVAL);
+
+	*ret = value;
+	return (0);
+} /* int cu_procfs_parse_u64 */
@@ -0,0 +1,92 @@
+/**
+ * collectd - src/utils_procfs.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * DESCRIPTION
+ *   Reads files which are re-generated by the kernel on every read, such as
+ *   the files below /proc, without opening them again each time. The
+ *   contents are read into a buffer owned by the object and can be split
+ *   into lines and fields in place.
+ **/
+
+#ifndef UTILS_PROCFS_H
+#define UTILS_PROCFS_H 1
+
+#include "collectd.h"
+
+struct cu_procfs_s;
+typedef struct cu_procfs_s cu_procfs_t;
+
+/*
+ * cu_procfs_create
+ *
+ * Opens `file' and returns an object to read it with. Returns NULL and sets
+ * `errno' if the file cannot be opened.
+ */
+cu_procfs_t *cu_procfs_create (const char *file);
+
+/*
+ * cu_procfs_destroy
+ *
+ * Closes the file and frees the object and its buffer.
+ */
+void cu_procfs_destroy (cu_procfs_t *obj);
+
+/*
+ * cu_procfs_read
+ *
+ * Reads the whole file again, from the beginning. The buffer grows as
+ * necessary. Returns a pointer to the null-terminated contents, which may be
+ * modified by the caller and are valid until the next call, or NULL with
+ * `errno' set on failure. If `ret_len' is not NULL, the number of bytes read
+ * is stored there.
+ */
+char *cu_procfs_read (cu_procfs_t *obj, size_t *ret_len);
+
+/*
+ * cu_procfs_line
+ *
+ * Returns the line at `*ptr' and advances `*ptr' to the following line. The
+ * newline character is replaced by a null byte. Returns NULL when the end of
+ * the buffer has been reached.
+ */
+char *cu_procfs_line (char **ptr);
+
+/*
+ * cu_procfs_fields
+ *
+ * Splits `string' at blanks into at most `size' fields, in place, like
+ * `strsplit'. Returns the number of fields.
+ */
+int cu_procfs_fields (char *string, char **fields, size_t size);
+
+/*
+ * cu_procfs_u64
+ *
+ * Parses the unsigned decimal number at the beginning of `str', skipping
+ * leading blanks. Returns zero if there is no number, like atoll(3).
+ */
+uint64_t cu_procfs_u64 (const char *str);
+
+/*
+ * cu_procfs_parse_u64
+ *
+ * Like `cu_procfs_u64', but fails if `str' does not start with a number, if
+ * the number is followed by anything but blanks, or if it overflows. Returns
+ * zero on success.
+ */
+int cu_procfs_parse_u64 (const char *str, uint64_t *ret);
+
+#endif /* UTILS_PROCFS_H */
@@ -65,6 +65,18 @@ static void rra_free (int rra_num, char **rra_def) /* {{{ */
   sfree (rra_def);
 } /* }}} void rra_free */
 
+/* RRD files have a resolution of one second, so shorter intervals are
+ * rounded up. */
+static int rrd_interval (const value_list_t *vl) /* {{{ */
+{
+  time_t interval = CDTIME_T_TO_TIME_T (vl->interval);
+
+  if (TIME_T_TO_CDTIME_T (interval) < vl->interval)
+    interval++;
+
+  return ((int) interval);
+} /* }}} int rrd_interval */
+
 /* * * * * * * * * *
  * WARNING:  Magic *
  * * * * * * * * * */
@@ -103,7 +115,7 @@ static int rra_get (char ***ret, const value_list_t *vl, /* {{{ */
     return (-1);
   }
 
-  ss = (cfg->stepsize > 0) ? cfg->stepsize : vl->interval;
+  ss = (cfg->stepsize > 0) ? cfg->stepsize : rrd_interval (vl);
   if (ss <= 0)
   {
     *ret = NULL;
@@ -241,7 +253,7 @@ static int ds_get (char ***ret, /* {{{ */
     status = ssnprintf (buffer, sizeof (buffer),
         "DS:%s:%s:%i:%s:%s",
         d->name, type,
-        (cfg->heartbeat > 0) ? cfg->heartbeat : (2 * vl->interval),
+        (cfg->heartbeat > 0) ? cfg->heartbeat : (2 * rrd_interval (vl)),
         min, max);
     if ((status < 1) || ((size_t) status >= sizeof (buffer)))
       break;
@@ -367,6 +379,7 @@ int cu_rrd_create_file (const char *filename, /* {{{ */
   int rra_num;
   char **ds_def;
   int ds_num;
+  time_t last_up;
   int status = 0;
 
   if (check_create_dir (filename))
@@ -398,9 +411,13 @@ int cu_rrd_create_file (const char *filename, /* {{{ */
   memcpy (argv + ds_num, rra_def, rra_num * sizeof (char *));
   argv[ds_num + rra_num] = NULL;
 
+  last_up = CDTIME_T_TO_TIME_T (vl->time);
+  if (last_up > 10)
+    last_up -= 10;
+
   status = srrd_create (filename,
-      (cfg->stepsize > 0) ? cfg->stepsize : vl->interval,
-      (vl->time > 10) ? (vl->time - 10) : vl->time,
+      (cfg->stepsize > 0) ? cfg->stepsize : rrd_interval (vl),
+      last_up,
       argc, (const char **) argv);
 
   free (argv);
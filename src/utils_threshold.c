@@ -655,7 +655,7 @@ static int ut_report_state (const data_set_t *ds,
   else
     n.severity = NOTIF_FAILURE;
 
-  n.time = vl->time;
+  n.time = CDTIME_T_TO_TIME_T (vl->time);
 
   status = ssnprintf (buf, bufsize, "Host %s, plugin %s",
       vl->host, vl->plugin);
@@ -0,0 +1,55 @@
+/**
+ * collectd - src/utils_time.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ **/
+
+#include "collectd.h"
+#include "utils_time.h"
+
+cdtime_t cdtime (void) /* {{{ */
+{
+	struct timeval tv = { 0, 0 };
+#if HAVE_CLOCK_GETTIME
+	struct timespec ts = { 0, 0 };
+
+	if (clock_gettime (CLOCK_REALTIME, &ts) == 0)
+		return (TIMESPEC_TO_CDTIME_T (&ts));
+#endif
+
+	gettimeofday (&tv, /* struct timezone = */ NULL);
+	return (TIMEVAL_TO_CDTIME_T (&tv));
+} /* }}} cdtime_t cdtime */
+
+int parse_cdtime (const char *str, cdtime_t *ret) /* {{{ */
+{
+	char *endptr = NULL;
+	double value;
+
+	if ((str == NULL) || (ret == NULL))
+		return (EINVAL);
+
+	errno = 0;
+	value = strtod (str, &endptr);
+	if ((errno != 0) || (endptr == str))
+		return (EINVAL);
+
+	while (isspace ((int) *endptr))
+		endptr++;
+	if ((*endptr != 0) || !(value >= 0.0))
+		return (EINVAL);
+
+	*ret = DOUBLE_TO_CDTIME_T (value);
+	return (0);
+} /* }}} int parse_cdtime */
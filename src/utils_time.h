@@ -0,0 +1,82 @@
+/**
+ * collectd - src/utils_time.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * DESCRIPTION
+ *   Timestamps and intervals with a resolution finer than one second. A
+ *   `cdtime_t' counts units of 2^-30 seconds (a little less than one
+ *   nanosecond), so the upper 34 bits hold the seconds and the lower 30
+ *   bits the fraction. Converting from and to seconds is a simple shift and
+ *   the values can be sent over the network unchanged.
+ **/
+
+#ifndef UTILS_TIME_H
+#define UTILS_TIME_H 1
+
+#include "collectd.h"
+
+typedef uint64_t cdtime_t;
+
+#define TIME_T_TO_CDTIME_T(t) (((cdtime_t) (t)) << 30)
+#define CDTIME_T_TO_TIME_T(t) ((time_t) ((t) >> 30))
+
+#define CDTIME_T_TO_DOUBLE(t) (((double) (t)) / 1073741824.0)
+#define DOUBLE_TO_CDTIME_T(d) ((cdtime_t) ((d) * 1073741824.0))
+
+#define MS_TO_CDTIME_T(ms) ((cdtime_t) \
+		(((((cdtime_t) (ms)) / 1000) << 30) \
+		 | (((((cdtime_t) (ms)) % 1000) << 30) / 1000)))
+#define CDTIME_T_TO_MS(t) ((uint64_t) \
+		((((t) >> 30) * 1000) \
+		 + ((((t) & 0x3fffffff) * 1000) >> 30)))
+
+#define US_TO_CDTIME_T(us) ((cdtime_t) \
+		(((((cdtime_t) (us)) / 1000000) << 30) \
+		 | (((((cdtime_t) (us)) % 1000000) << 30) / 1000000)))
+#define NS_TO_CDTIME_T(ns) ((cdtime_t) \
+		(((((cdtime_t) (ns)) / 1000000000) << 30) \
+		 | (((((cdtime_t) (ns)) % 1000000000) << 30) / 1000000000)))
+
+#define TIMEVAL_TO_CDTIME_T(tv) (TIME_T_TO_CDTIME_T ((tv)->tv_sec) \
+		+ US_TO_CDTIME_T ((tv)->tv_usec))
+#define TIMESPEC_TO_CDTIME_T(ts) (TIME_T_TO_CDTIME_T ((ts)->tv_sec) \
+		+ NS_TO_CDTIME_T ((ts)->tv_nsec))
+
+#define CDTIME_T_TO_TIMEVAL(t,tv) do { \
+	(tv)->tv_sec  = CDTIME_T_TO_TIME_T (t); \
+	(tv)->tv_usec = (suseconds_t) ((((t) & 0x3fffffff) * 1000000) >> 30); \
+} while (0)
+#define CDTIME_T_TO_TIMESPEC(t,ts) do { \
+	(ts)->tv_sec  = CDTIME_T_TO_TIME_T (t); \
+	(ts)->tv_nsec = (long) ((((t) & 0x3fffffff) * 1000000000) >> 30); \
+} while (0)
+
+/*
+ * cdtime
+ *
+ * Returns the current (wall clock) time.
+ */
+cdtime_t cdtime (void);
+
+/*
+ * parse_cdtime
+ *
+ * Parses a number of seconds, e. g. "10" or "0.25", and stores it in `ret'.
+ * Returns zero on success. Negative numbers and trailing garbage are
+ * rejected.
+ */
+int parse_cdtime (const char *str, cdtime_t *ret);
+
+#endif /* UTILS_TIME_H */
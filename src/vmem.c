@@ -24,6 +24,8 @@
 #include "plugin.h"
 
 #if KERNEL_LINUX
+# include "utils_procfs.h"
+
 static const char *config_keys[] =
 {
   "Verbose"
@@ -31,6 +33,8 @@ static const char *config_keys[] =
 static int config_keys_num = STATIC_ARRAY_SIZE (config_keys);
 
 static int verbose_output = 0;
+
+static cu_procfs_t *proc_vmstat = NULL;
 /* #endif KERNEL_LINUX */
 
 #else
@@ -105,42 +109,49 @@ static int vmem_read (void)
   counter_t pgmajfault = 0;
   int pgfaultvalid = 0;
 
-  FILE *fh;
-  char buffer[1024];
+  char *buffer;
+  char *line;
+
+  if (proc_vmstat == NULL)
+  {
+    proc_vmstat = cu_procfs_create ("/proc/vmstat");
+    if (proc_vmstat == NULL)
+    {
+      char errbuf[1024];
+      ERROR ("vmem plugin: open (/proc/vmstat) failed: %s",
+	  sstrerror (errno, errbuf, sizeof (errbuf)));
+      return (-1);
+    }
+  }
 
-  fh = fopen ("/proc/vmstat", "r");
-  if (fh == NULL)
+  buffer = cu_procfs_read (proc_vmstat, NULL);
+  if (buffer == NULL)
   {
     char errbuf[1024];
-    ERROR ("vmem plugin: fopen (/proc/vmstat) failed: %s",
+    ERROR ("vmem plugin: reading /proc/vmstat failed: %s",
 	sstrerror (errno, errbuf, sizeof (errbuf)));
     return (-1);
   }
 
-  while (fgets (buffer, sizeof (buffer), fh) != NULL)
+  while ((line = cu_procfs_line (&buffer)) != NULL)
   {
     char *fields[4];
     int fields_num;
     char *key;
-    char *endptr;
+    uint64_t number;
     counter_t counter;
     gauge_t gauge;
 
-    fields_num = strsplit (buffer, fields, STATIC_ARRAY_SIZE (fields));
+    fields_num = cu_procfs_fields (line, fields, STATIC_ARRAY_SIZE (fields));
     if (fields_num != 2)
       continue;
 
     key = fields[0];
 
-    endptr = NULL;
-    counter = strtoll (fields[1], &endptr, 10);
-    if (fields[1] == endptr)
-      continue;
-
-    endptr = NULL;
-    gauge = strtod (fields[1], &endptr);
-    if (fields[1] == endptr)
+    if (cu_procfs_parse_u64 (fields[1], &number) != 0)
       continue;
+    counter = (counter_t) number;
+    gauge = (gauge_t) number;
 
     /* 
      * Number of pages
@@ -254,10 +265,7 @@ static int vmem_read (void)
       value_t value  = { .counter = counter };
       submit_one (NULL, "vmpage_action", "deactivate", value);
     }
-  } /* while (fgets) */
-
-  fclose (fh);
-  fh = NULL;
+  } /* while (cu_procfs_line) */
 
   if (pgfaultvalid == 0x03)
     submit_two (NULL, "vmpage_faults", NULL, pgfault, pgmajfault);
@@ -272,11 +280,20 @@ static int vmem_read (void)
   return (0);
 } /* int vmem_read */
 
+static int vmem_shutdown (void)
+{
+  cu_procfs_destroy (proc_vmstat);
+  proc_vmstat = NULL;
+
+  return (0);
+} /* int vmem_shutdown */
+
 void module_register (void)
 {
   plugin_register_config ("vmem", vmem_config,
       config_keys, config_keys_num);
   plugin_register_read ("vmem", vmem_read);
+  plugin_register_shutdown ("vmem", vmem_shutdown);
 } /* void module_register */
 
 /* vim: set sw=2 sts=2 ts=8 : */